@@ -9,3 +9,4 @@
 /* #undef MATH21_FLAG_IS_ANDROID */
 /* #undef MATH21_FLAG_IS_APPLE */
 #define MATH21_FLAG_IS_LINUX
+/* #undef MATH21_FLAG_TENSOR_INDEX_TABLE */
@@ -19,6 +19,7 @@ limitations under the License.
 #include <cstdio>
 #include <stdexcept>
 #include <vector>
+#include <utility>
 #include "inner.h"
 
 namespace math21 {
@@ -49,6 +50,11 @@ namespace math21 {
             B.copyTo(*this);
         }
 
+        // move constructor, elements are relocated, and B becomes empty.
+        Seqce(Seqce &&B) noexcept {
+            v.swap(B.v);
+        }
+
         // Copy constructor
         template<typename S>
         Seqce(const Seqce<S> &B) {
@@ -144,6 +150,11 @@ namespace math21 {
             v.push_back(x);
         }
 
+        // push back, x is moved.
+        void push(T &&x) {
+            v.push_back(std::move(x));
+        }
+
         // push back
         void push(const Seqce<T> &xs) {
             for (NumN i = 1; i <= xs.size(); ++i) {
@@ -243,6 +254,21 @@ namespace math21 {
             return *this;
         }
 
+        // Elements of B are taken when this is empty, or moved one by one.
+        Seqce<T> &operator=(Seqce<T> &&B) {
+            if (this == &B) {
+                return *this;
+            }
+            if (isEmpty()) {
+                v.swap(B.v);
+            } else {
+                MATH21_ASSERT(B.size() == size(),
+                              "vector size doesn't match in assign");
+                for (NumN i = 1; i <= size(); i++) (*this).at(i) = std::move(B.at(i));
+            }
+            return *this;
+        }
+
         //assignment
         template<typename S>
         Seqce<T> &operator=(const Seqce<S> &B) {
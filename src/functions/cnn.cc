@@ -13,9 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <cmath>
 #include <fstream>
 #include "../opt/SteepestDescent.h"
 #include "cnn.h"
+#include "cnn_data.h"
 
 namespace math21 {
 
@@ -103,6 +105,407 @@ namespace math21 {
         }
     }
 
+    namespace detail {
+        // max of window mk*nk at x with rows ld apart, offset is argmax w.r.t. x.
+        // The first max in row-major order is taken, as math21_operator_ml_pooling_valueAt does.
+        template<typename T>
+        inline T math21_c_ml_pooling_window_max(const T *x, NumN ld, NumN mk, NumN nk, NumN32 &offset) {
+            T max = x[0];
+            offset = 0;
+            for (NumN i2 = 0; i2 < mk; ++i2) {
+                const T *x_i2 = x + i2 * ld;
+                for (NumN i3 = 0; i3 < nk; ++i3) {
+                    if (x_i2[i3] > max) {
+                        max = x_i2[i3];
+                        offset = (NumN32) (i2 * ld + i3);
+                    }
+                }
+            }
+            return max;
+        }
+
+        // the same with size K*K fixed, so loops are unrolled by compiler.
+        template<NumN K, typename T>
+        inline T math21_c_ml_pooling_window_max_k(const T *x, NumN ld, NumN32 &offset) {
+            T max = x[0];
+            offset = 0;
+            for (NumN i2 = 0; i2 < K; ++i2) {
+                const T *x_i2 = x + i2 * ld;
+                for (NumN i3 = 0; i3 < K; ++i3) {
+                    if (x_i2[i3] > max) {
+                        max = x_i2[i3];
+                        offset = (NumN32) (i2 * ld + i3);
+                    }
+                }
+            }
+            return max;
+        }
+
+        // sum is NumR whatever T is.
+        template<typename T>
+        inline NumR math21_c_ml_pooling_window_sum(const T *x, NumN ld, NumN mk, NumN nk) {
+            NumR y = 0;
+            for (NumN i2 = 0; i2 < mk; ++i2) {
+                const T *x_i2 = x + i2 * ld;
+                for (NumN i3 = 0; i3 < nk; ++i3) {
+                    y = y + x_i2[i3];
+                }
+            }
+            return y;
+        }
+
+        template<NumN K, typename T>
+        inline NumR math21_c_ml_pooling_window_sum_k(const T *x, NumN ld) {
+            NumR y = 0;
+            for (NumN i2 = 0; i2 < K; ++i2) {
+                const T *x_i2 = x + i2 * ld;
+                for (NumN i3 = 0; i3 < K; ++i3) {
+                    y = y + x_i2[i3];
+                }
+            }
+            return y;
+        }
+
+        template<NumN K, typename T>
+        void math21_c_ml_pooling_max_planes_k(NumN n_planes, NumN m1, NumN n1, NumN P,
+                                              const NumN32 *window_offset,
+                                              const T *x, T *y, NumN32 *argmax) {
+            for (NumN i = 0; i < n_planes; ++i) {
+                const T *x_i = x + i * m1 * n1;
+                T *y_i = y + i * P;
+                NumN32 *argmax_i = argmax ? argmax + i * P : 0;
+                for (NumN p = 0; p < P; ++p) {
+                    NumN32 offset;
+                    y_i[p] = math21_c_ml_pooling_window_max_k<K, T>(x_i + window_offset[p], n1, offset);
+                    if (argmax_i) {
+                        argmax_i[p] = window_offset[p] + offset;
+                    }
+                }
+            }
+        }
+
+        template<NumN K, typename T>
+        void math21_c_ml_pooling_average_planes_k(NumN n_planes, NumN m1, NumN n1, NumN P,
+                                                  const NumN32 *window_offset,
+                                                  const T *x, T *y) {
+            for (NumN i = 0; i < n_planes; ++i) {
+                const T *x_i = x + i * m1 * n1;
+                T *y_i = y + i * P;
+                for (NumN p = 0; p < P; ++p) {
+                    y_i[p] = (T) (math21_c_ml_pooling_window_sum_k<K, T>(x_i + window_offset[p], n1) / (K * K));
+                }
+            }
+        }
+
+        template<typename T>
+        void math21_c_ml_pooling_valueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                         NumN mk, NumN nk, const NumN32 *window_offset,
+                                         const T *x, T *y, NumN32 *argmax) {
+            NumN i, p;
+            if (cnn_type_pooling == cnn_type_pooling_max) {
+                if (mk == 2 && nk == 2) {
+                    math21_c_ml_pooling_max_planes_k<2>(n_planes, m1, n1, P, window_offset, x, y, argmax);
+                } else if (mk == 3 && nk == 3) {
+                    math21_c_ml_pooling_max_planes_k<3>(n_planes, m1, n1, P, window_offset, x, y, argmax);
+                } else {
+                    for (i = 0; i < n_planes; ++i) {
+                        const T *x_i = x + i * m1 * n1;
+                        T *y_i = y + i * P;
+                        NumN32 *argmax_i = argmax ? argmax + i * P : 0;
+                        for (p = 0; p < P; ++p) {
+                            NumN32 offset;
+                            y_i[p] = math21_c_ml_pooling_window_max(x_i + window_offset[p], n1, mk, nk, offset);
+                            if (argmax_i) {
+                                argmax_i[p] = window_offset[p] + offset;
+                            }
+                        }
+                    }
+                }
+            } else if (cnn_type_pooling == cnn_type_pooling_average) {
+                if (mk == 2 && nk == 2) {
+                    math21_c_ml_pooling_average_planes_k<2>(n_planes, m1, n1, P, window_offset, x, y);
+                } else if (mk == 3 && nk == 3) {
+                    math21_c_ml_pooling_average_planes_k<3>(n_planes, m1, n1, P, window_offset, x, y);
+                } else {
+                    for (i = 0; i < n_planes; ++i) {
+                        const T *x_i = x + i * m1 * n1;
+                        T *y_i = y + i * P;
+                        for (p = 0; p < P; ++p) {
+                            y_i[p] = (T) (math21_c_ml_pooling_window_sum(x_i + window_offset[p], n1, mk, nk) /
+                                          (mk * nk));
+                        }
+                    }
+                }
+            } else {
+                MATH21_ASSERT(0, "pooling type not supported");
+            }
+        }
+
+        template<typename T>
+        void math21_c_ml_pooling_derivativeValueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                                   NumN mk, NumN nk, const NumN32 *window_offset,
+                                                   const T *dy, const NumN32 *argmax, T *dx) {
+            NumN i, p, i2, i3;
+            for (i = 0; i < n_planes * m1 * n1; ++i) {
+                dx[i] = 0;
+            }
+            if (cnn_type_pooling == cnn_type_pooling_max) {
+                for (i = 0; i < n_planes; ++i) {
+                    T *dx_i = dx + i * m1 * n1;
+                    const T *dy_i = dy + i * P;
+                    const NumN32 *argmax_i = argmax + i * P;
+                    for (p = 0; p < P; ++p) {
+                        dx_i[argmax_i[p]] += dy_i[p];
+                    }
+                }
+            } else if (cnn_type_pooling == cnn_type_pooling_average) {
+                for (i = 0; i < n_planes; ++i) {
+                    T *dx_i = dx + i * m1 * n1;
+                    const T *dy_i = dy + i * P;
+                    for (p = 0; p < P; ++p) {
+                        T val = (T) (dy_i[p] / (mk * nk));
+                        T *dx_p = dx_i + window_offset[p];
+                        for (i2 = 0; i2 < mk; ++i2) {
+                            for (i3 = 0; i3 < nk; ++i3) {
+                                dx_p[i2 * n1 + i3] += val;
+                            }
+                        }
+                    }
+                }
+            } else {
+                MATH21_ASSERT(0, "pooling type not supported");
+            }
+        }
+    }
+
+    void math21_c_ml_pooling_get_window_offsets(NumN m1, NumN n1, NumN m2, NumN n2, NumN mk, NumN nk,
+                                                NumN ms, NumN ns, NumN32 *window_offset) {
+        MATH21_ASSERT((m2 - 1) * ms + mk <= m1 && (n2 - 1) * ns + nk <= n1, "window out of input");
+        MATH21_ASSERT(m1 * n1 <= (NumN) NumN32(-1), "input plane too large for 32-bit offsets");
+        for (NumN j2 = 0; j2 < m2; ++j2) {
+            for (NumN j3 = 0; j3 < n2; ++j3) {
+                window_offset[j2 * n2 + j3] = (NumN32) (j2 * ms * n1 + j3 * ns);
+            }
+        }
+    }
+
+    // NumR goes to simd kernels, float to the loops above.
+    void math21_c_ml_pooling_valueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                     NumN mk, NumN nk, const NumN32 *window_offset,
+                                     const NumR *x, NumR *y, NumN32 *argmax) {
+        NumN i;
+        if (cnn_type_pooling == cnn_type_pooling_max) {
+            for (i = 0; i < n_planes; ++i) {
+                math21_c_vector_pooling_max(mk, nk, P, window_offset, x + i * m1 * n1, n1, y + i * P,
+                                            argmax ? argmax + i * P : 0);
+            }
+        } else if (cnn_type_pooling == cnn_type_pooling_average) {
+            for (i = 0; i < n_planes; ++i) {
+                math21_c_vector_pooling_average(mk, nk, P, window_offset, x + i * m1 * n1, n1, y + i * P);
+            }
+        } else {
+            MATH21_ASSERT(0, "pooling type not supported");
+        }
+    }
+
+    void math21_c_ml_pooling_valueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                     NumN mk, NumN nk, const NumN32 *window_offset,
+                                     const float *x, float *y, NumN32 *argmax) {
+        detail::math21_c_ml_pooling_valueAt(cnn_type_pooling, n_planes, m1, n1, P, mk, nk, window_offset, x, y, argmax);
+    }
+
+    void math21_c_ml_pooling_derivativeValueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                               NumN mk, NumN nk, const NumN32 *window_offset,
+                                               const NumR *dy, const NumN32 *argmax, NumR *dx) {
+        detail::math21_c_ml_pooling_derivativeValueAt(cnn_type_pooling, n_planes, m1, n1, P, mk, nk, window_offset,
+                                                      dy, argmax, dx);
+    }
+
+    void math21_c_ml_pooling_derivativeValueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                               NumN mk, NumN nk, const NumN32 *window_offset,
+                                               const float *dy, const NumN32 *argmax, float *dx) {
+        detail::math21_c_ml_pooling_derivativeValueAt(cnn_type_pooling, n_planes, m1, n1, P, mk, nk, window_offset,
+                                                      dy, argmax, dx);
+    }
+
+#define MATH21_CNN_HN_BLOCK_SIZE 512
+
+    namespace detail {
+        // y = k*(y + b), then y = exp(y) and finished by caller, block by block,
+        // so a block is still in cache for the next pass. exp is simd.
+        inline void math21_c_cnn_hn_exp_block(NumN n, NumR k, const NumR *b, NumR *y) {
+            if (b) {
+                math21_c_vector_linear(n, k, y, k, b, y);
+            } else {
+                math21_c_vector_linear(n, k, y, y);
+            }
+            math21_c_vector_exp(n, y, y);
+        }
+    }
+
+    void math21_c_cnn_hn_bias_valueAt(NumN cnn_type_hn, NumN n, const NumR *b, NumR *y) {
+        NumN i, j;
+        NumR v;
+        switch (cnn_type_hn) {
+            case cnn_type_hn_linear:
+                if (b) {
+                    for (i = 0; i < n; ++i) {
+                        y[i] += b[i];
+                    }
+                }
+                break;
+            case cnn_type_hn_tanh: {
+                // tanh(v) = sign(v) * (1 - t)/(1 + t), t = exp(-2|v|) <= 1, so exp doesn't overflow.
+                // 1 - t cancels when |v| is small, so std::tanh is used there.
+                NumR t[MATH21_CNN_HN_BLOCK_SIZE];
+                for (i = 0; i < n; i += MATH21_CNN_HN_BLOCK_SIZE) {
+                    NumN n_i = xjmin(n - i, (NumN) MATH21_CNN_HN_BLOCK_SIZE);
+                    NumR *y_i = y + i;
+                    for (j = 0; j < n_i; ++j) {
+                        v = b ? y_i[j] + b[i + j] : y_i[j];
+                        y_i[j] = v;
+                        t[j] = -2 * xjabs(v);
+                    }
+                    math21_c_vector_exp(n_i, t, t);
+                    for (j = 0; j < n_i; ++j) {
+                        v = y_i[j];
+                        if (xjabs(v) < 0.5) {
+                            y_i[j] = std::tanh(v);
+                        } else {
+                            v = (1 - t[j]) / (1 + t[j]);
+                            y_i[j] = y_i[j] < 0 ? -v : v;
+                        }
+                    }
+                }
+                break;
+            }
+            case cnn_type_hn_ReLU:
+                // same as Function_LeakyReLU
+                for (i = 0; i < n; ++i) {
+                    v = b ? y[i] + b[i] : y[i];
+                    y[i] = v >= 0 ? v : 0.01 * v;
+                }
+                break;
+            case cnn_type_hn_LogSigmoid:
+                // With SSE2, two numbers per vector don't pay for the extra passes, so exp is scalar then.
+#if defined(__AVX2__)
+                for (i = 0; i < n; i += MATH21_CNN_HN_BLOCK_SIZE) {
+                    NumN n_i = xjmin(n - i, (NumN) MATH21_CNN_HN_BLOCK_SIZE);
+                    NumR *y_i = y + i;
+                    detail::math21_c_cnn_hn_exp_block(n_i, -1, b ? b + i : 0, y_i);
+                    for (j = 0; j < n_i; ++j) {
+                        y_i[j] = 1 / (1 + y_i[j]);
+                    }
+                }
+#else
+                for (i = 0; i < n; ++i) {
+                    v = b ? y[i] + b[i] : y[i];
+                    y[i] = 1 / (1 + xjexp(-v));
+                }
+#endif
+                break;
+            default:
+                MATH21_ASSERT(0, "current version check nonlinear hn fail!");
+        }
+    }
+
+    void math21_c_cnn_hn_derivativeValue_using_y(NumN cnn_type_hn, NumN n, const NumR *dy_next,
+                                                 const NumR *y, NumR *dy) {
+        NumN i;
+        switch (cnn_type_hn) {
+            case cnn_type_hn_linear:
+                if (dy != dy_next) {
+                    for (i = 0; i < n; ++i) {
+                        dy[i] = dy_next[i];
+                    }
+                }
+                break;
+            case cnn_type_hn_tanh:
+                for (i = 0; i < n; ++i) {
+                    dy[i] = dy_next[i] * (1 - y[i] * y[i]);
+                }
+                break;
+            case cnn_type_hn_ReLU:
+                for (i = 0; i < n; ++i) {
+                    dy[i] = y[i] >= 0 ? dy_next[i] : 0.01 * dy_next[i];
+                }
+                break;
+            case cnn_type_hn_LogSigmoid:
+                for (i = 0; i < n; ++i) {
+                    dy[i] = dy_next[i] * ((1 - y[i]) * y[i]);
+                }
+                break;
+            default:
+                MATH21_ASSERT(0, "current version check nonlinear hn fail!");
+        }
+    }
+
+    // float is for the mixed precision batch path, so it's scalar and kept simple.
+    void math21_c_cnn_hn_bias_valueAt(NumN cnn_type_hn, NumN n, const float *b, float *y) {
+        NumN i;
+        float v;
+        switch (cnn_type_hn) {
+            case cnn_type_hn_linear:
+                if (b) {
+                    for (i = 0; i < n; ++i) {
+                        y[i] += b[i];
+                    }
+                }
+                break;
+            case cnn_type_hn_tanh:
+                for (i = 0; i < n; ++i) {
+                    v = b ? y[i] + b[i] : y[i];
+                    y[i] = std::tanh(v);
+                }
+                break;
+            case cnn_type_hn_ReLU:
+                for (i = 0; i < n; ++i) {
+                    v = b ? y[i] + b[i] : y[i];
+                    y[i] = v >= 0 ? v : 0.01f * v;
+                }
+                break;
+            case cnn_type_hn_LogSigmoid:
+                for (i = 0; i < n; ++i) {
+                    v = b ? y[i] + b[i] : y[i];
+                    y[i] = 1 / (1 + std::exp(-v));
+                }
+                break;
+            default:
+                MATH21_ASSERT(0, "current version check nonlinear hn fail!");
+        }
+    }
+
+    void math21_c_cnn_hn_derivativeValue_using_y(NumN cnn_type_hn, NumN n, const float *dy_next,
+                                                 const float *y, float *dy) {
+        NumN i;
+        switch (cnn_type_hn) {
+            case cnn_type_hn_linear:
+                if (dy != dy_next) {
+                    for (i = 0; i < n; ++i) {
+                        dy[i] = dy_next[i];
+                    }
+                }
+                break;
+            case cnn_type_hn_tanh:
+                for (i = 0; i < n; ++i) {
+                    dy[i] = dy_next[i] * (1 - y[i] * y[i]);
+                }
+                break;
+            case cnn_type_hn_ReLU:
+                for (i = 0; i < n; ++i) {
+                    dy[i] = y[i] >= 0 ? dy_next[i] : 0.01f * dy_next[i];
+                }
+                break;
+            case cnn_type_hn_LogSigmoid:
+                for (i = 0; i < n; ++i) {
+                    dy[i] = dy_next[i] * ((1 - y[i]) * y[i]);
+                }
+                break;
+            default:
+                MATH21_ASSERT(0, "current version check nonlinear hn fail!");
+        }
+    }
+
 //#########################
     cnn::cnn() {
         init();
@@ -142,6 +545,153 @@ namespace math21 {
         }
     }
 
+    cnn_cost_class::cnn_cost_class(cnn &_f,
+                                   CostFunctional_class &_L,
+                                   cnn_data_pipeline &_pipeline,
+                                   NumB _isUsingDiff)
+            : f(_f),
+              L(_L),
+              pipeline(&_pipeline),
+              X(_pipeline.getPoints_x()),
+              Y(_pipeline.getPoints_y()),
+              isUsingDiff(_isUsingDiff) {
+        pipeline->start();
+        if (pipeline->getMinibatchNumber() == 0) {
+            pipeline->next();
+        }
+        // points of minibatch are used in order.
+        stride = 1;
+        init(1, pipeline->getMinibatchSize());
+    }
+
+    void cnn_cost_class::updateParas() {
+        if (pipeline) {
+            pipeline->next();
+            return;
+        }
+        start = start + size;
+        if (start > Xsize) {
+            start = start % Xsize;
+            if (start == 0) {
+                start = Xsize;
+            }
+        }
+    }
+
+    void cnn_cost_class::setBatch(NumN i0, NumN n, TenR &X_batch, TenR &Y_batch) const {
+        if (pipeline) {
+            math21_operator_share_first_dim_range(pipeline->getX(), i0 + 1, n, X_batch);
+            math21_operator_share_first_dim_range(pipeline->getY(), i0 + 1, n, Y_batch);
+            return;
+        }
+        setBatch_copy(i0, n, X_batch, Y_batch);
+    }
+
+    NumB cnn_cost_class::setWorkspaces() {
+        NumN n = xjmin(n_threads, size);
+        if (workspaces.size() == n) {
+            // f may be switched to float after workspaces are created.
+            for (NumN w = 1; w <= n; ++w) {
+                if (workspaces(w)->f.getUsingFloat() != f.getUsingFloat()) {
+                    workspaces(w)->f.setUsingFloat(f.getUsingFloat());
+                }
+            }
+            return 1;
+        }
+        clearWorkspaces();
+        CostFunctional_class *L_copy = L.clone();
+        if (L_copy == 0) {
+            return 0;
+        }
+        delete L_copy;
+        workspaces.setSize(n);
+        for (NumN w = 1; w <= n; ++w) {
+            workspaces(w) = new cnn_cost_workspace(f, L);
+        }
+        return 1;
+    }
+
+    void cnn_cost_class::clearWorkspaces() {
+        for (NumN w = 1; w <= workspaces.size(); ++w) {
+            delete workspaces(w);
+        }
+        workspaces.clear();
+    }
+
+    void cnn_cost_class::valueAt_workspace(const VecR &theta, NumN w) {
+        cnn_cost_workspace &ws = *workspaces(w + 1);
+        NumN n_workspaces = workspaces.size();
+        NumN i_start = size * w / n_workspaces;
+        NumN i_end = size * (w + 1) / n_workspaces;
+        TenR output_n;
+        ws.value = 0;
+        for (NumN i0 = i_start; i0 < i_end; i0 += batch_size_max) {
+            NumN n = xjmin(batch_size_max, i_end - i0);
+            setBatch(i0, n, ws.X_batch, ws.Y_batch);
+            const TenR &output = ws.f.valueAt_batch(ws.X_batch, theta);
+            for (NumN i = 1; i <= n; i++) {
+                math21_operator_share_first_dim_slice(output, i, output_n);
+                ws.L->setParas(Y(indexes(i0 + i)));
+                ws.value = ws.value + ws.L->valueAt(output_n);
+            }
+        }
+    }
+
+    void cnn_cost_class::derivativeValueAt_workspace(const VecR &theta, NumN w) {
+        cnn_cost_workspace &ws = *workspaces(w + 1);
+        NumN n_workspaces = workspaces.size();
+        NumN i_start = size * w / n_workspaces;
+        NumN i_end = size * (w + 1) / n_workspaces;
+        if (ws.dtheta.isSameSize(dtheta.size()) == 0) {
+            ws.dtheta.setSize(dtheta.size());
+        }
+        ws.dtheta = 0;
+        for (NumN i0 = i_start; i0 < i_end; i0 += batch_size_max) {
+            NumN n = xjmin(batch_size_max, i_end - i0);
+            setBatch(i0, n, ws.X_batch, ws.Y_batch);
+            const VecR &tmp = ws.f.derivativeValueAtTheta_batch(ws.X_batch, ws.Y_batch, theta, *ws.L, lambda);
+            math21_operator_addToA(ws.dtheta, tmp);
+        }
+    }
+
+    NumR cnn_cost_class::valueAt_parallel(const VecR &theta) {
+        setMinibatchIndexes();
+        NumZ n_workspaces = (NumZ) workspaces.size();
+        NumZ w;
+#pragma omp parallel for num_threads(n_workspaces) schedule(static)
+        for (w = 0; w < n_workspaces; ++w) {
+            valueAt_workspace(theta, (NumN) w);
+        }
+        NumR value = 0;
+        for (w = 1; w <= n_workspaces; ++w) {
+            value = value + workspaces(w)->value;
+        }
+        value = value / size + getPenalty(theta);
+        MATH21_ASSERT(!math21_check_clip(value), value << " should be clipped!");
+        return value;
+    }
+
+    const VecR &cnn_cost_class::derivativeValueAt_parallel(const VecR &theta) {
+        setMinibatchIndexes();
+        NumZ n_workspaces = (NumZ) workspaces.size();
+        NumZ w;
+#pragma omp parallel for num_threads(n_workspaces) schedule(static)
+        for (w = 0; w < n_workspaces; ++w) {
+            derivativeValueAt_workspace(theta, (NumN) w);
+        }
+        // tree reduction, dtheta of w + step is added to that of w, so the sum ends in workspace 1.
+        for (NumZ step = 1; step < n_workspaces; step *= 2) {
+#pragma omp parallel for num_threads(n_workspaces) schedule(static)
+            for (w = 0; w < n_workspaces - step; w += 2 * step) {
+                math21_operator_addToA(workspaces(w + 1)->dtheta, workspaces(w + step + 1)->dtheta);
+            }
+        }
+        math21_operator_container_set(workspaces(1)->dtheta, dtheta);
+        math21_operator_linear_to(1.0 / size, dtheta);
+        MATH21_ASSERT(!math21_check_clip(dtheta), "dtheta should be clipped!");
+        return dtheta;
+    }
+
     void evaluate_cnn(cnn &f,
                       cnn_cost_class &J,
                       const Seqce<TenR> &X,
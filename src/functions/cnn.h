@@ -66,6 +66,65 @@ namespace math21 {
                                             NumN mk, NumN nk, NumN ms, NumN ns,
                                             Seqce <TenN> *p_xn_argmax=0,
                                             NumB isUsingDiff=0);
+
+    // window p of an m1*n1 plane starts at offset window_offset[p], p = 0, ..., m2*n2-1.
+    void math21_c_ml_pooling_get_window_offsets(NumN m1, NumN n1, NumN m2, NumN n2, NumN mk, NumN nk,
+                                                NumN ms, NumN ns, NumN32 *window_offset);
+
+    // pooling of n_planes continuous m1*n1 planes, P = m2*n2 outputs per plane.
+    // argmax, if not 0, gets offset of max w.r.t. its plane. Only max pooling uses argmax.
+    // NumR windows go to math21_c_vector_pooling_max and math21_c_vector_pooling_average of simd.h.
+    void math21_c_ml_pooling_valueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                     NumN mk, NumN nk, const NumN32 *window_offset,
+                                     const NumR *x, NumR *y, NumN32 *argmax);
+
+    // dx is derivative w.r.t. x, given dy and argmax of math21_c_ml_pooling_valueAt.
+    void math21_c_ml_pooling_derivativeValueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                               NumN mk, NumN nk, const NumN32 *window_offset,
+                                               const NumR *dy, const NumN32 *argmax, NumR *dx);
+
+    // float versions, used by the mixed precision batch path.
+    void math21_c_ml_pooling_valueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                     NumN mk, NumN nk, const NumN32 *window_offset,
+                                     const float *x, float *y, NumN32 *argmax);
+
+    void math21_c_ml_pooling_derivativeValueAt(NumN cnn_type_pooling, NumN n_planes, NumN m1, NumN n1, NumN P,
+                                               NumN mk, NumN nk, const NumN32 *window_offset,
+                                               const float *dy, const NumN32 *argmax, float *dx);
+
+    // y = hn(y + b) for n continuous numbers, b can be 0.
+    // hn is selected once per call, so the loop has no virtual call, and exp uses simd kernels where it pays.
+    void math21_c_cnn_hn_bias_valueAt(NumN cnn_type_hn, NumN n, const NumR *b, NumR *y);
+
+    // dy = dy_next .* hn'(y), where hn' is computed using output y.
+    void math21_c_cnn_hn_derivativeValue_using_y(NumN cnn_type_hn, NumN n, const NumR *dy_next,
+                                                 const NumR *y, NumR *dy);
+
+    void math21_c_cnn_hn_bias_valueAt(NumN cnn_type_hn, NumN n, const float *b, float *y);
+
+    void math21_c_cnn_hn_derivativeValue_using_y(NumN cnn_type_hn, NumN n, const float *dy_next,
+                                                 const float *y, float *dy);
+
+    // y = x, element type converted, e.x., NumR to float.
+    template<typename S, typename T>
+    void math21_c_cnn_cast(NumN n, const S *x, T *y) {
+        for (NumN i = 0; i < n; ++i) {
+            y[i] = (T) x[i];
+        }
+    }
+
+    // B = A, element type converted. B is resized if shapes differ.
+    template<typename S, typename T>
+    void math21_operator_cnn_cast(const Tensor<S> &A, Tensor<T> &B) {
+        if (!B.isSameSize(A.shape())) {
+            B.setSize(A.shape());
+        }
+        if (A.isContinuous() && !A.isColumnMajor() && B.isContinuous() && !B.isColumnMajor()) {
+            math21_c_cnn_cast(A.volume(), math21_memory_tensor_data_address(A), math21_memory_tensor_data_address(B));
+        } else {
+            math21_operator_container_set(A, B);
+        }
+    }
     ////######################### config
     struct cnn_config_fn {
     public:
@@ -159,7 +218,54 @@ namespace math21 {
         TenR xn_next;
         TenR dxn;
         TenR dyn;
-        Function *h;
+
+        // batch of samples stacked along the first dim, N*d2, N*d1 and N*d2. Sized when used.
+        TenR xn_next_batch;
+        TenR dxn_batch;
+        TenR dyn_batch;
+        // dtheta of this layer, summed over samples by the default batch derivative.
+        VecR dtheta_fn;
+        VecR dtheta_fn_sum;
+
+        // float batch, the same as above, used when cnn uses float. See cnn::setUsingFloat.
+        Tensor<float> xn_next_batch_f;
+        Tensor<float> dxn_batch_f;
+        Tensor<float> dyn_batch_f;
+
+        template<typename T>
+        NumN getBatchSize(const Tensor<T> &X) const {
+            MATH21_ASSERT(X.dims() == 4, "batch is not 4-D tensor!");
+            MATH21_ASSERT(X.volume() == X.dim(1) * d1(1) * d1(2) * d1(3), "batch shape doesn't match input shape");
+            return X.dim(1);
+        }
+
+        void setSize_batch(NumN n_samples) {
+            xn_next_batch.setSize(n_samples, d2(1), d2(2), d2(3));
+            if (isUsingDiff) {
+                dxn_batch.setSize(n_samples, d1(1), d1(2), d1(3));
+                dyn_batch.setSize(n_samples, d2(1), d2(2), d2(3));
+            }
+        }
+
+        void setSize_batch_f(NumN n_samples) {
+            xn_next_batch_f.setSize(n_samples, d2(1), d2(2), d2(3));
+            if (isUsingDiff) {
+                dxn_batch_f.setSize(n_samples, d1(1), d1(2), d1(3));
+                dyn_batch_f.setSize(n_samples, d2(1), d2(2), d2(3));
+            }
+        }
+
+        // A as continuous row-major data, copied to A_c if needed.
+        template<typename T>
+        static const T *getContinuousData(const Tensor<T> &A, Tensor<T> &A_c) {
+            if (!A.isContinuous() || A.isColumnMajor()) {
+                A_c.setSize(A.shape());
+                math21_operator_container_set(A, A_c);
+                return math21_memory_tensor_data_address((const Tensor<T> &) A_c);
+            }
+            return math21_memory_tensor_data_address(A);
+        }
+
     public:
         //
         cnn_fn(const cnn_fn &fn) {
@@ -207,17 +313,10 @@ namespace math21 {
             xn_next.setSize(d2);
             cnn_type_hn = _cnn_type_hn;
             isUsingDiff = _isUsingDiff;
-            if (cnn_type_hn == cnn_type_hn_linear) {
-                h = new Function_linear();
-            } else if (cnn_type_hn == cnn_type_hn_tanh) {
-                h = new Function_tanh();
-            } else if (cnn_type_hn == cnn_type_hn_ReLU) {
-                h = new Function_LeakyReLU();
-            } else if (cnn_type_hn == cnn_type_hn_LogSigmoid) {
-                h = new Function_LogSigmoid();
-            } else {
-                MATH21_ASSERT(0, "current version check nonlinear hn fail!");
-            }
+            // hn is applied by math21_c_cnn_hn_bias_valueAt and math21_c_cnn_hn_derivativeValue_using_y.
+            MATH21_ASSERT(cnn_type_hn == cnn_type_hn_linear || cnn_type_hn == cnn_type_hn_tanh ||
+                          cnn_type_hn == cnn_type_hn_ReLU || cnn_type_hn == cnn_type_hn_LogSigmoid,
+                          "current version check nonlinear hn fail!");
             if (isUsingDiff) {
                 dxn.setSize(d1);
                 dyn.setSize(d2);
@@ -225,9 +324,6 @@ namespace math21 {
         }
 
         virtual ~cnn_fn() {
-            if (h != 0) {
-                delete h;
-            }
         }
 
         NumB isEmpty() const {
@@ -250,11 +346,41 @@ namespace math21 {
 
         virtual void setThetaSpace(const SpaceParas &paras) = 0;
 
+        // float copy of theta used by the float batch, paras is in unit of float.
+        // Layers without float version compute in NumR, and ignore it.
+        virtual void setThetaSpace_f(const SpaceParas &paras) {
+        }
+
 //        virtual void setDtheta(const TenR &_theta) = 0;
         virtual void setDthetaSpace(const SpaceParas &paras) = 0;
 
         virtual const TenR &valueAt(const TenR &x) = 0;
 
+        // inference only, buffers of diff are released. Called again when theta changes.
+        virtual void freeze() {
+            isUsingDiff = 0;
+            dxn.clear();
+            dyn.clear();
+            dxn_batch.clear();
+            dyn_batch.clear();
+            dtheta_fn.clear();
+            dtheta_fn_sum.clear();
+            xn_next_batch_f.clear();
+            dxn_batch_f.clear();
+            dyn_batch_f.clear();
+        }
+
+        // output shares space given by cnn, so layers can take turns using two buffers.
+        void setValueSpace(const SpaceParas &paras) {
+            xn_next.setSize(d2, &paras);
+        }
+
+        void setValueSpace_batch(NumN n_samples, const SpaceParas &paras) {
+            VecN d(4);
+            d = n_samples, d2(1), d2(2), d2(3);
+            xn_next_batch.setSize(d, &paras);
+        }
+
         const TenR &get_derivativeValue_J() {
             return dxn;
         }
@@ -265,6 +391,98 @@ namespace math21 {
 
         virtual void derivativeValueAtTheta_and_xn_J(const TenR &xn, const TenR &dxn_next, NumR alpha) = 0;
 
+        // used by the default batch derivative, paras is the same as that of setDthetaSpace.
+        void setDthetaSpace_batch(const SpaceParas &paras) {
+            if (getThetaSize() == 0) {
+                return;
+            }
+            VecN d(1);
+            d = getThetaSize();
+            dtheta_fn.setSize(d, &paras);
+        }
+
+        // X is N*d1, i.e., N samples stacked along the first dim, and return N*d2.
+        // Default is one sample at a time. Layers override it when the whole batch can be computed at once.
+        virtual const TenR &valueAt_batch(const TenR &X) {
+            NumN n_samples = getBatchSize(X);
+            setSize_batch(n_samples);
+            TenR x, y;
+            for (NumN n = 1; n <= n_samples; ++n) {
+                math21_operator_share_first_dim_slice(X, n, x);
+                math21_operator_share_first_dim_slice(xn_next_batch, n, y);
+                math21_operator_container_set(valueAt(x), y);
+            }
+            return xn_next_batch;
+        }
+
+        const TenR &getValue_batch() const {
+            return xn_next_batch;
+        }
+
+        const TenR &get_derivativeValue_J_batch() const {
+            return dxn_batch;
+        }
+
+        // Derivative w.r.t. theta is summed over samples, so N*alpha*theta is added.
+        // valueAt_batch(X) must be called first.
+        // Default is one sample at a time, and valueAt is called again to restore state of the sample.
+        virtual void derivativeValueAtTheta_and_xn_J_batch(const TenR &X, const TenR &dX_next, NumR alpha) {
+            MATH21_ASSERT(isUsingDiff, "maybe you forgot to enable diff in constructor");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch(n_samples);
+            TenR x, dx_next, dx;
+            for (NumN n = 1; n <= n_samples; ++n) {
+                math21_operator_share_first_dim_slice(X, n, x);
+                math21_operator_share_first_dim_slice(dX_next, n, dx_next);
+                math21_operator_share_first_dim_slice(dxn_batch, n, dx);
+                valueAt(x);
+                derivativeValueAtTheta_and_xn_J(x, dx_next, alpha);
+                math21_operator_container_set(dxn, dx);
+                if (!dtheta_fn.isEmpty()) {
+                    if (n == 1) {
+                        dtheta_fn_sum.setSize(dtheta_fn.size());
+                        math21_operator_container_set(dtheta_fn, dtheta_fn_sum);
+                    } else {
+                        math21_operator_addToA(dtheta_fn_sum, dtheta_fn);
+                    }
+                }
+            }
+            if (!dtheta_fn.isEmpty()) {
+                math21_operator_container_set(dtheta_fn_sum, dtheta_fn);
+            }
+        }
+
+        // float version of valueAt_batch, theta is the one set by setThetaSpace_f.
+        // Default converts X to NumR and calls valueAt_batch, so layers without float version still work.
+        virtual const Tensor<float> &valueAt_batch_f(const Tensor<float> &X) {
+            TenR X_r;
+            math21_operator_cnn_cast(X, X_r);
+            const TenR &Y = valueAt_batch(X_r);
+            setSize_batch_f(getBatchSize(X));
+            math21_operator_cnn_cast(Y, xn_next_batch_f);
+            return xn_next_batch_f;
+        }
+
+        const Tensor<float> &getValue_batch_f() const {
+            return xn_next_batch_f;
+        }
+
+        const Tensor<float> &get_derivativeValue_J_batch_f() const {
+            return dxn_batch_f;
+        }
+
+        // float version of derivativeValueAtTheta_and_xn_J_batch, dtheta is still NumR.
+        // valueAt_batch_f(X) must be called first.
+        virtual void derivativeValueAtTheta_and_xn_J_batch_f(const Tensor<float> &X, const Tensor<float> &dX_next,
+                                                             NumR alpha) {
+            TenR X_r, dX_next_r;
+            math21_operator_cnn_cast(X, X_r);
+            math21_operator_cnn_cast(dX_next, dX_next_r);
+            derivativeValueAtTheta_and_xn_J_batch(X_r, dX_next_r, alpha);
+            setSize_batch_f(getBatchSize(X));
+            math21_operator_cnn_cast(dxn_batch, dxn_batch_f);
+        }
+
         virtual void log() const = 0;
 
         virtual NumR calWeightNormSquare(NumN norm) const = 0;
@@ -274,6 +492,8 @@ namespace math21 {
     private:
         TenR W, b;
         TenR dW, db;
+        Tensor<float> W_f, b_f; // set by setThetaSpace_f
+        Tensor<float> dW_f; // data term of dW computed in float
 
         void thetaToInner(const SpaceParas &paras, TenR &W, TenR &b) {
             MATH21_ASSERT(paras.size == getThetaSize() * sizeof(NumR));
@@ -330,6 +550,23 @@ namespace math21 {
             thetaToInner(paras, dW, db);
         }
 
+        void setThetaSpace_f(const SpaceParas &paras) override {
+            MATH21_ASSERT(paras.size == getThetaSize() * sizeof(float));
+            SpaceParas paras_dst;
+            VecN d;
+            math21_memory_getSpace(paras, paras_dst, 0, W.volume(), sizeof(float));
+            W_f.setSize(W.shape(d), &paras_dst);
+            math21_memory_getSpace(paras, paras_dst, W.volume(), b.volume(), sizeof(float));
+            b_f.setSize(b.shape(d), &paras_dst);
+        }
+
+        void freeze() override {
+            cnn_fn::freeze();
+            dW.clear();
+            db.clear();
+            dW_f.clear();
+        }
+
         void log() const override {
             if (isEmpty()) {
                 return;
@@ -357,76 +594,182 @@ namespace math21 {
         }
 
         void derivativeValueAtTheta_and_xn_J(const TenR &xn, const TenR &dxn_next, NumR alpha) override {
-            NumN j1, j2, j3, i1, i2, i3;
             // dyn
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        dyn(j1, j2, j3) = dxn_next(j1, j2, j3) * h->derivativeValue_using_y(xn_next(j1, j2, j3));
-                    }
-                }
-            }
-
-            // dW, db
-            NumR val_dy;
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        val_dy = dyn(j1, j2, j3);
-                        for (i1 = 1; i1 <= d1(1); ++i1) {
-                            for (i2 = 1; i2 <= d1(2); ++i2) {
-                                for (i3 = 1; i3 <= d1(3); ++i3) {
-                                    dW(j1, j2, j3, i1, i2, i3) = val_dy * xn(i1, i2, i3) +
-                                                                 alpha * W(j1, j2, j3, i1, i2, i3);
-                                }
-                            }
-                        }
-                        db(j1, j2, j3) = val_dy;
-                    }
-                }
-            }
-
-            // dxn, clear first, then reverse compute.
-            dxn = 0;
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        val_dy = dyn(j1, j2, j3);
-                        for (i1 = 1; i1 <= d1(1); ++i1) {
-                            for (i2 = 1; i2 <= d1(2); ++i2) {
-                                for (i3 = 1; i3 <= d1(3); ++i3) {
-                                    NumR &val_dxn = dxn.valueAt(i1, i2, i3);
-                                    val_dxn = val_dxn + W(j1, j2, j3, i1, i2, i3) * val_dy;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+            TenR dxn_next_c;
+            math21_c_cnn_hn_derivativeValue_using_y(cnn_type_hn, dyn.volume(),
+                                                    getContinuousData(dxn_next, dxn_next_c),
+                                                    math21_memory_tensor_data_address((const TenR &) xn_next),
+                                                    math21_memory_tensor_data_address(dyn));
+
+            // W is seen as no*ni matrix, xn as ni*1, dyn as no*1.
+            // Both products use gemm with W read in place, no transpose is materialized.
+            const TenR *p_xn = &xn;
+            TenR xn_c;
+            if (!xn.isContinuous() || xn.isColumnMajor()) {
+                xn_c.setSize(xn.shape());
+                math21_operator_container_set(xn, xn_c);
+                p_xn = &xn_c;
+            }
+            NumN ni = p_xn->volume();
+            NumN no = dyn.volume();
+            MATH21_ASSERT(W.volume() == no * ni);
+            const NumR *W_data = math21_memory_tensor_data_address(W);
+            const NumR *dy_data = math21_memory_tensor_data_address(dyn);
+            const NumR *x_data = math21_memory_tensor_data_address(*p_xn);
+
+            // dW = dyn * xn.transpose + alpha * W, db = dyn
+            NumR *dW_data = math21_memory_tensor_data_address(dW);
+            math21_c_vector_linear(no * ni, alpha, W_data, dW_data);
+            math21_c_gemm(0, 1, no, ni, 1, 1, dy_data, 1, x_data, 1, 1, dW_data, ni);
+            math21_operator_container_set(dyn, db);
+
+            // dxn = W.transpose * dyn
+            math21_c_gemm(1, 0, ni, 1, no, 1, W_data, ni, dy_data, 1, 0,
+                          math21_memory_tensor_data_address(dxn), 1);
 
             // clip
             math21_clip(dxn);
         }
 
+        // y = W * x, then bias and hn are applied in place.
         const TenR &valueAt(const TenR &x) override {
-            NumN j1, j2, j3, i1, i2, i3;
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        NumR y = 0;
-                        for (i1 = 1; i1 <= d1(1); ++i1) {
-                            for (i2 = 1; i2 <= d1(2); ++i2) {
-                                for (i3 = 1; i3 <= d1(3); ++i3) {
-                                    y = y + x(i1, i2, i3) * W(j1, j2, j3, i1, i2, i3);
-                                }
-                            }
-                        }
-                        y = y + b(j1, j2, j3);
-                        xn_next(j1, j2, j3) = h->valueAt(y);
-                    }
+            NumN ni = d1(1) * d1(2) * d1(3);
+            NumN no = d2(1) * d2(2) * d2(3);
+            TenR x_c;
+            const NumR *x_data = getContinuousData(x, x_c);
+            const NumR *W_data = math21_memory_tensor_data_address((const TenR &) W);
+            const NumR *b_data = math21_memory_tensor_data_address((const TenR &) b);
+            NumR *y = math21_memory_tensor_data_address(xn_next);
+            math21_c_gemm(0, 0, no, 1, ni, 1, W_data, ni, x_data, 1, 0, y, 1);
+            math21_c_cnn_hn_bias_valueAt(cnn_type_hn, no, b_data, y);
+            return xn_next;
+        }
+
+        // X is seen as N*ni matrix, and output Y as N*no, so the batch is one gemm, Y = X * W.transpose.
+        const TenR &valueAt_batch(const TenR &X) override {
+            NumN n_samples = getBatchSize(X);
+            setSize_batch(n_samples);
+            NumN ni = d1(1) * d1(2) * d1(3);
+            NumN no = d2(1) * d2(2) * d2(3);
+            TenR X_c;
+            const NumR *x_data = getContinuousData(X, X_c);
+            const NumR *W_data = math21_memory_tensor_data_address((const TenR &) W);
+            const NumR *b_data = math21_memory_tensor_data_address((const TenR &) b);
+            NumR *y = math21_memory_tensor_data_address(xn_next_batch);
+            math21_c_gemm(0, 1, n_samples, no, ni, 1, x_data, ni, W_data, ni, 0, y, no);
+            for (NumN n = 0; n < n_samples; ++n) {
+                math21_c_cnn_hn_bias_valueAt(cnn_type_hn, no, b_data, y + n * no);
+            }
+            return xn_next_batch;
+        }
+
+        void derivativeValueAtTheta_and_xn_J_batch(const TenR &X, const TenR &dX_next, NumR alpha) override {
+            MATH21_ASSERT(isUsingDiff, "maybe you forgot to enable diff in constructor");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch(n_samples);
+            NumN ni = d1(1) * d1(2) * d1(3);
+            NumN no = d2(1) * d2(2) * d2(3);
+            NumN n, j;
+
+            // dY
+            TenR X_c, dX_next_c;
+            const NumR *dy_next = getContinuousData(dX_next, dX_next_c);
+            const NumR *y = math21_memory_tensor_data_address((const TenR &) xn_next_batch);
+            NumR *dy = math21_memory_tensor_data_address(dyn_batch);
+            math21_c_cnn_hn_derivativeValue_using_y(cnn_type_hn, n_samples * no, dy_next, y, dy);
+
+            const NumR *x_data = getContinuousData(X, X_c);
+            const NumR *W_data = math21_memory_tensor_data_address((const TenR &) W);
+
+            // dW = dY.transpose * X + N * alpha * W, db = sum of rows of dY
+            NumR *dW_data = math21_memory_tensor_data_address(dW);
+            math21_c_vector_linear(no * ni, n_samples * alpha, W_data, dW_data);
+            math21_c_gemm(1, 0, no, ni, n_samples, 1, dy, no, x_data, ni, 1, dW_data, ni);
+            NumR *db_data = math21_memory_tensor_data_address(db);
+            for (j = 0; j < no; ++j) {
+                db_data[j] = 0;
+            }
+            for (n = 0; n < n_samples; ++n) {
+                const NumR *dy_n = dy + n * no;
+                for (j = 0; j < no; ++j) {
+                    db_data[j] += dy_n[j];
                 }
             }
-            return xn_next;
+
+            // dX = dY * W
+            math21_c_gemm(0, 0, n_samples, ni, no, 1, dy, no, W_data, ni, 0,
+                          math21_memory_tensor_data_address(dxn_batch), ni);
+
+            // clip
+            math21_clip(dxn_batch);
+        }
+
+        const Tensor<float> &valueAt_batch_f(const Tensor<float> &X) override {
+            MATH21_ASSERT(!W_f.isEmpty(), "float theta not set");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch_f(n_samples);
+            NumN ni = d1(1) * d1(2) * d1(3);
+            NumN no = d2(1) * d2(2) * d2(3);
+            Tensor<float> X_c;
+            const float *x_data = getContinuousData(X, X_c);
+            const float *W_data = math21_memory_tensor_data_address((const Tensor<float> &) W_f);
+            const float *b_data = math21_memory_tensor_data_address((const Tensor<float> &) b_f);
+            float *y = math21_memory_tensor_data_address(xn_next_batch_f);
+            math21_c_gemm(0, 1, n_samples, no, ni, 1, x_data, ni, W_data, ni, 0, y, no);
+            for (NumN n = 0; n < n_samples; ++n) {
+                math21_c_cnn_hn_bias_valueAt(cnn_type_hn, no, b_data, y + n * no);
+            }
+            return xn_next_batch_f;
+        }
+
+        // products are in float, sums over samples written to dtheta are in NumR.
+        void derivativeValueAtTheta_and_xn_J_batch_f(const Tensor<float> &X, const Tensor<float> &dX_next,
+                                                     NumR alpha) override {
+            MATH21_ASSERT(isUsingDiff, "maybe you forgot to enable diff in constructor");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch_f(n_samples);
+            NumN ni = d1(1) * d1(2) * d1(3);
+            NumN no = d2(1) * d2(2) * d2(3);
+            NumN n, j;
+
+            // dY
+            Tensor<float> X_c, dX_next_c;
+            const float *dy_next = getContinuousData(dX_next, dX_next_c);
+            const float *y = math21_memory_tensor_data_address((const Tensor<float> &) xn_next_batch_f);
+            float *dy = math21_memory_tensor_data_address(dyn_batch_f);
+            math21_c_cnn_hn_derivativeValue_using_y(cnn_type_hn, n_samples * no, dy_next, y, dy);
+
+            const float *x_data = getContinuousData(X, X_c);
+            const float *W_data = math21_memory_tensor_data_address((const Tensor<float> &) W_f);
+
+            // dW = dY.transpose * X + N * alpha * W, db = sum of rows of dY
+            if (dW_f.isEmpty()) {
+                dW_f.setSize(W.shape());
+            }
+            float *dW_f_data = math21_memory_tensor_data_address(dW_f);
+            math21_c_gemm(1, 0, no, ni, n_samples, 1, dy, no, x_data, ni, 0, dW_f_data, ni);
+            const NumR *W_r = math21_memory_tensor_data_address((const TenR &) W);
+            NumR *dW_data = math21_memory_tensor_data_address(dW);
+            for (j = 0; j < no * ni; ++j) {
+                dW_data[j] = dW_f_data[j] + n_samples * alpha * W_r[j];
+            }
+            NumR *db_data = math21_memory_tensor_data_address(db);
+            for (j = 0; j < no; ++j) {
+                db_data[j] = 0;
+            }
+            for (n = 0; n < n_samples; ++n) {
+                const float *dy_n = dy + n * no;
+                for (j = 0; j < no; ++j) {
+                    db_data[j] += dy_n[j];
+                }
+            }
+
+            // dX = dY * W
+            math21_c_gemm(0, 0, n_samples, ni, no, 1, dy, no, W_data, ni, 0,
+                          math21_memory_tensor_data_address(dxn_batch_f), ni);
+
+            // clip
+            math21_clip(dxn_batch_f);
         }
 
         NumR calWeightNormSquare(NumN norm) const override {
@@ -525,6 +868,12 @@ namespace math21 {
             thetaToInner(paras, dK, db);
         }
 
+        void freeze() override {
+            cnn_fn::freeze();
+            dK.clear();
+            db.clear();
+        }
+
         void log() const override {
             if (isEmpty()) {
                 return;
@@ -590,13 +939,11 @@ namespace math21 {
             NumR val;
 
             // dyn
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        dyn(j1, j2, j3) = dxn_next(j1, j2, j3) * h->derivativeValue_using_y(xn_next(j1, j2, j3));
-                    }
-                }
-            }
+            TenR dxn_next_c;
+            math21_c_cnn_hn_derivativeValue_using_y(cnn_type_hn, dyn.volume(),
+                                                    getContinuousData(dxn_next, dxn_next_c),
+                                                    math21_memory_tensor_data_address((const TenR &) xn_next),
+                                                    math21_memory_tensor_data_address(dyn));
             // dW, db
             NumR val_dy;
             for (j1 = 1; j1 <= d2(1); ++j1) {
@@ -677,11 +1024,13 @@ namespace math21 {
                                 }
                             }
                         }
-                        y = y + b(j1, j2, j3);
-                        xn_next(j1, j2, j3) = h->valueAt(y);
+                        xn_next(j1, j2, j3) = y;
                     }
                 }
             }
+            math21_c_cnn_hn_bias_valueAt(cnn_type_hn, xn_next.volume(),
+                                         math21_memory_tensor_data_address((const TenR &) b),
+                                         math21_memory_tensor_data_address(xn_next));
             return xn_next;
         }
 
@@ -716,6 +1065,284 @@ namespace math21 {
         NumN mpad;
         NumN npad;
 
+        // Conv is lowered to im2col and gemm.
+        // Columns of x_col are output positions grouped by kernel tile, position (j2, j3) uses tile (j2%mt, j3%nt).
+        // Rows of x_col are kernel taps (i1, i2, i3), so x_col is L*P, L = d1(1)*mk*nk, P = d2(2)*d2(3).
+        // For a batch of N samples, x_col is L*(N*P), and columns of tile t are grouped by sample,
+        // i.e., column c of sample n is at tile_offset[t]*N + n*n_t + c - tile_offset[t], n_t is column number of tile t.
+        // Kernel of tile t is d2(1)*L matrix in K with row stride mt*nt*L, so it's read in place.
+        std::vector<NumN> col_position; // 0-based output position of column
+        std::vector<NumN> tile_offset; // columns of tile t are [tile_offset[t], tile_offset[t+1])
+        std::vector<NumZ> col_ia; // top of receptive field in x, 0-based, may be negative.
+        std::vector<NumZ> col_ic;
+        TenR x_col;
+        TenR y_col; // d2(1)*(N*P)
+        TenR dx_col;
+        TenR K_packed; // kernel of tile t is K_packed(t), set by freeze when there are tiles.
+        // float batch, see setThetaSpace_f.
+        Tensor<float> K_f, b_f;
+        Tensor<float> dK_f; // data term of dK computed in float
+        Tensor<float> x_col_f, y_col_f, dx_col_f;
+
+        void setSize_im2col() {
+            NumN P = d2(2) * d2(3);
+            NumN n_tiles = mt * nt;
+            col_position.resize(P);
+            col_ia.resize(P);
+            col_ic.resize(P);
+            tile_offset.assign(n_tiles + 1, 0);
+            NumN j2, j3, t, c;
+            for (j2 = 1; j2 <= d2(2); ++j2) {
+                for (j3 = 1; j3 <= d2(3); ++j3) {
+                    t = (j2 % mt) * nt + j3 % nt;
+                    ++tile_offset[t + 1];
+                }
+            }
+            for (t = 1; t <= n_tiles; ++t) {
+                tile_offset[t] += tile_offset[t - 1];
+            }
+            std::vector<NumN> next(tile_offset.begin(), tile_offset.end() - 1);
+            for (j2 = 1; j2 <= d2(2); ++j2) {
+                for (j3 = 1; j3 <= d2(3); ++j3) {
+                    t = (j2 % mt) * nt + j3 % nt;
+                    c = next[t]++;
+                    col_position[c] = (j2 - 1) * d2(3) + (j3 - 1);
+                    col_ia[c] = (NumZ) ((j2 - 1) * ms) - (NumZ) mpad;
+                    col_ic[c] = (NumZ) ((j3 - 1) * ns) - (NumZ) npad;
+                }
+            }
+            x_col.clear();
+            y_col.clear();
+            dx_col.clear();
+            K_packed.clear();
+            x_col_f.clear();
+            y_col_f.clear();
+            dx_col_f.clear();
+            setSize_col(1, x_col, y_col, dx_col);
+        }
+
+        // column buffers only grow, so switching between sample and batch doesn't reallocate.
+        template<typename T>
+        void setSize_col(NumN n_samples, Tensor<T> &x_col, Tensor<T> &y_col, Tensor<T> &dx_col) {
+            NumN n_cols = n_samples * d2(2) * d2(3);
+            if (!x_col.isEmpty() && x_col.dim(2) >= n_cols) {
+                return;
+            }
+            x_col.setSize(d1(1) * mk * nk, n_cols);
+            y_col.setSize(d2(1), n_cols);
+            if (isUsingDiff) {
+                dx_col.setSize(d1(1) * mk * nk, n_cols);
+            }
+        }
+
+        // Padding is handled here only, taps out of x are 0.
+        template<typename T>
+        void im2col(const T *x, NumN n_samples, T *x_col_data) const {
+            NumN P = d2(2) * d2(3);
+            NumN m1 = d1(2), n1 = d1(3);
+            NumN v1 = d1(1) * m1 * n1;
+            NumN i1, i2, i3, n, t, c;
+            NumZ ii2, ii3;
+            T *row = x_col_data;
+            for (i1 = 0; i1 < d1(1); ++i1) {
+                for (i2 = 0; i2 < mk; ++i2) {
+                    for (i3 = 0; i3 < nk; ++i3) {
+                        for (t = 0; t < mt * nt; ++t) {
+                            NumN c0 = tile_offset[t];
+                            NumN n_t = tile_offset[t + 1] - c0;
+                            for (n = 0; n < n_samples; ++n) {
+                                const T *x_i1 = x + n * v1 + i1 * m1 * n1;
+                                T *row_n = row + c0 * n_samples + n * n_t - c0;
+                                for (c = c0; c < c0 + n_t; ++c) {
+                                    ii2 = col_ia[c] + (NumZ) i2;
+                                    ii3 = col_ic[c] + (NumZ) i3;
+                                    if (ii2 >= 0 && ii2 < (NumZ) m1 && ii3 >= 0 && ii3 < (NumZ) n1) {
+                                        row_n[c] = x_i1[ii2 * n1 + ii3];
+                                    } else {
+                                        row_n[c] = 0;
+                                    }
+                                }
+                            }
+                        }
+                        row += n_samples * P;
+                    }
+                }
+            }
+        }
+
+        // dx += col2im(dx_col), reverse of im2col.
+        template<typename T>
+        void col2im(const T *dx_col_data, NumN n_samples, T *dx) const {
+            NumN P = d2(2) * d2(3);
+            NumN m1 = d1(2), n1 = d1(3);
+            NumN v1 = d1(1) * m1 * n1;
+            NumN i1, i2, i3, n, t, c;
+            NumZ ii2, ii3;
+            const T *row = dx_col_data;
+            for (i1 = 0; i1 < d1(1); ++i1) {
+                for (i2 = 0; i2 < mk; ++i2) {
+                    for (i3 = 0; i3 < nk; ++i3) {
+                        for (t = 0; t < mt * nt; ++t) {
+                            NumN c0 = tile_offset[t];
+                            NumN n_t = tile_offset[t + 1] - c0;
+                            for (n = 0; n < n_samples; ++n) {
+                                T *dx_i1 = dx + n * v1 + i1 * m1 * n1;
+                                const T *row_n = row + c0 * n_samples + n * n_t - c0;
+                                for (c = c0; c < c0 + n_t; ++c) {
+                                    ii2 = col_ia[c] + (NumZ) i2;
+                                    ii3 = col_ic[c] + (NumZ) i3;
+                                    if (ii2 >= 0 && ii2 < (NumZ) m1 && ii3 >= 0 && ii3 < (NumZ) n1) {
+                                        dx_i1[ii2 * n1 + ii3] += row_n[c];
+                                    }
+                                }
+                            }
+                        }
+                        row += n_samples * P;
+                    }
+                }
+            }
+        }
+
+        // y = hn(conv(x) + b) for n_samples samples.
+        // Kernel of tile t is d2(1)*L matrix at K_data + t * K_tile_offset with row stride ldk.
+        template<typename T>
+        void forward(const T *x, NumN n_samples, const T *K_data, NumN K_tile_offset, NumN ldk, const T *b_data,
+                     Tensor<T> &x_col, Tensor<T> &y_col, Tensor<T> &dx_col, T *y) {
+            NumN j1, n, c;
+            NumN P = d2(2) * d2(3);
+            NumN L = d1(1) * mk * nk;
+            NumN ld = n_samples * P;
+
+            setSize_col(n_samples, x_col, y_col, dx_col);
+            T *x_col_data = math21_memory_tensor_data_address(x_col);
+            im2col(x, n_samples, x_col_data);
+
+            // y_t = K_t * x_t for every tile, all samples at once.
+            T *y_col_data = math21_memory_tensor_data_address(y_col);
+            for (NumN t = 0; t < mt * nt; ++t) {
+                NumN c0 = tile_offset[t];
+                NumN n_t = tile_offset[t + 1] - c0;
+                if (n_t == 0) {
+                    continue;
+                }
+                math21_c_gemm(0, 0, d2(1), n_samples * n_t, L, 1, K_data + t * K_tile_offset, ldk,
+                              x_col_data + c0 * n_samples, ld, 0, y_col_data + c0 * n_samples, ld);
+            }
+
+            for (NumN t = 0; t < mt * nt; ++t) {
+                NumN c0 = tile_offset[t];
+                NumN n_t = tile_offset[t + 1] - c0;
+                for (n = 0; n < n_samples; ++n) {
+                    T *y_n = y + n * d2(1) * P;
+                    for (j1 = 0; j1 < d2(1); ++j1) {
+                        const T *y_col_n = y_col_data + j1 * ld + c0 * n_samples + n * n_t - c0;
+                        T *y_n_j1 = y_n + j1 * P;
+                        for (c = c0; c < c0 + n_t; ++c) {
+                            y_n_j1[col_position[c]] = y_col_n[c];
+                        }
+                    }
+                }
+            }
+            // epilogue, y is in output order now.
+            for (n = 0; n < n_samples; ++n) {
+                math21_c_cnn_hn_bias_valueAt(cnn_type_hn, d2(1) * P, b_data, y + n * d2(1) * P);
+            }
+        }
+
+        void forward(const NumR *x, NumN n_samples, NumR *y) {
+            NumN L = d1(1) * mk * nk;
+            const NumR *K_data = math21_memory_tensor_data_address((const TenR &) K);
+            NumN K_tile_offset = L;
+            NumN ldk = mt * nt * L;
+            if (!K_packed.isEmpty()) {
+                K_data = math21_memory_tensor_data_address((const TenR &) K_packed);
+                K_tile_offset = d2(1) * L;
+                ldk = L;
+            }
+            forward(x, n_samples, K_data, K_tile_offset, ldk, math21_memory_tensor_data_address((const TenR &) b),
+                    x_col, y_col, dx_col, y);
+        }
+
+        // dK = sum of dK_n, i.e., without alpha term, db = sum of dy_n, dx is derivative w.r.t. x.
+        // y is output of forward, dy is buffer of the same size.
+        template<typename T>
+        void backward(const T *x, const T *dy_next, const T *y, NumN n_samples, const T *K_data,
+                      Tensor<T> &x_col, Tensor<T> &y_col, Tensor<T> &dx_col,
+                      T *dy, T *dK_data, NumR *db_data, T *dx) {
+            NumN j1, n, c, p;
+            NumN P = d2(2) * d2(3);
+            NumN L = d1(1) * mk * nk;
+            NumN ldk = mt * nt * L;
+            NumN ld = n_samples * P;
+            NumN v2 = d2(1) * P;
+
+            // dy
+            math21_c_cnn_hn_derivativeValue_using_y(cnn_type_hn, n_samples * v2, dy_next, y, dy);
+
+            // dy_col is dy with columns in order of x_col, y_col is reused for it.
+            setSize_col(n_samples, x_col, y_col, dx_col);
+            T *dy_col = math21_memory_tensor_data_address(y_col);
+            for (NumN t = 0; t < mt * nt; ++t) {
+                NumN c0 = tile_offset[t];
+                NumN n_t = tile_offset[t + 1] - c0;
+                for (n = 0; n < n_samples; ++n) {
+                    const T *dy_n = dy + n * v2;
+                    for (j1 = 0; j1 < d2(1); ++j1) {
+                        T *dy_col_n = dy_col + j1 * ld + c0 * n_samples + n * n_t - c0;
+                        for (c = c0; c < c0 + n_t; ++c) {
+                            dy_col_n[c] = dy_n[j1 * P + col_position[c]];
+                        }
+                    }
+                }
+            }
+
+            T *x_col_data = math21_memory_tensor_data_address(x_col);
+            im2col(x, n_samples, x_col_data);
+
+            T *dx_col_data = math21_memory_tensor_data_address(dx_col);
+
+            // for every tile, dK_t = dy_t * x_t.transpose, summed over positions of the tile.
+            // Tiles are disjoint columns of dK, and every tile has positions, so dK is fully written.
+            for (NumN t = 0; t < mt * nt; ++t) {
+                NumN c0 = tile_offset[t] * n_samples;
+                NumN n_t = (tile_offset[t + 1] - tile_offset[t]) * n_samples;
+                if (n_t == 0) {
+                    continue;
+                }
+                math21_c_gemm(0, 1, d2(1), L, n_t, 1, dy_col + c0, ld, x_col_data + c0, ld,
+                              0, dK_data + t * L, ldk);
+                // dx_t = K_t.transpose * dy_t
+                math21_c_gemm(1, 0, L, n_t, d2(1), 1, K_data + t * L, ldk, dy_col + c0, ld,
+                              0, dx_col_data + c0, ld);
+            }
+
+            // db = sum of dy
+            for (p = 0; p < v2; ++p) {
+                db_data[p] = dy[p];
+            }
+            for (n = 1; n < n_samples; ++n) {
+                for (p = 0; p < v2; ++p) {
+                    db_data[p] += dy[n * v2 + p];
+                }
+            }
+
+            // dx, clear first, then reverse im2col.
+            for (p = 0; p < n_samples * d1(1) * d1(2) * d1(3); ++p) {
+                dx[p] = 0;
+            }
+            col2im(dx_col_data, n_samples, dx);
+        }
+
+        // dK = sum of dK_n + N * alpha * K, db = sum of dy_n, dx is derivative w.r.t. x.
+        void backward(const NumR *x, const NumR *dy_next, const NumR *y, NumN n_samples, NumR alpha,
+                      NumR *dy, NumR *dx) {
+            const NumR *K_data = math21_memory_tensor_data_address((const TenR &) K);
+            NumR *dK_data = math21_memory_tensor_data_address(dK);
+            backward(x, dy_next, y, n_samples, K_data, x_col, y_col, dx_col,
+                     dy, dK_data, math21_memory_tensor_data_address(db), dx);
+            math21_c_vector_linear(dK.volume(), 1, dK_data, n_samples * alpha, K_data, dK_data);
+        }
+
         void thetaToInner(const SpaceParas &paras, TenR &W, TenR &b) {
             MATH21_ASSERT(paras.size == getThetaSize() * sizeof(NumR));
             NumN offset = 0;
@@ -788,6 +1415,41 @@ namespace math21 {
             thetaToInner(paras, dK, db);
         }
 
+        void setThetaSpace_f(const SpaceParas &paras) override {
+            MATH21_ASSERT(paras.size == getThetaSize() * sizeof(float));
+            SpaceParas paras_dst;
+            VecN d;
+            math21_memory_getSpace(paras, paras_dst, 0, K.volume(), sizeof(float));
+            K_f.setSize(K.shape(d), &paras_dst);
+            math21_memory_getSpace(paras, paras_dst, K.volume(), b.volume(), sizeof(float));
+            b_f.setSize(b.shape(d), &paras_dst);
+        }
+
+        // kernels of tiles are copied to K_packed, so each one is continuous.
+        void freeze() override {
+            cnn_fn::freeze();
+            dK.clear();
+            db.clear();
+            dx_col.clear();
+            dK_f.clear();
+            x_col_f.clear();
+            y_col_f.clear();
+            dx_col_f.clear();
+            if (mt * nt > 1) {
+                NumN L = d1(1) * mk * nk;
+                NumN ldk = mt * nt * L;
+                K_packed.setSize(mt * nt, d2(1), L);
+                const NumR *K_data = math21_memory_tensor_data_address((const TenR &) K);
+                NumR *K_packed_data = math21_memory_tensor_data_address(K_packed);
+                for (NumN t = 0; t < mt * nt; ++t) {
+                    for (NumN j1 = 0; j1 < d2(1); ++j1) {
+                        math21_memory_memcpy(K_packed_data + (t * d2(1) + j1) * L,
+                                             K_data + j1 * ldk + t * L, sizeof(NumR) * L);
+                    }
+                }
+            }
+        }
+
         void log() const override {
             if (isEmpty()) {
                 return;
@@ -852,121 +1514,88 @@ namespace math21 {
                 dK.setSize(index);
                 db.setSize(d2);
             }
+            setSize_im2col();
         }
 
         void derivativeValueAtTheta_and_xn_J(const TenR &xn, const TenR &dxn_next, NumR alpha) override {
-            NumN j1, j2, j3, i1, i2, i3;
-            NumN jj2, jj3; // index of K.
-            NumZ ii2, ii3; //absolute index w.r.t. x.
-            NumZ ia, ic;
-            NumR val;
-
-            // dyn
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        dyn(j1, j2, j3) = dxn_next(j1, j2, j3) * h->derivativeValue_using_y(xn_next(j1, j2, j3));
-                    }
-                }
-            }
-
-            // dW, db
-            NumR val_dy;
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    jj2 = j2 % mt + 1;
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        jj3 = j3 % nt + 1;
-                        val_dy = dyn(j1, j2, j3);
-                        ia = (j2 - 1) * ms - mpad;
-                        ic = (j3 - 1) * ns - npad;
-                        for (i1 = 1; i1 <= d1(1); ++i1) {
-                            for (i2 = 1; i2 <= mk; ++i2) {
-                                ii2 = ia + i2;
-                                for (i3 = 1; i3 <= nk; ++i3) {
-                                    ii3 = ic + i3;
-                                    if (xjIsIn(ii2, 1, d1(2)) && xjIsIn(ii3, 1, d1(3))) {
-                                        val = xn(i1, ii2, ii3);
-                                    } else {
-                                        val = 0;
-                                    }
-                                    dK(j1, jj2, jj3, i1, i2, i3) = val_dy * val +
-                                                                   alpha * K(j1, jj2, jj3, i1, i2, i3);
-                                }
-                            }
-                        }
-                        db(j1, j2, j3) = val_dy;
-                    }
-                }
-            }
-
-            // dxn, clear first, then reverse compute.
-            dxn = 0;
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    jj2 = j2 % mt + 1;
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        jj3 = j3 % nt + 1;
-                        val_dy = dyn(j1, j2, j3);
-                        ia = (j2 - 1) * ms - mpad;
-                        ic = (j3 - 1) * ns - npad;
-                        for (i1 = 1; i1 <= d1(1); ++i1) {
-                            for (i2 = 1; i2 <= mk; ++i2) {
-                                ii2 = ia + i2;
-                                for (i3 = 1; i3 <= nk; ++i3) {
-                                    ii3 = ic + i3;
-                                    if (xjIsIn(ii2, 1, d1(2)) && xjIsIn(ii3, 1, d1(3))) {
-                                        NumR &val_dxn = dxn.valueAt(i1, ii2, ii3);
-                                        val_dxn = val_dxn + K(j1, jj2, jj3, i1, i2, i3) * val_dy;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+            MATH21_ASSERT(xn.volume() == d1(1) * d1(2) * d1(3), "input size doesn't match conv");
+            TenR xn_c, dxn_next_c;
+            backward(getContinuousData(xn, xn_c), getContinuousData(dxn_next, dxn_next_c),
+                     math21_memory_tensor_data_address((const TenR &) xn_next), 1, alpha,
+                     math21_memory_tensor_data_address(dyn), math21_memory_tensor_data_address(dxn));
 
             // clip
             math21_clip(dxn);
         }
 
         const TenR &valueAt(const TenR &x) override {
-            NumN j1, j2, j3, i1, i2, i3;
-            NumN jj2, jj3; // index of K.
-            NumZ ii2, ii3; //absolute index w.r.t. x.
-            NumZ ia, ic;
-            NumR val;
-            NumR y;
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    jj2 = j2 % mt + 1;
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        jj3 = j3 % nt + 1;
-                        y = 0;
-                        ia = (j2 - 1) * ms - mpad;
-                        ic = (j3 - 1) * ns - npad;
-                        for (i1 = 1; i1 <= d1(1); ++i1) {
-                            for (i2 = 1; i2 <= mk; ++i2) {
-                                ii2 = ia + i2;
-                                for (i3 = 1; i3 <= nk; ++i3) {
-                                    ii3 = ic + i3;
-                                    if (xjIsIn(ii2, 1, d1(2)) && xjIsIn(ii3, 1, d1(3))) {
-                                        val = x(i1, ii2, ii3);
-                                    } else {
-                                        val = 0;
-                                    }
-                                    y = y + val * K(j1, jj2, jj3, i1, i2, i3);
-                                }
-                            }
-                        }
-                        y = y + b(j1, j2, j3);
-                        xn_next(j1, j2, j3) = h->valueAt(y);
-                    }
-                }
-            }
+            MATH21_ASSERT(x.volume() == d1(1) * d1(2) * d1(3), "input size doesn't match conv");
+            TenR x_c;
+            forward(getContinuousData(x, x_c), 1, math21_memory_tensor_data_address(xn_next));
             return xn_next;
         }
 
+        const TenR &valueAt_batch(const TenR &X) override {
+            NumN n_samples = getBatchSize(X);
+            setSize_batch(n_samples);
+            TenR X_c;
+            forward(getContinuousData(X, X_c), n_samples, math21_memory_tensor_data_address(xn_next_batch));
+            return xn_next_batch;
+        }
+
+        void derivativeValueAtTheta_and_xn_J_batch(const TenR &X, const TenR &dX_next, NumR alpha) override {
+            MATH21_ASSERT(isUsingDiff, "maybe you forgot to enable diff in constructor");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch(n_samples);
+            TenR X_c, dX_next_c;
+            backward(getContinuousData(X, X_c), getContinuousData(dX_next, dX_next_c),
+                     math21_memory_tensor_data_address((const TenR &) xn_next_batch), n_samples, alpha,
+                     math21_memory_tensor_data_address(dyn_batch), math21_memory_tensor_data_address(dxn_batch));
+
+            // clip
+            math21_clip(dxn_batch);
+        }
+
+        const Tensor<float> &valueAt_batch_f(const Tensor<float> &X) override {
+            MATH21_ASSERT(!K_f.isEmpty(), "float theta not set");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch_f(n_samples);
+            Tensor<float> X_c;
+            NumN L = d1(1) * mk * nk;
+            forward(getContinuousData(X, X_c), n_samples, math21_memory_tensor_data_address((const Tensor<float> &) K_f),
+                    L, mt * nt * L, math21_memory_tensor_data_address((const Tensor<float> &) b_f),
+                    x_col_f, y_col_f, dx_col_f, math21_memory_tensor_data_address(xn_next_batch_f));
+            return xn_next_batch_f;
+        }
+
+        // products are in float, sums over samples written to dtheta are in NumR.
+        void derivativeValueAtTheta_and_xn_J_batch_f(const Tensor<float> &X, const Tensor<float> &dX_next,
+                                                     NumR alpha) override {
+            MATH21_ASSERT(isUsingDiff, "maybe you forgot to enable diff in constructor");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch_f(n_samples);
+            if (dK_f.isEmpty()) {
+                dK_f.setSize(K.shape());
+            }
+            Tensor<float> X_c, dX_next_c;
+            float *dK_f_data = math21_memory_tensor_data_address(dK_f);
+            backward(getContinuousData(X, X_c), getContinuousData(dX_next, dX_next_c),
+                     math21_memory_tensor_data_address((const Tensor<float> &) xn_next_batch_f), n_samples,
+                     math21_memory_tensor_data_address((const Tensor<float> &) K_f), x_col_f, y_col_f, dx_col_f,
+                     math21_memory_tensor_data_address(dyn_batch_f), dK_f_data,
+                     math21_memory_tensor_data_address(db), math21_memory_tensor_data_address(dxn_batch_f));
+
+            // dK = dK_f + N * alpha * K
+            const NumR *K_data = math21_memory_tensor_data_address((const TenR &) K);
+            NumR *dK_data = math21_memory_tensor_data_address(dK);
+            for (NumN i = 0; i < dK.volume(); ++i) {
+                dK_data[i] = dK_f_data[i] + n_samples * alpha * K_data[i];
+            }
+
+            // clip
+            math21_clip(dxn_batch_f);
+        }
+
         NumR calWeightNormSquare(NumN norm) const override {
             NumR sum = math21_operator_norm(K, norm);
             if (norm == 1) {
@@ -987,7 +1616,10 @@ namespace math21 {
 
     class cnn_fn_pooling : public cnn_fn {
     private:
-        Seqce <TenN> xn_argmax; //just for train max pooling
+        // just for train max pooling, offset of max w.r.t. its input plane, d2 and N*d2.
+        Tensor <NumN32> xn_argmax;
+        Tensor <NumN32> xn_argmax_batch;
+        Tensor <NumN32> window_offset; // offsets of windows in an input plane, from math21_c_ml_pooling_get_window_offsets.
         NumN cnn_type_pooling;
         NumN mk;
         NumN nk;
@@ -1042,6 +1674,12 @@ namespace math21 {
         void setDthetaSpace(const SpaceParas &paras) override {
         }
 
+        void freeze() override {
+            cnn_fn::freeze();
+            xn_argmax.clear();
+            xn_argmax_batch.clear();
+        }
+
         void log() const override {
             if (isEmpty()) {
                 return;
@@ -1058,80 +1696,129 @@ namespace math21 {
             //
             math21_operator_ml_pooling_get_mk_ms(d1(2), d1(3), d2(2), d2(3), mk, nk, ms, ns);
 
+            window_offset.setSize(d2(2) * d2(3));
+            math21_c_ml_pooling_get_window_offsets(d1(2), d1(3), d2(2), d2(3), mk, nk, ms, ns,
+                                                   math21_memory_tensor_data_address(window_offset));
+
             // just for training
             if (isUsingDiff) {
                 if (cnn_type_pooling == cnn_type_pooling_max) {
-                    xn_argmax.setSize(2);
-                    xn_argmax(1).setSize(d2);
-                    xn_argmax(2).setSize(d2);
+                    xn_argmax.setSize(d2(1) * d2(2) * d2(3));
                 }
             }
         }
 
         void derivativeValueAtTheta_and_xn_J(const TenR &xn, const TenR &dxn_next, NumR alpha) override {
-            NumN j1, j2, j3, i1, i2, i3;
-            NumZ ii2, ii3; //absolute index w.r.t. x.
-            NumZ ia, ic;
-            NumR val;
-            NumN ii2_max; // argmax index of x
-            NumN ii3_max;
             // dyn
-            for (j1 = 1; j1 <= d2(1); ++j1) {
-                for (j2 = 1; j2 <= d2(2); ++j2) {
-                    for (j3 = 1; j3 <= d2(3); ++j3) {
-                        dyn(j1, j2, j3) = dxn_next(j1, j2, j3);
-                    }
-                }
-            }
+            math21_operator_container_set(dxn_next, dyn);
 
-            NumR val_dy;
-            // dxn, clear first, then reverse compute.
-            dxn = 0;
-            if (cnn_type_pooling == cnn_type_pooling_average) {
-                for (j1 = 1; j1 <= d2(1); ++j1) {
-                    for (j2 = 1; j2 <= d2(2); ++j2) {
-                        for (j3 = 1; j3 <= d2(3); ++j3) {
-                            val_dy = dyn(j1, j2, j3);
-                            ia = (j2 - 1) * ms;
-                            ic = (j3 - 1) * ns;
-                            i1 = j1;
-                            for (i2 = 1; i2 <= mk; ++i2) {
-                                ii2 = ia + i2;
-                                for (i3 = 1; i3 <= nk; ++i3) {
-                                    ii3 = ic + i3;
-                                    NumR &val_dxn = dxn.valueAt(i1, ii2, ii3);
-                                    val_dxn = val_dxn + val_dy / (mk * nk);
-                                }
-                            }
-                        }
-                    }
-                }
-            } else if (cnn_type_pooling == cnn_type_pooling_max) {
-                for (j1 = 1; j1 <= d2(1); ++j1) {
-                    for (j2 = 1; j2 <= d2(2); ++j2) {
-                        for (j3 = 1; j3 <= d2(3); ++j3) {
-                            val_dy = dyn(j1, j2, j3);
-                            i1 = j1;
-                            ii2_max = xn_argmax(1)(j1, j2, j3);
-                            ii3_max = xn_argmax(2)(j1, j2, j3);
-                            NumR &val_dxn = dxn.valueAt(i1, ii2_max, ii3_max);
-                            val_dxn = val_dxn + val_dy;
-                        }
-                    }
-                }
+            const NumN32 *argmax = 0;
+            if (cnn_type_pooling == cnn_type_pooling_max) {
+                argmax = math21_memory_tensor_data_address((const Tensor <NumN32> &) xn_argmax);
             }
+            math21_c_ml_pooling_derivativeValueAt(cnn_type_pooling, d1(1), d1(2), d1(3), d2(2) * d2(3), mk, nk,
+                                                  math21_memory_tensor_data_address(
+                                                          (const Tensor <NumN32> &) window_offset),
+                                                  math21_memory_tensor_data_address((const TenR &) dyn), argmax,
+                                                  math21_memory_tensor_data_address(dxn));
 
             // clip
             math21_clip(dxn);
         }
 
         const TenR &valueAt(const TenR &x) override {
-            math21_operator_ml_pooling_valueAt(x, xn_next, cnn_type_pooling,
-                                               mk, nk, ms, ns,
-                                               &xn_argmax, isUsingDiff);
+            TenR x_c;
+            NumN32 *argmax = 0;
+            if (isUsingDiff && cnn_type_pooling == cnn_type_pooling_max) {
+                argmax = math21_memory_tensor_data_address(xn_argmax);
+            }
+            math21_c_ml_pooling_valueAt(cnn_type_pooling, d1(1), d1(2), d1(3), d2(2) * d2(3), mk, nk,
+                                        math21_memory_tensor_data_address((const Tensor <NumN32> &) window_offset),
+                                        getContinuousData(x, x_c), math21_memory_tensor_data_address(xn_next),
+                                        argmax);
             return xn_next;
         }
 
+        // channels of all samples are pooled as N*d1(1) planes.
+        const TenR &valueAt_batch(const TenR &X) override {
+            NumN n_samples = getBatchSize(X);
+            setSize_batch(n_samples);
+            TenR X_c;
+            NumN32 *argmax = 0;
+            if (isUsingDiff && cnn_type_pooling == cnn_type_pooling_max) {
+                xn_argmax_batch.setSize(n_samples * d2(1) * d2(2) * d2(3));
+                argmax = math21_memory_tensor_data_address(xn_argmax_batch);
+            }
+            math21_c_ml_pooling_valueAt(cnn_type_pooling, n_samples * d1(1), d1(2), d1(3), d2(2) * d2(3), mk, nk,
+                                        math21_memory_tensor_data_address((const Tensor <NumN32> &) window_offset),
+                                        getContinuousData(X, X_c), math21_memory_tensor_data_address(xn_next_batch),
+                                        argmax);
+            return xn_next_batch;
+        }
+
+        void derivativeValueAtTheta_and_xn_J_batch(const TenR &X, const TenR &dX_next, NumR alpha) override {
+            MATH21_ASSERT(isUsingDiff, "maybe you forgot to enable diff in constructor");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch(n_samples);
+            math21_operator_container_set(dX_next, dyn_batch);
+
+            const NumN32 *argmax = 0;
+            if (cnn_type_pooling == cnn_type_pooling_max) {
+                MATH21_ASSERT(xn_argmax_batch.size() == n_samples * d2(1) * d2(2) * d2(3),
+                              "valueAt_batch must be called first");
+                argmax = math21_memory_tensor_data_address((const Tensor <NumN32> &) xn_argmax_batch);
+            }
+            math21_c_ml_pooling_derivativeValueAt(cnn_type_pooling, n_samples * d1(1), d1(2), d1(3), d2(2) * d2(3),
+                                                  mk, nk,
+                                                  math21_memory_tensor_data_address(
+                                                          (const Tensor <NumN32> &) window_offset),
+                                                  math21_memory_tensor_data_address((const TenR &) dyn_batch), argmax,
+                                                  math21_memory_tensor_data_address(dxn_batch));
+
+            // clip
+            math21_clip(dxn_batch);
+        }
+
+        // argmax is shared with valueAt_batch.
+        const Tensor<float> &valueAt_batch_f(const Tensor<float> &X) override {
+            NumN n_samples = getBatchSize(X);
+            setSize_batch_f(n_samples);
+            Tensor<float> X_c;
+            NumN32 *argmax = 0;
+            if (isUsingDiff && cnn_type_pooling == cnn_type_pooling_max) {
+                xn_argmax_batch.setSize(n_samples * d2(1) * d2(2) * d2(3));
+                argmax = math21_memory_tensor_data_address(xn_argmax_batch);
+            }
+            math21_c_ml_pooling_valueAt(cnn_type_pooling, n_samples * d1(1), d1(2), d1(3), d2(2) * d2(3), mk, nk,
+                                        math21_memory_tensor_data_address((const Tensor <NumN32> &) window_offset),
+                                        getContinuousData(X, X_c), math21_memory_tensor_data_address(xn_next_batch_f),
+                                        argmax);
+            return xn_next_batch_f;
+        }
+
+        void derivativeValueAtTheta_and_xn_J_batch_f(const Tensor<float> &X, const Tensor<float> &dX_next,
+                                                     NumR alpha) override {
+            MATH21_ASSERT(isUsingDiff, "maybe you forgot to enable diff in constructor");
+            NumN n_samples = getBatchSize(X);
+            setSize_batch_f(n_samples);
+
+            const NumN32 *argmax = 0;
+            if (cnn_type_pooling == cnn_type_pooling_max) {
+                MATH21_ASSERT(xn_argmax_batch.size() == n_samples * d2(1) * d2(2) * d2(3),
+                              "valueAt_batch_f must be called first");
+                argmax = math21_memory_tensor_data_address((const Tensor <NumN32> &) xn_argmax_batch);
+            }
+            Tensor<float> dX_next_c;
+            math21_c_ml_pooling_derivativeValueAt(cnn_type_pooling, n_samples * d1(1), d1(2), d1(3), d2(2) * d2(3),
+                                                  mk, nk,
+                                                  math21_memory_tensor_data_address(
+                                                          (const Tensor <NumN32> &) window_offset),
+                                                  getContinuousData(dX_next, dX_next_c), argmax,
+                                                  math21_memory_tensor_data_address(dxn_batch_f));
+
+            // clip
+            math21_clip(dxn_batch_f);
+        }
 
         NumR calWeightNormSquare(NumN norm) const override {
             return 0;
@@ -1158,6 +1845,58 @@ namespace math21 {
         VecR theta;
         //dtheta has space currently.
         VecR dtheta;//performance theta
+        TenR dxn_next_batch; // derivative of loss w.r.t. batch output
+
+        // theta is changed by setTheta only, so its version keys the weight norms cached for evaluation.
+        NumN theta_version;
+        NumN weight_norm_version[2]; // version of cached norm 1 and 2, 0 if not cached.
+        NumR weight_norm_value[2];
+
+        NumB isThetaShared; // theta uses space given by setThetaSpace.
+
+        // inference only, see freeze.
+        NumB isFrozen;
+        TenR xn_buffers[2];
+        TenR xn_batch_buffers[2];
+
+        // batch in float, see setUsingFloat.
+        NumB isUsingFloat;
+        Tensor<float> theta_f;
+        Tensor<float> X_f;
+        Tensor<float> dxn_next_batch_f;
+        TenR y_batch; // output of float batch converted to NumR
+
+        // layer n writes output to buffer n%2, and reads input from the other one.
+        void freezeLayers() {
+            NumN volume_max = 0;
+            for (NumN n = 1; n <= N; n++) {
+                volume_max = xjmax(volume_max, math21_operator_multiply_all(fns(n)->getOutputShape()));
+            }
+            xn_buffers[0].setSize(volume_max);
+            xn_buffers[1].setSize(volume_max);
+            for (NumN n = 1; n <= N; n++) {
+                cnn_fn &fn = *fns(n);
+                fn.freeze();
+                NumN volume = math21_operator_multiply_all(fn.getOutputShape());
+                fn.setValueSpace(xn_buffers[n % 2].getSpace(0, volume, sizeof(NumR)));
+            }
+        }
+
+        void setValueSpace_batch(NumN n_samples) {
+            NumN volume_max = 0;
+            for (NumN n = 1; n <= N; n++) {
+                volume_max = xjmax(volume_max, math21_operator_multiply_all(fns(n)->getOutputShape()));
+            }
+            if (xn_batch_buffers[0].size() < n_samples * volume_max) {
+                xn_batch_buffers[0].setSize(n_samples * volume_max);
+                xn_batch_buffers[1].setSize(n_samples * volume_max);
+            }
+            for (NumN n = 1; n <= N; n++) {
+                cnn_fn &fn = *fns(n);
+                NumN volume = math21_operator_multiply_all(fn.getOutputShape());
+                fn.setValueSpace_batch(n_samples, xn_batch_buffers[n % 2].getSpace(0, n_samples * volume, sizeof(NumR)));
+            }
+        }
 
         void init() {
             reset();
@@ -1166,6 +1905,73 @@ namespace math21 {
         void reset() {
             N = 0;
             isUsingDiff = 0;
+            theta_version = 1;
+            weight_norm_version[0] = 0;
+            weight_norm_version[1] = 0;
+            theta.clear();
+            isThetaShared = 0;
+            isFrozen = 0;
+            xn_buffers[0].clear();
+            xn_buffers[1].clear();
+            xn_batch_buffers[0].clear();
+            xn_batch_buffers[1].clear();
+            isUsingFloat = 0;
+            theta_f.clear();
+            X_f.clear();
+            dxn_next_batch_f.clear();
+            y_batch.clear();
+        }
+
+        // theta_f = theta, and its space is given to layers once.
+        void thetaToInner_f(const VecR &theta) {
+            NumB isNew = theta_f.isEmpty() ? (NumB) 1 : (NumB) 0;
+            math21_operator_cnn_cast(theta, theta_f);
+            if (!isNew) {
+                return;
+            }
+            NumN offset = 0;
+            for (NumN i = 1; i <= fns.size(); i++) {
+                cnn_fn &fn = *fns(i);
+                SpaceParas paras = theta_f.getSpace(offset, fn.getThetaSize(), sizeof(float));
+                offset = offset + fn.getThetaSize();
+                fn.setThetaSpace_f(paras);
+            }
+        }
+
+        const TenR &valueAt_batch_f(const TenR &X, const VecR &theta) {
+            thetaToInner_f(theta);
+            math21_operator_cnn_cast(X, X_f);
+            const Tensor<float> *xn = &X_f;
+            const Tensor<float> *xn_next;
+            for (NumN n = 1; n <= N; n++) {
+                cnn_fn &fn = *fns(n);
+                xn_next = &fn.valueAt_batch_f(*xn);
+                xn = xn_next;
+            }
+            math21_operator_cnn_cast(*xn_next, y_batch);
+            return y_batch;
+        }
+
+        void derivativeValueAtTheta_batch_f(NumR alpha) {
+            math21_operator_cnn_cast(dxn_next_batch, dxn_next_batch_f);
+            const Tensor<float> *xn_p;
+            const Tensor<float> *dxn_next_p;
+            for (NumN n = N; n >= 1; n--) {
+                if (n == N) {
+                    dxn_next_p = &dxn_next_batch_f;
+                } else {
+                    cnn_fn &fn_next = *fns(n + 1);
+                    dxn_next_p = &fn_next.get_derivativeValue_J_batch_f();
+                }
+                if (n > 1) {
+                    cnn_fn &fn_pre = *fns(n - 1);
+                    xn_p = &fn_pre.getValue_batch_f();
+                } else {
+                    xn_p = &X_f;
+                }
+                cnn_fn &fn = *fns(n);
+                fn.derivativeValueAtTheta_and_xn_J_batch_f(*xn_p, *dxn_next_p, alpha);
+            }
         }
 
         // called only once
@@ -1187,6 +1993,7 @@ namespace math21 {
                 SpaceParas paras = theta.getSpace(offset, fn.getThetaSize(), sizeof(NumR));
                 offset = offset + fn.getThetaSize();
                 fn.setDthetaSpace(paras);
+                fn.setDthetaSpace_batch(paras);
             }
         }
 
@@ -1267,6 +2074,38 @@ namespace math21 {
             if (_fns.isEmpty()) {
                 return;
             }
+            setSize_fns(_d0, _fns, _isUsingDiff);
+            logInfo();
+        }
+
+        // same architecture as f, theta is not copied.
+        // Every copy has its own buffers, so copies can run on different threads sharing the same theta.
+        void copyArchitecture(const cnn &f) {
+            MATH21_ASSERT(!f.isEmpty());
+            setSize_fns(f.d0, f.fns, f.isUsingDiff);
+            setUsingFloat(f.isUsingFloat);
+        }
+
+        // Batch, i.e., valueAt_batch and derivativeValueAtTheta_batch, is computed in float,
+        // so it takes half the memory traffic. theta and dtheta stay NumR, and are what optimizers see.
+        // theta is converted to float on every call, and sums over samples written to dtheta are in NumR.
+        // Single sample is always in NumR, and layers without float version, e.x., locally, compute in NumR.
+        void setUsingFloat(NumB _isUsingFloat) {
+            MATH21_ASSERT(!isFrozen || !_isUsingFloat, "frozen cnn doesn't use float");
+            isUsingFloat = _isUsingFloat;
+            theta_f.clear();
+            X_f.clear();
+            dxn_next_batch_f.clear();
+            y_batch.clear();
+        }
+
+        NumB getUsingFloat() const {
+            return isUsingFloat;
+        }
+
+    private:
+        void setSize_fns(const VecN &_d0, const Seqce<cnn_fn *> &_fns,
+                         NumB _isUsingDiff) {
             for (NumN i = 1; i <= _fns.size(); i++) {
                 MATH21_ASSERT(_fns(i) != 0, "null fn " << i);
             }
@@ -1292,10 +2131,9 @@ namespace math21 {
 //                dtheta.log("1");
                 dthetaToInner(dtheta);
             }
-
-            logInfo();
         }
 
+    public:
         void serialize(std::ostream &out, SerializeNumInterface &sn) const {
             math21_serialize(out, d0, sn);
             sn.serialize(out, N);
@@ -1347,17 +2185,61 @@ namespace math21 {
 
         //used when finishing training.
         void setTheta(const VecR &_theta) {
+            // don't write to space given by setThetaSpace.
+            if (isThetaShared) {
+                theta.clear();
+                isThetaShared = 0;
+            }
             if (theta.isSameSize(_theta.shape()) == 0) {
                 theta.setSize(_theta.shape());
             }
             theta.assign(_theta);
             thetaToInner(theta);
+            ++theta_version;
+            if (isFrozen) {
+                freezeLayers();
+            }
+        }
+
+        // theta shares space given, e.x., a mapped checkpoint, so no copy is made.
+        // The space must live until theta is set again or cnn is cleared.
+        void setThetaSpace(const SpaceParas &paras) {
+            MATH21_ASSERT(paras.size == getThetaSize() * sizeof(NumR), "space size doesn't match theta size");
+            VecN d(1);
+            d = getThetaSize();
+            theta.setSize(d, &paras);
+            isThetaShared = 1;
+            thetaToInner(theta);
+            ++theta_version;
+            if (isFrozen) {
+                freezeLayers();
+            }
+        }
+
+        // Inference only mode for deploying, i.e., forward with theta set by setTheta.
+        // dtheta and diff buffers of layers are released, outputs of layers take turns using two buffers,
+        // and weights are kept in layout used by forward.
+        // Outputs of layers other than the last one are not valid after valueAt.
+        void freeze() {
+            MATH21_ASSERT(!isEmpty());
+            MATH21_ASSERT(!isUsingFloat, "frozen cnn doesn't use float");
+            isFrozen = 1;
+            isUsingDiff = 0;
+            dtheta.clear();
+            dxn_next_batch.clear();
+            freezeLayers();
         }
 
         //used when evaluate
+        //computed once for every theta set by setTheta.
         NumR calWeightNormSquare(NumN norm) {
             MATH21_ASSERT(!theta.isEmpty());
-            return calWeightNormSquare(theta, norm);
+            MATH21_ASSERT(norm == 1 || norm == 2, "norm other than 1, 2 not supported currently");
+            if (weight_norm_version[norm - 1] != theta_version) {
+                weight_norm_value[norm - 1] = calWeightNormSquare(theta, norm);
+                weight_norm_version[norm - 1] = theta_version;
+            }
+            return weight_norm_value[norm - 1];
         }
 
         //used when train
@@ -1381,6 +2263,7 @@ namespace math21 {
 
         //used by loss function
         const TenR &valueAt(const TenR &x, const VecR &theta) {
+            MATH21_ASSERT(!isFrozen || &theta == &this->theta, "frozen cnn uses theta set by setTheta only");
             thetaToInner(theta);
             const TenR *xn = &x;
             const TenR *xn_next;
@@ -1420,6 +2303,86 @@ namespace math21 {
             return dtheta;
         }
 
+        //use when predict
+        const TenR &valueAt_batch(const TenR &X) {
+            MATH21_ASSERT(!theta.isEmpty());
+            return valueAt_batch(X, theta);
+        }
+
+        // X is N*d0, i.e., N samples stacked along the first dim, and return output of the batch.
+        const TenR &valueAt_batch(const TenR &X, const VecR &theta) {
+            MATH21_ASSERT(!isFrozen || &theta == &this->theta, "frozen cnn uses theta set by setTheta only");
+            thetaToInner(theta);
+            if (isUsingFloat) {
+                return valueAt_batch_f(X, theta);
+            }
+            if (isFrozen) {
+                setValueSpace_batch(X.dim(1));
+            }
+            const TenR *xn = &X;
+            const TenR *xn_next;
+            for (NumN n = 1; n <= N; n++) {
+                cnn_fn &fn = *fns(n);
+                xn_next = &fn.valueAt_batch(*xn);
+                xn = xn_next;
+            }
+            return *xn_next;
+        }
+
+        // Y is batch of targets, sample n of Y is set to L when computing loss of sample n.
+        // Return derivative summed over samples, i.e., alpha*theta is added N times.
+        const VecR &derivativeValueAtTheta_batch(const TenR &X, const TenR &Y, const VecR &theta,
+                                                 CostFunctional_class &L, NumR alpha) {
+            MATH21_ASSERT(!dtheta.isEmpty(), "empty, you can set when create cnn");
+            MATH21_ASSERT(X.dims() == 4 && Y.dims() == 4 && X.dim(1) == Y.dim(1));
+
+            const TenR &output = valueAt_batch(X, theta);
+            if (!dxn_next_batch.isSameSize(output.shape())) {
+                dxn_next_batch.setSize(output.shape());
+            }
+            TenR y, output_n, dxn_next_n;
+            for (NumN i = 1; i <= X.dim(1); i++) {
+                math21_operator_share_first_dim_slice(Y, i, y);
+                math21_operator_share_first_dim_slice(output, i, output_n);
+                math21_operator_share_first_dim_slice(dxn_next_batch, i, dxn_next_n);
+                L.setParas(y);
+                math21_operator_container_set(L.derivativeValueAt(output_n), dxn_next_n);
+            }
+
+            if (isUsingFloat) {
+                derivativeValueAtTheta_batch_f(alpha);
+                math21_clip(dtheta);
+                return dtheta;
+            }
+
+            const TenR *xn_p;
+            const TenR *dxn_next_p;
+            for (NumN n = N; n >= 1; n--) {
+                if (n == N) {
+                    dxn_next_p = &dxn_next_batch;
+                } else {
+                    cnn_fn &fn_next = *fns(n + 1);
+                    dxn_next_p = &fn_next.get_derivativeValue_J_batch();
+                }
+                if (n > 1) {
+                    cnn_fn &fn_pre = *fns(n - 1);
+                    xn_p = &fn_pre.getValue_batch();
+                } else {
+                    xn_p = &X;
+                }
+                cnn_fn &fn = *fns(n);
+                fn.derivativeValueAtTheta_and_xn_J_batch(*xn_p, *dxn_next_p, alpha);
+            }
+
+            math21_clip(dtheta);
+            return dtheta;
+        }
+
+        // theta set by setTheta or setThetaSpace.
+        const VecR &getTheta() const {
+            return theta;
+        }
+
         NumN getThetaSize() const {
             if (theta.isEmpty()) {
                 NumN thetaSize = 0;
@@ -1448,6 +2411,15 @@ namespace math21 {
             return N == 0 ? 1 : 0;
         }
 
+        NumN getNumberOfLayers() const {
+            return N;
+        }
+
+        // from bottom to top, i = 1, ..., N.
+        const cnn_fn &getLayer(NumN i) const {
+            return *fns(i);
+        }
+
         virtual ~cnn() {
             clear();
         }
@@ -1468,12 +2440,36 @@ namespace math21 {
         cnn_cost_class_paras(NumR &lambda) : lambda(lambda) {}
     };
 
+    // buffers of one thread when cnn_cost_class runs in parallel.
+    struct cnn_cost_workspace {
+        cnn f;
+        CostFunctional_class *L;
+        TenR X_batch;
+        TenR Y_batch;
+        VecR dtheta; // sum over points of this thread
+        NumR value; // sum over points of this thread
+
+        cnn_cost_workspace(const cnn &_f, const CostFunctional_class &_L) {
+            f.copyArchitecture(_f);
+            L = _L.clone();
+            value = 0;
+        }
+
+        virtual ~cnn_cost_workspace() {
+            delete L;
+        }
+    };
+
     //negative log likelihood cost function with respect to theta.
     //here we use softmax function and cross-entropy together.
+    class cnn_data_pipeline;
+
     class cnn_cost_class : public Functional {
     private:
         cnn &f;
         CostFunctional_class &L;
+        // minibatches are from pipeline if not 0, and X, Y are points of the current one.
+        cnn_data_pipeline *pipeline;
 
         const Seqce <TenR> &X;
         const Seqce <TenR> &Y;
@@ -1487,6 +2483,103 @@ namespace math21 {
 
         // not good
         NumN stride = 33;
+
+        // minibatch is run through cnn as batches of at most batch_size_max samples.
+        NumB isUsingBatch;
+        NumN batch_size_max;
+        VecN indexes;
+        TenR X_batch;
+        TenR Y_batch;
+
+        // penalty doesn't depend on points, so it is computed once for a minibatch instead of once for every point.
+        NumR getPenalty(const VecR &theta) {
+            return (lambda / 2) * f.calWeightNormSquare(theta, 2);
+        }
+
+        // indexes of minibatch, i.e., start, start + stride, ..., wrapped by Xsize.
+        void setMinibatchIndexes() {
+            indexes.setSize(size);
+            NumN index = start;
+            for (NumN i = 1; i <= size; i++) {
+                if (index > Xsize) {
+                    index = index % Xsize;
+                    if (index == 0) {
+                        index = Xsize;
+                    }
+                }
+                indexes(i) = index;
+                index = index + stride;
+            }
+        }
+
+        // data parallel, every thread has its own workspace, i.e., copy of f and L, and dtheta.
+        NumN n_threads;
+        Seqce<cnn_cost_workspace *> workspaces;
+
+        // copy points indexes(i0+1), ..., indexes(i0+n) to X_batch and Y_batch.
+        // Minibatch from pipeline is already a batch, so X_batch and Y_batch share its rows instead.
+        void setBatch(NumN i0, NumN n, TenR &X_batch, TenR &Y_batch) const;
+
+        void setBatch_copy(NumN i0, NumN n, TenR &X_batch, TenR &Y_batch) const {
+            X_batch.setSize(n, X(1).dim(1), X(1).dim(2), X(1).dim(3));
+            Y_batch.setSize(n, Y(1).dim(1), Y(1).dim(2), Y(1).dim(3));
+            TenR x, y;
+            for (NumN i = 1; i <= n; i++) {
+                math21_operator_share_first_dim_slice(X_batch, i, x);
+                math21_operator_share_first_dim_slice(Y_batch, i, y);
+                math21_operator_container_set(X(indexes(i0 + i)), x);
+                math21_operator_container_set(Y(indexes(i0 + i)), y);
+            }
+        }
+
+        NumR valueAt_batch(const VecR &theta) {
+            setMinibatchIndexes();
+            NumR value = 0;
+            TenR output_n;
+            for (NumN i0 = 0; i0 < size; i0 += batch_size_max) {
+                NumN n = xjmin(batch_size_max, size - i0);
+                setBatch(i0, n, X_batch, Y_batch);
+                const TenR &output = f.valueAt_batch(X_batch, theta);
+                for (NumN i = 1; i <= n; i++) {
+                    math21_operator_share_first_dim_slice(output, i, output_n);
+                    L.setParas(Y(indexes(i0 + i)));
+                    value = value + L.valueAt(output_n);
+                }
+            }
+            value = value / size + getPenalty(theta);
+            MATH21_ASSERT(!math21_check_clip(value), value << " should be clipped!");
+            return value;
+        }
+
+        const VecR &derivativeValueAt_batch(const VecR &theta) {
+            setMinibatchIndexes();
+            dtheta = 0;
+            for (NumN i0 = 0; i0 < size; i0 += batch_size_max) {
+                NumN n = xjmin(batch_size_max, size - i0);
+                setBatch(i0, n, X_batch, Y_batch);
+                const VecR &tmp = f.derivativeValueAtTheta_batch(X_batch, Y_batch, theta, L, lambda);
+                math21_operator_addToA(dtheta, tmp);
+            }
+            math21_operator_linear_to(1.0 / size, dtheta);
+            MATH21_ASSERT(!math21_check_clip(dtheta), "dtheta should be clipped!");
+            return dtheta;
+        }
+
+        // 0 if L can't be cloned, then minibatch runs in this thread.
+        NumB setWorkspaces();
+
+        void clearWorkspaces();
+
+        // workspace w runs w-th part of the minibatch as batches, w is 0-based.
+        void valueAt_workspace(const VecR &theta, NumN w);
+
+        void derivativeValueAt_workspace(const VecR &theta, NumN w);
+
+        // workspaces must be set.
+        NumR valueAt_parallel(const VecR &theta);
+
+        const VecR &derivativeValueAt_parallel(const VecR &theta);
+
     public:
         //Todo: ruffle X
         //cnn requires data to have same size, rnn doesn't require it.
@@ -1498,9 +2591,22 @@ namespace math21 {
                        NumN minibatch_size, NumB _isUsingDiff = 1)
                 : f(_f),
                   L(_L),
+                  pipeline(0),
                   X(_X),
                   Y(_Y),
                   isUsingDiff(_isUsingDiff) {
+            init(start, minibatch_size);
+        }
+
+        // minibatch is the current one of pipeline, and moves to the next one in updateParas.
+        // pipeline is started, and the first minibatch is waited for, if not yet.
+        cnn_cost_class(cnn &_f,
+                       CostFunctional_class &_L,
+                       cnn_data_pipeline &_pipeline,
+                       NumB _isUsingDiff = 1);
+
+    private:
+        void init(NumN start, NumN minibatch_size) {
             MATH21_ASSERT(!X.isEmpty(), "X is empty");
             MATH21_ASSERT(X.size() == Y.size(), "X and Y must contain same number of points");
             MATH21_ASSERT(X(1).dims() == 3 && Y(1).dims() == 3, "data point must be 3-D tensor");
@@ -1510,6 +2616,9 @@ namespace math21 {
                                       "You can use pooling as first layer to remove the restriction.");
             }
             lambda = 0.0001;
+            isUsingBatch = 1;
+            batch_size_max = 32;
+            n_threads = 1;
             this->size = minibatch_size;
             this->start = start;
             Xsize = X.size();
@@ -1524,14 +2633,42 @@ namespace math21 {
             }
         }
 
-        virtual ~cnn_cost_class() {}
+    public:
+        virtual ~cnn_cost_class() {
+            clearWorkspaces();
+        }
 
         cnn_cost_class_paras getParas() {
             cnn_cost_class_paras paras(lambda);
             return paras;
         }
 
+        // batch is used by default, points are computed one by one otherwise.
+        void setUsingBatch(NumB isUsingBatch) {
+            this->isUsingBatch = isUsingBatch;
+        }
+
+        // bound memory of a batch, e.x., im2col of conv.
+        void setBatchSizeMax(NumN batch_size_max) {
+            MATH21_ASSERT(batch_size_max >= 1);
+            this->batch_size_max = batch_size_max;
+        }
+
+        // minibatch is split among n_threads threads, every thread runs its points as batches,
+        // then dtheta of threads are summed by tree reduction. 1 means no parallel.
+        // Minibatch runs in this thread if L doesn't support clone.
+        void setThreadNumber(NumN n_threads) {
+            MATH21_ASSERT(n_threads >= 1);
+            this->n_threads = n_threads;
+        }
+
         NumR valueAt(const VecR &theta) override {
+            if (n_threads > 1 && size > 1 && setWorkspaces()) {
+                return valueAt_parallel(theta);
+            }
+            if (isUsingBatch) {
+                return valueAt_batch(theta);
+            }
             NumR value = 0;
             NumN index = start;
             for (NumN i = 1; i <= size; i++) {
@@ -1544,13 +2681,12 @@ namespace math21 {
                 L.setParas(Y(index));
 //                value = value + L.valueAt(f.valueAt(X(index), theta));
 
-                value = value + L.valueAt(f.valueAt(X(index), theta)) +
-                        (lambda / 2) * f.calWeightNormSquare(theta, 2);
+                value = value + L.valueAt(f.valueAt(X(index), theta));
 //                index++;
                 index = index + stride;
 //                break;
             }
-            value = value / size;
+            value = value / size + getPenalty(theta);
             MATH21_ASSERT(!math21_check_clip(value), value << " should be clipped!");
             return value;
         }
@@ -1558,6 +2694,7 @@ namespace math21 {
         NumR valueAt_cnn_y(cnn &f, const TenR &cnn_y, const TenR &y, NumB isUsingPenalty = 1) {
             L.setParas(y);
             if (isUsingPenalty) {
+                // norm of theta set in f is cached, so evaluating many points walks weights once.
                 return L.valueAt(cnn_y) + (lambda / 2) * f.calWeightNormSquare(2);
             } else {
                 return L.valueAt(cnn_y);
@@ -1565,6 +2702,12 @@ namespace math21 {
         }
 
         const VecR &derivativeValueAt(const VecR &theta) override {
+            if (n_threads > 1 && size > 1 && setWorkspaces()) {
+                return derivativeValueAt_parallel(theta);
+            }
+            if (isUsingBatch) {
+                return derivativeValueAt_batch(theta);
+            }
             NumN index = start;
             dtheta = 0;
             for (NumN i = 1; i <= size; i++) {
@@ -1586,15 +2729,8 @@ namespace math21 {
             return dtheta;
         }
 
-        void updateParas() {
-            start = start + size;
-            if (start > Xsize) {
-                start = start % Xsize;
-                if (start == 0) {
-                    start = Xsize;
-                }
-            }
-        }
+        // next minibatch.
+        void updateParas();
 
         NumN getXDim() override {
             return f.getThetaSize();
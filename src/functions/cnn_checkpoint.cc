@@ -0,0 +1,290 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include "cnn_checkpoint.h"
+
+#ifndef MATH21_FLAG_IS_WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#endif
+
+namespace math21 {
+    namespace detail {
+        const char cnn_checkpoint_magic[8] = {'M', '2', '1', 'C', 'N', 'N', 'C', 'K'};
+        const NumN32 cnn_checkpoint_byte_order = 0x01020304;
+
+        inline NumN64 math21_cnn_checkpoint_align(NumN64 n) {
+            return (n + MATH21_CNN_CHECKPOINT_ALIGNMENT - 1) / MATH21_CNN_CHECKPOINT_ALIGNMENT *
+                   MATH21_CNN_CHECKPOINT_ALIGNMENT;
+        }
+    }
+
+    NumB math21_cnn_checkpoint_save(const char *path, const cnn &f, const VecR &theta) {
+        MATH21_ASSERT(!f.isEmpty());
+        MATH21_ASSERT(theta.size() == f.getThetaSize(), "theta size doesn't match cnn");
+        static_assert(sizeof(cnn_checkpoint_header) == 64, "header must be 64 bytes");
+        static_assert(sizeof(cnn_checkpoint_layer) == 24, "layer entry must be 24 bytes");
+
+        std::ostringstream arch;
+        SerializeNumInterface_simple sn;
+        f.serialize(arch, sn);
+        std::string arch_data = arch.str();
+
+        NumN64 n_layers = f.getNumberOfLayers();
+        NumN64 arch_size = arch_data.size();
+
+        cnn_checkpoint_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, detail::cnn_checkpoint_magic, sizeof(header.magic));
+        header.version = MATH21_CNN_CHECKPOINT_VERSION;
+        header.header_size = sizeof(cnn_checkpoint_header);
+        header.num_size = sizeof(NumR);
+        header.byte_order = detail::cnn_checkpoint_byte_order;
+        header.table_offset = sizeof(cnn_checkpoint_header);
+        header.table_size = sizeof(NumN64) + n_layers * sizeof(cnn_checkpoint_layer) + sizeof(NumN64) + arch_size;
+        header.theta_offset = detail::math21_cnn_checkpoint_align(header.table_offset + header.table_size);
+        header.theta_size = theta.size();
+        header.file_size = header.theta_offset + header.theta_size * sizeof(NumR);
+
+        std::ofstream out;
+        out.open(path, std::ofstream::binary);
+        if (!out.is_open()) {
+            m21log("can't open", path);
+            return 0;
+        }
+        out.write((const char *) &header, sizeof(header));
+        out.write((const char *) &n_layers, sizeof(n_layers));
+        NumN64 offset = 0;
+        for (NumN i = 1; i <= n_layers; ++i) {
+            const cnn_fn &fn = f.getLayer(i);
+            cnn_checkpoint_layer layer;
+            layer.type = (NumN32) fn.getType();
+            layer.reserved = 0;
+            layer.theta_offset = offset;
+            layer.theta_size = fn.getThetaSize();
+            offset += layer.theta_size;
+            out.write((const char *) &layer, sizeof(layer));
+        }
+        out.write((const char *) &arch_size, sizeof(arch_size));
+        out.write(arch_data.data(), arch_size);
+
+        NumN64 n_pad = header.theta_offset - (header.table_offset + header.table_size);
+        char pad[MATH21_CNN_CHECKPOINT_ALIGNMENT] = {0};
+        out.write(pad, n_pad);
+
+        // theta is written as one block.
+        TenR theta_c;
+        const NumR *theta_data;
+        if (theta.isContinuous() && !theta.isColumnMajor()) {
+            theta_data = math21_memory_tensor_data_address(theta);
+        } else {
+            theta_c.setSize(theta.shape());
+            math21_operator_container_set(theta, theta_c);
+            theta_data = math21_memory_tensor_data_address((const TenR &) theta_c);
+        }
+        out.write((const char *) theta_data, header.theta_size * sizeof(NumR));
+        NumB isGood = out.good() ? (NumB) 1 : (NumB) 0;
+        out.close();
+        return isGood;
+    }
+
+    cnn_checkpoint::cnn_checkpoint() {
+        init();
+    }
+
+    cnn_checkpoint::~cnn_checkpoint() {
+        close();
+    }
+
+    void cnn_checkpoint::init() {
+        address = 0;
+        size = 0;
+        isMapped = 0;
+    }
+
+    NumB cnn_checkpoint::open(const char *path) {
+        close();
+#ifndef MATH21_FLAG_IS_WIN32
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            m21log("can't open", path);
+            return 0;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(cnn_checkpoint_header)) {
+            ::close(fd);
+            m21log("not a cnn checkpoint", path);
+            return 0;
+        }
+        // private mapping, pages are copied only when written.
+        void *p = mmap(0, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            m21log("can't map", path);
+            return 0;
+        }
+        address = (char *) p;
+        size = (NumN) st.st_size;
+        isMapped = 1;
+#else
+        std::ifstream in;
+        in.open(path, std::ifstream::binary | std::ifstream::ate);
+        if (!in.is_open()) {
+            m21log("can't open", path);
+            return 0;
+        }
+        size = (NumN) in.tellg();
+        if (size < sizeof(cnn_checkpoint_header)) {
+            size = 0;
+            m21log("not a cnn checkpoint", path);
+            return 0;
+        }
+        buffer_space.resize((size + sizeof(NumR) - 1) / sizeof(NumR));
+        address = (char *) buffer_space.data();
+        in.seekg(0);
+        in.read(address, size);
+        in.close();
+#endif
+        if (!check()) {
+            m21log("not a valid cnn checkpoint", path);
+            close();
+            return 0;
+        }
+
+        const cnn_checkpoint_header &header = getHeader();
+        SpaceParas paras;
+        paras.address = address;
+        paras.start = address + header.theta_offset;
+        paras.ref_count = 0;
+        paras.size = header.theta_size * sizeof(NumR);
+        paras.unit = sizeof(char);
+        VecN d(1);
+        d = header.theta_size;
+        theta.setSize(d, &paras);
+        return 1;
+    }
+
+    NumB cnn_checkpoint::check() {
+        const cnn_checkpoint_header &header = getHeader();
+        if (std::memcmp(header.magic, detail::cnn_checkpoint_magic, sizeof(header.magic)) != 0 ||
+            header.byte_order != detail::cnn_checkpoint_byte_order) {
+            return 0;
+        }
+        if (header.version != MATH21_CNN_CHECKPOINT_VERSION || header.header_size != sizeof(cnn_checkpoint_header)
+            || header.num_size != sizeof(NumR)) {
+            m21log("unsupported cnn checkpoint version", header.version);
+            return 0;
+        }
+        // fields are bounded by file size before added, so a corrupt file can't wrap them around.
+        NumN64 file_size = size;
+        if (header.file_size != file_size || header.table_offset < sizeof(cnn_checkpoint_header) ||
+            header.table_offset % sizeof(NumN64) != 0 || header.table_offset > file_size ||
+            header.table_size > file_size - header.table_offset ||
+            header.theta_offset % MATH21_CNN_CHECKPOINT_ALIGNMENT != 0 || header.theta_offset > file_size ||
+            header.table_offset + header.table_size > header.theta_offset ||
+            header.theta_size != (file_size - header.theta_offset) / sizeof(NumR) ||
+            header.theta_offset + header.theta_size * sizeof(NumR) != file_size) {
+            return 0;
+        }
+        // layer table
+        if (header.table_size < 2 * sizeof(NumN64)) {
+            return 0;
+        }
+        NumN64 n_layers = *(const NumN64 *) (address + header.table_offset);
+        if (n_layers == 0 || n_layers > (header.table_size - 2 * sizeof(NumN64)) / sizeof(cnn_checkpoint_layer)) {
+            return 0;
+        }
+        NumN64 table_size = sizeof(NumN64) + n_layers * sizeof(cnn_checkpoint_layer) + sizeof(NumN64);
+        NumN64 arch_size = *(const NumN64 *) (address + header.table_offset + table_size - sizeof(NumN64));
+        if (arch_size != header.table_size - table_size) {
+            return 0;
+        }
+        NumN64 offset = 0;
+        for (NumN i = 1; i <= n_layers; ++i) {
+            const cnn_checkpoint_layer &layer = getLayer(i);
+            if (layer.theta_offset != offset || layer.theta_size > header.theta_size - offset) {
+                return 0;
+            }
+            offset += layer.theta_size;
+        }
+        if (offset != header.theta_size) {
+            return 0;
+        }
+        return 1;
+    }
+
+    void cnn_checkpoint::close() {
+        theta.clear();
+        if (address != 0) {
+#ifndef MATH21_FLAG_IS_WIN32
+            if (isMapped) {
+                munmap(address, (size_t) size);
+            }
+#endif
+            buffer_space.clear();
+            buffer_space.shrink_to_fit();
+        }
+        init();
+    }
+
+    NumB cnn_checkpoint::isOpen() const {
+        return address != 0 ? (NumB) 1 : (NumB) 0;
+    }
+
+    const cnn_checkpoint_header &cnn_checkpoint::getHeader() const {
+        MATH21_ASSERT(address != 0, "checkpoint not open");
+        return *(const cnn_checkpoint_header *) address;
+    }
+
+    NumN cnn_checkpoint::getNumberOfLayers() const {
+        return (NumN) *(const NumN64 *) (address + getHeader().table_offset);
+    }
+
+    const cnn_checkpoint_layer &cnn_checkpoint::getLayer(NumN i) const {
+        MATH21_ASSERT(i >= 1 && i <= getNumberOfLayers());
+        return *((const cnn_checkpoint_layer *) (address + getHeader().table_offset + sizeof(NumN64)) + (i - 1));
+    }
+
+    const VecR &cnn_checkpoint::getTheta() const {
+        return theta;
+    }
+
+    void cnn_checkpoint::getModel(cnn &f) const {
+        MATH21_ASSERT(isOpen(), "checkpoint not open");
+        const cnn_checkpoint_header &header = getHeader();
+        NumN n_layers = getNumberOfLayers();
+        const char *arch_size_address = address + header.table_offset + sizeof(NumN64) +
+                                        n_layers * sizeof(cnn_checkpoint_layer);
+        NumN64 arch_size = *(const NumN64 *) arch_size_address;
+        std::istringstream in(std::string(arch_size_address + sizeof(NumN64), arch_size));
+        DeserializeNumInterface_simple sn;
+        f.deserialize(in, sn);
+
+        MATH21_ASSERT(f.getNumberOfLayers() == n_layers, "layer table doesn't match architecture");
+        for (NumN i = 1; i <= n_layers; ++i) {
+            MATH21_ASSERT(f.getLayer(i).getType() == getLayer(i).type &&
+                          f.getLayer(i).getThetaSize() == getLayer(i).theta_size,
+                          "layer table doesn't match architecture, layer " << i);
+        }
+        f.setThetaSpace(theta.getSpace());
+    }
+}
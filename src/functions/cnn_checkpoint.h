@@ -0,0 +1,102 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <vector>
+#include "cnn.h"
+
+namespace math21 {
+
+    /*
+     * cnn checkpoint, a binary file which can be mapped and used in place.
+     * 1. header, see cnn_checkpoint_header.
+     * 2. layer table at table_offset:
+     *    n_layers (NumN64), then n_layers entries of cnn_checkpoint_layer,
+     *    then architecture of size arch_size (NumN64) written by cnn::serialize.
+     * 3. theta at theta_offset, theta_size numbers of NumR, aligned to MATH21_CNN_CHECKPOINT_ALIGNMENT bytes.
+     * Numbers are in byte order of the writer, and byte_order is used to reject a file of other byte order.
+     * */
+#define MATH21_CNN_CHECKPOINT_VERSION 1
+#define MATH21_CNN_CHECKPOINT_ALIGNMENT 64
+
+    struct cnn_checkpoint_header {
+        char magic[8]; // "M21CNNCK"
+        NumN32 version;
+        NumN32 header_size;
+        NumN32 num_size; // sizeof(NumR)
+        NumN32 byte_order; // 0x01020304
+        NumN64 file_size;
+        NumN64 table_offset;
+        NumN64 table_size; // in byte
+        NumN64 theta_offset; // in byte
+        NumN64 theta_size; // number of NumR
+    };
+
+    struct cnn_checkpoint_layer {
+        NumN32 type; // cnn_type_fn_*
+        NumN32 reserved;
+        NumN64 theta_offset; // number of NumR from theta start
+        NumN64 theta_size;
+    };
+
+    // Write f with theta to file. Return 0 if fail.
+    NumB math21_cnn_checkpoint_save(const char *path, const cnn &f, const VecR &theta);
+
+    /*
+     * Map a checkpoint, and bind theta to cnn with no copy.
+     * The file is mapped private, so writing to theta, e.x., training, doesn't change the file.
+     * Mapped space is released by close(), so cnn bound by getModel must be cleared or given another theta
+     * by setTheta before that.
+     * On platform without mmap, the file is read into memory instead.
+     * */
+    class cnn_checkpoint {
+    private:
+        char *address; // start of mapped file
+        NumN size; // size of mapped file
+        NumB isMapped; // address is from mmap, otherwise from buffer.
+        std::vector<NumR> buffer_space; // file content when mmap isn't used, NumR for alignment.
+        VecR theta; // shares space of file
+
+        void init();
+
+        NumB check();
+
+    public:
+        cnn_checkpoint();
+
+        virtual ~cnn_checkpoint();
+
+        // Return 0 if file can't be opened or isn't a valid checkpoint.
+        NumB open(const char *path);
+
+        void close();
+
+        NumB isOpen() const;
+
+        const cnn_checkpoint_header &getHeader() const;
+
+        NumN getNumberOfLayers() const;
+
+        // i = 1, ..., N.
+        const cnn_checkpoint_layer &getLayer(NumN i) const;
+
+        // theta in file, no copy.
+        const VecR &getTheta() const;
+
+        // Build architecture of f from file, and bind theta of f to file.
+        void getModel(cnn &f) const;
+    };
+}
@@ -0,0 +1,252 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "../probability/files.h"
+#include "../image/image.h"
+#include "cnn_data.h"
+
+namespace math21 {
+
+    cnn_data_source_memory::cnn_data_source_memory(const Seqce <TenR> &X, const Seqce <TenR> &Y) : X(X), Y(Y) {
+        MATH21_ASSERT(!X.isEmpty(), "X is empty");
+        MATH21_ASSERT(X.size() == Y.size(), "X and Y must contain same number of points");
+    }
+
+    NumN cnn_data_source_memory::size() const {
+        return X.size();
+    }
+
+    void cnn_data_source_memory::getPoint(NumN i, TenR &x, TenR &y) const {
+        if (!x.isSameSize(X(i).shape())) {
+            x.setSize(X(i).shape());
+        }
+        if (!y.isSameSize(Y(i).shape())) {
+            y.setSize(Y(i).shape());
+        }
+        math21_operator_container_set(X(i), x);
+        math21_operator_container_set(Y(i), y);
+    }
+
+    cnn_data_pipeline::cnn_data_pipeline(const cnn_data_source &source, NumN minibatch_size, NumN n_threads,
+                                         NumN n_slots)
+            : source(source), minibatch_size(minibatch_size), n_threads(n_threads), n_slots(n_slots) {
+        MATH21_ASSERT(source.size() >= 1, "data source is empty");
+        MATH21_ASSERT(minibatch_size >= 1 && n_threads >= 1);
+        // one slot is used by training, others are loaded.
+        MATH21_ASSERT(n_slots >= 2, "at least 2 slots are needed to load while training");
+        init();
+    }
+
+    cnn_data_pipeline::~cnn_data_pipeline() {
+        stop();
+        for (NumN i = 1; i <= slots.size(); ++i) {
+            delete slots(i);
+        }
+    }
+
+    void cnn_data_pipeline::init() {
+        isShuffled = 0;
+        seed = 21;
+        img_resize_method = img_resize_method_default;
+        epoch = 0;
+        order_position = 1;
+        k_claimed = 0;
+        k_current = 0;
+        k_released = 0;
+        isStarted = 0;
+        isStopping = 0;
+    }
+
+    void cnn_data_pipeline::setShuffle(NumB isShuffled, NumN seed) {
+        MATH21_ASSERT(slots.isEmpty(), "set before start");
+        this->isShuffled = isShuffled;
+        this->seed = seed;
+    }
+
+    void cnn_data_pipeline::setInputShape(const VecN &d) {
+        setInputShape(d, img_resize_method_default);
+    }
+
+    void cnn_data_pipeline::setInputShape(const VecN &d, NumN img_resize_method) {
+        MATH21_ASSERT(slots.isEmpty(), "set before start");
+        MATH21_ASSERT(d.size() == 3, "input shape is not 3-D tensor!");
+        d_x.setSize(d.size());
+        d_x.assign(d);
+        this->img_resize_method = img_resize_method;
+    }
+
+    void cnn_data_pipeline::setEpochOrder() {
+        ++epoch;
+        order.setSize(source.size());
+        order.letters();
+        if (isShuffled) {
+            DefaultRandomEngine engine(seed + epoch);
+            math21_algorithm_shuffle(order, order.size(), engine);
+        }
+        order_position = 1;
+    }
+
+    void cnn_data_pipeline::setIndexes(VecN &indexes) {
+        for (NumN i = 1; i <= minibatch_size; ++i) {
+            if (order_position > order.size()) {
+                setEpochOrder();
+            }
+            indexes(i) = order(order_position);
+            ++order_position;
+        }
+    }
+
+    void cnn_data_pipeline::loadPoints(cnn_data_slot &slot, TenR &x, TenR &y) const {
+        TenR x_i, y_i;
+        for (NumN i = 1; i <= minibatch_size; ++i) {
+            source.getPoint(slot.indexes(i), x, y);
+            math21_operator_share_first_dim_slice(slot.X, i, x_i);
+            math21_operator_share_first_dim_slice(slot.Y, i, y_i);
+            MATH21_ASSERT(y.isSameSize(y_i.shape()), "y of point " << slot.indexes(i) << " has different size");
+            if (x.isSameSize(x_i.shape())) {
+                math21_operator_container_set(x, x_i);
+            } else {
+                MATH21_ASSERT(!d_x.isEmpty(), "x of point " << slot.indexes(i) << " has different size, "
+                                                                                 "set input shape to resize it");
+                math21_img_resize(x, x_i, img_resize_method);
+            }
+            math21_operator_container_set(y, y_i);
+        }
+    }
+
+    void cnn_data_pipeline::load() {
+        TenR x, y;
+        while (1) {
+            cnn_data_slot *slot;
+            NumN k;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                // slot of minibatch k is free when minibatch k - n_slots is released.
+                cv_loader.wait(lock, [this] { return isStopping || k_claimed + 1 <= k_released + n_slots; });
+                if (isStopping) {
+                    return;
+                }
+                k = ++k_claimed;
+                slot = &getSlot(k);
+                slot->k = 0;
+                setIndexes(slot->indexes);
+            }
+            loadPoints(*slot, x, y);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slot->k = k;
+            }
+            cv_consumer.notify_all();
+        }
+    }
+
+    void cnn_data_pipeline::start() {
+        if (isStarted) {
+            return;
+        }
+        if (slots.isEmpty()) {
+            TenR x, y;
+            source.getPoint(1, x, y);
+            MATH21_ASSERT(x.dims() == 3 && y.dims() == 3, "data point must be 3-D tensor");
+            VecN d(4);
+            if (d_x.isEmpty()) {
+                d = minibatch_size, x.dim(1), x.dim(2), x.dim(3);
+            } else {
+                d = minibatch_size, d_x(1), d_x(2), d_x(3);
+            }
+            VecN d_y(4);
+            d_y = minibatch_size, y.dim(1), y.dim(2), y.dim(3);
+            slots.setSize(n_slots);
+            for (NumN i = 1; i <= n_slots; ++i) {
+                slots(i) = new cnn_data_slot();
+                slots(i)->X.setSize(d);
+                slots(i)->Y.setSize(d_y);
+                slots(i)->indexes.setSize(minibatch_size);
+                slots(i)->k = 0;
+            }
+            X_points.setSize(minibatch_size);
+            Y_points.setSize(minibatch_size);
+        }
+        isStopping = 0;
+        isStarted = 1;
+        for (NumN t = 1; t <= n_threads; ++t) {
+            loaders.push_back(std::thread(&cnn_data_pipeline::load, this));
+        }
+    }
+
+    void cnn_data_pipeline::stop() {
+        if (!isStarted) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopping = 1;
+        }
+        cv_loader.notify_all();
+        for (NumN t = 0; t < loaders.size(); ++t) {
+            loaders[t].join();
+        }
+        loaders.clear();
+        isStarted = 0;
+    }
+
+    void cnn_data_pipeline::next() {
+        MATH21_ASSERT(isStarted, "call start() first");
+        cnn_data_slot *slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            k_released = k_current;
+            ++k_current;
+            cv_loader.notify_all();
+            slot = &getSlot(k_current);
+            cv_consumer.wait(lock, [this, slot] { return slot->k == k_current; });
+        }
+        for (NumN i = 1; i <= minibatch_size; ++i) {
+            math21_operator_share_first_dim_slice(slot->X, i, X_points(i));
+            math21_operator_share_first_dim_slice(slot->Y, i, Y_points(i));
+        }
+    }
+
+    NumN cnn_data_pipeline::getMinibatchSize() const {
+        return minibatch_size;
+    }
+
+    NumN cnn_data_pipeline::getMinibatchNumber() const {
+        return k_current;
+    }
+
+    const TenR &cnn_data_pipeline::getX() const {
+        MATH21_ASSERT(k_current > 0, "call next() first");
+        return slots((k_current - 1) % n_slots + 1)->X;
+    }
+
+    const TenR &cnn_data_pipeline::getY() const {
+        MATH21_ASSERT(k_current > 0, "call next() first");
+        return slots((k_current - 1) % n_slots + 1)->Y;
+    }
+
+    const Seqce <TenR> &cnn_data_pipeline::getPoints_x() const {
+        return X_points;
+    }
+
+    const Seqce <TenR> &cnn_data_pipeline::getPoints_y() const {
+        return Y_points;
+    }
+
+    const VecN &cnn_data_pipeline::getIndexes() const {
+        MATH21_ASSERT(k_current > 0, "call next() first");
+        return slots((k_current - 1) % n_slots + 1)->indexes;
+    }
+}
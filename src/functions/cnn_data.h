@@ -0,0 +1,157 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "cnn.h"
+
+namespace math21 {
+
+    // source of data points (x, y) read by loader threads of cnn_data_pipeline.
+    // Points can be read on demand, e.x., from files, so data set can be larger than memory.
+    class cnn_data_source {
+    public:
+        virtual ~cnn_data_source() {
+        }
+
+        virtual NumN size() const = 0;
+
+        // point i, i = 1, ..., size(). x and y are resized if needed.
+        // Loader threads call it at the same time, so it must be thread safe.
+        virtual void getPoint(NumN i, TenR &x, TenR &y) const = 0;
+    };
+
+    // points in memory.
+    class cnn_data_source_memory : public cnn_data_source {
+    private:
+        const Seqce <TenR> &X;
+        const Seqce <TenR> &Y;
+
+    public:
+        cnn_data_source_memory(const Seqce <TenR> &X, const Seqce <TenR> &Y);
+
+        NumN size() const override;
+
+        void getPoint(NumN i, TenR &x, TenR &y) const override;
+    };
+
+    /*
+     * Minibatches are prepared by background threads into a ring of n_slots slots,
+     * so training uses one while the next ones are loaded.
+     * 1. Points are taken in order, or in a new random order every epoch if shuffled.
+     *    Minibatches run across epochs, i.e., minibatch k has points (k-1)*m+1, ..., k*m of the sequence
+     *    of epochs. Order depends on seed only, not on thread number.
+     * 2. x of a point is resized to input shape by math21_img_resize if the shape is set and differs.
+     * 3. Minibatch is N*d, points stacked along the first dim, ready for cnn::valueAt_batch.
+     * Settings must be done before start().
+     * */
+    class cnn_data_pipeline {
+    private:
+        struct cnn_data_slot {
+            TenR X;
+            TenR Y;
+            VecN indexes; // indexes of points in source
+            NumN k; // minibatch number, 0 if not ready.
+        };
+
+        const cnn_data_source &source;
+        NumN minibatch_size;
+        NumN n_threads;
+        NumN n_slots;
+        NumB isShuffled;
+        NumN seed;
+        VecN d_x; // input shape, empty if x isn't resized.
+        VecN d_y;
+        NumN img_resize_method;
+
+        Seqce<cnn_data_slot *> slots;
+        SeqceN order; // order of points in the current epoch
+        NumN epoch;
+        NumN order_position; // next position in order, 1-based.
+        NumN k_claimed; // last minibatch claimed by a loader
+        NumN k_current; // minibatch used by consumer, 0 if none.
+        NumN k_released; // last minibatch released by consumer, so its slot can be loaded again.
+        Seqce <TenR> X_points; // points of current minibatch, sharing its space.
+        Seqce <TenR> Y_points;
+
+        std::vector<std::thread> loaders;
+        std::mutex mutex;
+        std::condition_variable cv_loader; // a slot is free or stopping.
+        std::condition_variable cv_consumer; // a minibatch is ready.
+        NumB isStarted;
+        NumB isStopping;
+
+        void init();
+
+        // set order of epoch, called with lock held.
+        void setEpochOrder();
+
+        // indexes of the next minibatch, called with lock held.
+        void setIndexes(VecN &indexes);
+
+        void loadPoints(cnn_data_slot &slot, TenR &x, TenR &y) const;
+
+        void load();
+
+        cnn_data_slot &getSlot(NumN k) {
+            return *slots((k - 1) % n_slots + 1);
+        }
+
+    public:
+        cnn_data_pipeline(const cnn_data_source &source, NumN minibatch_size, NumN n_threads = 1,
+                          NumN n_slots = 3);
+
+        virtual ~cnn_data_pipeline();
+
+        // shuffled every epoch, with order depending on seed only.
+        void setShuffle(NumB isShuffled, NumN seed = 21);
+
+        // x of every point is resized to d, e.x., images of different sizes.
+        void setInputShape(const VecN &d);
+
+        // img_resize_method is that of math21_img_resize.
+        void setInputShape(const VecN &d, NumN img_resize_method);
+
+        // start loader threads.
+        void start();
+
+        // stop and join loader threads. Loaded minibatches are kept, so start() continues from them.
+        void stop();
+
+        // release current minibatch and move to the next one, waiting only if it is not ready yet.
+        void next();
+
+        NumN getMinibatchSize() const;
+
+        // minibatch number, 1, 2, ...
+        NumN getMinibatchNumber() const;
+
+        const TenR &getX() const;
+
+        const TenR &getY() const;
+
+        // points of current minibatch, sharing space of getX() and getY().
+        const Seqce <TenR> &getPoints_x() const;
+
+        const Seqce <TenR> &getPoints_y() const;
+
+        // indexes in source of points in current minibatch.
+        const VecN &getIndexes() const;
+    };
+}
@@ -103,6 +103,12 @@ namespace math21 {
 
         virtual ~CostFunctional_class() {}
 
+        // another construction, parameters are not copied.
+        // 0 if not supported, then cnn_cost_class runs in one thread.
+        virtual CostFunctional_class *clone() const {
+            return 0;
+        }
+
         virtual void setParas(const VecR &_t) = 0;
 
 //        virtual void setParas(const TenR &_t) = 0;
@@ -123,6 +129,10 @@ namespace math21 {
 
         virtual ~CostFunctional_mse_se_class() {}
 
+        CostFunctional_class *clone() const override {
+            return new CostFunctional_mse_se_class();
+        }
+
         NumR valueAt(const VecR &x) override {
             MATH21_ASSERT(isSet, "Please set parameters first!")
             NumR fx;
@@ -170,6 +180,10 @@ namespace math21 {
 
         virtual ~CostFunctional_nll_CrossEntroy_softmax_class() {}
 
+        CostFunctional_class *clone() const override {
+            return new CostFunctional_nll_CrossEntroy_softmax_class();
+        }
+
         NumR valueAt(const TenR &x) override {
             MATH21_ASSERT(isSet, "Please set parameters first!")
             NumR fx;
@@ -23,6 +23,8 @@ limitations under the License.
 #include "f_ex_sin.h"
 #include "commonFunctions.h"
 #include "cnn.h"
+#include "cnn_checkpoint.h"
+#include "cnn_data.h"
 #include "basic01/files.h"
 #include "basic02/files.h"
 
@@ -349,8 +349,13 @@ namespace math21 {
     void math21_la_affine_transform_image(const MatR &A, MatR &B, const MatR &T) {
         MATH21_ASSERT(T.isSameSize(3, 3))
         MATH21_ASSERT(T(3, 1) == 0 && T(3, 2) == 0 && T(3, 3) == 1)
+        Mat33R T3, T3_inv;
+        T3.assign(T);
+        if (!math21_operator_fixed_inverse(T3, T3_inv)) {
+            MATH21_ASSERT(0, "T is singular");
+        }
         MatR T_inv;
-        math21_operator_inverse(T, T_inv);
+        T3_inv.copyTo(T_inv);
         math21_la_affine_transform_image_reverse_mode(A, B, T_inv);
     }
 
@@ -360,8 +365,13 @@ namespace math21 {
                       && math21_operator_num_isEqual(T(4, 2), 0, 1e-10)
                       && math21_operator_num_isEqual(T(4, 3), 0, 1e-10)
                       && math21_operator_num_isEqual(T(4, 4), 1, 1e-10), "" << T.log("T"))
+        Mat44R T4, T4_inv;
+        T4.assign(T);
+        if (!math21_operator_fixed_inverse(T4, T4_inv)) {
+            MATH21_ASSERT(0, "T is singular");
+        }
         MatR T_inv;
-        math21_operator_inverse(T, T_inv);
+        T4_inv.copyTo(T_inv);
         math21_la_3d_affine_transform_image_reverse_mode(A, B, T_inv);
     }
 
@@ -396,14 +406,16 @@ namespace math21 {
         }
 
         NumN i1, i2, k;
-        VecR x(3), y(3);
+        Mat33R T3;
+        T3.assign(T);
+        Vec3R x, y;
         x(3) = 1;
         NumN y1, y2;
         for (i1 = 1; i1 <= nr; ++i1) {
             for (i2 = 1; i2 <= nc; ++i2) {
                 x(1) = i1;
                 x(2) = i2;
-                math21_operator_multiply(1, T, x, y);
+                math21_operator_fixed_multiply(T3, x, y);
                 y1 = (NumN) y(1);
                 y2 = (NumN) y(2);
                 if (y1 >= 1 && y1 <= nr_A && y2 >= 1 && y2 <= nc_A) {
@@ -460,7 +472,9 @@ namespace math21 {
         }
 
         NumN i1, i2, k;
-        VecR x(4), y(4);
+        Mat44R T4;
+        T4.assign(T);
+        Vec4R x, y;
         x(3) = 0;
         x(4) = 1;
         NumN y1, y2;
@@ -468,7 +482,7 @@ namespace math21 {
             for (i2 = 1; i2 <= nc; ++i2) {
                 x(1) = i1;
                 x(2) = i2;
-                math21_operator_multiply(1, T, x, y);
+                math21_operator_fixed_multiply(T4, x, y);
                 y1 = (NumN) y(1);
                 y2 = (NumN) y(2);
                 if (y1 >= 1 && y1 <= nr_A && y2 >= 1 && y2 <= nc_A) {
@@ -600,8 +614,14 @@ namespace math21 {
                 x1(2), x2(2), x3(2),
                 x1(3), x2(3), x3(3);
 
-        math21_operator_inverse(R);
-        math21_operator_multiply(1.0, R, K_inv, T);
+        // T = inverse(R)*K_inv, solved by QR instead of forming inverse.
+        QRDecomposition qr;
+        qr.factor(R);
+        if (!qr.isFullRank()) {
+            m21error("R is singular");
+            return 0;
+        }
+        qr.solve(K_inv, T);
         return 1;
     }
 
@@ -651,7 +671,7 @@ namespace math21 {
                                                      const Seqce<NumR> &ls, const MatR &T,
                                                      MatR &A, VecR &b, VecR &ls_predict) {
         NumN N = xas.size();
-        MATH21_ASSERT(N == 2 && xbs.size() == N && ls.size() == N);
+        MATH21_ASSERT(N >= 2 && xbs.size() == N && ls.size() == N);
         for (NumN i = 1; i <= N; ++i) {
             MATH21_ASSERT(xas(i).size() == 3 && xbs(i).size() == 3)
         }
@@ -697,8 +717,15 @@ namespace math21 {
         S.setSize(3, 3);
 
 //        A.log("A");
+        // least squares by QR, exact if N = 2.
+        QRDecomposition qr;
+        qr.factor(A);
+        if (!qr.isFullRank()) {
+            m21error("A is rank deficient");
+            return 0;
+        }
         VecR x;
-        math21_operator_solve_linear_equation(A, b, x);
+        qr.solve(b, x);
 
         if (x(1) < MATH21_EPS || x(2) < MATH21_EPS) {
             m21error("solution x of linear equation not positive");
@@ -726,7 +753,7 @@ namespace math21 {
     NumB geometry_cal_projection_scale(const Seqce<VecR> &xas, const Seqce<VecR> &xbs,
                                        const Seqce<NumR> &ls, MatR &T) {
         NumN N = xas.size();
-        MATH21_ASSERT(N == 2 && xbs.size() == N && ls.size() == N);
+        MATH21_ASSERT(N >= 2 && xbs.size() == N && ls.size() == N);
         for (NumN i = 1; i <= N; ++i) {
             MATH21_ASSERT(xas(i).size() == 3 && xbs(i).size() == 3)
         }
@@ -760,9 +787,15 @@ namespace math21 {
 
     // X = T*x, xs * T_trans = Xs
     NumB geometry_cal_affine(const MatR &xs, const MatR &Xs, MatR &T) {
-        MATH21_ASSERT(xs.isSameSize(3, 3));
-        MATH21_ASSERT(Xs.isSameSize(3, 3));
-        math21_operator_solve_linear_equation(xs, Xs, T);
+        MATH21_ASSERT(xs.dims() == 2 && xs.ncols() == 3 && xs.nrows() >= 3);
+        MATH21_ASSERT(Xs.isSameSize(xs.nrows(), 3));
+        QRDecomposition qr;
+        qr.factor(xs);
+        if (!qr.isFullRank()) {
+            m21error("points are collinear");
+            return 0;
+        }
+        qr.solve(Xs, T);
         math21_operator_matrix_trans(T);
 //        T.log("affine T");
         MATH21_ASSERT(math21_operator_num_isEqual(T(3, 1), 0, 1e-10));
@@ -817,29 +850,152 @@ namespace math21 {
 
     // X = lambda * T * x; lambda is set to make sure X(3) = 1. Here T is 3*3.
     NumN geometry_project(const MatR &T, const VecR &x, VecR &X) {
-        math21_operator_multiply(1.0, T, x, X);
-        if (xjabs(X(3)) < MATH21_EPS) {
+        Mat33R T3;
+        Vec3R x3, X3;
+        T3.assign(T);
+        x3.assign(x);
+        math21_operator_fixed_multiply(T3, x3, X3);
+        if (xjabs(X3(3)) < MATH21_EPS) {
+            X3.copyTo(X);
             return 0;
         }
-        math21_operator_linear_to(1.0 / X(3), X);
+        NumR ratio = 1.0 / X3(3);
+        for (NumN i = 1; i <= 3; ++i) {
+            X3(i) *= ratio;
+        }
+        X3.copyTo(X);
         return 1;
     }
 
-    // X = lambda * T * x; lambda is set to make sure X(3) = 1. Here T is 3*3.
-    NumB geometry_project_in_batch(const MatR &T, const MatR &xs, MatR &Xs) {
-        math21_operator_multiply_trans(1, xs, T, Xs);
+    namespace detail {
+        // points per thread below which a batch runs in one thread.
+        const NumN math21_la_batch_min_points_per_thread = 1 << 16;
 
-        NumR ratio;
-        for (NumN i = 1; i <= Xs.nrows(); ++i) {
-            if (xjabs(Xs(i, 3)) < MATH21_EPS) {
-                return 0;
+        int math21_la_batch_compute_num_threads(NumN n) {
+#ifdef MATH21_FLAG_USE_OPENMP
+            NumN tn = (NumN) omp_get_max_threads();
+            NumN n_max = n / math21_la_batch_min_points_per_thread;
+            if (n_max < tn) {
+                tn = n_max;
+            }
+            if (tn < 1) {
+                tn = 1;
+            }
+            return (int) tn;
+#else
+            return 1;
+#endif
+        }
+
+        /*
+         * X_i = T * x_i for n homogeneous points of dimension D + 1, T is (D+1)*(D+1).
+         * Coordinate d of point i is x[d][i*inc_x], homogeneous coordinate is w_x[i*inc_x], or 1 if w_x is 0.
+         * Projective: X_i is divided by its homogeneous coordinate, which is then 1.
+         * If that coordinate is 0, X_i is at infinity, and is kept not divided as geometry_project does.
+         * Affine: last row of T is taken as (0, ..., 0, 1), and homogeneous coordinate is kept.
+         * A point is read before written, so X can be x.
+         * Return 0 if some point is projected to infinity.
+         * */
+        template<NumN D>
+        NumB math21_la_transform_in_batch(const MatFixed<NumR, D + 1, D + 1> &T, NumB isProjective, NumN n,
+                                          const NumR *const *x, const NumR *w_x, NumN inc_x,
+                                          NumR *const *X, NumR *w_X, NumN inc_X) {
+            const NumN K = D + 1;
+            NumR t[K * K];
+            for (NumN k = 0; k < K * K; ++k) {
+                t[k] = T.getData()[k];
+            }
+            NumN n_infinity = 0;
+            int tn = math21_la_batch_compute_num_threads(n);
+#pragma omp parallel for num_threads(tn) schedule(static) reduction(+:n_infinity)
+            for (NumN i = 0; i < n; ++i) {
+                NumR p[K], q[K];
+                for (NumN d = 0; d < D; ++d) {
+                    p[d] = x[d][i * inc_x];
+                }
+                p[D] = w_x ? w_x[i * inc_x] : 1;
+                for (NumN r = 0; r < (isProjective ? K : D); ++r) {
+                    NumR sum = 0;
+                    for (NumN c = 0; c < K; ++c) {
+                        sum += t[r * K + c] * p[c];
+                    }
+                    q[r] = sum;
+                }
+                if (isProjective && xjabs(q[D]) >= MATH21_EPS) {
+                    NumR ratio = 1 / q[D];
+                    for (NumN d = 0; d < D; ++d) {
+                        X[d][i * inc_X] = q[d] * ratio;
+                    }
+                    q[D] = 1;
+                } else if (isProjective) {
+                    ++n_infinity;
+                    for (NumN d = 0; d < D; ++d) {
+                        X[d][i * inc_X] = q[d];
+                    }
+                } else {
+                    for (NumN d = 0; d < D; ++d) {
+                        X[d][i * inc_X] = q[d];
+                    }
+                    q[D] = p[D];
+                }
+                if (w_X) {
+                    w_X[i * inc_X] = q[D];
+                }
             }
-            ratio = Xs(i, 3);
-            Xs(i, 1) /= ratio;
-            Xs(i, 2) /= ratio;
-            Xs(i, 3) = 1;
+            return n_infinity == 0;
         }
-        return 1;
+    }
+
+    void math21_la_2d_affine_transform_in_batch(const Mat33R &T, NumN n, const NumR *x, const NumR *y,
+                                                NumR *X, NumR *Y) {
+        const NumR *xs[2] = {x, y};
+        NumR *Xs[2] = {X, Y};
+        detail::math21_la_transform_in_batch<2>(T, 0, n, xs, 0, 1, Xs, 0, 1);
+    }
+
+    NumB math21_la_2d_project_in_batch(const Mat33R &T, NumN n, const NumR *x, const NumR *y,
+                                       NumR *X, NumR *Y) {
+        const NumR *xs[2] = {x, y};
+        NumR *Xs[2] = {X, Y};
+        return detail::math21_la_transform_in_batch<2>(T, 1, n, xs, 0, 1, Xs, 0, 1);
+    }
+
+    void math21_la_3d_affine_transform_in_batch(const Mat44R &T, NumN n, const NumR *x, const NumR *y, const NumR *z,
+                                                NumR *X, NumR *Y, NumR *Z) {
+        const NumR *xs[3] = {x, y, z};
+        NumR *Xs[3] = {X, Y, Z};
+        detail::math21_la_transform_in_batch<3>(T, 0, n, xs, 0, 1, Xs, 0, 1);
+    }
+
+    NumB math21_la_3d_project_in_batch(const Mat44R &T, NumN n, const NumR *x, const NumR *y, const NumR *z,
+                                       NumR *X, NumR *Y, NumR *Z) {
+        const NumR *xs[3] = {x, y, z};
+        NumR *Xs[3] = {X, Y, Z};
+        return detail::math21_la_transform_in_batch<3>(T, 1, n, xs, 0, 1, Xs, 0, 1);
+    }
+
+    // X = lambda * T * x; lambda is set to make sure X(3) = 1. Here T is 3*3.
+    // Rows of xs are points, so they are read with stride 3.
+    NumB geometry_project_in_batch(const MatR &T, const MatR &xs, MatR &Xs) {
+        MATH21_ASSERT(!xs.isEmpty() && xs.ncols() == 3, "xs must be N*3");
+        Mat33R T3;
+        T3.assign(T);
+        NumN n = xs.nrows();
+        MatR xs_c;
+        const MatR *p_xs = &xs;
+        if (!xs.isContinuous() || xs.isColumnMajor()) {
+            xs_c.setSize(xs.shape());
+            math21_operator_container_set(xs, xs_c);
+            p_xs = &xs_c;
+        }
+        if (!Xs.isSameSize(n, 3) || !Xs.isContinuous() || Xs.isColumnMajor()) {
+            Xs.setSize(n, 3);
+        }
+        const NumR *x = math21_memory_tensor_data_address(*p_xs);
+        NumR *X = math21_memory_tensor_data_address(Xs);
+        const NumR *x_coords[2] = {x, x + 1};
+        NumR *X_coords[2] = {X, X + 1};
+        return detail::math21_la_transform_in_batch<2>(T3, 1, n, x_coords, x + 2, 3, X_coords, X + 2, 3);
     }
 
     // Xab = Xb - Xa. Here T is 3*3.
@@ -864,20 +1020,23 @@ namespace math21 {
     // index(1), index(2) keeps the X(1), X(2) respectively.
     // X = lambda * T * x; x is in image(nr, nc);
     NumB geometry_project_image(const MatR &T, NumN nr, NumN nc, TenR &index) {
-        if (!index.isSameSize(2, nr, nc)) {
+        if (!index.isSameSize(2, nr, nc) || !index.isContinuous() || index.isColumnMajor()) {
             index.setSize(2, nr, nc);
         }
 
-        VecR x(3), X(3);
+        // index(1) and index(2) are x and y in SoA layout, projected in place.
+        NumN n = nr * nc;
+        NumR *X = math21_memory_tensor_data_address(index);
+        NumR *Y = X + n;
         for (NumN i = 1; i <= nr; ++i) {
             for (NumN j = 1; j <= nc; ++j) {
-                x = i, j, 1;
-                geometry_project(T, x, X);
-                index(1, i, j) = X(1);
-                index(2, i, j) = X(2);
+                X[(i - 1) * nc + j - 1] = i;
+                Y[(i - 1) * nc + j - 1] = j;
             }
         }
-        return 1;
+        Mat33R T3;
+        T3.assign(T);
+        return math21_la_2d_project_in_batch(T3, n, X, Y, X, Y);
     }
 
     // project points in [x1, x2]*[y1, y2] to [1, nr]*[1, nc].
@@ -106,9 +106,31 @@ namespace math21 {
     // X = lambda * T * x; lambda is set to make sure X(3) = 1. Here T is 3*3.
     NumN geometry_project(const MatR &T, const VecR &x, VecR &X);
 
-    // xs: {*,*,1;*,*,1;*,*,1}
+    // xs: {*,*,1;*,*,1;*,*,1}, N*3 points as rows. Xs can be xs.
+    // Return 0 if some point is projected to infinity.
     NumB geometry_project_in_batch(const MatR &T, const MatR &xs, MatR &Xs);
 
+    /*
+     * Transform n points in SoA layout, i.e., every coordinate in its own array.
+     * Points are read and written once, and split among threads when n is large,
+     * so speed is bound by memory bandwidth. Output can be input, e.x., X = x.
+     * */
+    // (X, Y) = A*(x, y) + b, T = (A, b; 0, 1) is 3*3 affine.
+    void math21_la_2d_affine_transform_in_batch(const Mat33R &T, NumN n, const NumR *x, const NumR *y,
+                                                NumR *X, NumR *Y);
+
+    // (X, Y, 1) = lambda * T * (x, y, 1). Return 0 if some point is projected to infinity.
+    NumB math21_la_2d_project_in_batch(const Mat33R &T, NumN n, const NumR *x, const NumR *y,
+                                       NumR *X, NumR *Y);
+
+    // (X, Y, Z) = A*(x, y, z) + b, T = (A, b; 0, 1) is 4*4 affine.
+    void math21_la_3d_affine_transform_in_batch(const Mat44R &T, NumN n, const NumR *x, const NumR *y, const NumR *z,
+                                                NumR *X, NumR *Y, NumR *Z);
+
+    // (X, Y, Z, 1) = lambda * T * (x, y, z, 1). Return 0 if some point is projected to infinity.
+    NumB math21_la_3d_project_in_batch(const Mat44R &T, NumN n, const NumR *x, const NumR *y, const NumR *z,
+                                       NumR *X, NumR *Y, NumR *Z);
+
     // Xab = Xb - Xa. Here T is 3*3.
     NumN geometry_project(const MatR &T, const VecR &xa, const VecR &xb, VecR &Xab);
 
@@ -116,6 +138,7 @@ namespace math21 {
 
     NumN geometry_cal_projection_scale(const VecR &xa, const VecR &xb, NumR l, MatR &T);
 
+    // N >= 2 pairs, sx, sy are fitted by least squares if N > 2.
     NumB geometry_cal_projection_scale(const Seqce <VecR> &xas, const Seqce <VecR> &xbs,
                                        const Seqce <NumR> &ls,
                                        MatR &T);
@@ -127,6 +150,7 @@ namespace math21 {
     NumB geometry_project_image(const MatR &T, NumR x1, NumR x2, NumR y1, NumR y2, NumN nr, NumN nc, TenR &src_index);
 
     // X = T*x, xs * T_trans = Xs
+    // xs and Xs are N*3 homogeneous points as rows, N >= 3, T is fitted by least squares if N > 3.
     NumB geometry_cal_affine(const MatR &xs, const MatR &Xs, MatR &T);
 
     // (x1,y1), (x2, y2) as diagonal.
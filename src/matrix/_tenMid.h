@@ -27,13 +27,24 @@ namespace math21 {
     template<typename T>
     class TensorSub;
 
+    /*
+     * Element (j1, ..., jn) is at data(1 + (j1-1)*s(1) + ... + (jn-1)*s(n)), s are strides in numbers.
+     * Build with cmake option MATH21_FLAG_TENSOR_INDEX_TABLE to use the legacy layout,
+     * which keeps a table of offsets for every index value of every dim.
+     * The option is written to the generated config header, so library and clients always use the same layout.
+     * Don't define the macro otherwise.
+     * The table costs N+1 arrays per tensor and a dependent load per dim on every access.
+     * */
     template<typename T>
     class Tensor {
     private:
         std::string name;
         Array<T> data;
+#ifdef MATH21_FLAG_TENSOR_INDEX_TABLE
         // Note: a is auxiliary, not necessary.
         Seqce<ArrayN> a; ////a is index to vector data. we can design a to be empty.
+#endif
+        ArrayN s; // strides
         ArrayN d;
 //        Tensor<NumN> d2;
         // Note: N is auxiliary, not necessary.
@@ -65,6 +76,26 @@ namespace math21 {
 
         //set size from left to right, from top to bottom.
         void _setSize_index(NumN &scale) {
+            s.setSize(N);
+            scale = 1;
+            if (!isColumnMajor()) {
+                for (NumN n = N; n >= 1; --n) {
+                    s.at(n) = scale;
+                    scale = scale * dim(n);
+                }
+            } else {
+                for (NumN n = 1; n <= N; ++n) {
+                    s.at(n) = scale;
+                    scale = scale * dim(n);
+                }
+            }
+#ifdef MATH21_FLAG_TENSOR_INDEX_TABLE
+            _setSize_index_table(scale);
+#endif
+        }
+
+#ifdef MATH21_FLAG_TENSOR_INDEX_TABLE
+        void _setSize_index_table(NumN &scale) {
             a.setSize(N);
             scale = 0;
             if (!isColumnMajor()) {
@@ -100,6 +131,26 @@ namespace math21 {
             }
         }
 
+#endif
+
+        // offset of index j of dim i.
+        NumN _offset(NumN i, NumN j) const {
+#ifdef MATH21_FLAG_TENSOR_INDEX_TABLE
+            return a(i)(j);
+#else
+            return (j - 1) * s(i);
+#endif
+        }
+
+        // offset of element (1, ..., 1) in data.
+        NumN _offset_base() const {
+#ifdef MATH21_FLAG_TENSOR_INDEX_TABLE
+            return 0;
+#else
+            return 1;
+#endif
+        }
+
         //set size from left to right, from top to bottom.
         void _setSize(const ArrayN &_d, const SpaceParas *paras = 0) {
             _setSize_shape(_d);
@@ -142,7 +193,10 @@ namespace math21 {
         void clearSome() {
             name = "";
             data.clear();
+#ifdef MATH21_FLAG_TENSOR_INDEX_TABLE
             a.clear();
+#endif
+            s.clear();
             d.clear();
             N = 0;
         }
@@ -162,26 +216,26 @@ namespace math21 {
         // deprecate
         NumN index_tensor_to_array(const Array<NumN> &index) const {
             MATH21_ASSERT(dims() == index.size(), "not " << dims() << "-D tensor index");
-            NumN sum = 0;
+            NumN sum = _offset_base();
             for (NumN i = 1; i <= dims(); i++) {
                 MATH21_ASSERT(index(i) >= 1 && index(i) <= dim(i),
                               "\tYou must give a valid index"
                                       << "\n\tcurrent index: " << index(i)
                                       << "\n\trequired [" << 1 << ", " << dim(i) << "]");
-                sum = sum + a(i)(index(i));
+                sum = sum + _offset(i, index(i));
             }
             return sum;
         }
 
         NumN index_tensor_to_array(const Tensor<NumN> &index) const {
             MATH21_ASSERT(dims() == index.size(), "not " << dims() << "-D tensor index");
-            NumN sum = 0;
+            NumN sum = _offset_base();
             for (NumN i = 1; i <= dims(); i++) {
                 MATH21_ASSERT(index(i) >= 1 && index(i) <= dim(i),
                               "\tYou must give a valid index"
                                       << "\n\tcurrent index: " << index(i)
                                       << "\n\trequired [" << 1 << ", " << dim(i) << "]");
-                sum = sum + a(i)(index(i));
+                sum = sum + _offset(i, index(i));
             }
             return sum;
         }
@@ -198,7 +252,7 @@ namespace math21 {
             MATH21_ASSERT(dims() == 2, "not 2-D tensor");
             MATH21_ASSERT(j1 >= 1 && j1 <= dim(1) && j2 >= 1 && j2 <= dim(2),
                           "\tYou must give a valid index");
-            return a(1)(j1) + a(2)(j2);
+            return _offset_base() + _offset(1, j1) + _offset(2, j2);
         }
 
         NumN index_tensor_to_array(NumN j1, NumN j2, NumN j3) const {
@@ -206,7 +260,7 @@ namespace math21 {
             MATH21_ASSERT(dims() == 3, "not 3-D tensor");
             MATH21_ASSERT(j1 >= 1 && j1 <= dim(1) && j2 >= 1 && j2 <= dim(2) && j3 >= 1 && j3 <= dim(3),
                           "\tYou must give a valid index");
-            return a(1)(j1) + a(2)(j2) + a(3)(j3);
+            return _offset_base() + _offset(1, j1) + _offset(2, j2) + _offset(3, j3);
         }
 
         NumN index_tensor_to_array(NumN j1, NumN j2, NumN j3, NumN j4) const {
@@ -215,7 +269,7 @@ namespace math21 {
                     j1 >= 1 && j1 <= dim(1) && j2 >= 1 && j2 <= dim(2) && j3 >= 1 && j3 <= dim(3) && j4 >= 1 &&
                     j4 <= dim(4),
                     "\tYou must give a valid index");
-            return a(1)(j1) + a(2)(j2) + a(3)(j3) + a(4)(j4);
+            return _offset_base() + _offset(1, j1) + _offset(2, j2) + _offset(3, j3) + _offset(4, j4);
         }
 
         NumN index_tensor_to_array(NumN j1, NumN j2, NumN j3, NumN j4, NumN j5) const {
@@ -224,7 +278,8 @@ namespace math21 {
                     j1 >= 1 && j1 <= dim(1) && j2 >= 1 && j2 <= dim(2) && j3 >= 1 && j3 <= dim(3) && j4 >= 1 &&
                     j4 <= dim(4) && j5 >= 1 && j5 <= dim(5),
                     "\tYou must give a valid index");
-            return a(1)(j1) + a(2)(j2) + a(3)(j3) + a(4)(j4) + a(5)(j5);
+            return _offset_base() + _offset(1, j1) + _offset(2, j2) + _offset(3, j3) + _offset(4, j4) +
+                   _offset(5, j5);
         }
 
         NumN index_tensor_to_array(NumN j1, NumN j2, NumN j3, NumN j4, NumN j5, NumN j6) const {
@@ -234,7 +289,8 @@ namespace math21 {
                     j1 >= 1 && j1 <= dim(1) && j2 >= 1 && j2 <= dim(2) && j3 >= 1 && j3 <= dim(3) && j4 >= 1 &&
                     j4 <= dim(4) && j5 >= 1 && j5 <= dim(5) && j6 >= 1 && j6 <= dim(6),
                     "\tYou must give a valid index");
-            return a(1)(j1) + a(2)(j2) + a(3)(j3) + a(4)(j4) + a(5)(j5) + a(6)(j6);
+            return _offset_base() + _offset(1, j1) + _offset(2, j2) + _offset(3, j3) + _offset(4, j4) +
+                   _offset(5, j5) + _offset(6, j6);
         }
 
     public:
@@ -277,6 +333,18 @@ namespace math21 {
             copyFrom(B);
         }
 
+        // move constructor, data is taken from B, and B becomes empty.
+        // Views and subs are copied, because their data belongs to other tensors.
+        Tensor(Tensor &&B) noexcept {
+            init();
+            if (B.getClassName() == Tensor::getClassName()) {
+                swap(B);
+            } else {
+                setColumnMajor(B.isColumnMajor());
+                copyFrom(B);
+            }
+        }
+
         //construct like mlp, but from top to bottom.
         Tensor(ArrayN d) {
             init();
@@ -689,6 +757,19 @@ namespace math21 {
             return *this;
         }
 
+        // Data of B is taken only when this is empty.
+        // Otherwise it's assigned as usual, because the space of this may be shared or viewed by others.
+        Tensor &operator=(Tensor &&B) {
+            if (this != &B && isEmpty() && getClassName() == Tensor::getClassName()
+                && B.getClassName() == Tensor::getClassName()) {
+                clear();
+                swap(B);
+            } else {
+                assign(B);
+            }
+            return *this;
+        }
+
         void copyTo(Tensor &B) const {
             B.setSize(shape());
             B.assign(*this);
@@ -703,6 +784,38 @@ namespace math21 {
             return 1;
         }
 
+        // share data of continuous tensor B, and both copy data before writing.
+        // So B can be read by threads, e.x., weights, without deep copy.
+        void setDataCopyOnWrite(const Tensor &B) {
+            MATH21_ASSERT(getClassName() == Tensor::getClassName(), "You must overwrite to use");
+            MATH21_ASSERT(B.isContinuous())
+            if (this == &B) {
+                return;
+            }
+            if (B.isEmpty()) {
+                clear();
+                return;
+            }
+            clearSome();
+            is_column_major = B.is_column_major;
+            _setSizeNoSpace(B.d);
+            data.setDataCopyOnWrite(B.data);
+        }
+
+        virtual NumB isCopyOnWrite() const {
+            return data.isCopyOnWrite();
+        }
+
+        // copy shared data before writing through raw address, see math21_memory_tensor_data_address.
+        virtual void prepareWriting() {
+            data.prepareWriting();
+        }
+
+        // allocator used when data space is allocated next time, e.x., by setSize. 0 means current allocator.
+        void setAllocator(Allocator *allocator) {
+            data.setAllocator(allocator);
+        }
+
         // deprecated
         SpaceParas getSpace(NumN offset, NumN size, NumN unit = sizeof(char)) const {
             return data.getAutoBuffer().getSpace(offset, size, unit);
@@ -754,7 +867,10 @@ namespace math21 {
         void swap(Tensor &B) {
             MATH21_ASSERT(getClassName() == Tensor::getClassName(), "You must overwrite to use");
             data.swap(B.data);
+#ifdef MATH21_FLAG_TENSOR_INDEX_TABLE
             a.swap(B.a);
+#endif
+            s.swap(B.s);
             d.swap(B.d);
             m21_swap(N, B.N);
             m21_swap(is_column_major, B.is_column_major);
@@ -27,18 +27,27 @@ namespace math21 {
     template<typename T>
     class Array {
     private:
-        AutoBuffer autoBuffer;
+        // mutable, because inline space is moved to heap when shared, see getAutoBuffer.
+        mutable AutoBuffer autoBuffer;
         NumN n; // n is not auxiliary.
-        T *v; // v is auxiliary.
+        mutable T *v; // v is auxiliary.
 
         void init() {
             clear();
         }
 
-        void updateAuxiliary() {
+        void updateAuxiliary() const {
             v = (T *) autoBuffer.getObj();
         }
 
+        // space of small array is inline, and must be moved to heap before sharing.
+        void prepareSharing() const {
+            if (autoBuffer.isInline()) {
+                autoBuffer.moveToHeap();
+                updateAuxiliary();
+            }
+        }
+
         void destroy() {
             MATH21_ASSERT_CODE((n > 0 && v != 0) || (n == 0 && v == 0),
                                "You've called setSizeNoSpace(), and should call setSpace() afterwards!");
@@ -61,6 +70,12 @@ namespace math21 {
             B.copyTo(*this);
         }
 
+        // move constructor, B becomes empty.
+        Array(Array &&B) noexcept {
+            init();
+            swap(B);
+        }
+
         // Copy constructor
         template<typename S>
         Array(const Array<S> &B) {
@@ -115,6 +130,14 @@ namespace math21 {
             updateAuxiliary();
         }
 
+        // copy shared space before writing if copy-on-write.
+        void prepareWriting() {
+            if (autoBuffer.isCopyOnWrite()) {
+                autoBuffer.prepareWriting();
+                updateAuxiliary();
+            }
+        }
+
         void setSizeNoSpace(NumN n) {
             clear();
             if (n == 0) {
@@ -146,6 +169,7 @@ namespace math21 {
         }
 
         SpaceParas getSpace(NumN offset, NumN size, NumN unit = sizeof(char)) const {
+            prepareSharing();
             return autoBuffer.getSpace(offset, size, unit);
         }
 
@@ -167,6 +191,7 @@ namespace math21 {
 
         T &operator()(NumN n, NumN m) {
             MATH21_ASSERT_INDEX(n <= size() && m == 1);
+            prepareWriting();
             MATH21_ASSERT_CODE(v != 0,
                                "v is 0, maybe you forget call setSize, "
                                "or you've called setSizeNoSpace(), but didn't call setSpace() afterwards?")
@@ -175,6 +200,7 @@ namespace math21 {
 
         T &operator()(NumN n) {
             MATH21_ASSERT_INDEX(n <= size());
+            prepareWriting();
             MATH21_ASSERT_CODE(v != 0,
                                "v is 0, maybe you forget call setSize, "
                                "or you've called setSizeNoSpace(), but didn't call setSpace() afterwards?")
@@ -183,6 +209,7 @@ namespace math21 {
 
         T &at(NumN n) {
             MATH21_ASSERT_INDEX(n <= size());
+            prepareWriting();
             MATH21_ASSERT_CODE(v != 0,
                                "v is 0, maybe you forget call setSize, "
                                "or you've called setSizeNoSpace(), but didn't call setSpace() afterwards?")
@@ -241,6 +268,16 @@ namespace math21 {
             return *this;
         }
 
+        // Space of B is taken only when this is empty, because space of this may be shared.
+        Array<T> &operator=(Array<T> &&B) {
+            if (this != &B && isEmpty()) {
+                swap(B);
+            } else {
+                assign(B);
+            }
+            return *this;
+        }
+
         //assignment
         template<typename S>
         Array<T> &operator=(const Array<S> &B) {
@@ -250,8 +287,28 @@ namespace math21 {
             return *this;
         }
 
+        // allocator used when space is allocated next time, 0 means current allocator.
+        void setAllocator(Allocator *allocator) {
+            autoBuffer.setAllocator(allocator);
+        }
+
+        // share space of B, and both copy space before writing.
+        // B is const, but its mode is changed, so it must not be written by other threads meanwhile.
+        void setDataCopyOnWrite(const Array<T> &B) {
+            B.prepareSharing();
+            autoBuffer.setDataCopyOnWrite(B.autoBuffer);
+            n = B.n;
+            updateAuxiliary();
+        }
+
+        NumB isCopyOnWrite() const {
+            return autoBuffer.isCopyOnWrite();
+        }
+
         // use carefully
+        // Space got from the buffer can be shared, so it isn't inline.
         const AutoBuffer &getAutoBuffer() const {
+            prepareSharing();
             return autoBuffer;
         }
 
@@ -260,7 +317,11 @@ namespace math21 {
                           "vector size doesn't match in assign");
             if (this != &B) {
                 if (isContinuous() && B.isContinuous()) {
-                    autoBuffer.setDataDeep(B.getAutoBuffer());
+                    // space is overwritten, so copy-on-write space is dropped instead of copied.
+                    if (autoBuffer.isCopyOnWrite() && !autoBuffer.isIndependent()) {
+                        autoBuffer.clear();
+                    }
+                    autoBuffer.setDataDeep(B.autoBuffer);
                     updateAuxiliary();
                 } else {
                     NumN i;
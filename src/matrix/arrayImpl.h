@@ -22,6 +22,8 @@ namespace math21 {
     void Array<T>::swap(Array &B) {
         autoBuffer.swap(B.autoBuffer);
         m21_swap(n, B.n);
-        m21_swap(v, B.v);
+        // inline space doesn't move with swap, so v is updated instead of swapped.
+        updateAuxiliary();
+        B.updateAuxiliary();
     }
 }
\ No newline at end of file
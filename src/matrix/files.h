@@ -21,6 +21,7 @@ limitations under the License.
 #include "tenView.h"
 #include "tenSub.h"
 #include "matrix.h"
+#include "mat_fixed.h"
 #include "vec_ops.h"
 #include "ten_ops.h"
 #include "after_ops.h"
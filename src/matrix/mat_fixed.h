@@ -0,0 +1,273 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#pragma once
+
+#include "ten.h"
+
+namespace math21 {
+
+    /*
+     * N*M matrix of fixed size on the stack, row-major, with no heap and no shape at run time.
+     * Loops have trip counts known at compile time, so products of small ones are fully unrolled.
+     * It is for small transforms, e.x., 3*3 and 4*4 homogeneous ones, where Tensor costs more than the arithmetic.
+     * Element access (i, j) is 1-based as Tensor. An N*1 one is a vector, and can also be accessed by (i).
+     * */
+    template<typename T, NumN N, NumN M>
+    class MatFixed {
+    private:
+        T a[N * M];
+
+    public:
+        // zeros
+        MatFixed() {
+            setZero();
+        }
+
+        static NumN nrows() {
+            return N;
+        }
+
+        static NumN ncols() {
+            return M;
+        }
+
+        static NumN size() {
+            return N * M;
+        }
+
+        T &operator()(NumN i, NumN j) {
+            return a[(i - 1) * M + j - 1];
+        }
+
+        const T &operator()(NumN i, NumN j) const {
+            return a[(i - 1) * M + j - 1];
+        }
+
+        T &operator()(NumN i) {
+            return a[i - 1];
+        }
+
+        const T &operator()(NumN i) const {
+            return a[i - 1];
+        }
+
+        T *getData() {
+            return a;
+        }
+
+        const T *getData() const {
+            return a;
+        }
+
+        void setZero() {
+            for (NumN k = 0; k < N * M; ++k) {
+                a[k] = 0;
+            }
+        }
+
+        void setIdentity() {
+            for (NumN i = 0; i < N; ++i) {
+                for (NumN j = 0; j < M; ++j) {
+                    a[i * M + j] = i == j ? 1 : 0;
+                }
+            }
+        }
+
+        // A must be N*M, or a vector of size N when M is 1.
+        void assign(const Tensor<T> &A) {
+            MATH21_ASSERT(A.nrows() == N && A.ncols() == M, "size doesn't match, A is "
+                    << A.nrows() << "*" << A.ncols() << ", should be " << N << "*" << M);
+            for (NumN i = 1; i <= N; ++i) {
+                for (NumN j = 1; j <= M; ++j) {
+                    (*this)(i, j) = A.dims() == 1 ? A(i) : A(i, j);
+                }
+            }
+        }
+
+        // B is N*M, or a vector when M is 1.
+        void copyTo(Tensor<T> &B) const {
+            if (M == 1) {
+                if (B.dims() != 1 || B.size() != N) {
+                    B.setSize(N);
+                }
+                for (NumN i = 1; i <= N; ++i) {
+                    B(i) = (*this)(i);
+                }
+            } else {
+                if (!B.isSameSize(N, M)) {
+                    B.setSize(N, M);
+                }
+                for (NumN i = 1; i <= N; ++i) {
+                    for (NumN j = 1; j <= M; ++j) {
+                        B(i, j) = (*this)(i, j);
+                    }
+                }
+            }
+        }
+    };
+
+    typedef MatFixed<NumR, 2, 2> Mat22R;
+    typedef MatFixed<NumR, 3, 3> Mat33R;
+    typedef MatFixed<NumR, 4, 4> Mat44R;
+    typedef MatFixed<NumR, 2, 1> Vec2R;
+    typedef MatFixed<NumR, 3, 1> Vec3R;
+    typedef MatFixed<NumR, 4, 1> Vec4R;
+
+    // C = A*B, C can't be A or B.
+    template<typename T, NumN N, NumN K, NumN M>
+    void math21_operator_fixed_multiply(const MatFixed<T, N, K> &A, const MatFixed<T, K, M> &B,
+                                        MatFixed<T, N, M> &C) {
+        const T *a = A.getData();
+        const T *b = B.getData();
+        T *c = C.getData();
+        for (NumN i = 0; i < N; ++i) {
+            for (NumN j = 0; j < M; ++j) {
+                T sum = 0;
+                for (NumN k = 0; k < K; ++k) {
+                    sum += a[i * K + k] * b[k * M + j];
+                }
+                c[i * M + j] = sum;
+            }
+        }
+    }
+
+    template<typename T, NumN N, NumN M>
+    void math21_operator_fixed_trans(const MatFixed<T, N, M> &A, MatFixed<T, M, N> &B) {
+        for (NumN i = 1; i <= N; ++i) {
+            for (NumN j = 1; j <= M; ++j) {
+                B(j, i) = A(i, j);
+            }
+        }
+    }
+
+    // closed forms for n <= 4.
+    template<typename T>
+    T math21_operator_fixed_det(const MatFixed<T, 1, 1> &A) {
+        return A(1, 1);
+    }
+
+    template<typename T>
+    T math21_operator_fixed_det(const MatFixed<T, 2, 2> &A) {
+        return A(1, 1) * A(2, 2) - A(1, 2) * A(2, 1);
+    }
+
+    template<typename T>
+    T math21_operator_fixed_det(const MatFixed<T, 3, 3> &A) {
+        return A(1, 1) * (A(2, 2) * A(3, 3) - A(2, 3) * A(3, 2))
+               - A(1, 2) * (A(2, 1) * A(3, 3) - A(2, 3) * A(3, 1))
+               + A(1, 3) * (A(2, 1) * A(3, 2) - A(2, 2) * A(3, 1));
+    }
+
+    namespace detail {
+        // 2*2 minors of rows 1, 2 in s, and of rows 3, 4 in c, shared by det and inverse of 4*4.
+        template<typename T>
+        void math21_operator_fixed_minors_4_4(const MatFixed<T, 4, 4> &A, T *s, T *c) {
+            s[0] = A(1, 1) * A(2, 2) - A(2, 1) * A(1, 2);
+            s[1] = A(1, 1) * A(2, 3) - A(2, 1) * A(1, 3);
+            s[2] = A(1, 1) * A(2, 4) - A(2, 1) * A(1, 4);
+            s[3] = A(1, 2) * A(2, 3) - A(2, 2) * A(1, 3);
+            s[4] = A(1, 2) * A(2, 4) - A(2, 2) * A(1, 4);
+            s[5] = A(1, 3) * A(2, 4) - A(2, 3) * A(1, 4);
+            c[5] = A(3, 3) * A(4, 4) - A(4, 3) * A(3, 4);
+            c[4] = A(3, 2) * A(4, 4) - A(4, 2) * A(3, 4);
+            c[3] = A(3, 2) * A(4, 3) - A(4, 2) * A(3, 3);
+            c[2] = A(3, 1) * A(4, 4) - A(4, 1) * A(3, 4);
+            c[1] = A(3, 1) * A(4, 3) - A(4, 1) * A(3, 3);
+            c[0] = A(3, 1) * A(4, 2) - A(4, 1) * A(3, 2);
+        }
+    }
+
+    template<typename T>
+    T math21_operator_fixed_det(const MatFixed<T, 4, 4> &A) {
+        T s[6], c[6];
+        detail::math21_operator_fixed_minors_4_4(A, s, c);
+        return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+    }
+
+    // B = inverse of A by adjugate. Return 0 if A is singular. B can be A.
+    template<typename T>
+    NumB math21_operator_fixed_inverse(const MatFixed<T, 2, 2> &A, MatFixed<T, 2, 2> &B) {
+        T det = math21_operator_fixed_det(A);
+        if (det == 0) {
+            return 0;
+        }
+        T a = A(1, 1), b = A(1, 2), c = A(2, 1), d = A(2, 2);
+        B(1, 1) = d / det;
+        B(1, 2) = -b / det;
+        B(2, 1) = -c / det;
+        B(2, 2) = a / det;
+        return 1;
+    }
+
+    template<typename T>
+    NumB math21_operator_fixed_inverse(const MatFixed<T, 3, 3> &A, MatFixed<T, 3, 3> &B) {
+        MatFixed<T, 3, 3> C;
+        C(1, 1) = A(2, 2) * A(3, 3) - A(2, 3) * A(3, 2);
+        C(1, 2) = A(1, 3) * A(3, 2) - A(1, 2) * A(3, 3);
+        C(1, 3) = A(1, 2) * A(2, 3) - A(1, 3) * A(2, 2);
+        C(2, 1) = A(2, 3) * A(3, 1) - A(2, 1) * A(3, 3);
+        C(2, 2) = A(1, 1) * A(3, 3) - A(1, 3) * A(3, 1);
+        C(2, 3) = A(1, 3) * A(2, 1) - A(1, 1) * A(2, 3);
+        C(3, 1) = A(2, 1) * A(3, 2) - A(2, 2) * A(3, 1);
+        C(3, 2) = A(1, 2) * A(3, 1) - A(1, 1) * A(3, 2);
+        C(3, 3) = A(1, 1) * A(2, 2) - A(1, 2) * A(2, 1);
+        T det = A(1, 1) * C(1, 1) + A(1, 2) * C(2, 1) + A(1, 3) * C(3, 1);
+        if (det == 0) {
+            return 0;
+        }
+        T det_inv = 1 / det;
+        for (NumN i = 1; i <= 3; ++i) {
+            for (NumN j = 1; j <= 3; ++j) {
+                B(i, j) = C(i, j) * det_inv;
+            }
+        }
+        return 1;
+    }
+
+    template<typename T>
+    NumB math21_operator_fixed_inverse(const MatFixed<T, 4, 4> &A, MatFixed<T, 4, 4> &B) {
+        T s[6], c[6];
+        detail::math21_operator_fixed_minors_4_4(A, s, c);
+        T det = s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+        if (det == 0) {
+            return 0;
+        }
+        T det_inv = 1 / det;
+        MatFixed<T, 4, 4> C;
+        C(1, 1) = (A(2, 2) * c[5] - A(2, 3) * c[4] + A(2, 4) * c[3]) * det_inv;
+        C(1, 2) = (-A(1, 2) * c[5] + A(1, 3) * c[4] - A(1, 4) * c[3]) * det_inv;
+        C(1, 3) = (A(4, 2) * s[5] - A(4, 3) * s[4] + A(4, 4) * s[3]) * det_inv;
+        C(1, 4) = (-A(3, 2) * s[5] + A(3, 3) * s[4] - A(3, 4) * s[3]) * det_inv;
+
+        C(2, 1) = (-A(2, 1) * c[5] + A(2, 3) * c[2] - A(2, 4) * c[1]) * det_inv;
+        C(2, 2) = (A(1, 1) * c[5] - A(1, 3) * c[2] + A(1, 4) * c[1]) * det_inv;
+        C(2, 3) = (-A(4, 1) * s[5] + A(4, 3) * s[2] - A(4, 4) * s[1]) * det_inv;
+        C(2, 4) = (A(3, 1) * s[5] - A(3, 3) * s[2] + A(3, 4) * s[1]) * det_inv;
+
+        C(3, 1) = (A(2, 1) * c[4] - A(2, 2) * c[2] + A(2, 4) * c[0]) * det_inv;
+        C(3, 2) = (-A(1, 1) * c[4] + A(1, 2) * c[2] - A(1, 4) * c[0]) * det_inv;
+        C(3, 3) = (A(4, 1) * s[4] - A(4, 2) * s[2] + A(4, 4) * s[0]) * det_inv;
+        C(3, 4) = (-A(3, 1) * s[4] + A(3, 2) * s[2] - A(3, 4) * s[0]) * det_inv;
+
+        C(4, 1) = (-A(2, 1) * c[3] + A(2, 2) * c[1] - A(2, 3) * c[0]) * det_inv;
+        C(4, 2) = (A(1, 1) * c[3] - A(1, 2) * c[1] + A(1, 3) * c[0]) * det_inv;
+        C(4, 3) = (-A(4, 1) * s[3] + A(4, 2) * s[1] - A(4, 3) * s[0]) * det_inv;
+        C(4, 4) = (A(3, 1) * s[3] - A(3, 2) * s[1] + A(3, 3) * s[0]) * det_inv;
+        B = C;
+        return 1;
+    }
+}
@@ -36,12 +36,19 @@ namespace math21 {
         void init_ts() {
         }
 
+        // m is writable, so is the strided data, after shared data of m is copied.
+        T *stridedData() {
+            prepareWriting();
+            return const_cast<T *>(this->s_data);
+        }
+
     public:
 
         TensorSub(Tensor <T> &m, const Seqce <VecN> &index) : TensorView<T>(m, index), m(m) {
             init_ts();
             MATH21_ASSERT(m.isWritable(),
                           "can't get tensor sub from tensor which is read only. Maybe you can use tensor view instead.");
+            prepareWriting();
             y.setSize(m.dims());
         }
 
@@ -49,9 +56,25 @@ namespace math21 {
             init_ts();
             MATH21_ASSERT(m.isWritable(),
                           "can't get tensor sub from tensor which is read only. Maybe you can use tensor view instead.");
+            prepareWriting();
             y.setSize(m.dims());
         }
 
+        NumB isCopyOnWrite() const override {
+            return m.isCopyOnWrite();
+        }
+
+        // Data of m is copied if shared copy-on-write, and strided data is derived again,
+        // so writes through strided data never reach tensors sharing with m.
+        // Strided data is kept as address, so like math21_memory_tensor_data_address,
+        // it is stale if m gets new space otherwise, e.x., m is resized, or m writes first after being shared.
+        void prepareWriting() override {
+            if (m.isCopyOnWrite()) {
+                m.prepareWriting();
+                this->init_strided();
+            }
+        }
+
         virtual T &operator()(const VecN &index) override {
             MATH21_ASSERT(!this->isEmpty() && this->dims() == index.size(), "index not match tensor dim");
             for (NumN i = 1; i <= this->dims(); i++) {
@@ -60,6 +83,9 @@ namespace math21 {
                                       << "\n\tcurrent index: " << index(i)
                                       << "\n\trequired [" << 1 << ", " << this->dim(i) << "]");
             }
+            if (this->is_strided) {
+                return stridedData()[this->stridedOffset(index)];
+            }
             if (this->b.isEmpty()) {
                 for (NumN i = 1; i <= this->dims(); i++) {
                     y(i) = this->a(i)(index(i));
@@ -82,6 +108,9 @@ namespace math21 {
         // as container.
         virtual T &operator()(NumN j1) override {
             MATH21_ASSERT(j1 <= this->volume());
+            if (this->is_strided) {
+                return stridedData()[this->stridedOffset(j1)];
+            }
             VecN index(this->dims());
 //            math21_operator_number_num_to_index_right(j1, index, this->shape());
             math21_operator_number_num_to_index_left(j1, index, this->shape());
@@ -105,6 +134,9 @@ namespace math21 {
             MATH21_ASSERT(
                     j1 >= 1 && j1 <= this->dim(1) && j2 >= 1 && j2 <= this->dim(2),
                     "\tYou must give a valid index");
+            if (this->is_strided) {
+                return stridedData()[(j1 - 1) * this->s_stride(1) + (j2 - 1) * this->s_stride(2)];
+            }
             if (this->b.isEmpty()) {
                 return m(this->a(1)(j1), this->a(2)(j2));
             } else {
@@ -130,6 +162,10 @@ namespace math21 {
             MATH21_ASSERT(
                     j1 >= 1 && j1 <= this->dim(1) && j2 >= 1 && j2 <= this->dim(2) && j3 >= 1 && j3 <= this->dim(3),
                     "\tYou must give a valid index");
+            if (this->is_strided) {
+                return stridedData()[(j1 - 1) * this->s_stride(1) + (j2 - 1) * this->s_stride(2) +
+                                     (j3 - 1) * this->s_stride(3)];
+            }
             if (this->b.isEmpty()) {
                 return m(this->a(1)(j1), this->a(2)(j2), this->a(3)(j3));
             } else {
@@ -158,6 +194,10 @@ namespace math21 {
                     j1 >= 1 && j1 <= this->dim(1) && j2 >= 1 && j2 <= this->dim(2) && j3 >= 1 &&
                     j3 <= this->dim(3) && j4 >= 1 && j4 <= this->dim(4),
                     "\tYou must give a valid index");
+            if (this->is_strided) {
+                return stridedData()[(j1 - 1) * this->s_stride(1) + (j2 - 1) * this->s_stride(2) +
+                                     (j3 - 1) * this->s_stride(3) + (j4 - 1) * this->s_stride(4)];
+            }
             if (this->b.isEmpty()) {
                 return m(this->a(1)(j1), this->a(2)(j2), this->a(3)(j3), this->a(4)(j4));
             } else {
@@ -29,6 +29,12 @@ namespace math21 {
      * 2. tensor sub can choose more than one time an element from the tensor in a given position, while sub tensor can select one element only one time.
      *
      * element access is slow!!!
+     * Except for strided views. If m is continuous or is a strided view itself,
+     * and every slice index is an increasing arithmetic progression, e.g., a contiguous range,
+     * then the view is strided, i.e., element (j1, ..., jn) is s_data[(j1-1)*s_stride(1) + ... + (jn-1)*s_stride(n)].
+     * Shrink views of such m are always strided.
+     * Strided views skip index tables in element access, and ops can iterate them with pointers,
+     * see math21_memory_tensor_strided_address.
      *
      * Todo: consider constructor safety!
      * */
@@ -42,11 +48,116 @@ namespace math21 {
         void init_tv() {
             MATH21_ASSERT(a.isEmpty());
             MATH21_ASSERT(b.isEmpty());
+            is_strided = 0;
+            s_data = 0;
+        }
+
+        // get strided representation of m, return 0 if m has no such representation.
+        NumB getTensorStrides(const T *&data, ArrayN &stride) const {
+            if (m.isContinuous()) {
+                data = math21_memory_tensor_data_address(m);
+                math21_operator_tensor_continuous_strides(m, stride);
+                return 1;
+            }
+            if (m.getClassName() == "TensorView" || m.getClassName() == "TensorSub") {
+                const TensorView<T> &mv = (const TensorView<T> &) m;
+                if (mv.isStrided()) {
+                    data = mv.getStridedData();
+                    stride.setSize(mv.getStrides().size());
+                    stride.assign(mv.getStrides());
+                    return 1;
+                }
+            }
+            return 0;
+        }
+
+        // call after shape is set.
+        void init_strided_slice() {
+            const T *data;
+            ArrayN stride;
+            if (this->isEmpty() || !getTensorStrides(data, stride)) {
+                return;
+            }
+            s_stride.setSize(a.size());
+            for (NumN i = 1; i <= a.size(); ++i) {
+                const VecN &x = a(i);
+                NumN step = 0;
+                if (x.size() > 1) {
+                    if (x(2) <= x(1)) {
+                        return;
+                    }
+                    step = x(2) - x(1);
+                    for (NumN k = 3; k <= x.size(); ++k) {
+                        if (x(k) != x(k - 1) + step) {
+                            return;
+                        }
+                    }
+                }
+                data = data + (x(1) - 1) * stride(i);
+                s_stride(i) = step * stride(i);
+            }
+            s_data = data;
+            is_strided = 1;
+        }
+
+        // call after shape is set.
+        void init_strided_shrink() {
+            const T *data;
+            ArrayN stride;
+            if (this->isEmpty() || !getTensorStrides(data, stride)) {
+                return;
+            }
+            s_stride.setSize(this->dims());
+            for (NumN i = 1, j = 1; i <= b.size(); ++i) {
+                if (b(i) == 0) {
+                    s_stride(j) = stride(i);
+                    ++j;
+                } else {
+                    data = data + (b(i) - 1) * stride(i);
+                }
+            }
+            s_data = data;
+            is_strided = 1;
         }
 
     protected:
+        // derive strided representation again, e.x., after data of m is copied.
+        void init_strided() {
+            is_strided = 0;
+            s_data = 0;
+            if (b.isEmpty()) {
+                init_strided_slice();
+            } else {
+                init_strided_shrink();
+            }
+        }
+
         VecN b;//// b is index to a.
         Seqce<VecN> a;////a is index to Tensor
+
+        NumB is_strided;
+        const T *s_data; // address of element (1, ..., 1)
+        ArrayN s_stride; // strides of view, not of m.
+
+        // offset of element in container order, i.e., from left.
+        NumN stridedOffset(NumN j1) const {
+            NumN x = j1 - 1;
+            NumN offset = 0;
+            for (NumN k = 1; k <= this->dims(); ++k) {
+                offset = offset + (x % this->dim(k)) * s_stride(k);
+                x = x / this->dim(k);
+            }
+            return offset;
+        }
+
+        NumN stridedOffset(const VecN &index) const {
+            NumN offset = 0;
+            for (NumN k = 1; k <= this->dims(); ++k) {
+                offset = offset + (index(k) - 1) * s_stride(k);
+            }
+            return offset;
+        }
+
     public:
 
         TensorView(const TensorView<T> &m) : Tensor<T>(), m(m.getTensor()) {
@@ -74,6 +185,7 @@ namespace math21 {
                 d(i) = a.at(i).size();
             }
             this->setSizeNoSpace(d);
+            init_strided_slice();
         }
 
         //shrink, i.e., slice and remove. We use this to discriminate move constructor or copy constructor which we don't handle.
@@ -86,6 +198,7 @@ namespace math21 {
             VecN d;
             math21_operator_tensor_shrink_shape(m, b, d);
             this->setSizeNoSpace(d);
+            init_strided_shrink();
         }
 
         // call clear to avoid MATH21_ASSERT no space error!
@@ -105,6 +218,21 @@ namespace math21 {
             return m;
         }
 
+        NumB isStrided() const {
+            return is_strided;
+        }
+
+        // address of element (1, ..., 1), valid only when strided.
+        const T *getStridedData() const {
+            MATH21_ASSERT(is_strided)
+            return s_data;
+        }
+
+        const ArrayN &getStrides() const {
+            MATH21_ASSERT(is_strided)
+            return s_stride;
+        }
+
         virtual T &operator()(const VecN &index) override {
             MATH21_ASSERT(0, "dummy, can't call this!");
             return dummy;
@@ -138,6 +266,9 @@ namespace math21 {
                                       << "\n\tcurrent index: " << index(i)
                                       << "\n\trequired [" << 1 << ", " << this->dim(i) << "]");
             }
+            if (is_strided) {
+                return s_data[stridedOffset(index)];
+            }
             // slice
             if (b.isEmpty()) {
                 VecN y(m.dims());
@@ -155,6 +286,9 @@ namespace math21 {
         // as container.
         virtual const T &operator()(NumN j1) const override {
             MATH21_ASSERT(j1 <= this->volume());
+            if (is_strided) {
+                return s_data[stridedOffset(j1)];
+            }
             VecN index(this->dims());
 //            math21_operator_number_num_to_index_right(j1, index, this->shape());
             math21_operator_number_num_to_index_left(j1, index, this->shape());
@@ -166,6 +300,9 @@ namespace math21 {
             MATH21_ASSERT(
                     j1 >= 1 && j1 <= this->dim(1) && j2 >= 1 && j2 <= this->dim(2),
                     "\tYou must give a valid index");
+            if (is_strided) {
+                return s_data[(j1 - 1) * s_stride(1) + (j2 - 1) * s_stride(2)];
+            }
             if (b.isEmpty()) {
                 return m(a(1)(j1), a(2)(j2));
             } else {
@@ -192,6 +329,9 @@ namespace math21 {
             MATH21_ASSERT(
                     j1 >= 1 && j1 <= this->dim(1) && j2 >= 1 && j2 <= this->dim(2) && j3 >= 1 && j3 <= this->dim(3),
                     "\tYou must give a valid index");
+            if (is_strided) {
+                return s_data[(j1 - 1) * s_stride(1) + (j2 - 1) * s_stride(2) + (j3 - 1) * s_stride(3)];
+            }
             if (b.isEmpty()) {
                 return m(a(1)(j1), a(2)(j2), a(3)(j3));
             } else {
@@ -221,6 +361,10 @@ namespace math21 {
                     j1 >= 1 && j1 <= this->dim(1) && j2 >= 1 && j2 <= this->dim(2) && j3 >= 1 &&
                     j3 <= this->dim(3) && j4 >= 1 && j4 <= this->dim(4),
                     "\tYou must give a valid index");
+            if (is_strided) {
+                return s_data[(j1 - 1) * s_stride(1) + (j2 - 1) * s_stride(2) +
+                              (j3 - 1) * s_stride(3) + (j4 - 1) * s_stride(4)];
+            }
             if (b.isEmpty()) {
                 return m(a(1)(j1), a(2)(j2), a(3)(j3), a(4)(j4));
             } else {
@@ -102,6 +102,36 @@ namespace math21 {
         w.setSpace(paras);
     }
 
+    // w shares the n-th sub-tensor of v along the first dim, e.x., sample n of a batch N*C*H*W.
+    // v must be continuous and row-major.
+    template<typename T>
+    void math21_operator_share_first_dim_slice(const Tensor <T> &v, NumN n, Tensor <T> &w) {
+        MATH21_ASSERT(v.dims() >= 2 && v.isContinuous() && !v.isColumnMajor());
+        MATH21_ASSERT(n >= 1 && n <= v.dim(1));
+        VecN d(v.dims() - 1);
+        for (NumN i = 1; i <= d.size(); ++i) {
+            d(i) = v.dim(i + 1);
+        }
+        NumN volume = v.volume() / v.dim(1);
+        SpaceParas paras = v.getSpace((n - 1) * volume, volume, sizeof(T));
+        w.setSize(d, &paras);
+    }
+
+    // w shares sub-tensors n1, ..., n1 + n - 1 of v along the first dim, e.x., part of a batch.
+    template<typename T>
+    void math21_operator_share_first_dim_range(const Tensor <T> &v, NumN n1, NumN n, Tensor <T> &w) {
+        MATH21_ASSERT(v.dims() >= 2 && v.isContinuous() && !v.isColumnMajor());
+        MATH21_ASSERT(n >= 1 && n1 >= 1 && n1 + n - 1 <= v.dim(1));
+        VecN d(v.dims());
+        d(1) = n;
+        for (NumN i = 2; i <= d.size(); ++i) {
+            d(i) = v.dim(i);
+        }
+        NumN volume = v.volume() / v.dim(1);
+        SpaceParas paras = v.getSpace((n1 - 1) * volume, n * volume, sizeof(T));
+        w.setSize(d, &paras);
+    }
+
     // return shrink shape
     // e.x., b = 2, 1, 0.
     template<typename T>
@@ -120,6 +150,27 @@ namespace math21 {
         }
     }
 
+    // strides of continuous tensor in numbers,
+    // i.e., element (j1, ..., jn) is at (j1-1)*stride(1) + ... + (jn-1)*stride(n) from the first element.
+    template<typename T>
+    void math21_operator_tensor_continuous_strides(const Tensor <T> &A, ArrayN &stride) {
+        MATH21_ASSERT(A.isContinuous())
+        NumN n = A.dims();
+        stride.setSize(n);
+        NumN scale = 1;
+        if (!A.isColumnMajor()) {
+            for (NumN i = n; i >= 1; --i) {
+                stride(i) = scale;
+                scale = scale * A.dim(i);
+            }
+        } else {
+            for (NumN i = 1; i <= n; ++i) {
+                stride(i) = scale;
+                scale = scale * A.dim(i);
+            }
+        }
+    }
+
     // Has error!
     template<typename T>
     const T *math21_memory_tensor_data_address(const Tensor <T> &A) {
@@ -132,6 +183,7 @@ namespace math21 {
     template<typename T>
     T *math21_memory_tensor_data_address(Tensor <T> &A) {
         MATH21_ASSERT(A.isContinuous())
+        A.prepareWriting();
         SpaceParas paras = A.getSpace();
         return (T *) paras.start;
     }
@@ -0,0 +1,173 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#include "../matrix_op/gemm.h"
+#include "triangular.h"
+#include "cholesky.h"
+
+namespace math21 {
+    namespace detail {
+        const NumN math21_cholesky_block_size = 64;
+
+        // unblocked Cholesky of diagonal block k0, ..., k0+kb-1. Return 0 if not positive definite.
+        NumB math21_c_cholesky_block(NumN n, NumN k0, NumN kb, NumR *A) {
+            for (NumN j = k0; j < k0 + kb; ++j) {
+                NumR *a_j = A + j * n;
+                NumR d = a_j[j];
+                for (NumN k = k0; k < j; ++k) {
+                    d -= a_j[k] * a_j[k];
+                }
+                if (!(d > 0)) {
+                    return 0;
+                }
+                d = xjsqrt(d);
+                a_j[j] = d;
+                for (NumN i = j + 1; i < k0 + kb; ++i) {
+                    NumR *a_i = A + i * n;
+                    NumR sum = a_i[j];
+                    for (NumN k = k0; k < j; ++k) {
+                        sum -= a_i[k] * a_j[k];
+                    }
+                    a_i[j] = sum / d;
+                }
+            }
+            return 1;
+        }
+
+        // L21 = A21 * inverse(L11.transpose), row by row.
+        void math21_c_cholesky_panel(NumN n, NumN k0, NumN kb, NumR *A) {
+            const NumR *L11 = A + k0 * n + k0;
+            for (NumN i = k0 + kb; i < n; ++i) {
+                NumR *a = A + i * n + k0;
+                for (NumN j = 0; j < kb; ++j) {
+                    const NumR *l = L11 + j * n;
+                    NumR sum = a[j];
+                    for (NumN k = 0; k < j; ++k) {
+                        sum -= a[k] * l[k];
+                    }
+                    a[j] = sum / l[j];
+                }
+            }
+        }
+    }
+
+    CholeskyDecomposition::CholeskyDecomposition() {
+        isPositiveDefinite = 0;
+    }
+
+    NumB CholeskyDecomposition::factor(const MatR &A) {
+        MATH21_ASSERT(A.dims() == 2 && A.nrows() == A.ncols(), "A is not square matrix");
+        NumN n = A.nrows();
+        if (!L.isSameSize(n, n)) {
+            L.setSize(n, n);
+        }
+        L.assign(A);
+        NumR *data = math21_memory_tensor_data_address(L);
+
+        isPositiveDefinite = 0;
+        const NumN nb = detail::math21_cholesky_block_size;
+        for (NumN k0 = 0; k0 < n; k0 += nb) {
+            NumN kb = xjmin(nb, n - k0);
+            if (!detail::math21_c_cholesky_block(n, k0, kb, data)) {
+                return 0;
+            }
+            NumN k1 = k0 + kb;
+            if (k1 < n) {
+                detail::math21_c_cholesky_panel(n, k0, kb, data);
+                // A22 -= L21 * L21.transpose, lower triangle only, by block rows.
+                for (NumN i0 = k1; i0 < n; i0 += nb) {
+                    NumN ib = xjmin(nb, n - i0);
+                    math21_c_gemm(0, 1, ib, i0 + ib - k1, kb, -1, data + i0 * n + k0, n, data + k1 * n + k0, n,
+                                  1, data + i0 * n + k1, n);
+                }
+            }
+        }
+        isPositiveDefinite = 1;
+        return 1;
+    }
+
+    NumB CholeskyDecomposition::isFactored() const {
+        return isPositiveDefinite;
+    }
+
+    NumN CholeskyDecomposition::size() const {
+        return L.nrows();
+    }
+
+    void CholeskyDecomposition::solve_c(NumN m, NumR *X) const {
+        NumN n = size();
+        const NumR *data = math21_memory_tensor_data_address(L);
+        math21_c_triangular_solve_lower(0, n, m, data, n, X, m);
+        math21_c_triangular_solve_lower_trans(0, n, m, data, n, X, m);
+    }
+
+    void CholeskyDecomposition::solve(MatR &B) const {
+        MATH21_ASSERT(isFactored(), "call factor() first, and A must be positive definite");
+        MATH21_ASSERT(B.nrows() == size(), "matrix size doesn't match");
+        if (B.isContinuous() && !B.isColumnMajor()) {
+            solve_c(B.ncols(), math21_memory_tensor_data_address(B));
+        } else {
+            MatR X;
+            X.setSize(B.shape());
+            X.assign(B);
+            solve_c(X.ncols(), math21_memory_tensor_data_address(X));
+            B.assign(X);
+        }
+    }
+
+    void CholeskyDecomposition::solve(const MatR &B, MatR &X) const {
+        if (!math21_operator_container_isEqual(X.shape(), B.shape())) {
+            X.setSize(B.shape());
+        }
+        X.assign(B);
+        solve(X);
+    }
+
+    void CholeskyDecomposition::inverse(MatR &A_inv) const {
+        MATH21_ASSERT(isFactored(), "call factor() first, and A must be positive definite");
+        NumN n = size();
+        if (!A_inv.isSameSize(n, n)) {
+            A_inv.setSize(n, n);
+        }
+        A_inv = 0;
+        for (NumN i = 1; i <= n; ++i) {
+            A_inv(i, i) = 1;
+        }
+        solve(A_inv);
+    }
+
+    NumR CholeskyDecomposition::determinant() const {
+        MATH21_ASSERT(isFactored(), "call factor() first, and A must be positive definite");
+        NumR det = 1;
+        for (NumN i = 1; i <= size(); ++i) {
+            det *= L(i, i);
+        }
+        return det * det;
+    }
+
+    void CholeskyDecomposition::getL(MatR &L) const {
+        MATH21_ASSERT(isFactored(), "call factor() first, and A must be positive definite");
+        NumN n = size();
+        if (!L.isSameSize(n, n)) {
+            L.setSize(n, n);
+        }
+        for (NumN i = 1; i <= n; ++i) {
+            for (NumN j = 1; j <= n; ++j) {
+                L(i, j) = j <= i ? this->L(i, j) : 0;
+            }
+        }
+    }
+}
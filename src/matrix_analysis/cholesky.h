@@ -0,0 +1,58 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#pragma once
+
+#include "inner.h"
+
+namespace math21 {
+    /*
+     * Cholesky decomposition A = L*L.transpose, A is symmetric positive definite.
+     * Only lower triangle of A is read.
+     * Factor once, then solve for any number of right-hand sides.
+     * Factorization is blocked and right-looking like LUDecomposition, with about half its work.
+     * */
+    class CholeskyDecomposition : public think::Algorithm {
+    private:
+        MatR L; // upper triangle isn't used.
+        NumB isPositiveDefinite;
+
+        void solve_c(NumN m, NumR *X) const;
+
+    public:
+        CholeskyDecomposition();
+
+        // return 0 if A isn't positive definite.
+        NumB factor(const MatR &A);
+
+        NumB isFactored() const;
+
+        NumN size() const;
+
+        // solve A*X=B, B can be vector.
+        void solve(const MatR &B, MatR &X) const;
+
+        // solve A*X=B, B will become X.
+        void solve(MatR &B) const;
+
+        void inverse(MatR &A_inv) const;
+
+        NumR determinant() const;
+
+        // L with zero upper triangle.
+        void getL(MatR &L) const;
+    };
+}
@@ -0,0 +1,508 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include "../matrix_op/gemm.h"
+#include "eigen.h"
+
+namespace math21 {
+    namespace detail {
+        // blocks not larger than this are solved by QL.
+        const NumN math21_eigen_dc_min_size = 25;
+
+        /*
+         * implicit QL of symmetric tridiagonal, d is diagonal, e is off-diagonal, e(n-1) is used as work.
+         * Rotations are applied to columns of Z, n*n, if Z isn't 0.
+         * */
+        void math21_c_eigen_tridiagonal_ql(NumN n, NumR *d, NumR *e, NumR *Z) {
+            if (n == 0) {
+                return;
+            }
+            e[n - 1] = 0;
+            for (NumZ l = 0; l < (NumZ) n; ++l) {
+                NumN iter = 0;
+                NumZ m;
+                do {
+                    for (m = l; m < (NumZ) n - 1; ++m) {
+                        NumR dd = xjabs(d[m]) + xjabs(d[m + 1]);
+                        if (xjabs(e[m]) <= std::numeric_limits<NumR>::epsilon() * dd) {
+                            break;
+                        }
+                    }
+                    if (m != l) {
+                        ++iter;
+                        MATH21_ASSERT(iter <= 60, "too many iterations in tridiagonal QL");
+                        NumR g = (d[l + 1] - d[l]) / (2 * e[l]);
+                        NumR r = std::hypot(g, (NumR) 1);
+                        g = d[m] - d[l] + e[l] / (g + (g >= 0 ? r : -r));
+                        NumR s = 1, c = 1, p = 0;
+                        NumZ i;
+                        for (i = m - 1; i >= l; --i) {
+                            NumR f = s * e[i];
+                            NumR b = c * e[i];
+                            r = std::hypot(f, g);
+                            e[i + 1] = r;
+                            if (r == 0) {
+                                d[i + 1] -= p;
+                                e[m] = 0;
+                                break;
+                            }
+                            s = f / r;
+                            c = g / r;
+                            g = d[i + 1] - p;
+                            r = (d[i] - g) * s + 2 * c * b;
+                            p = s * r;
+                            d[i + 1] = g + p;
+                            g = c * r - b;
+                            if (Z) {
+                                for (NumN k = 0; k < n; ++k) {
+                                    NumR *z = Z + k * n;
+                                    f = z[i + 1];
+                                    z[i + 1] = s * z[i] + c * f;
+                                    z[i] = c * z[i] - s * f;
+                                }
+                            }
+                        }
+                        if (r == 0 && i >= l) {
+                            continue;
+                        }
+                        d[l] -= p;
+                        e[l] = g;
+                        e[m] = 0;
+                    }
+                } while (m != l);
+            }
+        }
+
+        // values ascending, with columns of Z, n*n, in the same order.
+        void math21_c_eigen_sort(NumN n, NumR *d, NumR *Z) {
+            std::vector<NumN> order(n);
+            for (NumN i = 0; i < n; ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [d](NumN a, NumN b) {
+                return d[a] < d[b];
+            });
+            std::vector<NumR> d2(d, d + n), Z2(Z, Z + n * n);
+            for (NumN j = 0; j < n; ++j) {
+                d[j] = d2[order[j]];
+                for (NumN i = 0; i < n; ++i) {
+                    Z[i * n + j] = Z2[i * n + order[j]];
+                }
+            }
+        }
+
+        /*
+         * eigen decomposition of Q*(D + rho*z*z.transpose)*Q.transpose, rho > 0, |z| = 1, Q is n*n.
+         * Eigenvalues are written to d, and eigenvectors to columns of Z, not sorted.
+         * */
+        void math21_c_eigen_merge_positive(NumN n, const NumR *D, const NumR *z0, NumR rho, const NumR *Q,
+                                           NumR *d, NumR *Z) {
+            const NumR eps = std::numeric_limits<NumR>::epsilon();
+            // sort poles
+            std::vector<NumN> order(n);
+            for (NumN i = 0; i < n; ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [D](NumN a, NumN b) {
+                return D[a] < D[b];
+            });
+            std::vector<NumR> Ds(n), z(n), Qs(n * n);
+            NumR d_max = rho;
+            for (NumN j = 0; j < n; ++j) {
+                Ds[j] = D[order[j]];
+                z[j] = z0[order[j]];
+                d_max = xjmax(d_max, xjabs(Ds[j]));
+                for (NumN i = 0; i < n; ++i) {
+                    Qs[i * n + j] = Q[i * n + order[j]];
+                }
+            }
+
+            // deflation: small z, and close poles rotated to one.
+            NumR tol = 8 * eps * d_max;
+            std::vector<NumB> isDeflated(n, 0);
+            NumZ prev = -1;
+            for (NumN i = 0; i < n; ++i) {
+                if (rho * xjabs(z[i]) <= tol) {
+                    isDeflated[i] = 1;
+                    continue;
+                }
+                if (prev >= 0 && Ds[i] - Ds[prev] <= tol) {
+                    NumR r = std::hypot(z[prev], z[i]);
+                    NumR c = z[i] / r;
+                    NumR s = z[prev] / r;
+                    z[i] = r;
+                    z[prev] = 0;
+                    for (NumN k = 0; k < n; ++k) {
+                        NumR *q = Qs.data() + k * n;
+                        NumR a = q[prev];
+                        NumR b = q[i];
+                        q[prev] = c * a - s * b;
+                        q[i] = s * a + c * b;
+                    }
+                    isDeflated[prev] = 1;
+                }
+                prev = i;
+            }
+
+            std::vector<NumN> idx;
+            for (NumN i = 0; i < n; ++i) {
+                if (isDeflated[i]) {
+                    d[i] = Ds[i];
+                    for (NumN k = 0; k < n; ++k) {
+                        Z[k * n + i] = Qs[k * n + i];
+                    }
+                } else {
+                    idx.push_back(i);
+                }
+            }
+            NumN K = idx.size();
+            if (K == 0) {
+                return;
+            }
+            std::vector<NumR> dd(K), zz(K);
+            NumR sumz2 = 0;
+            for (NumN k = 0; k < K; ++k) {
+                dd[k] = Ds[idx[k]];
+                zz[k] = z[idx[k]];
+                sumz2 += zz[k] * zz[k];
+            }
+
+            // roots of secular equation f = 1 + rho*sum(zz_k^2/(dd_k - lambda)),
+            // lambda_j = dd(origin_j) + mu_j, so lambda_j - dd_i is accurate near the poles.
+            std::vector<NumN> origins(K);
+            std::vector<NumR> mus(K);
+#pragma omp parallel for
+            for (NumN j = 0; j < K; ++j) {
+                NumN o;
+                NumR lo, hi;
+                auto f = [&](NumN origin, NumR mu) {
+                    NumR sum = 1;
+                    for (NumN k = 0; k < K; ++k) {
+                        sum += rho * zz[k] * zz[k] / ((dd[k] - dd[origin]) - mu);
+                    }
+                    return sum;
+                };
+                if (j + 1 < K) {
+                    NumR gap = dd[j + 1] - dd[j];
+                    if (f(j, gap / 2) >= 0) {
+                        o = j;
+                        lo = 0;
+                        hi = gap / 2;
+                    } else {
+                        o = j + 1;
+                        lo = -gap / 2;
+                        hi = 0;
+                    }
+                } else {
+                    o = j;
+                    lo = 0;
+                    hi = rho * sumz2;
+                }
+                // f is increasing in mu.
+                for (NumN iter = 0; iter < 300; ++iter) {
+                    NumR mid = (lo + hi) / 2;
+                    if (mid == lo || mid == hi) {
+                        break;
+                    }
+                    if (f(o, mid) > 0) {
+                        hi = mid;
+                    } else {
+                        lo = mid;
+                    }
+                }
+                origins[j] = o;
+                mus[j] = (lo + hi) / 2;
+                if (mus[j] == 0) {
+                    mus[j] = o == j ? hi : lo;
+                }
+            }
+
+            // lambda_j - dd_i
+            auto diff = [&](NumN i, NumN j) {
+                return (dd[origins[j]] - dd[i]) + mus[j];
+            };
+            // zz is computed again from the roots, see Gu and Eisenstat.
+            std::vector<NumR> zh(K);
+            for (NumN i = 0; i < K; ++i) {
+                NumR val = diff(i, K - 1) / rho;
+                for (NumN j = 0; j < i; ++j) {
+                    val *= diff(i, j) / (dd[j] - dd[i]);
+                }
+                for (NumN j = i + 1; j < K; ++j) {
+                    val *= diff(i, j - 1) / (dd[j] - dd[i]);
+                }
+                zh[i] = xjsqrt(xjabs(val));
+                if (zz[i] < 0) {
+                    zh[i] = -zh[i];
+                }
+            }
+            // eigenvectors of D + rho*z*z.transpose, U is K*K, columns are vectors.
+            std::vector<NumR> U(K * K);
+#pragma omp parallel for
+            for (NumN j = 0; j < K; ++j) {
+                NumR norm2 = 0;
+                for (NumN i = 0; i < K; ++i) {
+                    NumR u = -zh[i] / diff(i, j);
+                    U[i * K + j] = u;
+                    norm2 += u * u;
+                }
+                NumR norm = xjsqrt(norm2);
+                for (NumN i = 0; i < K; ++i) {
+                    U[i * K + j] /= norm;
+                }
+            }
+            // Z(:, idx) = Qs(:, idx)*U
+            std::vector<NumR> QK(n * K), ZK(n * K);
+            for (NumN i = 0; i < n; ++i) {
+                for (NumN k = 0; k < K; ++k) {
+                    QK[i * K + k] = Qs[i * n + idx[k]];
+                }
+            }
+            math21_c_gemm(0, 0, n, K, K, 1, QK.data(), K, U.data(), K, 0, ZK.data(), K);
+            for (NumN k = 0; k < K; ++k) {
+                d[idx[k]] = dd[origins[k]] + mus[k];
+                for (NumN i = 0; i < n; ++i) {
+                    Z[i * n + idx[k]] = ZK[i * K + k];
+                }
+            }
+        }
+
+        // divide and conquer, d and e are overwritten, eigenvalues are in d, eigenvectors in columns of Z.
+        void math21_c_eigen_tridiagonal_dc(NumN n, NumR *d, NumR *e, NumR *Z) {
+            if (n <= math21_eigen_dc_min_size) {
+                for (NumN i = 0; i < n * n; ++i) {
+                    Z[i] = 0;
+                }
+                for (NumN i = 0; i < n; ++i) {
+                    Z[i * n + i] = 1;
+                }
+                std::vector<NumR> e2(n);
+                for (NumN i = 0; i + 1 < n; ++i) {
+                    e2[i] = e[i];
+                }
+                math21_c_eigen_tridiagonal_ql(n, d, e2.data(), Z);
+                math21_c_eigen_sort(n, d, Z);
+                return;
+            }
+            // T = diag(T1, T2) + beta*u*u.transpose, u = e(m-1) + e(m).
+            NumN m = n / 2;
+            NumN m2 = n - m;
+            NumR beta = e[m - 1];
+            std::vector<NumR> D(d, d + n);
+            D[m - 1] -= beta;
+            D[m] -= beta;
+            std::vector<NumR> Z1(m * m), Z2(m2 * m2);
+            math21_c_eigen_tridiagonal_dc(m, D.data(), e, Z1.data());
+            math21_c_eigen_tridiagonal_dc(m2, D.data() + m, e + m, Z2.data());
+
+            std::vector<NumR> Q(n * n, 0), z(n);
+            for (NumN i = 0; i < m; ++i) {
+                for (NumN j = 0; j < m; ++j) {
+                    Q[i * n + j] = Z1[i * m + j];
+                }
+            }
+            for (NumN i = 0; i < m2; ++i) {
+                for (NumN j = 0; j < m2; ++j) {
+                    Q[(m + i) * n + m + j] = Z2[i * m2 + j];
+                }
+            }
+            // z = Q.transpose*u
+            for (NumN j = 0; j < m; ++j) {
+                z[j] = Z1[(m - 1) * m + j];
+            }
+            for (NumN j = 0; j < m2; ++j) {
+                z[m + j] = Z2[j];
+            }
+
+            NumR znorm = 0;
+            for (NumN i = 0; i < n; ++i) {
+                znorm += z[i] * z[i];
+            }
+            znorm = xjsqrt(znorm);
+            NumR rho = beta * znorm * znorm;
+            if (rho == 0) {
+                for (NumN i = 0; i < n; ++i) {
+                    d[i] = D[i];
+                }
+                std::copy(Q.begin(), Q.end(), Z);
+                math21_c_eigen_sort(n, d, Z);
+                return;
+            }
+            for (NumN i = 0; i < n; ++i) {
+                z[i] /= znorm;
+            }
+            if (rho > 0) {
+                math21_c_eigen_merge_positive(n, D.data(), z.data(), rho, Q.data(), d, Z);
+            } else {
+                // D + rho*z*z.transpose = -(-D - rho*z*z.transpose)
+                for (NumN i = 0; i < n; ++i) {
+                    D[i] = -D[i];
+                }
+                math21_c_eigen_merge_positive(n, D.data(), z.data(), -rho, Q.data(), d, Z);
+                for (NumN i = 0; i < n; ++i) {
+                    d[i] = -d[i];
+                }
+            }
+            math21_c_eigen_sort(n, d, Z);
+        }
+    }
+
+    void SymmetricEigenDecomposition::solve_tridiagonal(const VecR &d, const VecR &e, NumB isVectors) {
+        NumN n = d.size();
+        MATH21_ASSERT(n >= 1, "empty matrix");
+        MATH21_ASSERT(e.size() + 1 == n || (n == 1 && e.isEmpty()), "e must have size n-1");
+        values.setSize(n);
+        NumR *d_data = math21_memory_tensor_data_address(values);
+        std::vector<NumR> e2(n, 0);
+        for (NumN i = 1; i <= n; ++i) {
+            d_data[i - 1] = d(i);
+        }
+        for (NumN i = 1; i < n; ++i) {
+            e2[i - 1] = e(i);
+        }
+        if (!isVectors) {
+            vectors.clear();
+            detail::math21_c_eigen_tridiagonal_ql(n, d_data, e2.data(), 0);
+            std::sort(d_data, d_data + n);
+            return;
+        }
+        vectors.setSize(n, n);
+        detail::math21_c_eigen_tridiagonal_dc(n, d_data, e2.data(), math21_memory_tensor_data_address(vectors));
+    }
+
+    void SymmetricEigenDecomposition::solve(const MatR &A, NumB isVectors) {
+        MATH21_ASSERT(A.dims() == 2 && A.nrows() == A.ncols() && !A.isEmpty(), "A is not square matrix");
+        NumN n = A.nrows();
+        // symmetric copy from lower triangle
+        std::vector<NumR> S(n * n);
+        for (NumN i = 0; i < n; ++i) {
+            for (NumN j = 0; j <= i; ++j) {
+                S[i * n + j] = A(i + 1, j + 1);
+                S[j * n + i] = A(i + 1, j + 1);
+            }
+        }
+        // Householder tridiagonalization, reflector k has v = (1, v_2, ...) on rows k+1, ...,
+        // and v_2, ... are kept below subdiagonal of column k.
+        VecR d(n), e;
+        if (n > 1) {
+            e.setSize(n - 1);
+        }
+        std::vector<NumR> taus(n, 0), p(n);
+        for (NumN k = 0; k + 2 < n; ++k) {
+            NumR alpha = S[(k + 1) * n + k];
+            NumR xnorm2 = 0;
+            for (NumN i = k + 2; i < n; ++i) {
+                xnorm2 += S[i * n + k] * S[i * n + k];
+            }
+            d(k + 1) = S[k * n + k];
+            if (xnorm2 == 0) {
+                e(k + 1) = alpha;
+                continue;
+            }
+            NumR beta = xjsqrt(alpha * alpha + xnorm2);
+            if (alpha > 0) {
+                beta = -beta;
+            }
+            NumR tau = (beta - alpha) / beta;
+            NumR scale = 1 / (alpha - beta);
+            taus[k] = tau;
+            e(k + 1) = beta;
+            // v on rows k+1, ..., n-1
+            std::vector<NumR> v(n - k - 1);
+            v[0] = 1;
+            for (NumN i = k + 2; i < n; ++i) {
+                S[i * n + k] *= scale;
+                v[i - k - 1] = S[i * n + k];
+            }
+            // S22 = H*S22*H by S22 -= v*w.transpose + w*v.transpose,
+            // p = tau*S22*v, w = p - (tau/2)*(p.v)*v.
+            NumN s = n - k - 1;
+            NumR pv = 0;
+            for (NumN i = 0; i < s; ++i) {
+                const NumR *row = S.data() + (k + 1 + i) * n + k + 1;
+                NumR sum = 0;
+                for (NumN j = 0; j < s; ++j) {
+                    sum += row[j] * v[j];
+                }
+                p[i] = tau * sum;
+                pv += p[i] * v[i];
+            }
+            NumR K = tau / 2 * pv;
+            for (NumN i = 0; i < s; ++i) {
+                p[i] -= K * v[i];
+            }
+            for (NumN i = 0; i < s; ++i) {
+                NumR *row = S.data() + (k + 1 + i) * n + k + 1;
+                for (NumN j = 0; j < s; ++j) {
+                    row[j] -= v[i] * p[j] + p[i] * v[j];
+                }
+            }
+        }
+        if (n >= 2) {
+            d(n - 1) = S[(n - 2) * n + n - 2];
+            e(n - 1) = S[(n - 1) * n + n - 2];
+        }
+        d(n) = S[(n - 1) * n + n - 1];
+
+        solve_tridiagonal(d, e, isVectors);
+        if (!isVectors) {
+            return;
+        }
+        // vectors = Q*vectors, Q = H(1)*...*H(n-2), applied backward.
+        NumR *Z = math21_memory_tensor_data_address(vectors);
+        std::vector<NumR> w(n);
+        for (NumN k = n >= 2 ? n - 2 : 0; k > 0;) {
+            --k;
+            if (taus[k] == 0) {
+                continue;
+            }
+            // rows k+1, ..., n-1: Z -= tau*v*(v.transpose*Z)
+            for (NumN j = 0; j < n; ++j) {
+                w[j] = Z[(k + 1) * n + j];
+            }
+            for (NumN i = k + 2; i < n; ++i) {
+                NumR v = S[i * n + k];
+                const NumR *z = Z + i * n;
+                for (NumN j = 0; j < n; ++j) {
+                    w[j] += v * z[j];
+                }
+            }
+            for (NumN j = 0; j < n; ++j) {
+                w[j] *= taus[k];
+                Z[(k + 1) * n + j] -= w[j];
+            }
+            for (NumN i = k + 2; i < n; ++i) {
+                NumR v = S[i * n + k];
+                NumR *z = Z + i * n;
+                for (NumN j = 0; j < n; ++j) {
+                    z[j] -= v * w[j];
+                }
+            }
+        }
+    }
+
+    const VecR &SymmetricEigenDecomposition::getValues() const {
+        return values;
+    }
+
+    const MatR &SymmetricEigenDecomposition::getVectors() const {
+        return vectors;
+    }
+}
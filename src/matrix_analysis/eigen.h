@@ -0,0 +1,50 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#pragma once
+
+#include "inner.h"
+
+namespace math21 {
+    /*
+     * Eigen decomposition of symmetric matrix, A = V*diag(values)*V.transpose, values are ascending.
+     * 1. A is reduced to tridiagonal T = Q.transpose*A*Q by Householder reflectors.
+     * 2. T is solved by divide and conquer: T is split into two halves and a rank-one correction,
+     *    halves are solved recursively, and merged by solving the secular equation.
+     *    Eigenvectors of the merge use the corrected z of Gu and Eisenstat, so they stay orthogonal.
+     *    Small blocks and values only are solved by implicit QL.
+     * */
+    class SymmetricEigenDecomposition : public think::Algorithm {
+    private:
+        VecR values;
+        MatR vectors;
+
+    public:
+        SymmetricEigenDecomposition() {
+        }
+
+        // only lower triangle of A is read.
+        void solve(const MatR &A, NumB isVectors = 1);
+
+        // d is diagonal, e is off-diagonal of size n-1.
+        void solve_tridiagonal(const VecR &d, const VecR &e, NumB isVectors = 1);
+
+        const VecR &getValues() const;
+
+        // eigenvectors are columns.
+        const MatR &getVectors() const;
+    };
+}
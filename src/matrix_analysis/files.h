@@ -16,4 +16,9 @@ limitations under the License.
 #pragma once
 
 #include "gje.h"
+#include "triangular.h"
+#include "lu.h"
+#include "cholesky.h"
+#include "qr.h"
+#include "eigen.h"
 #include "svd.h"
\ No newline at end of file
@@ -0,0 +1,184 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#include "../matrix_op/gemm.h"
+#include "triangular.h"
+#include "lu.h"
+
+namespace math21 {
+    namespace detail {
+        // columns factored in a panel.
+        const NumN math21_lu_block_size = 64;
+
+        inline void math21_c_lu_swap_rows(NumN m, NumR *x, NumR *y) {
+            for (NumN j = 0; j < m; ++j) {
+                m21_swap(x[j], y[j]);
+            }
+        }
+
+        // unblocked LU of columns k0, ..., k0+kb-1 of rows k0, ..., n-1.
+        // Rows are swapped in full. Return 0 if a pivot is 0.
+        NumB math21_c_lu_panel(NumN n, NumN k0, NumN kb, NumR *A, NumN *pivots) {
+            NumB isGood = 1;
+            for (NumN j = k0; j < k0 + kb; ++j) {
+                NumN p = j;
+                NumR big = xjabs(A[j * n + j]);
+                for (NumN i = j + 1; i < n; ++i) {
+                    if (xjabs(A[i * n + j]) > big) {
+                        big = xjabs(A[i * n + j]);
+                        p = i;
+                    }
+                }
+                pivots[j] = p;
+                if (p != j) {
+                    math21_c_lu_swap_rows(n, A + j * n, A + p * n);
+                }
+                if (big == 0) {
+                    isGood = 0;
+                    continue;
+                }
+                NumR pivinv = 1 / A[j * n + j];
+                const NumR *u = A + j * n;
+                for (NumN i = j + 1; i < n; ++i) {
+                    NumR *a = A + i * n;
+                    NumR l = a[j] * pivinv;
+                    a[j] = l;
+                    if (l != 0) {
+                        for (NumN k = j + 1; k < k0 + kb; ++k) {
+                            a[k] -= l * u[k];
+                        }
+                    }
+                }
+            }
+            return isGood;
+        }
+    }
+
+    LUDecomposition::LUDecomposition() {
+        sign = 1;
+        isSingular = 0;
+    }
+
+    NumB LUDecomposition::factor(const MatR &A) {
+        MATH21_ASSERT(A.dims() == 2 && A.nrows() == A.ncols(), "A is not square matrix");
+        NumN n = A.nrows();
+        if (!LU.isSameSize(n, n)) {
+            LU.setSize(n, n);
+        }
+        LU.assign(A);
+        pivots.setSize(n);
+        NumR *data = math21_memory_tensor_data_address(LU);
+        NumN *ipiv = math21_memory_tensor_data_address(pivots);
+
+        isSingular = 0;
+        const NumN nb = detail::math21_lu_block_size;
+        for (NumN k0 = 0; k0 < n; k0 += nb) {
+            NumN kb = xjmin(nb, n - k0);
+            if (!detail::math21_c_lu_panel(n, k0, kb, data, ipiv)) {
+                isSingular = 1;
+            }
+            NumN k1 = k0 + kb;
+            if (k1 < n) {
+                // U12 = inverse(L11) * A12
+                math21_c_triangular_solve_lower(1, kb, n - k1, data + k0 * n + k0, n, data + k0 * n + k1, n);
+                // A22 -= L21 * U12
+                math21_c_gemm(0, 0, n - k1, n - k1, kb, -1, data + k1 * n + k0, n, data + k0 * n + k1, n,
+                              1, data + k1 * n + k1, n);
+            }
+        }
+        sign = 1;
+        for (NumN i = 0; i < n; ++i) {
+            ipiv[i] += 1;
+            if (ipiv[i] != i + 1) {
+                sign = -sign;
+            }
+        }
+        return (NumB) !isSingular;
+    }
+
+    NumB LUDecomposition::isFactored() const {
+        return (NumB) !LU.isEmpty();
+    }
+
+    NumN LUDecomposition::size() const {
+        return LU.nrows();
+    }
+
+    void LUDecomposition::solve_c(NumN m, NumR *X) const {
+        NumN n = size();
+        for (NumN i = 1; i <= n; ++i) {
+            if (pivots(i) != i) {
+                detail::math21_c_lu_swap_rows(m, X + (i - 1) * m, X + (pivots(i) - 1) * m);
+            }
+        }
+        const NumR *data = math21_memory_tensor_data_address(LU);
+        math21_c_triangular_solve_lower(1, n, m, data, n, X, m);
+        math21_c_triangular_solve_upper(0, n, m, data, n, X, m);
+    }
+
+    void LUDecomposition::solve(MatR &B) const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        MATH21_ASSERT(!isSingular, "LU decomposition: Singular Matrix");
+        MATH21_ASSERT(B.nrows() == size(), "matrix size doesn't match");
+        if (B.isContinuous() && !B.isColumnMajor()) {
+            solve_c(B.ncols(), math21_memory_tensor_data_address(B));
+        } else {
+            MatR X;
+            X.setSize(B.shape());
+            X.assign(B);
+            solve_c(X.ncols(), math21_memory_tensor_data_address(X));
+            B.assign(X);
+        }
+    }
+
+    void LUDecomposition::solve(const MatR &B, MatR &X) const {
+        if (!math21_operator_container_isEqual(X.shape(), B.shape())) {
+            X.setSize(B.shape());
+        }
+        X.assign(B);
+        solve(X);
+    }
+
+    void LUDecomposition::inverse(MatR &A_inv) const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        NumN n = size();
+        if (!A_inv.isSameSize(n, n)) {
+            A_inv.setSize(n, n);
+        }
+        A_inv = 0;
+        for (NumN i = 1; i <= n; ++i) {
+            A_inv(i, i) = 1;
+        }
+        solve(A_inv);
+    }
+
+    NumR LUDecomposition::determinant() const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        NumR det = sign;
+        for (NumN i = 1; i <= size(); ++i) {
+            det *= LU(i, i);
+        }
+        return det;
+    }
+
+    const MatR &LUDecomposition::getLU() const {
+        return LU;
+    }
+
+    const VecN &LUDecomposition::getPivots() const {
+        return pivots;
+    }
+}
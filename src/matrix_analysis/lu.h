@@ -0,0 +1,63 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#pragma once
+
+#include "inner.h"
+
+namespace math21 {
+    /*
+     * LU decomposition with partial pivoting, P*A = L*U, A is square.
+     * Factor once, then solve for any number of right-hand sides.
+     * Factorization is blocked and right-looking: a panel of columns is factored,
+     * and the trailing matrix is updated by one gemm per panel.
+     * L (unit diagonal, not stored) and U share the storage of LU.
+     * */
+    class LUDecomposition : public think::Algorithm {
+    private:
+        MatR LU;
+        VecN pivots; // row i was swapped with row pivots(i) at step i.
+        NumZ sign; // sign of permutation
+        NumB isSingular;
+
+        void solve_c(NumN m, NumR *X) const;
+
+    public:
+        LUDecomposition();
+
+        // return 0 if A is singular.
+        NumB factor(const MatR &A);
+
+        NumB isFactored() const;
+
+        NumN size() const;
+
+        // solve A*X=B, B can be vector.
+        void solve(const MatR &B, MatR &X) const;
+
+        // solve A*X=B, B will become X.
+        void solve(MatR &B) const;
+
+        void inverse(MatR &A_inv) const;
+
+        NumR determinant() const;
+
+        // L below diagonal, U on and above diagonal.
+        const MatR &getLU() const;
+
+        const VecN &getPivots() const;
+    };
+}
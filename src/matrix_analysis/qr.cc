@@ -0,0 +1,328 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#include <limits>
+#include "../matrix_op/gemm.h"
+#include "triangular.h"
+#include "qr.h"
+
+namespace math21 {
+    namespace detail {
+        // columns reduced in a panel.
+        const NumN math21_qr_block_size = 32;
+
+        // V of panel, mv*kb, with unit diagonal and zero upper triangle.
+        void math21_c_qr_get_V(NumN n, NumN k0, NumN mv, NumN kb, const NumR *A, NumR *V) {
+            for (NumN r = 0; r < mv; ++r) {
+                const NumR *a = A + (k0 + r) * n + k0;
+                for (NumN c = 0; c < kb; ++c) {
+                    V[r * kb + c] = r > c ? a[c] : (r == c ? 1 : 0);
+                }
+            }
+        }
+
+        // C = (I - V*op(T)*V.transpose)*C, op(T) is T.transpose if isTrans. T is kb*kb with row stride ldt.
+        void math21_c_qr_apply_block(NumB isTrans, NumN mv, NumN kb, const NumR *V, const NumR *T, NumN ldt,
+                                     NumN nc, NumR *C, NumN ldc, std::vector<NumR> &W) {
+            if (nc == 0) {
+                return;
+            }
+            W.resize(kb * nc);
+            // W = V.transpose * C
+            math21_c_gemm(1, 0, kb, nc, mv, 1, V, kb, C, ldc, 0, W.data(), nc);
+            // W = op(T) * W, in place.
+            if (isTrans) {
+                for (NumN i = kb; i > 0;) {
+                    --i;
+                    NumR *w = W.data() + i * nc;
+                    for (NumN j = 0; j < nc; ++j) {
+                        w[j] *= T[i * ldt + i];
+                    }
+                    for (NumN c = 0; c < i; ++c) {
+                        NumR t = T[c * ldt + i];
+                        const NumR *w_c = W.data() + c * nc;
+                        for (NumN j = 0; j < nc; ++j) {
+                            w[j] += t * w_c[j];
+                        }
+                    }
+                }
+            } else {
+                for (NumN i = 0; i < kb; ++i) {
+                    NumR *w = W.data() + i * nc;
+                    for (NumN j = 0; j < nc; ++j) {
+                        w[j] *= T[i * ldt + i];
+                    }
+                    for (NumN c = i + 1; c < kb; ++c) {
+                        NumR t = T[i * ldt + c];
+                        const NumR *w_c = W.data() + c * nc;
+                        for (NumN j = 0; j < nc; ++j) {
+                            w[j] += t * w_c[j];
+                        }
+                    }
+                }
+            }
+            // C -= V * W
+            math21_c_gemm(0, 0, mv, nc, kb, -1, V, kb, W.data(), nc, 1, C, ldc);
+        }
+
+        // unblocked Householder QR of columns k0, ..., k0+kb-1 of rows k0, ..., m-1.
+        void math21_c_qr_panel(NumN m, NumN n, NumN k0, NumN kb, NumR *A, NumR *tau) {
+            std::vector<NumR> w(kb);
+            for (NumN j = k0; j < k0 + kb; ++j) {
+                NumR alpha = A[j * n + j];
+                NumR xnorm2 = 0;
+                for (NumN i = j + 1; i < m; ++i) {
+                    xnorm2 += A[i * n + j] * A[i * n + j];
+                }
+                if (xnorm2 == 0) {
+                    tau[j] = 0;
+                    continue;
+                }
+                NumR beta = xjsqrt(alpha * alpha + xnorm2);
+                if (alpha > 0) {
+                    beta = -beta;
+                }
+                tau[j] = (beta - alpha) / beta;
+                NumR scale = 1 / (alpha - beta);
+                for (NumN i = j + 1; i < m; ++i) {
+                    A[i * n + j] *= scale;
+                }
+                A[j * n + j] = beta;
+
+                // H = I - tau*v*v.transpose on rest columns of panel, row by row.
+                NumN c0 = j + 1;
+                NumN c1 = k0 + kb;
+                if (c0 == c1) {
+                    continue;
+                }
+                for (NumN c = c0; c < c1; ++c) {
+                    w[c - c0] = A[j * n + c];
+                }
+                for (NumN i = j + 1; i < m; ++i) {
+                    NumR v = A[i * n + j];
+                    const NumR *a = A + i * n;
+                    for (NumN c = c0; c < c1; ++c) {
+                        w[c - c0] += v * a[c];
+                    }
+                }
+                for (NumN c = c0; c < c1; ++c) {
+                    w[c - c0] *= tau[j];
+                    A[j * n + c] -= w[c - c0];
+                }
+                for (NumN i = j + 1; i < m; ++i) {
+                    NumR v = A[i * n + j];
+                    NumR *a = A + i * n;
+                    for (NumN c = c0; c < c1; ++c) {
+                        a[c] -= v * w[c - c0];
+                    }
+                }
+            }
+        }
+
+        // T of compact WY form, H(1)*...*H(kb) = I - V*T*V.transpose, T is upper triangular.
+        void math21_c_qr_get_T(NumN mv, NumN kb, const NumR *V, const NumR *tau, NumR *T, NumN ldt) {
+            std::vector<NumR> t(kb);
+            for (NumN i = 0; i < kb; ++i) {
+                for (NumN c = 0; c < i; ++c) {
+                    t[c] = 0;
+                }
+                // t = V(:, 0:i).transpose * v_i
+                for (NumN r = i; r < mv; ++r) {
+                    NumR v_i = V[r * kb + i];
+                    const NumR *v = V + r * kb;
+                    for (NumN c = 0; c < i; ++c) {
+                        t[c] += v[c] * v_i;
+                    }
+                }
+                // T(0:i, i) = -tau_i * T(0:i, 0:i) * t
+                for (NumN r = 0; r < i; ++r) {
+                    NumR sum = 0;
+                    for (NumN c = r; c < i; ++c) {
+                        sum += T[r * ldt + c] * t[c];
+                    }
+                    T[r * ldt + i] = -tau[i] * sum;
+                }
+                T[i * ldt + i] = tau[i];
+            }
+        }
+    }
+
+    QRDecomposition::QRDecomposition() {
+    }
+
+    void QRDecomposition::factor(const MatR &A) {
+        MATH21_ASSERT(A.dims() == 2 && !A.isEmpty(), "A is not matrix");
+        NumN m = A.nrows();
+        NumN n = A.ncols();
+        MATH21_ASSERT(m >= n, "QR decomposition needs m >= n");
+        if (!QR.isSameSize(m, n)) {
+            QR.setSize(m, n);
+        }
+        QR.assign(A);
+        tau.setSize(n);
+        NumR *data = math21_memory_tensor_data_address(QR);
+        NumR *tau_data = math21_memory_tensor_data_address(tau);
+
+        const NumN nb = detail::math21_qr_block_size;
+        NumN n_panels = (n + nb - 1) / nb;
+        Ts.assign(n_panels * nb * nb, 0);
+        std::vector<NumR> V, W;
+        for (NumN p = 0; p < n_panels; ++p) {
+            NumN k0 = p * nb;
+            NumN kb = xjmin(nb, n - k0);
+            NumN mv = m - k0;
+            detail::math21_c_qr_panel(m, n, k0, kb, data, tau_data);
+            V.resize(mv * kb);
+            detail::math21_c_qr_get_V(n, k0, mv, kb, data, V.data());
+            NumR *T = Ts.data() + p * nb * nb;
+            detail::math21_c_qr_get_T(mv, kb, V.data(), tau_data + k0, T, nb);
+            // A22 = Q_panel.transpose * A22
+            detail::math21_c_qr_apply_block(1, mv, kb, V.data(), T, nb,
+                                            n - k0 - kb, data + k0 * n + k0 + kb, n, W);
+        }
+    }
+
+    NumB QRDecomposition::isFactored() const {
+        return (NumB) !QR.isEmpty();
+    }
+
+    NumB QRDecomposition::isFullRank() const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        NumN n = QR.ncols();
+        NumR r_max = 0;
+        for (NumN i = 1; i <= n; ++i) {
+            r_max = xjmax(r_max, xjabs(QR(i, i)));
+        }
+        NumR tol = QR.nrows() * std::numeric_limits<NumR>::epsilon() * r_max;
+        for (NumN i = 1; i <= n; ++i) {
+            if (xjabs(QR(i, i)) <= tol) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    // C = Q*C or Q.transpose*C, C is m*nc.
+    void QRDecomposition::applyQ(NumB isTrans, NumN nc, NumR *C, NumN ldc) const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        NumN m = QR.nrows();
+        NumN n = QR.ncols();
+        const NumR *data = math21_memory_tensor_data_address(QR);
+        const NumN nb = detail::math21_qr_block_size;
+        NumN n_panels = (n + nb - 1) / nb;
+        std::vector<NumR> V, W;
+        for (NumN l = 0; l < n_panels; ++l) {
+            // Q.transpose = H(n)*...*H(1), so panels are applied in order, and backward for Q.
+            NumN p = isTrans ? l : n_panels - 1 - l;
+            NumN k0 = p * nb;
+            NumN kb = xjmin(nb, n - k0);
+            NumN mv = m - k0;
+            V.resize(mv * kb);
+            detail::math21_c_qr_get_V(n, k0, mv, kb, data, V.data());
+            detail::math21_c_qr_apply_block(isTrans, mv, kb, V.data(), Ts.data() + p * nb * nb, nb,
+                                            nc, C + k0 * ldc, ldc, W);
+        }
+    }
+
+    void QRDecomposition::multiplyQTrans(MatR &B) const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        MATH21_ASSERT(B.nrows() == QR.nrows(), "matrix size doesn't match");
+        if (B.isContinuous() && !B.isColumnMajor()) {
+            applyQ(1, B.ncols(), math21_memory_tensor_data_address(B), B.ncols());
+        } else {
+            MatR C;
+            C.setSize(B.shape());
+            C.assign(B);
+            applyQ(1, C.ncols(), math21_memory_tensor_data_address(C), C.ncols());
+            B.assign(C);
+        }
+    }
+
+    void QRDecomposition::multiplyQ(MatR &B) const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        MATH21_ASSERT(B.nrows() == QR.nrows(), "matrix size doesn't match");
+        if (B.isContinuous() && !B.isColumnMajor()) {
+            applyQ(0, B.ncols(), math21_memory_tensor_data_address(B), B.ncols());
+        } else {
+            MatR C;
+            C.setSize(B.shape());
+            C.assign(B);
+            applyQ(0, C.ncols(), math21_memory_tensor_data_address(C), C.ncols());
+            B.assign(C);
+        }
+    }
+
+    void QRDecomposition::solve(const MatR &B, MatR &X) const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        MATH21_ASSERT(isFullRank(), "QR decomposition: columns are dependent");
+        NumN m = QR.nrows();
+        NumN n = QR.ncols();
+        MATH21_ASSERT(B.nrows() == m, "matrix size doesn't match");
+        NumN k = B.ncols();
+        MatR C;
+        C.setSize(m, k);
+        math21_operator_container_set(B, C);
+        NumR *C_data = math21_memory_tensor_data_address(C);
+        applyQ(1, k, C_data, k);
+        math21_c_triangular_solve_upper(0, n, k, math21_memory_tensor_data_address(QR), n, C_data, k);
+        if (B.dims() == 1) {
+            if (!X.isSameSize(n)) {
+                X.setSize(n);
+            }
+            for (NumN i = 1; i <= n; ++i) {
+                X(i) = C(i, 1);
+            }
+            return;
+        }
+        if (!X.isSameSize(n, k)) {
+            X.setSize(n, k);
+        }
+        for (NumN i = 1; i <= n; ++i) {
+            for (NumN j = 1; j <= k; ++j) {
+                X(i, j) = C(i, j);
+            }
+        }
+    }
+
+    void QRDecomposition::getQ(MatR &Q, NumB isThin) const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        NumN m = QR.nrows();
+        NumN k = isThin ? QR.ncols() : m;
+        MatR C(m, k);
+        C = 0;
+        for (NumN i = 1; i <= k; ++i) {
+            C(i, i) = 1;
+        }
+        applyQ(0, k, math21_memory_tensor_data_address(C), k);
+        if (!Q.isSameSize(m, k)) {
+            Q.setSize(m, k);
+        }
+        Q.assign(C);
+    }
+
+    void QRDecomposition::getR(MatR &R) const {
+        MATH21_ASSERT(isFactored(), "call factor() first");
+        NumN n = QR.ncols();
+        if (!R.isSameSize(n, n)) {
+            R.setSize(n, n);
+        }
+        for (NumN i = 1; i <= n; ++i) {
+            for (NumN j = 1; j <= n; ++j) {
+                R(i, j) = j >= i ? QR(i, j) : 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#pragma once
+
+#include <vector>
+#include "inner.h"
+
+namespace math21 {
+    /*
+     * Householder QR decomposition A = Q*R, A is m*n, m >= n.
+     * Factorization is blocked: a panel of columns is reduced by Householder reflectors,
+     * which are kept as the compact WY form I - V*T*V.transpose, and applied to the trailing
+     * matrix and to right-hand sides by gemm, see gemm.h.
+     * V (unit diagonal, not stored) and R share the storage of QR.
+     * solve gives least squares solution, and doesn't form normal equations.
+     * */
+    class QRDecomposition : public think::Algorithm {
+    private:
+        MatR QR;
+        VecR tau;
+        std::vector<NumR> Ts; // T of panels, nb*nb each.
+
+        void applyQ(NumB isTrans, NumN nc, NumR *C, NumN ldc) const;
+
+    public:
+        QRDecomposition();
+
+        void factor(const MatR &A);
+
+        NumB isFactored() const;
+
+        // return 0 if R has diagonal of zero up to rounding, i.e., columns of A are dependent.
+        NumB isFullRank() const;
+
+        // X minimizes |A*X - B|, B is m*k or vector, X is n*k or vector.
+        void solve(const MatR &B, MatR &X) const;
+
+        // thin: Q is m*n, else Q is m*m.
+        void getQ(MatR &Q, NumB isThin = 1) const;
+
+        // R is n*n.
+        void getR(MatR &R) const;
+
+        // B = Q.transpose*B, B is m*k.
+        void multiplyQTrans(MatR &B) const;
+
+        // B = Q*B, B is m*k.
+        void multiplyQ(MatR &B) const;
+    };
+}
@@ -0,0 +1,447 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include "../matrix_op/gemm.h"
+#include "../probability/files.h"
+#include "qr.h"
+#include "svd.h"
+
+namespace math21 {
+    namespace detail {
+        const NumN math21_svd_max_sweeps = 60;
+
+        inline NumR math21_c_svd_dot(NumN m, const NumR *x, const NumR *y) {
+            NumR sum = 0;
+            for (NumN j = 0; j < m; ++j) {
+                sum += x[j] * y[j];
+            }
+            return sum;
+        }
+
+        // x, y = c*x - s*y, s*x + c*y
+        inline void math21_c_svd_rotate(NumN m, NumR c, NumR s, NumR *x, NumR *y) {
+            for (NumN j = 0; j < m; ++j) {
+                NumR a = x[j];
+                NumR b = y[j];
+                x[j] = c * a - s * b;
+                y[j] = s * a + c * b;
+            }
+        }
+
+        // x -= (x.q)*q for every good row q of Q, twice for stability.
+        void math21_c_svd_orthogonalize(NumN m, NumR *x, NumN n_rows, const NumR *Q, const std::vector<NumB> &isGood) {
+            for (NumN l = 0; l < 2; ++l) {
+                for (NumN i = 0; i < n_rows; ++i) {
+                    if (!isGood[i] || Q + i * m == x) {
+                        continue;
+                    }
+                    NumR a = math21_c_svd_dot(m, x, Q + i * m);
+                    for (NumN j = 0; j < m; ++j) {
+                        x[j] -= a * Q[i * m + j];
+                    }
+                }
+            }
+        }
+
+        // rows of W are rotated pairwise until orthogonal, W is n*m, rotations are also applied to Vt, n*n.
+        void math21_c_svd_jacobi(NumN n, NumN m, NumR *W, NumR *Vt) {
+            if (n < 2) {
+                return;
+            }
+            const NumR eps = std::numeric_limits<NumR>::epsilon();
+            // round-robin order, with a dummy row if n is odd.
+            NumN n_even = n + n % 2;
+            std::vector<NumN> players(n_even);
+            for (NumN i = 0; i < n_even; ++i) {
+                players[i] = i;
+            }
+            // squared norms of rows, updated by rotations, and computed again every sweep.
+            std::vector<NumR> norms(n);
+            for (NumN sweep = 0; sweep < math21_svd_max_sweeps; ++sweep) {
+                for (NumN i = 0; i < n; ++i) {
+                    norms[i] = math21_c_svd_dot(m, W + i * m, W + i * m);
+                }
+                NumN n_rotations = 0;
+                for (NumN round = 0; round + 1 < n_even; ++round) {
+#pragma omp parallel for reduction(+:n_rotations)
+                    for (NumN l = 0; l < n_even / 2; ++l) {
+                        NumN i = players[l];
+                        NumN j = players[n_even - 1 - l];
+                        if (i >= n || j >= n) {
+                            continue;
+                        }
+                        NumR *x = W + i * m;
+                        NumR *y = W + j * m;
+                        NumR alpha = norms[i];
+                        NumR beta = norms[j];
+                        NumR gamma = math21_c_svd_dot(m, x, y);
+                        if (gamma == 0 || xjabs(gamma) <= eps * xjsqrt(alpha * beta)) {
+                            continue;
+                        }
+                        NumR zeta = (beta - alpha) / (2 * gamma);
+                        NumR t = (zeta >= 0 ? 1 : -1) / (xjabs(zeta) + xjsqrt(1 + zeta * zeta));
+                        NumR c = 1 / xjsqrt(1 + t * t);
+                        NumR s = c * t;
+                        math21_c_svd_rotate(m, c, s, x, y);
+                        math21_c_svd_rotate(n, c, s, Vt + i * n, Vt + j * n);
+                        norms[i] = alpha - t * gamma;
+                        norms[j] = beta + t * gamma;
+                        ++n_rotations;
+                    }
+                    // first player is fixed, others rotate.
+                    NumN last = players[n_even - 1];
+                    for (NumN l = n_even - 1; l > 1; --l) {
+                        players[l] = players[l - 1];
+                    }
+                    players[1] = last;
+                }
+                if (n_rotations == 0) {
+                    break;
+                }
+            }
+        }
+
+        /*
+         * rows of Q which aren't good are replaced by orthonormal rows in the complement of good ones.
+         * C = I - Q.transpose*Q projects to the complement, and the next row is its column of
+         * the largest norm, normalized. Then C -= x*x.transpose.
+         * */
+        void math21_c_svd_complete(NumN n_rows, NumN m, NumR *Q, std::vector<NumB> &isGood) {
+            NumN n_bad = 0;
+            for (NumN i = 0; i < n_rows; ++i) {
+                if (!isGood[i]) {
+                    for (NumN j = 0; j < m; ++j) {
+                        Q[i * m + j] = 0;
+                    }
+                    ++n_bad;
+                }
+            }
+            if (n_bad == 0) {
+                return;
+            }
+            std::vector<NumR> C(m * m, 0);
+            for (NumN j = 0; j < m; ++j) {
+                C[j * m + j] = 1;
+            }
+            math21_c_gemm(1, 0, m, m, n_rows, -1, Q, m, Q, m, 1, C.data(), m);
+            for (NumN i = 0; i < n_rows; ++i) {
+                if (isGood[i]) {
+                    continue;
+                }
+                NumN p = 0;
+                for (NumN j = 1; j < m; ++j) {
+                    if (C[j * m + j] > C[p * m + p]) {
+                        p = j;
+                    }
+                }
+                MATH21_ASSERT(C[p * m + p] > 0, "can't complete orthonormal basis");
+                NumR *x = Q + i * m;
+                for (NumN j = 0; j < m; ++j) {
+                    x[j] = C[p * m + j];
+                }
+                math21_c_svd_orthogonalize(m, x, n_rows, Q, isGood);
+                NumR norm = xjsqrt(math21_c_svd_dot(m, x, x));
+                for (NumN j = 0; j < m; ++j) {
+                    x[j] /= norm;
+                }
+                for (NumN j1 = 0; j1 < m; ++j1) {
+                    for (NumN j2 = 0; j2 < m; ++j2) {
+                        C[j1 * m + j2] -= x[j1] * x[j2];
+                    }
+                }
+                isGood[i] = 1;
+            }
+        }
+
+        // rows of Q are orthonormalized in order, rows in range of previous ones become zero.
+        void math21_c_svd_orthonormalize(NumN n_rows, NumN m, NumR *Q) {
+            std::vector<NumB> isGood(n_rows, 0);
+            for (NumN i = 0; i < n_rows; ++i) {
+                NumR *x = Q + i * m;
+                NumR norm0 = xjsqrt(math21_c_svd_dot(m, x, x));
+                math21_c_svd_orthogonalize(m, x, i, Q, isGood);
+                NumR norm = xjsqrt(math21_c_svd_dot(m, x, x));
+                if (norm > 0 && norm > norm0 * m * std::numeric_limits<NumR>::epsilon()) {
+                    for (NumN j = 0; j < m; ++j) {
+                        x[j] /= norm;
+                    }
+                    isGood[i] = 1;
+                } else {
+                    for (NumN j = 0; j < m; ++j) {
+                        x[j] = 0;
+                    }
+                }
+            }
+        }
+
+        // B = A.transpose, A is n*m.
+        void math21_c_svd_trans(NumN n, NumN m, const NumR *A, NumR *B) {
+            for (NumN i = 0; i < n; ++i) {
+                for (NumN j = 0; j < m; ++j) {
+                    B[j * n + i] = A[i * m + j];
+                }
+            }
+        }
+
+        /*
+         * Jacobi svd of T, T.transpose is given as W, nt*mt, mt >= nt, and W is overwritten.
+         * Ut is k_u*mt, k_u = nt or mt, rows are left singular vectors. Vt is nt*nt. S is nt.
+         * */
+        void math21_c_svd_jacobi_solve(NumN nt, NumN mt, NumR *W, NumN k_u, NumR *Ut, NumR *Vt, NumR *S) {
+            std::vector<NumR> V0(nt * nt, 0);
+            for (NumN i = 0; i < nt; ++i) {
+                V0[i * nt + i] = 1;
+            }
+            math21_c_svd_jacobi(nt, mt, W, V0.data());
+
+            std::vector<NumR> norms(nt);
+            std::vector<NumN> order(nt);
+            for (NumN i = 0; i < nt; ++i) {
+                norms[i] = xjsqrt(math21_c_svd_dot(mt, W + i * mt, W + i * mt));
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&norms](NumN a, NumN b) {
+                return norms[a] > norms[b];
+            });
+            NumR tol = nt == 0 ? 0 : norms[order[0]] * mt * std::numeric_limits<NumR>::epsilon();
+            std::vector<NumB> isGood(k_u, 0);
+            for (NumN i = 0; i < nt; ++i) {
+                NumN i0 = order[i];
+                S[i] = norms[i0];
+                for (NumN j = 0; j < nt; ++j) {
+                    Vt[i * nt + j] = V0[i0 * nt + j];
+                }
+                NumR *u = Ut + i * mt;
+                if (norms[i0] > tol && norms[i0] > 0) {
+                    for (NumN j = 0; j < mt; ++j) {
+                        u[j] = W[i0 * mt + j] / norms[i0];
+                    }
+                    isGood[i] = 1;
+                }
+            }
+            math21_c_svd_complete(k_u, mt, Ut, isGood);
+        }
+    }
+
+    void svd::solve(const MatR &A, NumB isThin) {
+        MATH21_ASSERT(A.dims() == 2 && !A.isEmpty(), "A is not matrix");
+        NumN m = A.nrows();
+        NumN n = A.ncols();
+        NumB isTrans = m < n ? (NumB) 1 : (NumB) 0;
+        // T = A or A.transpose, mt*nt, mt >= nt.
+        NumN mt = isTrans ? n : m;
+        NumN nt = isTrans ? m : n;
+        NumN k_u = isThin ? nt : mt;
+
+        // W = T.transpose, so columns of T are rows.
+        std::vector<NumR> W(nt * mt);
+        MatR A_c;
+        const NumR *A_data;
+        if (A.isContinuous() && !A.isColumnMajor()) {
+            A_data = math21_memory_tensor_data_address(A);
+        } else {
+            A_c.setSize(m, n);
+            A_c.assign(A);
+            A_data = math21_memory_tensor_data_address((const MatR &) A_c);
+        }
+        if (isTrans) {
+            std::copy(A_data, A_data + m * n, W.begin());
+        } else {
+            detail::math21_c_svd_trans(m, n, A_data, W.data());
+        }
+
+        MatR &U_T = isTrans ? V : U;
+        MatR &V_T = isTrans ? U : V;
+        std::vector<NumR> Vt(nt * nt);
+        S.setSize(nt);
+        if (mt >= 2 * nt) {
+            // T = Q*R, and R is solved, so rotations run on rows of length nt instead of mt.
+            MatR T(mt, nt);
+            detail::math21_c_svd_trans(nt, mt, W.data(), math21_memory_tensor_data_address(T));
+            QRDecomposition qr;
+            qr.factor(T);
+            MatR R;
+            qr.getR(R);
+            std::vector<NumR> W_R(nt * nt), Ut_R(nt * nt);
+            detail::math21_c_svd_trans(nt, nt, math21_memory_tensor_data_address((const MatR &) R), W_R.data());
+            detail::math21_c_svd_jacobi_solve(nt, nt, W_R.data(), nt, Ut_R.data(), Vt.data(),
+                                              math21_memory_tensor_data_address(S));
+            // U_T = Q*diag(U_R, I)
+            U_T.setSize(mt, k_u);
+            U_T = 0;
+            for (NumN i = 1; i <= nt; ++i) {
+                for (NumN j = 1; j <= nt; ++j) {
+                    U_T(i, j) = Ut_R[(j - 1) * nt + (i - 1)];
+                }
+            }
+            for (NumN i = nt + 1; i <= k_u; ++i) {
+                U_T(i, i) = 1;
+            }
+            qr.multiplyQ(U_T);
+        } else {
+            std::vector<NumR> Ut(k_u * mt);
+            detail::math21_c_svd_jacobi_solve(nt, mt, W.data(), k_u, Ut.data(), Vt.data(),
+                                              math21_memory_tensor_data_address(S));
+            U_T.setSize(mt, k_u);
+            detail::math21_c_svd_trans(k_u, mt, Ut.data(), math21_memory_tensor_data_address(U_T));
+        }
+
+        // T = U_T*S*V_T.transpose, A = T or T.transpose.
+        V_T.setSize(nt, nt);
+        detail::math21_c_svd_trans(nt, nt, Vt.data(), math21_memory_tensor_data_address(V_T));
+    }
+
+    void svd::solve_randomized(const MatR &A, NumN k, NumN p, NumN q, NumN seed) {
+        MATH21_ASSERT(A.dims() == 2 && !A.isEmpty(), "A is not matrix");
+        NumN m = A.nrows();
+        NumN n = A.ncols();
+        MATH21_ASSERT(k >= 1 && k <= xjmin(m, n), "k must be in [1, min(m, n)]");
+        NumN l = xjmin(k + p, xjmin(m, n));
+
+        MatR A_c;
+        const NumR *A_data;
+        if (A.isContinuous() && !A.isColumnMajor()) {
+            A_data = math21_memory_tensor_data_address(A);
+        } else {
+            A_c.setSize(m, n);
+            A_c.assign(A);
+            A_data = math21_memory_tensor_data_address((const MatR &) A_c);
+        }
+
+        // Qt = (A*Omega).transpose = Omega.transpose*A.transpose, l*m.
+        DefaultRandomEngine engine(seed);
+        RanNormal ran(engine);
+        MatR Omega_t(l, n);
+        math21_random_draw(Omega_t, ran);
+        std::vector<NumR> Qt(l * m), Zt(l * n);
+        math21_c_gemm(0, 1, l, m, n, 1, math21_memory_tensor_data_address((const MatR &) Omega_t), n,
+                      A_data, n, 0, Qt.data(), m);
+        detail::math21_c_svd_orthonormalize(l, m, Qt.data());
+        for (NumN i = 0; i < q; ++i) {
+            // Zt = Qt*A, Qt = Zt*A.transpose
+            math21_c_gemm(0, 0, l, n, m, 1, Qt.data(), m, A_data, n, 0, Zt.data(), n);
+            detail::math21_c_svd_orthonormalize(l, n, Zt.data());
+            math21_c_gemm(0, 1, l, m, n, 1, Zt.data(), n, A_data, n, 0, Qt.data(), m);
+            detail::math21_c_svd_orthonormalize(l, m, Qt.data());
+        }
+        // B = Q.transpose*A, l*n, l <= n, B = U_B*S*V_B.transpose, and W = B.
+        std::vector<NumR> W(l * n);
+        math21_c_gemm(0, 0, l, n, m, 1, Qt.data(), m, A_data, n, 0, W.data(), n);
+        std::vector<NumR> U_Bt(l * l), V_Bt(l * n);
+        VecR S_all(l);
+        detail::math21_c_svd_jacobi_solve(l, n, W.data(), l, V_Bt.data(), U_Bt.data(),
+                                          math21_memory_tensor_data_address(S_all));
+
+        // U = Q*U_B, first k columns.
+        S.setSize(k);
+        for (NumN i = 1; i <= k; ++i) {
+            S(i) = S_all(i);
+        }
+        U.setSize(m, k);
+        V.setSize(n, k);
+        std::vector<NumR> U_B(l * k);
+        for (NumN i = 0; i < l; ++i) {
+            for (NumN j = 0; j < k; ++j) {
+                U_B[i * k + j] = U_Bt[j * l + i];
+            }
+        }
+        math21_c_gemm(1, 0, m, k, l, 1, Qt.data(), m, U_B.data(), k, 0, math21_memory_tensor_data_address(U), k);
+        detail::math21_c_svd_trans(k, n, V_Bt.data(), math21_memory_tensor_data_address(V));
+    }
+
+    const MatR &svd::getU() const {
+        return U;
+    }
+
+    const VecR &svd::getS() const {
+        return S;
+    }
+
+    const MatR &svd::getV() const {
+        return V;
+    }
+
+    NumN svd::rank(NumR tol) const {
+        MATH21_ASSERT(!S.isEmpty(), "call solve() first");
+        if (tol < 0) {
+            tol = xjmax(U.nrows(), V.nrows()) * std::numeric_limits<NumR>::epsilon() * S(1);
+        }
+        NumN r = 0;
+        for (NumN i = 1; i <= S.size(); ++i) {
+            if (S(i) > tol) {
+                ++r;
+            }
+        }
+        return r;
+    }
+
+    void svd::approximate(NumN k, MatR &A_k) const {
+        MATH21_ASSERT(!S.isEmpty(), "call solve() first");
+        MATH21_ASSERT(k >= 1 && k <= S.size());
+        NumN m = U.nrows();
+        NumN n = V.nrows();
+        MatR US(m, k);
+        for (NumN i = 1; i <= m; ++i) {
+            for (NumN j = 1; j <= k; ++j) {
+                US(i, j) = U(i, j) * S(j);
+            }
+        }
+        MatR V_k(n, k);
+        for (NumN i = 1; i <= n; ++i) {
+            for (NumN j = 1; j <= k; ++j) {
+                V_k(i, j) = V(i, j);
+            }
+        }
+        if (!A_k.isSameSize(m, n)) {
+            A_k.setSize(m, n);
+        }
+        MATH21_ASSERT(A_k.isContinuous() && !A_k.isColumnMajor());
+        math21_c_gemm(0, 1, m, n, k, 1, math21_memory_tensor_data_address((const MatR &) US), k,
+                      math21_memory_tensor_data_address((const MatR &) V_k), k,
+                      0, math21_memory_tensor_data_address(A_k), n);
+    }
+
+    void svd::pseudoInverse(MatR &A_pinv, NumR tol) const {
+        NumN r = rank(tol);
+        NumN m = U.nrows();
+        NumN n = V.nrows();
+        if (!A_pinv.isSameSize(n, m)) {
+            A_pinv.setSize(n, m);
+        }
+        MATH21_ASSERT(A_pinv.isContinuous() && !A_pinv.isColumnMajor());
+        if (r == 0) {
+            A_pinv = 0;
+            return;
+        }
+        MatR VS(n, r), U_r(m, r);
+        for (NumN i = 1; i <= n; ++i) {
+            for (NumN j = 1; j <= r; ++j) {
+                VS(i, j) = V(i, j) / S(j);
+            }
+        }
+        for (NumN i = 1; i <= m; ++i) {
+            for (NumN j = 1; j <= r; ++j) {
+                U_r(i, j) = U(i, j);
+            }
+        }
+        math21_c_gemm(0, 1, n, m, r, 1, math21_memory_tensor_data_address((const MatR &) VS), r,
+                      math21_memory_tensor_data_address((const MatR &) U_r), r,
+                      0, math21_memory_tensor_data_address(A_pinv), m);
+    }
+}
@@ -13,70 +13,53 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+
 #pragma once
 
 #include "inner.h"
 
 namespace math21 {
-    // svd
+    /*
+     * Singular value decomposition A = U*diag(S)*V.transpose, A is m*n, k = min(m, n).
+     * S is in descending order.
+     * 1. solve: one-sided Jacobi on rows of A.transpose (or A if m < n), accurate to small singular values.
+     *    Rotations of a round of the round-robin order touch disjoint rows, so they run in parallel,
+     *    and the result doesn't depend on thread number.
+     *    If A is tall, i.e., max(m, n) >= 2*k, R of its QR decomposition is solved instead, see QRDecomposition.
+     *    Thin: U is m*k, V is n*k. Full: U is m*m, V is n*n.
+     * 2. solve_randomized: rank k approximation, U is m*k, V is n*k.
+     *    Range of A is sampled by A*Omega with k+p gaussian columns and q power iterations,
+     *    then the small matrix Q.transpose*A is solved. Fast when k is much smaller than m and n.
+     * Columns of U and V for zero singular values are completed to orthonormal ones.
+     * */
     class svd : public think::Algorithm {
+    private:
+        MatR U;
+        VecR S;
+        MatR V;
 
     public:
         svd() {
         }
 
-        //A*(X,Y)=(B,I), A will become Y, B will become X.
-        void solve(MatR &A, MatR &B) {
-            MATH21_ASSERT(A.nrows() == A.ncols());
-            NumN i, icol, irow, j, k, l, ll, n = A.nrows(), m = B.ncols();
-            NumR big, dum, pivinv;
-            ArrayN index_c(n), index_r(n), ipiv(n);
-            for (j = 1; j <= n; j++) ipiv(j) = 0;
-            for (i = 1; i <= n; i++) {
-                big = 0.0;
-                for (j = 1; j <= n; j++)
-                    if (ipiv(j) != 1)
-                        for (k = 1; k <= n; k++) {
-                            if (ipiv(k) == 0) {
-                                if (xjabs(A(j, k)) >= big) {
-                                    big = xjabs(A(j, k));
-                                    irow = j;
-                                    icol = k;
-                                }
-                            }
-                        }
-                ++(ipiv(icol));
-                if (irow != icol) {
-                    for (l = 1; l <= n; l++) m21_swap(A(irow, l), A(icol, l));
-                    for (l = 1; l <= m; l++) m21_swap(B(irow, l), B(icol, l));
-                }
-                index_r(i) = irow;
-                index_c(i) = icol;
-                if (A(icol, icol) == 0.0) MATH21_ASSERT(0, "Gauss-Jordan elimination: Singular Matrix");
-                pivinv = 1.0 / A(icol, icol);
-                A(icol, icol) = 1.0;
-                for (l = 1; l <= n; l++) A(icol, l) *= pivinv;
-                for (l = 1; l <= m; l++) B(icol, l) *= pivinv;
-                for (ll = 1; ll <= n; ll++)
-                    if (ll != icol) {
-                        dum = A(ll, icol);
-                        A(ll, icol) = 0.0;
-                        for (l = 1; l <= n; l++) A(ll, l) -= A(icol, l) * dum;
-                        for (l = 1; l <= m; l++) B(ll, l) -= B(icol, l) * dum;
-                    }
-            }
-            for (l = n; l >= 1; l--) {
-                if (index_r(l) != index_c(l))
-                    for (k = 1; k <= n; k++)
-                        m21_swap(A(k, index_r(l)), A(k, index_c(l)));
-            }
-        }
+        void solve(const MatR &A, NumB isThin = 1);
 
-        //A*Y=I, A will become Y.
-        void solve(MatR &A) {
-            MatR B;
-            B.setSize(A.nrows(), 0);
-            solve(A, B);
-        }
+        // p is oversampling, q is number of power iterations.
+        void solve_randomized(const MatR &A, NumN k, NumN p = 10, NumN q = 2, NumN seed = 21);
+
+        const MatR &getU() const;
+
+        const VecR &getS() const;
+
+        const MatR &getV() const;
+
+        // number of singular values larger than tol, default tol is max(m, n)*eps*S(1).
+        NumN rank(NumR tol = -1) const;
+
+        // A_k = U_k*diag(S_k)*V_k.transpose, the first k singular values.
+        void approximate(NumN k, MatR &A_k) const;
+
+        // V*inverse(diag(S))*U.transpose, with singular values not larger than tol taken as 0.
+        void pseudoInverse(MatR &A_pinv, NumR tol = -1) const;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,124 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#include "../matrix_op/gemm.h"
+#include "triangular.h"
+
+namespace math21 {
+    namespace detail {
+        // rows solved before one gemm update.
+        const NumN math21_triangular_block_size = 64;
+
+        // x = x - a*y, x and y are rows of X.
+        inline void math21_c_triangular_row_axpy(NumN m, NumR a, const NumR *y, NumR *x) {
+            if (a == 0) {
+                return;
+            }
+            for (NumN j = 0; j < m; ++j) {
+                x[j] -= a * y[j];
+            }
+        }
+
+        inline void math21_c_triangular_row_scale(NumN m, NumR a, NumR *x) {
+            for (NumN j = 0; j < m; ++j) {
+                x[j] *= a;
+            }
+        }
+    }
+
+    void math21_c_triangular_solve_lower(NumB isUnit, NumN n, NumN m,
+                                         const NumR *L, NumN ldl, NumR *X, NumN ldx) {
+        if (n == 0 || m == 0) {
+            return;
+        }
+        const NumN nb = detail::math21_triangular_block_size;
+        for (NumN i0 = 0; i0 < n; i0 += nb) {
+            NumN ib = xjmin(nb, n - i0);
+            // X1 -= L10 * X0
+            if (i0 > 0) {
+                math21_c_gemm(0, 0, ib, m, i0, -1, L + i0 * ldl, ldl, X, ldx, 1, X + i0 * ldx, ldx);
+            }
+            for (NumN i = i0; i < i0 + ib; ++i) {
+                NumR *x = X + i * ldx;
+                for (NumN k = i0; k < i; ++k) {
+                    detail::math21_c_triangular_row_axpy(m, L[i * ldl + k], X + k * ldx, x);
+                }
+                if (!isUnit) {
+                    MATH21_ASSERT(L[i * ldl + i] != 0, "singular triangular matrix");
+                    detail::math21_c_triangular_row_scale(m, 1 / L[i * ldl + i], x);
+                }
+            }
+        }
+    }
+
+    void math21_c_triangular_solve_upper(NumB isUnit, NumN n, NumN m,
+                                         const NumR *U, NumN ldu, NumR *X, NumN ldx) {
+        if (n == 0 || m == 0) {
+            return;
+        }
+        const NumN nb = detail::math21_triangular_block_size;
+        for (NumN i1 = n; i1 > 0;) {
+            NumN ib = xjmin(nb, i1);
+            NumN i0 = i1 - ib;
+            // X1 -= U12 * X2
+            if (i1 < n) {
+                math21_c_gemm(0, 0, ib, m, n - i1, -1, U + i0 * ldu + i1, ldu, X + i1 * ldx, ldx,
+                              1, X + i0 * ldx, ldx);
+            }
+            for (NumN i = i1; i > i0;) {
+                --i;
+                NumR *x = X + i * ldx;
+                for (NumN k = i + 1; k < i1; ++k) {
+                    detail::math21_c_triangular_row_axpy(m, U[i * ldu + k], X + k * ldx, x);
+                }
+                if (!isUnit) {
+                    MATH21_ASSERT(U[i * ldu + i] != 0, "singular triangular matrix");
+                    detail::math21_c_triangular_row_scale(m, 1 / U[i * ldu + i], x);
+                }
+            }
+            i1 = i0;
+        }
+    }
+
+    void math21_c_triangular_solve_lower_trans(NumB isUnit, NumN n, NumN m,
+                                               const NumR *L, NumN ldl, NumR *X, NumN ldx) {
+        if (n == 0 || m == 0) {
+            return;
+        }
+        const NumN nb = detail::math21_triangular_block_size;
+        for (NumN i1 = n; i1 > 0;) {
+            NumN ib = xjmin(nb, i1);
+            NumN i0 = i1 - ib;
+            // X1 -= L21.transpose * X2
+            if (i1 < n) {
+                math21_c_gemm(1, 0, ib, m, n - i1, -1, L + i1 * ldl + i0, ldl, X + i1 * ldx, ldx,
+                              1, X + i0 * ldx, ldx);
+            }
+            for (NumN i = i1; i > i0;) {
+                --i;
+                NumR *x = X + i * ldx;
+                for (NumN k = i + 1; k < i1; ++k) {
+                    detail::math21_c_triangular_row_axpy(m, L[k * ldl + i], X + k * ldx, x);
+                }
+                if (!isUnit) {
+                    MATH21_ASSERT(L[i * ldl + i] != 0, "singular triangular matrix");
+                    detail::math21_c_triangular_row_scale(m, 1 / L[i * ldl + i], x);
+                }
+            }
+            i1 = i0;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#pragma once
+
+#include "inner.h"
+
+namespace math21 {
+
+    /*
+     * Triangular solves with many right-hand sides on raw row-major data.
+     * X is n*m with row stride ldx, and is overwritten by the solution.
+     * Rows are done in blocks, and the update from solved blocks is one gemm, see gemm.h.
+     * Diagonal of the triangular matrix is taken as 1 if isUnit.
+     * */
+
+    // X = inverse(L)*X, L is lower triangular.
+    void math21_c_triangular_solve_lower(NumB isUnit, NumN n, NumN m,
+                                         const NumR *L, NumN ldl, NumR *X, NumN ldx);
+
+    // X = inverse(U)*X, U is upper triangular.
+    void math21_c_triangular_solve_upper(NumB isUnit, NumN n, NumN m,
+                                         const NumR *U, NumN ldu, NumR *X, NumN ldx);
+
+    // X = inverse(L.transpose)*X, L is lower triangular, L.transpose is read in place.
+    void math21_c_triangular_solve_lower_trans(NumB isUnit, NumN n, NumN m,
+                                               const NumR *L, NumN ldl, NumR *X, NumN ldx);
+}
@@ -18,6 +18,10 @@ limitations under the License.
 #include "vec_ops.h"
 #include "mat_ops.h"
 #include "ten_ops.h"
+#include "gemm.h"
+#include "simd.h"
+#include "ten_expr.h"
 #include "ops_after_01.h"
 #include "operations.h"
+#include "sparse.h"
 #include "serialize.h"
@@ -0,0 +1,275 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+#include "gemm.h"
+
+namespace math21 {
+
+    namespace detail {
+
+        int math21_gemm_compute_num_threads(NumZ n_blocks) {
+#ifdef MATH21_FLAG_USE_OPENMP
+            int tn = omp_get_max_threads();
+            if (n_blocks < tn) {
+                tn = (int) n_blocks;
+            }
+            if (tn < 1) {
+                tn = 1;
+            }
+            return tn;
+#else
+            return 1;
+#endif
+        }
+
+        // C = beta*C, C is n*m.
+        template<typename T>
+        void math21_c_gemm_scale_C(NumN n, NumN m, NumR beta, T *C, NumN ldc) {
+            NumN i, j;
+            if (beta == 1) {
+                return;
+            }
+            for (i = 0; i < n; ++i) {
+                T *c = C + i * ldc;
+                if (beta == 0) {
+                    for (j = 0; j < m; ++j) c[j] = 0;
+                } else {
+                    for (j = 0; j < m; ++j) c[j] = (T) (beta * c[j]);
+                }
+            }
+        }
+
+        // op(A)(i, k)
+        template<typename T>
+        inline T math21_c_gemm_at(NumB isTrans, const T *A, NumN lda, NumN i, NumN k) {
+            return isTrans ? A[k * lda + i] : A[i * lda + k];
+        }
+
+        // i-k-j order, so B and C are walked along rows.
+        // Used for small products and matrix-vector products where packing doesn't pay.
+        template<typename T>
+        void math21_c_gemm_simple(NumB isTransA, NumB isTransB, NumN n, NumN m, NumN r,
+                                  NumR s, const T *A, NumN lda, const T *B, NumN ldb,
+                                  NumR beta, T *C, NumN ldc) {
+            NumN i, j, k;
+            math21_c_gemm_scale_C(n, m, beta, C, ldc);
+            if (m == 1) {
+                // B is a vector, so stride of op(B) is ldb or 1.
+                NumN stride_b = isTransB ? 1 : ldb;
+                if (isTransA) {
+                    // walk rows of A, i.e., C += s*b(k)*A(k, :)
+                    for (k = 0; k < r; ++k) {
+                        const T *a = A + k * lda;
+                        T b_k = (T) (s * B[k * stride_b]);
+                        for (i = 0; i < n; ++i) C[i * ldc] += b_k * a[i];
+                    }
+                } else {
+                    for (i = 0; i < n; ++i) {
+                        NumR sum = 0;
+                        const T *a = A + i * lda;
+                        for (k = 0; k < r; ++k) sum += a[k] * B[k * stride_b];
+                        C[i * ldc] += (T) (s * sum);
+                    }
+                }
+                return;
+            }
+            for (i = 0; i < n; ++i) {
+                T *c = C + i * ldc;
+                for (k = 0; k < r; ++k) {
+                    T a_ik = (T) (s * math21_c_gemm_at(isTransA, A, lda, i, k));
+                    if (isTransB) {
+                        for (j = 0; j < m; ++j) c[j] += a_ik * B[j * ldb + k];
+                    } else {
+                        const T *b = B + k * ldb;
+                        for (j = 0; j < m; ++j) c[j] += a_ik * b[j];
+                    }
+                }
+            }
+        }
+
+        // pack mc*kc block of A into row panels of height MR.
+        // Panel layout: for every p, MR consecutive values of column p.
+        // A points to op(A)(0, 0) of the block.
+        template<typename T>
+        void math21_c_gemm_pack_A(NumB isTransA, NumN mc, NumN kc, const T *A, NumN lda, T *packA) {
+            const NumN MR = math21_gemm_blocking<T>::MR;
+            NumN i, ii, p, mr;
+            for (i = 0; i < mc; i += MR) {
+                mr = xjmin(MR, mc - i);
+                if (isTransA) {
+                    // op(A) columns are rows of A.
+                    const T *a = A + i;
+                    for (p = 0; p < kc; ++p) {
+                        const T *a_p = a + p * lda;
+                        for (ii = 0; ii < mr; ++ii) packA[ii] = a_p[ii];
+                        for (ii = mr; ii < MR; ++ii) packA[ii] = 0;
+                        packA += MR;
+                    }
+                } else {
+                    const T *a = A + i * lda;
+                    for (p = 0; p < kc; ++p) {
+                        for (ii = 0; ii < mr; ++ii) packA[ii] = a[ii * lda + p];
+                        for (ii = mr; ii < MR; ++ii) packA[ii] = 0;
+                        packA += MR;
+                    }
+                }
+            }
+        }
+
+        // pack kc*nc block of B into column panels of width NR.
+        // Panel layout: for every p, NR consecutive values of row p.
+        // B points to op(B)(0, 0) of the block.
+        template<typename T>
+        void math21_c_gemm_pack_B(NumB isTransB, NumN kc, NumN nc, const T *B, NumN ldb, T *packB) {
+            const NumN NR = math21_gemm_blocking<T>::NR;
+            NumN j, jj, p, nr;
+            for (j = 0; j < nc; j += NR) {
+                nr = xjmin(NR, nc - j);
+                if (isTransB) {
+                    // op(B) rows are columns of B.
+                    const T *b = B + j * ldb;
+                    for (p = 0; p < kc; ++p) {
+                        for (jj = 0; jj < nr; ++jj) packB[jj] = b[jj * ldb + p];
+                        for (jj = nr; jj < NR; ++jj) packB[jj] = 0;
+                        packB += NR;
+                    }
+                } else {
+                    const T *b = B + j;
+                    for (p = 0; p < kc; ++p) {
+                        const T *b_p = b + p * ldb;
+                        for (jj = 0; jj < nr; ++jj) packB[jj] = b_p[jj];
+                        for (jj = nr; jj < NR; ++jj) packB[jj] = 0;
+                        packB += NR;
+                    }
+                }
+            }
+        }
+
+        // acc = a*b, a is MR*kc panel, b is kc*NR panel.
+        // Fixed trip counts let the compiler keep acc in vector registers.
+        template<typename T>
+        void math21_c_gemm_micro_kernel(NumN kc, const T *a, const T *b, T *acc) {
+            const NumN MR = math21_gemm_blocking<T>::MR;
+            const NumN NR = math21_gemm_blocking<T>::NR;
+            NumN p, i, j;
+            for (i = 0; i < MR * NR; ++i) acc[i] = 0;
+            for (p = 0; p < kc; ++p) {
+                for (i = 0; i < MR; ++i) {
+                    T a_i = a[i];
+                    for (j = 0; j < NR; ++j) acc[i * NR + j] += a_i * b[j];
+                }
+                a += MR;
+                b += NR;
+            }
+        }
+
+        // C(mc*nc) += s * packA * packB
+        template<typename T>
+        void math21_c_gemm_macro_kernel(NumN mc, NumN nc, NumN kc, NumR s,
+                                        const T *packA, const T *packB, T *C, NumN ldc) {
+            const NumN MR = math21_gemm_blocking<T>::MR;
+            const NumN NR = math21_gemm_blocking<T>::NR;
+            T acc[MR * NR];
+            NumN i, j, ii, jj, mr, nr;
+            for (j = 0; j < nc; j += NR) {
+                nr = xjmin(NR, nc - j);
+                for (i = 0; i < mc; i += MR) {
+                    mr = xjmin(MR, mc - i);
+                    math21_c_gemm_micro_kernel(kc, packA + i * kc, packB + j * kc, acc);
+                    T *c = C + i * ldc + j;
+                    for (ii = 0; ii < mr; ++ii) {
+                        for (jj = 0; jj < nr; ++jj) c[ii * ldc + jj] += (T) (s * acc[ii * NR + jj]);
+                    }
+                }
+            }
+        }
+
+        template<typename T>
+        void math21_c_gemm_blocked(NumB isTransA, NumB isTransB, NumN n, NumN m, NumN r,
+                                   NumR s, const T *A, NumN lda, const T *B, NumN ldb,
+                                   NumR beta, T *C, NumN ldc) {
+            const NumN MC = math21_gemm_blocking<T>::MC;
+            const NumN KC = math21_gemm_blocking<T>::KC;
+            const NumN NC = math21_gemm_blocking<T>::NC;
+            const NumN NR = math21_gemm_blocking<T>::NR;
+
+            math21_c_gemm_scale_C(n, m, beta, C, ldc);
+
+            NumN nc_max = xjmin(NC, m);
+            std::vector<T> packB(((nc_max + NR - 1) / NR) * NR * xjmin(KC, r));
+
+            NumN jc, pc, nc, kc;
+            NumZ n_blocks = (NumZ) ((n + MC - 1) / MC);
+            for (jc = 0; jc < m; jc += NC) {
+                nc = xjmin(NC, m - jc);
+                for (pc = 0; pc < r; pc += KC) {
+                    kc = xjmin(KC, r - pc);
+                    const T *B_block = isTransB ? B + jc * ldb + pc : B + pc * ldb + jc;
+                    math21_c_gemm_pack_B(isTransB, kc, nc, B_block, ldb, &packB[0]);
+                    // Every thread owns its own packed A block and disjoint rows of C.
+#pragma omp parallel num_threads(math21_gemm_compute_num_threads(n_blocks))
+                    {
+                        std::vector<T> packA(MC * kc + math21_gemm_blocking<T>::MR * kc);
+                        NumZ ib;
+#pragma omp for schedule(static)
+                        for (ib = 0; ib < n_blocks; ++ib) {
+                            NumN ic = (NumN) ib * MC;
+                            NumN mc = xjmin(MC, n - ic);
+                            const T *A_block = isTransA ? A + pc * lda + ic : A + ic * lda + pc;
+                            math21_c_gemm_pack_A(isTransA, mc, kc, A_block, lda, &packA[0]);
+                            math21_c_gemm_macro_kernel(mc, nc, kc, s, &packA[0], &packB[0],
+                                                       C + ic * ldc + jc, ldc);
+                        }
+                    }
+                }
+            }
+        }
+
+        template<typename T>
+        void math21_c_gemm(NumB isTransA, NumB isTransB, NumN n, NumN m, NumN r,
+                           NumR s, const T *A, NumN lda, const T *B, NumN ldb,
+                           NumR beta, T *C, NumN ldc) {
+            if (n == 0 || m == 0) {
+                return;
+            }
+            if (r == 0 || s == 0) {
+                math21_c_gemm_scale_C(n, m, beta, C, ldc);
+                return;
+            }
+            if (m == 1 || n * m * r < math21_c_gemm_get_min_volume()) {
+                math21_c_gemm_simple(isTransA, isTransB, n, m, r, s, A, lda, B, ldb, beta, C, ldc);
+            } else {
+                math21_c_gemm_blocked(isTransA, isTransB, n, m, r, s, A, lda, B, ldb, beta, C, ldc);
+            }
+        }
+    }
+
+    NumN math21_c_gemm_get_min_volume() {
+        return 32 * 32 * 32;
+    }
+
+    void math21_c_gemm(NumB isTransA, NumB isTransB, NumN n, NumN m, NumN r,
+                       NumR s, const NumR *A, NumN lda, const NumR *B, NumN ldb,
+                       NumR beta, NumR *C, NumN ldc) {
+        detail::math21_c_gemm(isTransA, isTransB, n, m, r, s, A, lda, B, ldb, beta, C, ldc);
+    }
+
+    void math21_c_gemm(NumB isTransA, NumB isTransB, NumN n, NumN m, NumN r,
+                       NumR s, const float *A, NumN lda, const float *B, NumN ldb,
+                       NumR beta, float *C, NumN ldc) {
+        detail::math21_c_gemm(isTransA, isTransB, n, m, r, s, A, lda, B, ldb, beta, C, ldc);
+    }
+}
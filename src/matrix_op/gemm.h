@@ -0,0 +1,80 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include "inner.h"
+
+namespace math21 {
+
+    /*
+     * Packed, cache-blocked gemm on raw row-major data.
+     * C = s*op(A)*op(B) + beta*C, op(X) is X or X.transpose.
+     * op(A) is n*r, op(B) is r*m, C is n*m. lda, ldb, ldc are row strides of A, B, C as stored,
+     * e.x., lda >= r if A is not transposed, and lda >= n if A is transposed.
+     * Transposed operands are read in place when packing, nothing is materialized.
+     *
+     * Blocking follows the usual Goto scheme:
+     *   jc: NC columns of B and C, B panel lives in L3.
+     *   pc: KC depth, packed B panel kc*nc.
+     *   ic: MC rows of A, packed A block mc*kc lives in L2.
+     *   micro-kernel: MR*NR tile of C held in registers.
+     * Edge tiles are zero padded when packing, so the micro-kernel never branches.
+     * */
+
+    /*
+     * Block sizes are fixed for common x86-64 cores, L1d 32-48 KB, L2 256 KB-2 MB, shared L3 of several MB.
+     * For NumR:
+     *   B micro-panel KC*NR = 256*8 numbers is 16 KB, half of L1d, so it stays there across the micro-kernel loop.
+     *   A block MC*KC = 128*256 numbers is 256 KB, at most half of L2 from 512 KB on.
+     *   B panel KC*NC = 256*4096 numbers is 8 MB, for L3.
+     * MC = 256 was up to 1.5x faster on one core of a Xeon with 2 MB L2, since the B panel is streamed half as often,
+     * but it doubles the A block, and threads share half as many row blocks, e.x., 4 for n = 1024.
+     * For float, KC = 384 gives a 12 KB B micro-panel and a 192 KB A block, MC = 256 was slower.
+     * */
+    template<typename T>
+    struct math21_gemm_blocking {
+    };
+
+    template<>
+    struct math21_gemm_blocking<NumR> {
+        static const NumN MR = 4;
+        static const NumN NR = 8;
+        static const NumN MC = 128;
+        static const NumN KC = 256;
+        static const NumN NC = 4096;
+    };
+
+    // 4*8 tile of float fits in registers with SSE2, a larger one spills and is slower than NumR.
+    template<>
+    struct math21_gemm_blocking<float> {
+        static const NumN MR = 4;
+        static const NumN NR = 8;
+        static const NumN MC = 128;
+        static const NumN KC = 384;
+        static const NumN NC = 4096;
+    };
+
+    // products smaller than this volume n*m*r skip packing.
+    NumN math21_c_gemm_get_min_volume();
+
+    void math21_c_gemm(NumB isTransA, NumB isTransB, NumN n, NumN m, NumN r,
+                       NumR s, const NumR *A, NumN lda, const NumR *B, NumN ldb,
+                       NumR beta, NumR *C, NumN ldc);
+
+    void math21_c_gemm(NumB isTransA, NumB isTransB, NumN n, NumN m, NumN r,
+                       NumR s, const float *A, NumN lda, const float *B, NumN ldb,
+                       NumR beta, float *C, NumN ldc);
+}
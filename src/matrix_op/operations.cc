@@ -55,46 +55,38 @@ namespace math21 {
 
     // solve A*X=B;
     void math21_operator_solve_linear_equation(const MatR &A, const MatR &B, MatR &X) {
-        MatR A_inv;
-        A_inv.setSize(A.shape());
-        A_inv.assign(A);
-        if (!math21_operator_container_isEqual(X.shape(), B.shape())) {
-            X.setSize(B.shape());
+        LUDecomposition lu;
+        if (!lu.factor(A)) {
+            MATH21_ASSERT(0, "LU decomposition: Singular Matrix");
         }
-        X.assign(B);
-        GaussJordanElimination gje;
-        gje.solve(A_inv, X);
+        lu.solve(B, X);
     }
 
     void math21_operator_inverse(const MatR &A, MatR &A_inv) {
-        A_inv.setSize(A.shape());
-        A_inv.assign(A);
-
-        GaussJordanElimination gje;
-        gje.solve(A_inv);
+        LUDecomposition lu;
+        if (!lu.factor(A)) {
+            MATH21_ASSERT(0, "LU decomposition: Singular Matrix");
+        }
+        lu.inverse(A_inv);
     }
 
     void math21_operator_inverse(MatR &A) {
-        GaussJordanElimination gje;
-        gje.solve(A);
+        LUDecomposition lu;
+        if (!lu.factor(A)) {
+            MATH21_ASSERT(0, "LU decomposition: Singular Matrix");
+        }
+        lu.inverse(A);
     }
 
     // B = inverse of A
     void math21_operator_matrix_2_2_inverse(const MatR &A, MatR &B) {
         MATH21_ASSERT(A.isSameSize(2, 2))
-        if (!B.isSameSize(2, 2)) {
-            B.setSize(2, 2);
+        Mat22R A2, B2;
+        A2.assign(A);
+        if (!math21_operator_fixed_inverse(A2, B2)) {
+            MATH21_ASSERT(0, "matrix is singular");
         }
-        NumR a, b, c, d, det;
-        det = A(1, 1) * A(2, 2) - A(2, 1) * A(1, 2);
-        MATH21_ASSERT(det != 0)
-        a = A(2, 2) / det;
-        b = -A(2, 1) / det;
-        c = -A(1, 2) / det;
-        d = A(1, 1) / det;
-        B =
-                a, c,
-                b, d;
+        B2.copyTo(B);
     }
 
     // B = inverse of A
@@ -136,73 +128,71 @@ namespace math21 {
         B.swap(C);
     }
 
-    // C = s*(A.transpose)*B, * is matrix multiplication
-    void math21_operator_trans_multiply(NumR s, const MatR &A, const MatR &B, MatR &C) {
-        MATH21_ASSERT(!A.isEmpty() && !B.isEmpty(), "empty matrix");
-        MATH21_ASSERT(B.nrows() == A.nrows(), "matrix size doesn't match in *");
-
-        NumN n, m, r;
-        n = A.ncols();
-        m = B.ncols();
-        r = A.nrows();
-        if (C.nrows() != n || C.ncols() != m) {
-            C.setSize(n, m);
+    namespace detail {
+        NumB math21_operator_gemm_is_c_compatible(const MatR &A) {
+            return A.isContinuous() && !A.isColumnMajor();
         }
 
-        NumN i, j, k;
-        for (i = 1; i <= n; i++) {
-            for (j = 1; j <= m; j++) {
-                C(i, j) = 0;
-                for (k = 1; k <= r; k++) C(i, j) += A(k, i) * B(k, j);
-                C(i, j) = s * C(i, j);
+        // C = beta*C + s*op(A)*op(B) through element access, used when data isn't continuous.
+        void math21_operator_gemm_general(NumB isTransA, NumB isTransB, NumN n, NumN m, NumN r,
+                                          NumR s, const MatR &A, const MatR &B, NumR beta, MatR &C) {
+            NumN i, j, k;
+            for (i = 1; i <= n; i++) {
+                for (j = 1; j <= m; j++) {
+                    NumR sum = 0;
+                    for (k = 1; k <= r; k++) {
+                        sum += (isTransA ? A(k, i) : A(i, k)) * (isTransB ? B(j, k) : B(k, j));
+                    }
+                    if (beta == 0) {
+                        C(i, j) = s * sum;
+                    } else {
+                        C(i, j) = beta * C(i, j) + s * sum;
+                    }
+                }
             }
         }
     }
 
-    // C = s*A*(B.transpose), * is matrix multiplication
-    void math21_operator_multiply_trans(NumR s, const MatR &A, const MatR &B, MatR &C) {
+    void math21_operator_gemm(NumB isTransA, NumB isTransB, NumR s, const MatR &A, const MatR &B,
+                              NumR beta, MatR &C) {
         MATH21_ASSERT(!A.isEmpty() && !B.isEmpty(), "empty matrix");
-        MATH21_ASSERT(B.ncols() == A.ncols(), "matrix size doesn't match in *");
-
         NumN n, m, r;
-        n = A.nrows();
-        m = B.nrows();
-        r = A.ncols();
+        n = isTransA ? A.ncols() : A.nrows();
+        r = isTransA ? A.nrows() : A.ncols();
+        m = isTransB ? B.nrows() : B.ncols();
+        MATH21_ASSERT((isTransB ? B.ncols() : B.nrows()) == r, "matrix size doesn't match in *");
+        MATH21_ASSERT(&C != &A && &C != &B, "C can't be A or B");
         if (C.nrows() != n || C.ncols() != m) {
+            MATH21_ASSERT(beta == 0, "C must have shape n*m when beta is not zero");
             C.setSize(n, m);
         }
 
-        NumN i, j, k;
-        for (i = 1; i <= n; i++) {
-            for (j = 1; j <= m; j++) {
-                C(i, j) = 0;
-                for (k = 1; k <= r; k++) C(i, j) += A(i, k) * B(j, k);
-                C(i, j) = s * C(i, j);
-            }
+        if (detail::math21_operator_gemm_is_c_compatible(A) &&
+            detail::math21_operator_gemm_is_c_compatible(B) &&
+            detail::math21_operator_gemm_is_c_compatible(C)) {
+            // row strides of A, B, C as stored.
+            math21_c_gemm(isTransA, isTransB, n, m, r, s,
+                          math21_memory_tensor_data_address(A), A.ncols(),
+                          math21_memory_tensor_data_address(B), B.ncols(),
+                          beta, math21_memory_tensor_data_address(C), C.ncols());
+        } else {
+            detail::math21_operator_gemm_general(isTransA, isTransB, n, m, r, s, A, B, beta, C);
         }
     }
 
-    // C = s*(A.transpose)*(B.transpose), * is matrix multiplication
-    void math21_operator_trans_multiply_trans(NumR s, const MatR &A, const MatR &B, MatR &C) {
-        MATH21_ASSERT(!A.isEmpty() && !B.isEmpty(), "empty matrix");
-        MATH21_ASSERT(B.ncols() == A.nrows(), "matrix size doesn't match in *");
+    // C = s*(A.transpose)*B, * is matrix multiplication
+    void math21_operator_trans_multiply(NumR s, const MatR &A, const MatR &B, MatR &C) {
+        math21_operator_gemm(1, 0, s, A, B, 0, C);
+    }
 
-        NumN n, m, r;
-        n = A.ncols();
-        m = B.nrows();
-        r = A.nrows();
-        if (C.nrows() != n || C.ncols() != m) {
-            C.setSize(n, m);
-        }
+    // C = s*A*(B.transpose), * is matrix multiplication
+    void math21_operator_multiply_trans(NumR s, const MatR &A, const MatR &B, MatR &C) {
+        math21_operator_gemm(0, 1, s, A, B, 0, C);
+    }
 
-        NumN i, j, k;
-        for (i = 1; i <= n; i++) {
-            for (j = 1; j <= m; j++) {
-                C(i, j) = 0;
-                for (k = 1; k <= r; k++) C(i, j) += A(k, i) * B(j, k);
-                C(i, j) = s * C(i, j);
-            }
-        }
+    // C = s*(A.transpose)*(B.transpose), * is matrix multiplication
+    void math21_operator_trans_multiply_trans(NumR s, const MatR &A, const MatR &B, MatR &C) {
+        math21_operator_gemm(1, 1, s, A, B, 0, C);
     }
 
 }
\ No newline at end of file
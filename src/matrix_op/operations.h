@@ -16,6 +16,7 @@ limitations under the License.
 #pragma once
 
 #include "inner.h"
+#include "gemm.h"
 
 namespace math21 {
 
@@ -33,7 +34,9 @@ namespace math21 {
     // B = k1*A + k2*B
     void math21_operator_linear_to_B(NumR k1, const MatR &A, NumR k2, MatR &B);
 
-    // solve A*X=B;
+    // solve A*X=B by LU decomposition.
+    // To solve with the same A many times, factor once with LUDecomposition, or CholeskyDecomposition
+    // if A is symmetric positive definite.
     void math21_operator_solve_linear_equation(const MatR &A, const MatR &B, MatR &X);
 
     void math21_operator_inverse(const MatR &A, MatR &A_inv);
@@ -81,8 +84,37 @@ namespace math21 {
         }
     }
 
+    namespace detail {
+        // Reference kernel, kept for types without packed gemm.
+        template<typename T>
+        void math21_c_matrix_multiply_kernel(NumR s, NumN n, NumN m, NumN r,
+                                             const T *A_data, const T *B_data, T *C_data) {
+            NumN i, j, k;
+#pragma omp parallel for private(j, k) collapse(2)
+            for (i = 1; i <= n; i++) {
+                for (j = 1; j <= m; j++) {
+                    NumR sum = 0;
+                    for (k = 1; k <= r; k++) sum += A_data[(i - 1) * r + (k - 1)] * B_data[(k - 1) * m + (j - 1)];
+                    C_data[(i - 1) * m + (j - 1)] = (T) s * sum;
+                }
+            }
+        }
+
+        inline void math21_c_matrix_multiply_kernel(NumR s, NumN n, NumN m, NumN r,
+                                                    const NumR *A_data, const NumR *B_data, NumR *C_data) {
+            math21_c_gemm(0, 0, n, m, r, s, A_data, r, B_data, m, 0, C_data, m);
+        }
+
+        inline void math21_c_matrix_multiply_kernel(NumR s, NumN n, NumN m, NumN r,
+                                                    const float *A_data, const float *B_data, float *C_data) {
+            math21_c_gemm(0, 0, n, m, r, s, A_data, r, B_data, m, 0, C_data, m);
+        }
+    }
+
     // MATH21_ASSERT(A.isContinuous() && !A.isColumnMajor());
     // MATH21_ASSERT(B.isContinuous() && !B.isColumnMajor());
+    // NumR and float use the packed, cache-blocked gemm, see gemm.h.
+    // math21_c_matrix_multiply_no_parallel is the reference.
     template<typename T>
     void math21_c_matrix_multiply(NumR s, const Tensor<T> &A, const Tensor<T> &B, Tensor<T> &C) {
         MATH21_ASSERT(!A.isEmpty() && !B.isEmpty(), "empty matrix");
@@ -101,18 +133,10 @@ namespace math21 {
         }
         MATH21_ASSERT(C.isContinuous() && !C.isColumnMajor());
 
-        NumN i, j, k;
         const T *A_data = math21_memory_tensor_data_address(A);
         const T *B_data = math21_memory_tensor_data_address(B);
         T *C_data = math21_memory_tensor_data_address(C);
-#pragma omp parallel for private(j, k) collapse(2)
-        for (i = 1; i <= n; i++) {
-            for (j = 1; j <= m; j++) {
-                NumR sum = 0;
-                for (k = 1; k <= r; k++) sum += A_data[(i - 1) * r + (k - 1)] * B_data[(k - 1) * m + (j - 1)];
-                C_data[(i - 1) * m + (j - 1)] = (T) s * sum;
-            }
-        }
+        detail::math21_c_matrix_multiply_kernel(s, n, m, r, A_data, B_data, C_data);
     }
 
     // C will be vector type if C is n*1 shape.
@@ -224,10 +248,19 @@ namespace math21 {
     // B = s*A*B, * is matrix multiplication
     void math21_operator_multiply_to_B(NumR s, const MatR &A, MatR &B);
 
+    // C = s*op(A)*op(B) + beta*C, op(X) is X or X.transpose.
+    // Transposed operands are read in place, no transposed copy is made.
+    // C is resized to n*m if needed, which requires beta = 0. C can't be A or B.
+    void math21_operator_gemm(NumB isTransA, NumB isTransB, NumR s, const MatR &A, const MatR &B,
+                              NumR beta, MatR &C);
+
+    // C = s*(A.transpose)*B
     void math21_operator_trans_multiply(NumR s, const MatR &A, const MatR &B, MatR &C);
 
+    // C = s*A*(B.transpose)
     void math21_operator_multiply_trans(NumR s, const MatR &A, const MatR &B, MatR &C);
 
+    // C = s*(A.transpose)*(B.transpose)
     void math21_operator_trans_multiply_trans(NumR s, const MatR &A, const MatR &B, MatR &C);
 
 }
\ No newline at end of file
@@ -0,0 +1,628 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <cstring>
+#include "simd.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MATH21_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MATH21_SIMD_SSE2
+#endif
+
+namespace math21 {
+
+    namespace detail {
+
+        /*
+         * A packet is W numbers processed together.
+         * Bit operations view every lane as 64-bit integer.
+         * */
+#if defined(MATH21_SIMD_AVX2)
+        struct math21_simd_packet {
+            typedef __m256d Type;
+            typedef __m256i TypeI;
+            static const NumN W = 4;
+
+            static Type load(const NumR *p) { return _mm256_loadu_pd(p); }
+
+            // p[offset[0]], ..., p[offset[W-1]], offsets below 2^31.
+            static Type gather(const NumR *p, const NumN32 *offset) {
+                return _mm256_i32gather_pd(p, _mm_loadu_si128((const __m128i *) offset), 8);
+            }
+
+            static void store(NumR *p, Type a) { _mm256_storeu_pd(p, a); }
+
+            static Type set1(NumR a) { return _mm256_set1_pd(a); }
+
+            static Type add(Type a, Type b) { return _mm256_add_pd(a, b); }
+
+            static Type sub(Type a, Type b) { return _mm256_sub_pd(a, b); }
+
+            static Type mul(Type a, Type b) { return _mm256_mul_pd(a, b); }
+
+            static Type div(Type a, Type b) { return _mm256_div_pd(a, b); }
+
+            // a*b+c
+            static Type fmadd(Type a, Type b, Type c) {
+#if defined(__FMA__)
+                return _mm256_fmadd_pd(a, b, c);
+#else
+                return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+#endif
+            }
+
+            static Type sqrt(Type a) { return _mm256_sqrt_pd(a); }
+
+            static Type gt(Type a, Type b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+
+            // nan gives false.
+            static NumB isAllInRange(Type a, NumR lo, NumR hi) {
+                Type m = _mm256_and_pd(_mm256_cmp_pd(a, set1(lo), _CMP_GE_OQ),
+                                       _mm256_cmp_pd(a, set1(hi), _CMP_LE_OQ));
+                return _mm256_movemask_pd(m) == 0xf;
+            }
+
+            // mask ? a : b
+            static Type select(Type mask, Type a, Type b) { return _mm256_blendv_pd(b, a, mask); }
+
+            static TypeI asInt(Type a) { return _mm256_castpd_si256(a); }
+
+            static Type asReal(TypeI a) { return _mm256_castsi256_pd(a); }
+
+            static TypeI set1Int(NumN64 a) { return _mm256_set1_epi64x((long long) a); }
+
+            static TypeI addInt(TypeI a, TypeI b) { return _mm256_add_epi64(a, b); }
+
+            static TypeI subInt(TypeI a, TypeI b) { return _mm256_sub_epi64(a, b); }
+
+            static TypeI andInt(TypeI a, TypeI b) { return _mm256_and_si256(a, b); }
+
+            static TypeI orInt(TypeI a, TypeI b) { return _mm256_or_si256(a, b); }
+
+            static TypeI xorInt(TypeI a, TypeI b) { return _mm256_xor_si256(a, b); }
+
+            static TypeI shiftLeft52(TypeI a) { return _mm256_slli_epi64(a, 52); }
+
+            static TypeI shiftRight52(TypeI a) { return _mm256_srli_epi64(a, 52); }
+
+            static NumR sum(Type a) {
+                __m128d lo = _mm256_castpd256_pd128(a);
+                __m128d hi = _mm256_extractf128_pd(a, 1);
+                lo = _mm_add_pd(lo, hi);
+                hi = _mm_unpackhi_pd(lo, lo);
+                return _mm_cvtsd_f64(_mm_add_sd(lo, hi));
+            }
+        };
+
+#elif defined(MATH21_SIMD_SSE2)
+        struct math21_simd_packet {
+            typedef __m128d Type;
+            typedef __m128i TypeI;
+            static const NumN W = 2;
+
+            static Type load(const NumR *p) { return _mm_loadu_pd(p); }
+
+            static Type gather(const NumR *p, const NumN32 *offset) { return _mm_set_pd(p[offset[1]], p[offset[0]]); }
+
+            static void store(NumR *p, Type a) { _mm_storeu_pd(p, a); }
+
+            static Type set1(NumR a) { return _mm_set1_pd(a); }
+
+            static Type add(Type a, Type b) { return _mm_add_pd(a, b); }
+
+            static Type sub(Type a, Type b) { return _mm_sub_pd(a, b); }
+
+            static Type mul(Type a, Type b) { return _mm_mul_pd(a, b); }
+
+            static Type div(Type a, Type b) { return _mm_div_pd(a, b); }
+
+            static Type fmadd(Type a, Type b, Type c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+
+            static Type sqrt(Type a) { return _mm_sqrt_pd(a); }
+
+            static Type gt(Type a, Type b) { return _mm_cmpgt_pd(a, b); }
+
+            static NumB isAllInRange(Type a, NumR lo, NumR hi) {
+                Type m = _mm_and_pd(_mm_cmpge_pd(a, set1(lo)), _mm_cmple_pd(a, set1(hi)));
+                return _mm_movemask_pd(m) == 0x3;
+            }
+
+            static Type select(Type mask, Type a, Type b) {
+                return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+            }
+
+            static TypeI asInt(Type a) { return _mm_castpd_si128(a); }
+
+            static Type asReal(TypeI a) { return _mm_castsi128_pd(a); }
+
+            static TypeI set1Int(NumN64 a) { return _mm_set1_epi64x((long long) a); }
+
+            static TypeI addInt(TypeI a, TypeI b) { return _mm_add_epi64(a, b); }
+
+            static TypeI subInt(TypeI a, TypeI b) { return _mm_sub_epi64(a, b); }
+
+            static TypeI andInt(TypeI a, TypeI b) { return _mm_and_si128(a, b); }
+
+            static TypeI orInt(TypeI a, TypeI b) { return _mm_or_si128(a, b); }
+
+            static TypeI xorInt(TypeI a, TypeI b) { return _mm_xor_si128(a, b); }
+
+            static TypeI shiftLeft52(TypeI a) { return _mm_slli_epi64(a, 52); }
+
+            static TypeI shiftRight52(TypeI a) { return _mm_srli_epi64(a, 52); }
+
+            static NumR sum(Type a) {
+                Type hi = _mm_unpackhi_pd(a, a);
+                return _mm_cvtsd_f64(_mm_add_sd(a, hi));
+            }
+        };
+
+#else
+        struct math21_simd_packet {
+            typedef NumR Type;
+            typedef NumN64 TypeI;
+            static const NumN W = 1;
+
+            static Type load(const NumR *p) { return *p; }
+
+            static Type gather(const NumR *p, const NumN32 *offset) { return p[offset[0]]; }
+
+            static void store(NumR *p, Type a) { *p = a; }
+
+            static Type set1(NumR a) { return a; }
+
+            static Type add(Type a, Type b) { return a + b; }
+
+            static Type sub(Type a, Type b) { return a - b; }
+
+            static Type mul(Type a, Type b) { return a * b; }
+
+            static Type div(Type a, Type b) { return a / b; }
+
+            static Type fmadd(Type a, Type b, Type c) { return a * b + c; }
+
+            static Type sqrt(Type a) { return std::sqrt(a); }
+
+            static Type gt(Type a, Type b) { return a > b ? 1 : 0; }
+
+            static NumB isAllInRange(Type a, NumR lo, NumR hi) { return a >= lo && a <= hi; }
+
+            static Type select(Type mask, Type a, Type b) { return mask != 0 ? a : b; }
+
+            static TypeI asInt(Type a) {
+                TypeI b;
+                memcpy(&b, &a, sizeof(b));
+                return b;
+            }
+
+            static Type asReal(TypeI a) {
+                Type b;
+                memcpy(&b, &a, sizeof(b));
+                return b;
+            }
+
+            static TypeI set1Int(NumN64 a) { return a; }
+
+            static TypeI addInt(TypeI a, TypeI b) { return a + b; }
+
+            static TypeI subInt(TypeI a, TypeI b) { return a - b; }
+
+            static TypeI andInt(TypeI a, TypeI b) { return a & b; }
+
+            static TypeI orInt(TypeI a, TypeI b) { return a | b; }
+
+            static TypeI xorInt(TypeI a, TypeI b) { return a ^ b; }
+
+            static TypeI shiftLeft52(TypeI a) { return a << 52; }
+
+            static TypeI shiftRight52(TypeI a) { return a >> 52; }
+
+            static NumR sum(Type a) { return a; }
+        };
+#endif
+
+        typedef math21_simd_packet P;
+
+        // 1.5*2^52, adding it rounds to integer, and the integer sits in the low bits.
+        const NumR math21_simd_round_magic = 6755399441055744.0;
+        // ln2 split so that k*ln2_hi is exact for |k| < 2^11.
+        const NumR math21_simd_ln2_hi = 6.93147180369123816490e-01;
+        const NumR math21_simd_ln2_lo = 1.90821492927058770002e-10;
+        const NumR math21_simd_log2e = 1.44269504088896338700e+00;
+        const NumR math21_simd_exp_min = -708.0;
+        const NumR math21_simd_exp_max = 709.0;
+        const NumR math21_simd_real_min = 2.2250738585072014e-308;
+        const NumR math21_simd_real_max = 1.7976931348623157e+308;
+        // pi/2 split in 33-bit parts, so k*pio2_1 and k*pio2_2 are exact for |k| < 2^20, as in fdlibm.
+        const NumR math21_simd_pio2_1 = 1.57079632673412561417e+00;
+        const NumR math21_simd_pio2_2 = 6.07710050630396597660e-11;
+        const NumR math21_simd_pio2_3 = 2.02226624871116645580e-21;
+        const NumR math21_simd_2_over_pi = 6.36619772367581382433e-01;
+        // |x| <= 2^19 keeps |k| < 2^20.
+        const NumR math21_simd_trig_max = 524288.0;
+
+        // exp(x) = 2^k * exp(r), x = k*ln2 + r, |r| <= ln2/2.
+        // Taylor series of degree 13, truncation error < 1e-17 relatively.
+        inline P::Type math21_simd_exp(P::Type x) {
+            P::Type t = P::fmadd(x, P::set1(math21_simd_log2e), P::set1(math21_simd_round_magic));
+            P::Type k = P::sub(t, P::set1(math21_simd_round_magic));
+            P::Type r = P::fmadd(k, P::set1(-math21_simd_ln2_hi), x);
+            r = P::fmadd(k, P::set1(-math21_simd_ln2_lo), r);
+
+            P::Type p = P::set1(1.0 / 6227020800.0);
+            p = P::fmadd(p, r, P::set1(1.0 / 479001600.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 39916800.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 3628800.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 362880.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 40320.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 5040.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 720.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 120.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 24.0));
+            p = P::fmadd(p, r, P::set1(1.0 / 6.0));
+            p = P::fmadd(p, r, P::set1(0.5));
+            p = P::fmadd(p, r, P::set1(1.0));
+            p = P::fmadd(p, r, P::set1(1.0));
+
+            // 2^k built from the exponent bits.
+            P::TypeI ki = P::subInt(P::asInt(t), P::asInt(P::set1(math21_simd_round_magic)));
+            P::TypeI e = P::shiftLeft52(P::addInt(ki, P::set1Int(1023)));
+            return P::mul(p, P::asReal(e));
+        }
+
+        // log(x) = e*ln2 + log(m), m in [sqrt(2)/2, sqrt(2)).
+        // log(m) = 2*atanh(f), f = (m-1)/(m+1), |f| < 0.172, series up to f^21.
+        inline P::Type math21_simd_log(P::Type x) {
+            P::TypeI bits = P::asInt(x);
+            P::TypeI exp_bits = P::shiftRight52(bits);
+            P::Type two52 = P::set1(4503599627370496.0);
+            P::Type e = P::sub(P::asReal(P::orInt(exp_bits, P::asInt(two52))), two52);
+            e = P::sub(e, P::set1(1023.0));
+            P::Type m = P::asReal(P::orInt(P::andInt(bits, P::set1Int(0x000fffffffffffffULL)),
+                                           P::set1Int(0x3ff0000000000000ULL)));
+            P::Type mask = P::gt(m, P::set1(MATH21_SQRT2));
+            m = P::select(mask, P::mul(m, P::set1(0.5)), m);
+            e = P::select(mask, P::add(e, P::set1(1.0)), e);
+
+            P::Type f = P::div(P::sub(m, P::set1(1.0)), P::add(m, P::set1(1.0)));
+            P::Type s = P::mul(f, f);
+            P::Type p = P::set1(1.0 / 21.0);
+            p = P::fmadd(p, s, P::set1(1.0 / 19.0));
+            p = P::fmadd(p, s, P::set1(1.0 / 17.0));
+            p = P::fmadd(p, s, P::set1(1.0 / 15.0));
+            p = P::fmadd(p, s, P::set1(1.0 / 13.0));
+            p = P::fmadd(p, s, P::set1(1.0 / 11.0));
+            p = P::fmadd(p, s, P::set1(1.0 / 9.0));
+            p = P::fmadd(p, s, P::set1(1.0 / 7.0));
+            p = P::fmadd(p, s, P::set1(1.0 / 5.0));
+            p = P::fmadd(p, s, P::set1(1.0 / 3.0));
+            // log(m) = 2f + 2f*s*p
+            P::Type f2 = P::add(f, f);
+            P::Type log_m = P::fmadd(P::mul(f2, s), p, f2);
+            P::Type y = P::fmadd(e, P::set1(math21_simd_ln2_lo), log_m);
+            return P::fmadd(e, P::set1(math21_simd_ln2_hi), y);
+        }
+
+        // x = k*pi/2 + r, |r| <= pi/4 about, k is returned in the low bits of k_bits.
+        // x - k*pio2_1 and x - k*pio2_1 - k*pio2_2 are exact, so r keeps its precision near multiples of pi/2.
+        inline P::Type math21_simd_rem_pio2(P::Type x, P::TypeI &k_bits) {
+            P::Type t = P::fmadd(x, P::set1(math21_simd_2_over_pi), P::set1(math21_simd_round_magic));
+            P::Type k = P::sub(t, P::set1(math21_simd_round_magic));
+            k_bits = P::subInt(P::asInt(t), P::asInt(P::set1(math21_simd_round_magic)));
+            P::Type r = P::fmadd(k, P::set1(-math21_simd_pio2_1), x);
+            r = P::fmadd(k, P::set1(-math21_simd_pio2_2), r);
+            return P::fmadd(k, P::set1(-math21_simd_pio2_3), r);
+        }
+
+        // sin(r) and cos(r) for |r| <= pi/4, minimax polynomials of fdlibm __kernel_sin and __kernel_cos.
+        inline void math21_simd_sincos_kernel(P::Type r, P::Type &s, P::Type &c) {
+            P::Type z = P::mul(r, r);
+            P::Type p = P::set1(1.58969099521155010221e-10);
+            p = P::fmadd(p, z, P::set1(-2.50507602534068634195e-08));
+            p = P::fmadd(p, z, P::set1(2.75573137070700676789e-06));
+            p = P::fmadd(p, z, P::set1(-1.98412698298579493134e-04));
+            p = P::fmadd(p, z, P::set1(8.33333333332248946124e-03));
+            p = P::fmadd(p, z, P::set1(-1.66666666666666324348e-01));
+            // s = r + r*z*p
+            s = P::fmadd(P::mul(r, z), p, r);
+
+            P::Type q = P::set1(-1.13596475577881948265e-11);
+            q = P::fmadd(q, z, P::set1(2.08757232129817482790e-09));
+            q = P::fmadd(q, z, P::set1(-2.75573143513906633035e-07));
+            q = P::fmadd(q, z, P::set1(2.48015872894767294178e-05));
+            q = P::fmadd(q, z, P::set1(-1.38888888888741095749e-03));
+            q = P::fmadd(q, z, P::set1(4.16666666666666019037e-02));
+            // c = 1 - z/2 + z*z*q
+            c = P::fmadd(P::mul(z, z), q, P::sub(P::set1(1.0), P::mul(z, P::set1(0.5))));
+        }
+
+        // sin(x + quadrant*pi/2), x = k*pi/2 + r, so it is +-sin(r) or +-cos(r) by (k + quadrant) mod 4.
+        inline P::Type math21_simd_sin(P::Type x, NumN quadrant) {
+            P::TypeI k;
+            P::Type r = math21_simd_rem_pio2(x, k);
+            P::Type s, c;
+            math21_simd_sincos_kernel(r, s, c);
+            k = P::addInt(k, P::set1Int(quadrant));
+            // 0 - (k & 1) has all bits set when k is odd.
+            P::Type is_odd = P::asReal(P::subInt(P::set1Int(0), P::andInt(k, P::set1Int(1))));
+            P::Type y = P::select(is_odd, c, s);
+            // sign bit set when bit 1 of k is set.
+            P::TypeI sign = P::andInt(P::subInt(P::set1Int(0), P::andInt(k, P::set1Int(2))),
+                                      P::set1Int(0x8000000000000000ULL));
+            return P::asReal(P::xorInt(P::asInt(y), sign));
+        }
+
+        // W windows at a time, element (i2, i3) of the windows is gathered by window_offset.
+        // Comparisons and sums go in the same order as the scalar loop, so results are the same.
+        template<NumN MK, NumN NK>
+        void math21_simd_pooling_max(NumN mk, NumN nk, NumN n, const NumN32 *window_offset,
+                                     const NumR *x, NumN ld, NumR *y, NumN32 *argmax) {
+            if (MK) mk = MK;
+            if (NK) nk = NK;
+            NumN p = 0, w;
+            NumR offset[P::W];
+            for (; p + P::W <= n; p += P::W) {
+                P::Type max = P::gather(x, window_offset + p);
+                P::Type max_offset = P::set1(0);
+                for (NumN i2 = 0; i2 < mk; ++i2) {
+                    for (NumN i3 = i2 == 0 ? 1 : 0; i3 < nk; ++i3) {
+                        NumN e = i2 * ld + i3;
+                        P::Type v = P::gather(x + e, window_offset + p);
+                        P::Type mask = P::gt(v, max);
+                        max = P::select(mask, v, max);
+                        max_offset = P::select(mask, P::set1((NumR) e), max_offset);
+                    }
+                }
+                P::store(y + p, max);
+                if (argmax) {
+                    P::store(offset, max_offset);
+                    for (w = 0; w < P::W; ++w) {
+                        argmax[p + w] = window_offset[p + w] + (NumN32) offset[w];
+                    }
+                }
+            }
+            for (; p < n; ++p) {
+                const NumR *x_p = x + window_offset[p];
+                NumR max = x_p[0];
+                NumN32 max_offset = 0;
+                for (NumN i2 = 0; i2 < mk; ++i2) {
+                    for (NumN i3 = 0; i3 < nk; ++i3) {
+                        if (x_p[i2 * ld + i3] > max) {
+                            max = x_p[i2 * ld + i3];
+                            max_offset = (NumN32) (i2 * ld + i3);
+                        }
+                    }
+                }
+                y[p] = max;
+                if (argmax) {
+                    argmax[p] = window_offset[p] + max_offset;
+                }
+            }
+        }
+
+        // isVector = 0 does all windows by the scalar loop.
+        template<NumN MK, NumN NK>
+        void math21_simd_pooling_average(NumN mk, NumN nk, NumN n, const NumN32 *window_offset,
+                                         const NumR *x, NumN ld, NumR *y, NumB isVector = 1) {
+            if (MK) mk = MK;
+            if (NK) nk = NK;
+            NumN p = 0;
+            P::Type k = P::set1((NumR) (mk * nk));
+            for (; isVector && p + P::W <= n; p += P::W) {
+                P::Type sum = P::set1(0);
+                for (NumN i2 = 0; i2 < mk; ++i2) {
+                    for (NumN i3 = 0; i3 < nk; ++i3) {
+                        sum = P::add(sum, P::gather(x + i2 * ld + i3, window_offset + p));
+                    }
+                }
+                P::store(y + p, P::div(sum, k));
+            }
+            for (; p < n; ++p) {
+                const NumR *x_p = x + window_offset[p];
+                NumR sum = 0;
+                for (NumN i2 = 0; i2 < mk; ++i2) {
+                    for (NumN i3 = 0; i3 < nk; ++i3) {
+                        sum = sum + x_p[i2 * ld + i3];
+                    }
+                }
+                y[p] = sum / (mk * nk);
+            }
+        }
+    }
+
+    using namespace detail;
+
+    const char *math21_c_vector_get_simd_name() {
+#if defined(MATH21_SIMD_AVX2)
+        return "avx2";
+#elif defined(MATH21_SIMD_SSE2)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    void math21_c_vector_add(NumN n, NumR k, const NumR *x, NumR *y) {
+        NumN i = 0;
+        P::Type k_p = P::set1(k);
+        for (; i + P::W <= n; i += P::W) {
+            P::store(y + i, P::add(k_p, P::load(x + i)));
+        }
+        for (; i < n; ++i) y[i] = k + x[i];
+    }
+
+    void math21_c_vector_add(NumN n, const NumR *A, const NumR *B, NumR *C) {
+        NumN i = 0;
+        for (; i + P::W <= n; i += P::W) {
+            P::store(C + i, P::add(P::load(A + i), P::load(B + i)));
+        }
+        for (; i < n; ++i) C[i] = A[i] + B[i];
+    }
+
+    void math21_c_vector_SchurProduct(NumN n, const NumR *A, const NumR *B, NumR *C) {
+        NumN i = 0;
+        for (; i + P::W <= n; i += P::W) {
+            P::store(C + i, P::mul(P::load(A + i), P::load(B + i)));
+        }
+        for (; i < n; ++i) C[i] = A[i] * B[i];
+    }
+
+    void math21_c_vector_linear(NumN n, NumR k1, const NumR *A, NumR *C) {
+        NumN i = 0;
+        P::Type k1_p = P::set1(k1);
+        for (; i + P::W <= n; i += P::W) {
+            P::store(C + i, P::mul(k1_p, P::load(A + i)));
+        }
+        for (; i < n; ++i) C[i] = k1 * A[i];
+    }
+
+    void math21_c_vector_linear(NumN n, NumR k1, const NumR *A, NumR k2, const NumR *B, NumR *C) {
+        NumN i = 0;
+        P::Type k1_p = P::set1(k1);
+        P::Type k2_p = P::set1(k2);
+        for (; i + P::W <= n; i += P::W) {
+            P::store(C + i, P::add(P::mul(k1_p, P::load(A + i)), P::mul(k2_p, P::load(B + i))));
+        }
+        for (; i < n; ++i) C[i] = k1 * A[i] + k2 * B[i];
+    }
+
+    NumR math21_c_vector_InnerProduct(NumN n, NumR k, const NumR *A, const NumR *B) {
+        if (k == 0) {
+            return 0;
+        }
+        NumN i = 0;
+        // two accumulators hide the add latency.
+        P::Type s0 = P::set1(0);
+        P::Type s1 = P::set1(0);
+        for (; i + 2 * P::W <= n; i += 2 * P::W) {
+            s0 = P::fmadd(P::load(A + i), P::load(B + i), s0);
+            s1 = P::fmadd(P::load(A + i + P::W), P::load(B + i + P::W), s1);
+        }
+        NumR y = P::sum(P::add(s0, s1));
+        for (; i < n; ++i) y += A[i] * B[i];
+        return k * y;
+    }
+
+    void math21_c_vector_exp(NumN n, const NumR *x, NumR *y) {
+        NumN i = 0, j;
+        for (; i + P::W <= n; i += P::W) {
+            P::Type x_p = P::load(x + i);
+            if (P::isAllInRange(x_p, math21_simd_exp_min, math21_simd_exp_max)) {
+                P::store(y + i, math21_simd_exp(x_p));
+            } else {
+                for (j = i; j < i + P::W; ++j) y[j] = std::exp(x[j]);
+            }
+        }
+        for (; i < n; ++i) y[i] = std::exp(x[i]);
+    }
+
+    void math21_c_vector_log(NumN n, const NumR *x, NumR *y) {
+        NumN i = 0, j;
+        for (; i + P::W <= n; i += P::W) {
+            P::Type x_p = P::load(x + i);
+            if (P::isAllInRange(x_p, math21_simd_real_min, math21_simd_real_max)) {
+                P::store(y + i, math21_simd_log(x_p));
+            } else {
+                for (j = i; j < i + P::W; ++j) y[j] = std::log(x[j]);
+            }
+        }
+        for (; i < n; ++i) y[i] = std::log(x[i]);
+    }
+
+    void math21_c_vector_sqrt(NumN n, const NumR *x, NumR *y) {
+        NumN i = 0;
+        for (; i + P::W <= n; i += P::W) {
+            P::store(y + i, P::sqrt(P::load(x + i)));
+        }
+        for (; i < n; ++i) y[i] = std::sqrt(x[i]);
+    }
+
+    void math21_c_vector_sin(NumN n, const NumR *x, NumR *y) {
+        NumN i = 0, j;
+        for (; i + P::W <= n; i += P::W) {
+            P::Type x_p = P::load(x + i);
+            if (P::isAllInRange(x_p, -math21_simd_trig_max, math21_simd_trig_max)) {
+                P::store(y + i, math21_simd_sin(x_p, 0));
+            } else {
+                for (j = i; j < i + P::W; ++j) y[j] = std::sin(x[j]);
+            }
+        }
+        for (; i < n; ++i) y[i] = std::sin(x[i]);
+    }
+
+    // cos(x) = sin(x + pi/2)
+    void math21_c_vector_cos(NumN n, const NumR *x, NumR *y) {
+        NumN i = 0, j;
+        for (; i + P::W <= n; i += P::W) {
+            P::Type x_p = P::load(x + i);
+            if (P::isAllInRange(x_p, -math21_simd_trig_max, math21_simd_trig_max)) {
+                P::store(y + i, math21_simd_sin(x_p, 1));
+            } else {
+                for (j = i; j < i + P::W; ++j) y[j] = std::cos(x[j]);
+            }
+        }
+        for (; i < n; ++i) y[i] = std::cos(x[i]);
+    }
+
+    // 2*2 and 3*3 windows are unrolled.
+    void math21_c_vector_pooling_max(NumN mk, NumN nk, NumN n, const NumN32 *window_offset,
+                                     const NumR *x, NumN ld, NumR *y, NumN32 *argmax) {
+        if (n == 0) {
+            return;
+        }
+        MATH21_ASSERT(window_offset[n - 1] + (mk - 1) * ld + nk <= ((NumN) 1 << 31), "offsets too large to gather")
+        if (mk == 2 && nk == 2) {
+            math21_simd_pooling_max<2, 2>(mk, nk, n, window_offset, x, ld, y, argmax);
+        } else if (mk == 3 && nk == 3) {
+            math21_simd_pooling_max<3, 3>(mk, nk, n, window_offset, x, ld, y, argmax);
+        } else {
+            math21_simd_pooling_max<0, 0>(mk, nk, n, window_offset, x, ld, y, argmax);
+        }
+    }
+
+    void math21_c_vector_pooling_average(NumN mk, NumN nk, NumN n, const NumN32 *window_offset,
+                                         const NumR *x, NumN ld, NumR *y) {
+        if (n == 0) {
+            return;
+        }
+        MATH21_ASSERT(window_offset[n - 1] + (mk - 1) * ld + nk <= ((NumN) 1 << 31), "offsets too large to gather")
+        if (mk == 2 && nk == 2) {
+            // With SSE2, gathering two numbers for 4 adds is slower than the scalar loop.
+#if defined(MATH21_SIMD_SSE2)
+            math21_simd_pooling_average<2, 2>(mk, nk, n, window_offset, x, ld, y, 0);
+#else
+            math21_simd_pooling_average<2, 2>(mk, nk, n, window_offset, x, ld, y);
+#endif
+        } else if (mk == 3 && nk == 3) {
+            math21_simd_pooling_average<3, 3>(mk, nk, n, window_offset, x, ld, y);
+        } else {
+            math21_simd_pooling_average<0, 0>(mk, nk, n, window_offset, x, ld, y);
+        }
+    }
+
+    void math21_c_vector_clip_zero_and_pos_inf(NumN n, NumR *x) {
+        for (NumN i = 0; i < n; ++i) {
+            if (std::isinf(x[i])) {
+                x[i] = MATH21_MAX;
+            } else if (x[i] == 0) {
+                x[i] = MATH21_EPS;
+            }
+        }
+    }
+}
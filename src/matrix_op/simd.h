@@ -0,0 +1,78 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include "inner.h"
+
+namespace math21 {
+
+    /*
+     * Elementwise kernels on raw continuous data of n numbers.
+     * AVX2 (MATH21_FLAG_USE_AVX2) or SSE2 is used when the compiler targets it, scalar code otherwise.
+     * Output may be the same as one of the inputs, but must not overlap partially.
+     *
+     * exp and log are polynomial approximations after range reduction,
+     * relative error is below 5e-16, i.e., a few ulp.
+     * sin and cos reduce x by pi/2 in three parts, then use polynomials on [-pi/4, pi/4],
+     * absolute error is below 2e-16 for |x| <= 2^19.
+     * Numbers out of the normal range (inf, nan, subnormal, overflow, |x| > 2^19 for sin and cos)
+     * fall back to std functions.
+     * */
+
+    // return "avx2", "sse2" or "scalar".
+    const char *math21_c_vector_get_simd_name();
+
+    // y = k + x
+    void math21_c_vector_add(NumN n, NumR k, const NumR *x, NumR *y);
+
+    // C = A + B
+    void math21_c_vector_add(NumN n, const NumR *A, const NumR *B, NumR *C);
+
+    // C = A * B
+    void math21_c_vector_SchurProduct(NumN n, const NumR *A, const NumR *B, NumR *C);
+
+    // C = k1*A
+    void math21_c_vector_linear(NumN n, NumR k1, const NumR *A, NumR *C);
+
+    // C = k1*A + k2*B
+    void math21_c_vector_linear(NumN n, NumR k1, const NumR *A, NumR k2, const NumR *B, NumR *C);
+
+    // return k * <A, B>
+    NumR math21_c_vector_InnerProduct(NumN n, NumR k, const NumR *A, const NumR *B);
+
+    void math21_c_vector_exp(NumN n, const NumR *x, NumR *y);
+
+    void math21_c_vector_log(NumN n, const NumR *x, NumR *y);
+
+    void math21_c_vector_sqrt(NumN n, const NumR *x, NumR *y);
+
+    void math21_c_vector_sin(NumN n, const NumR *x, NumR *y);
+
+    void math21_c_vector_cos(NumN n, const NumR *x, NumR *y);
+
+    // y[p] = max of mk*nk window at x + window_offset[p] with rows ld apart, p = 0, ..., n-1.
+    // argmax, if not 0, gets window_offset[p] + offset of the first max in row-major order.
+    // W windows are done at a time, their elements gathered by offset. Window offsets must be below 2^31.
+    void math21_c_vector_pooling_max(NumN mk, NumN nk, NumN n, const NumN32 *window_offset,
+                                     const NumR *x, NumN ld, NumR *y, NumN32 *argmax);
+
+    // y[p] = average of the window, as math21_c_vector_pooling_max.
+    void math21_c_vector_pooling_average(NumN mk, NumN nk, NumN n, const NumN32 *window_offset,
+                                         const NumR *x, NumN ld, NumR *y);
+
+    // same as math21_operator_container_clip_zero_and_pos_inf
+    void math21_c_vector_clip_zero_and_pos_inf(NumN n, NumR *x);
+}
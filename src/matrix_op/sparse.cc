@@ -0,0 +1,465 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#include <algorithm>
+#include "sparse.h"
+
+namespace math21 {
+
+    namespace detail {
+        // products with less work than this run in one thread, work is about number of multiply-adds.
+        const NumN math21_sparse_min_work_per_thread = 1 << 15;
+
+        int math21_sparse_compute_num_threads(NumN work) {
+#ifdef MATH21_FLAG_USE_OPENMP
+            NumN tn = (NumN) omp_get_max_threads();
+            NumN n = work / math21_sparse_min_work_per_thread;
+            if (n < tn) {
+                tn = n;
+            }
+            if (tn < 1) {
+                tn = 1;
+            }
+            return (int) tn;
+#else
+            return 1;
+#endif
+        }
+
+        // majors bounds[t], ..., bounds[t+1]-1 go to thread t, each thread has about nnz/tn nonzeros.
+        void math21_sparse_partition(NumN n, const NumN *ptr, NumN tn, std::vector<NumN> &bounds) {
+            bounds.resize(tn + 1);
+            bounds[0] = 0;
+            for (NumN t = 1; t < tn; ++t) {
+                NumN target = (NumN) ((NumR) ptr[n] * t / tn);
+                NumN i = (NumN) (std::lower_bound(ptr, ptr + n + 1, target) - ptr);
+                bounds[t] = xjmax(xjmin(i, n), bounds[t - 1]);
+            }
+            bounds[tn] = n;
+        }
+
+        NumB math21_sparse_is_c_compatible(const MatR &A) {
+            return A.isContinuous() && !A.isColumnMajor();
+        }
+
+        // raw row-major data of A, copied to A_c if A isn't continuous.
+        const NumR *math21_sparse_get_data(const MatR &A, MatR &A_c) {
+            if (math21_sparse_is_c_compatible(A)) {
+                return math21_memory_tensor_data_address(A);
+            }
+            A_c.setSize(A.shape());
+            math21_operator_container_set(A, A_c);
+            return math21_memory_tensor_data_address((const MatR &) A_c);
+        }
+
+        // y = beta*y, y has size m.
+        inline void math21_sparse_scale(NumN m, NumR beta, NumR *y) {
+            if (beta == 0) {
+                for (NumN j = 0; j < m; ++j) y[j] = 0;
+            } else if (beta != 1) {
+                for (NumN j = 0; j < m; ++j) y[j] *= beta;
+            }
+        }
+
+        // Y(i, :) = beta*Y(i, :) + s*sum_k values[k]*X(indexes[k], :), i = 0, ..., n-1 are majors.
+        void math21_c_sparse_gather(NumN n, NumN m, const NumN *ptr, const NumN *idx, const NumR *val,
+                                    NumR s, const NumR *X, NumN ldx, NumR beta, NumR *Y, NumN ldy) {
+            NumN tn = (NumN) math21_sparse_compute_num_threads((ptr[n] + n) * m);
+            std::vector<NumN> bounds;
+            math21_sparse_partition(n, ptr, tn, bounds);
+#pragma omp parallel for num_threads(tn) schedule(static)
+            for (NumN t = 0; t < tn; ++t) {
+                for (NumN i = bounds[t]; i < bounds[t + 1]; ++i) {
+                    NumR *y = Y + i * ldy;
+                    if (m == 1) {
+                        NumR sum = 0;
+                        for (NumN k = ptr[i]; k < ptr[i + 1]; ++k) {
+                            sum += val[k] * X[idx[k] * ldx];
+                        }
+                        y[0] = beta == 0 ? s * sum : beta * y[0] + s * sum;
+                    } else {
+                        math21_sparse_scale(m, beta, y);
+                        for (NumN k = ptr[i]; k < ptr[i + 1]; ++k) {
+                            NumR a = s * val[k];
+                            const NumR *x = X + idx[k] * ldx;
+                            for (NumN j = 0; j < m; ++j) {
+                                y[j] += a * x[j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Y(indexes[k], j0:j1) += s*values[k]*X(i, j0:j1), majors i = i0, ..., i1-1.
+        void math21_c_sparse_scatter_range(NumN i0, NumN i1, NumN j0, NumN j1, const NumN *ptr, const NumN *idx,
+                                           const NumR *val, NumR s, const NumR *X, NumN ldx, NumR *Y, NumN ldy) {
+            for (NumN i = i0; i < i1; ++i) {
+                const NumR *x = X + i * ldx;
+                for (NumN k = ptr[i]; k < ptr[i + 1]; ++k) {
+                    NumR a = s * val[k];
+                    NumR *y = Y + idx[k] * ldy;
+                    for (NumN j = j0; j < j1; ++j) {
+                        y[j] += a * x[j];
+                    }
+                }
+            }
+        }
+
+        /*
+         * Y(indexes[k], :) += s*values[k]*X(i, :) for majors i = 0, ..., n-1, after Y = beta*Y. Y has n_out rows.
+         * Threads own columns of Y if there are enough, otherwise own copies of Y which are summed at last.
+         * */
+        void math21_c_sparse_scatter(NumN n, NumN n_out, NumN m, const NumN *ptr, const NumN *idx, const NumR *val,
+                                     NumR s, const NumR *X, NumN ldx, NumR beta, NumR *Y, NumN ldy) {
+            for (NumN i = 0; i < n_out; ++i) {
+                math21_sparse_scale(m, beta, Y + i * ldy);
+            }
+            NumN tn = (NumN) math21_sparse_compute_num_threads(ptr[n] * m);
+            if (tn == 1) {
+                math21_c_sparse_scatter_range(0, n, 0, m, ptr, idx, val, s, X, ldx, Y, ldy);
+            } else if (m >= tn) {
+#pragma omp parallel for num_threads(tn) schedule(static)
+                for (NumN t = 0; t < tn; ++t) {
+                    math21_c_sparse_scatter_range(0, n, m * t / tn, m * (t + 1) / tn,
+                                                  ptr, idx, val, s, X, ldx, Y, ldy);
+                }
+            } else {
+                // thread 0 writes to Y.
+                std::vector<NumN> bounds;
+                math21_sparse_partition(n, ptr, tn, bounds);
+                std::vector<NumR> buffer((tn - 1) * n_out * m, 0);
+#pragma omp parallel num_threads(tn)
+                {
+#pragma omp for schedule(static)
+                    for (NumN t = 0; t < tn; ++t) {
+                        if (t == 0) {
+                            math21_c_sparse_scatter_range(bounds[t], bounds[t + 1], 0, m,
+                                                          ptr, idx, val, s, X, ldx, Y, ldy);
+                        } else {
+                            math21_c_sparse_scatter_range(bounds[t], bounds[t + 1], 0, m,
+                                                          ptr, idx, val, s, X, ldx,
+                                                          buffer.data() + (t - 1) * n_out * m, m);
+                        }
+                    }
+#pragma omp for schedule(static)
+                    for (NumN i = 0; i < n_out; ++i) {
+                        NumR *y = Y + i * ldy;
+                        for (NumN t = 1; t < tn; ++t) {
+                            const NumR *b = buffer.data() + (t - 1) * n_out * m + i * m;
+                            for (NumN j = 0; j < m; ++j) {
+                                y[j] += b[j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // storage of A.transpose in the other format, i.e., CSR to CSC or CSC to CSR.
+        void math21_c_sparse_transpose(NumN n, NumN n_minor, const NumN *ptr, const NumN *idx, const NumR *val,
+                                       NumN *ptr_t, NumN *idx_t, NumR *val_t) {
+            for (NumN j = 0; j <= n_minor; ++j) {
+                ptr_t[j] = 0;
+            }
+            for (NumN k = 0; k < ptr[n]; ++k) {
+                ++ptr_t[idx[k] + 1];
+            }
+            for (NumN j = 0; j < n_minor; ++j) {
+                ptr_t[j + 1] += ptr_t[j];
+            }
+            std::vector<NumN> next(ptr_t, ptr_t + n_minor);
+            // majors are visited in order, so indexes of result are sorted.
+            for (NumN i = 0; i < n; ++i) {
+                for (NumN k = ptr[i]; k < ptr[i + 1]; ++k) {
+                    NumN q = next[idx[k]]++;
+                    idx_t[q] = i;
+                    val_t[q] = val[k];
+                }
+            }
+        }
+
+        /*
+         * C = s*A*B with A, B, C all read as CSR storage, B has m minors.
+         * Symbolic pass counts nonzeros of every row, numeric pass accumulates a row in dense acc.
+         * */
+        void math21_c_sparse_spgemm(const SpMatR &A, const SpMatR &B, NumN m, NumR s, SpMatR &C) {
+            NumN n = A.getMajorSize();
+            const NumN *pa = A.getPtr(), *ia = A.getIndexes();
+            const NumN *pb = B.getPtr(), *ib = B.getIndexes();
+            const NumR *va = A.getValues(), *vb = B.getValues();
+            NumN *pc = C.getPtr();
+
+            NumN work = 0;
+            for (NumN k = 0; k < pa[n]; ++k) {
+                work += pb[ia[k] + 1] - pb[ia[k]];
+            }
+            NumN tn = (NumN) math21_sparse_compute_num_threads(work + n);
+
+            pc[0] = 0;
+#pragma omp parallel num_threads(tn)
+            {
+                // mark[j] = i if column j is seen in row i.
+                std::vector<NumN> mark(m, n);
+#pragma omp for schedule(dynamic, 64)
+                for (NumN i = 0; i < n; ++i) {
+                    NumN count = 0;
+                    for (NumN ka = pa[i]; ka < pa[i + 1]; ++ka) {
+                        NumN k = ia[ka];
+                        for (NumN kb = pb[k]; kb < pb[k + 1]; ++kb) {
+                            if (mark[ib[kb]] != i) {
+                                mark[ib[kb]] = i;
+                                ++count;
+                            }
+                        }
+                    }
+                    pc[i + 1] = count;
+                }
+            }
+            for (NumN i = 0; i < n; ++i) {
+                pc[i + 1] += pc[i];
+            }
+            C.setNnz(pc[n]);
+            NumN *ic = C.getIndexes();
+            NumR *vc = C.getValues();
+
+#pragma omp parallel num_threads(tn)
+            {
+                std::vector<NumN> mark(m, n);
+                std::vector<NumR> acc(m);
+#pragma omp for schedule(dynamic, 64)
+                for (NumN i = 0; i < n; ++i) {
+                    NumN *cols = ic + pc[i];
+                    NumN q = 0;
+                    for (NumN ka = pa[i]; ka < pa[i + 1]; ++ka) {
+                        NumN k = ia[ka];
+                        NumR a = s * va[ka];
+                        for (NumN kb = pb[k]; kb < pb[k + 1]; ++kb) {
+                            NumN j = ib[kb];
+                            if (mark[j] != i) {
+                                mark[j] = i;
+                                acc[j] = a * vb[kb];
+                                cols[q++] = j;
+                            } else {
+                                acc[j] += a * vb[kb];
+                            }
+                        }
+                    }
+                    std::sort(cols, cols + q);
+                    for (NumN t = 0; t < q; ++t) {
+                        vc[pc[i] + t] = acc[cols[t]];
+                    }
+                }
+            }
+        }
+    }
+
+    void math21_operator_sparse_from_dense(const MatR &A, SpMatR &S, NumR threshold, NumB isColumnMajor) {
+        MATH21_ASSERT(!A.isEmpty(), "empty matrix");
+        NumN nr = A.nrows(), nc = A.ncols();
+        MatR A_c;
+        const NumR *a = detail::math21_sparse_get_data(A, A_c);
+        SpMatR B(nr, nc, isColumnMajor);
+        NumN n = B.getMajorSize(), n_minor = B.getMinorSize();
+        // A(major i, minor j) = a[i*s_major + j*s_minor]
+        NumN s_major = isColumnMajor ? 1 : nc;
+        NumN s_minor = isColumnMajor ? nc : 1;
+        NumN *ptr = B.getPtr();
+        NumN tn = (NumN) detail::math21_sparse_compute_num_threads(nr * nc);
+
+        ptr[0] = 0;
+#pragma omp parallel for num_threads(tn) schedule(static)
+        for (NumN i = 0; i < n; ++i) {
+            NumN count = 0;
+            for (NumN j = 0; j < n_minor; ++j) {
+                if (xjabs(a[i * s_major + j * s_minor]) > threshold) {
+                    ++count;
+                }
+            }
+            ptr[i + 1] = count;
+        }
+        for (NumN i = 0; i < n; ++i) {
+            ptr[i + 1] += ptr[i];
+        }
+        B.setNnz(ptr[n]);
+        NumN *idx = B.getIndexes();
+        NumR *val = B.getValues();
+#pragma omp parallel for num_threads(tn) schedule(static)
+        for (NumN i = 0; i < n; ++i) {
+            NumN k = ptr[i];
+            for (NumN j = 0; j < n_minor; ++j) {
+                NumR x = a[i * s_major + j * s_minor];
+                if (xjabs(x) > threshold) {
+                    idx[k] = j;
+                    val[k] = x;
+                    ++k;
+                }
+            }
+        }
+        S.swap(B);
+    }
+
+    void math21_operator_sparse_to_dense(const SpMatR &S, MatR &A) {
+        MATH21_ASSERT(!S.isEmpty(), "empty matrix");
+        MatR B(S.nrows(), S.ncols());
+        B = 0;
+        NumR *b = math21_memory_tensor_data_address(B);
+        NumN s_major = S.isColumnMajor() ? 1 : S.ncols();
+        NumN s_minor = S.isColumnMajor() ? S.ncols() : 1;
+        const NumN *ptr = S.getPtr(), *idx = S.getIndexes();
+        const NumR *val = S.getValues();
+        for (NumN i = 0; i < S.getMajorSize(); ++i) {
+            for (NumN k = ptr[i]; k < ptr[i + 1]; ++k) {
+                b[i * s_major + idx[k] * s_minor] = val[k];
+            }
+        }
+        A.swap(B);
+    }
+
+    void math21_operator_sparse_convert(const SpMatR &A, SpMatR &B, NumB isColumnMajor) {
+        if (A.isColumnMajor() == isColumnMajor) {
+            if (&A != &B) {
+                B = A;
+            }
+            return;
+        }
+        SpMatR C(A.nrows(), A.ncols(), isColumnMajor);
+        C.setNnz(A.nnz());
+        detail::math21_c_sparse_transpose(A.getMajorSize(), A.getMinorSize(), A.getPtr(), A.getIndexes(),
+                                          A.getValues(), C.getPtr(), C.getIndexes(), C.getValues());
+        B.swap(C);
+    }
+
+    void math21_operator_sparse_transpose(const SpMatR &A, SpMatR &B) {
+        SpMatR C(A.ncols(), A.nrows(), !A.isColumnMajor());
+        C.setNnz(A.nnz());
+        std::copy(A.getPtr(), A.getPtr() + A.getMajorSize() + 1, C.getPtr());
+        std::copy(A.getIndexes(), A.getIndexes() + A.nnz(), C.getIndexes());
+        std::copy(A.getValues(), A.getValues() + A.nnz(), C.getValues());
+        B.swap(C);
+    }
+
+    void math21_operator_sparse_gemm(NumB isTransA, NumR s, const SpMatR &A, const MatR &B,
+                                     NumR beta, MatR &C) {
+        MATH21_ASSERT(!A.isEmpty() && !B.isEmpty(), "empty matrix");
+        NumN n = isTransA ? A.ncols() : A.nrows();
+        NumN r = isTransA ? A.nrows() : A.ncols();
+        NumB isVector = B.dims() == 1;
+        NumN m = isVector ? 1 : B.ncols();
+        MATH21_ASSERT(B.nrows() == r, "matrix size doesn't match in *");
+        MATH21_ASSERT(&C != &B, "C can't be B");
+        if (C.nrows() != n || C.ncols() != m) {
+            MATH21_ASSERT(beta == 0, "C must have shape n*m when beta is not zero");
+            if (isVector) {
+                C.setSize(n);
+            } else {
+                C.setSize(n, m);
+            }
+        }
+
+        MatR B_c, C_c;
+        const NumR *b = detail::math21_sparse_get_data(B, B_c);
+        NumB isCopied = !detail::math21_sparse_is_c_compatible(C);
+        NumR *c;
+        if (isCopied) {
+            C_c.setSize(C.shape());
+            if (beta != 0) {
+                math21_operator_container_set(C, C_c);
+            }
+            c = math21_memory_tensor_data_address(C_c);
+        } else {
+            c = math21_memory_tensor_data_address(C);
+        }
+
+        // CSR A and CSC A.transpose are read by rows of C.
+        if (A.isColumnMajor() == isTransA) {
+            detail::math21_c_sparse_gather(n, m, A.getPtr(), A.getIndexes(), A.getValues(),
+                                           s, b, m, beta, c, m);
+        } else {
+            detail::math21_c_sparse_scatter(A.getMajorSize(), n, m, A.getPtr(), A.getIndexes(), A.getValues(),
+                                            s, b, m, beta, c, m);
+        }
+        if (isCopied) {
+            math21_operator_container_set(C_c, C);
+        }
+    }
+
+    void math21_operator_sparse_multiply(NumR s, const SpMatR &A, const MatR &B, MatR &C) {
+        math21_operator_sparse_gemm(0, s, A, B, 0, C);
+    }
+
+    void math21_operator_sparse_multiply(NumR s, const MatR &A, const SpMatR &B, MatR &C) {
+        MATH21_ASSERT(!A.isEmpty() && !B.isEmpty(), "empty matrix");
+        NumN n = A.nrows(), r = A.ncols(), m = B.ncols();
+        MATH21_ASSERT(B.nrows() == r, "matrix size doesn't match in *");
+        MATH21_ASSERT(&C != &A, "C can't be A");
+        MatR A_c, C_c;
+        const NumR *a = detail::math21_sparse_get_data(A, A_c);
+        C_c.setSize(n, m);
+        NumR *c = math21_memory_tensor_data_address(C_c);
+        const NumN *ptr = B.getPtr(), *idx = B.getIndexes();
+        const NumR *val = B.getValues();
+        NumB isCsc = B.isColumnMajor();
+        NumN tn = (NumN) detail::math21_sparse_compute_num_threads(n * (B.nnz() + m));
+
+        // rows of C are independent.
+#pragma omp parallel for num_threads(tn) schedule(static)
+        for (NumN i = 0; i < n; ++i) {
+            const NumR *a_i = a + i * r;
+            NumR *c_i = c + i * m;
+            if (!isCsc) {
+                detail::math21_sparse_scale(m, 0, c_i);
+                for (NumN k = 0; k < r; ++k) {
+                    if (a_i[k] == 0) {
+                        continue;
+                    }
+                    NumR a_ik = s * a_i[k];
+                    for (NumN q = ptr[k]; q < ptr[k + 1]; ++q) {
+                        c_i[idx[q]] += a_ik * val[q];
+                    }
+                }
+            } else {
+                for (NumN j = 0; j < m; ++j) {
+                    NumR sum = 0;
+                    for (NumN q = ptr[j]; q < ptr[j + 1]; ++q) {
+                        sum += a_i[idx[q]] * val[q];
+                    }
+                    c_i[j] = s * sum;
+                }
+            }
+        }
+        C.swap(C_c);
+    }
+
+    void math21_operator_sparse_multiply(NumR s, const SpMatR &A, const SpMatR &B, SpMatR &C) {
+        MATH21_ASSERT(!A.isEmpty() && !B.isEmpty(), "empty matrix");
+        MATH21_ASSERT(A.ncols() == B.nrows(), "matrix size doesn't match in *");
+        MATH21_ASSERT(&C != &A && &C != &B, "C can't be A or B");
+        SpMatR B_c;
+        const SpMatR *pB = &B;
+        if (B.isColumnMajor() != A.isColumnMajor()) {
+            math21_operator_sparse_convert(B, B_c, A.isColumnMajor());
+            pB = &B_c;
+        }
+        C.setSize(A.nrows(), B.ncols(), A.isColumnMajor());
+        if (!A.isColumnMajor()) {
+            detail::math21_c_sparse_spgemm(A, *pB, B.ncols(), s, C);
+        } else {
+            // CSC of C is CSR of C.transpose = B.transpose*A.transpose
+            detail::math21_c_sparse_spgemm(*pB, A, A.nrows(), s, C);
+        }
+    }
+}
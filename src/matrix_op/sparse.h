@@ -0,0 +1,289 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#pragma once
+
+#include <vector>
+#include "inner.h"
+
+namespace math21 {
+
+    /*
+     * Sparse matrix in compressed sparse row (CSR) or compressed sparse column (CSC) format.
+     * CSR: row i has values[k] at columns indexes[k], k = ptr[i-1], ..., ptr[i]-1, i = 1, ..., nrows.
+     * CSC is CSR with rows and columns swapped, i.e., CSC of A is stored as CSR of A.transpose.
+     * Indexes in ptr and indexes are 0-based for raw access, element access A(i, j) is 1-based as Tensor.
+     * Indexes in a row (column for CSC) are sorted and distinct. Zeros may be stored, e.x., after cancellation.
+     * Memory is O(nrows + nnz) for CSR, O(ncols + nnz) for CSC.
+     * */
+    template<typename T>
+    class SparseMatrix {
+    private:
+        NumN nr;
+        NumN nc;
+        NumB isCsc;
+        std::vector<NumN> ptr; // size is major size + 1
+        std::vector<NumN> indexes;
+        std::vector<T> values;
+
+        void init() {
+            nr = 0;
+            nc = 0;
+            isCsc = 0;
+            ptr.assign(1, 0);
+        }
+
+    public:
+        SparseMatrix() {
+            init();
+        }
+
+        SparseMatrix(NumN nr, NumN nc, NumB isColumnMajor = 0) {
+            init();
+            setSize(nr, nc, isColumnMajor);
+        }
+
+        virtual ~SparseMatrix() {
+        }
+
+        // all zeros, CSC if isColumnMajor.
+        void setSize(NumN nr, NumN nc, NumB isColumnMajor = 0) {
+            this->nr = nr;
+            this->nc = nc;
+            isCsc = isColumnMajor;
+            ptr.assign(getMajorSize() + 1, 0);
+            indexes.clear();
+            values.clear();
+        }
+
+        // size nnz of indexes and values, whose content and ptr are then set by caller.
+        void setNnz(NumN nnz) {
+            indexes.resize(nnz);
+            values.resize(nnz);
+        }
+
+        void clear() {
+            init();
+            indexes.clear();
+            values.clear();
+        }
+
+        NumB isEmpty() const {
+            return nr == 0 || nc == 0;
+        }
+
+        NumN nrows() const {
+            return nr;
+        }
+
+        NumN ncols() const {
+            return nc;
+        }
+
+        NumN nnz() const {
+            return ptr[getMajorSize()];
+        }
+
+        // 1 if CSC, 0 if CSR.
+        NumB isColumnMajor() const {
+            return isCsc;
+        }
+
+        // number of rows for CSR, number of columns for CSC.
+        NumN getMajorSize() const {
+            return isCsc ? nc : nr;
+        }
+
+        NumN getMinorSize() const {
+            return isCsc ? nr : nc;
+        }
+
+        const NumN *getPtr() const {
+            return ptr.data();
+        }
+
+        NumN *getPtr() {
+            return ptr.data();
+        }
+
+        const NumN *getIndexes() const {
+            return indexes.data();
+        }
+
+        NumN *getIndexes() {
+            return indexes.data();
+        }
+
+        const T *getValues() const {
+            return values.data();
+        }
+
+        T *getValues() {
+            return values.data();
+        }
+
+        // A(i, j), 0 if not stored. Binary search in row i (column j for CSC).
+        T operator()(NumN i, NumN j) const {
+            MATH21_ASSERT(i >= 1 && i <= nr && j >= 1 && j <= nc, "index out of range");
+            NumN major = isCsc ? j : i;
+            NumN minor = (isCsc ? i : j) - 1;
+            NumN lo = ptr[major - 1], hi = ptr[major];
+            while (lo < hi) {
+                NumN mid = lo + (hi - lo) / 2;
+                if (indexes[mid] < minor) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo < ptr[major] && indexes[lo] == minor) {
+                return values[lo];
+            }
+            return 0;
+        }
+
+        /*
+         * Set from triplets A(I(k), J(k)) = V(k), k = 1, ..., K. Indexes are 1-based, duplicates are summed.
+         * Time is O(nrows + ncols + K), entries are sorted by two bucket passes.
+         * */
+        void setFromTriplets(NumN nr, NumN nc, const VecN &I, const VecN &J, const Tensor<T> &V,
+                             NumB isColumnMajor = 0) {
+            MATH21_ASSERT(I.size() == J.size() && I.size() == V.size(), "triplets must have same size");
+            setSize(nr, nc, isColumnMajor);
+            NumN K = I.size();
+            NumN n_major = getMajorSize();
+            NumN n_minor = getMinorSize();
+            std::vector<NumN> major(K), minor(K);
+            for (NumN k = 1; k <= K; ++k) {
+                MATH21_ASSERT(I(k) >= 1 && I(k) <= nr && J(k) >= 1 && J(k) <= nc,
+                              "triplet " << k << " is out of range");
+                major[k - 1] = (isCsc ? J(k) : I(k)) - 1;
+                minor[k - 1] = (isCsc ? I(k) : J(k)) - 1;
+            }
+
+            // bucket by minor, then stably by major, so minor is sorted in every major.
+            std::vector<NumN> count(n_minor + 1, 0), by_minor(K), sorted(K);
+            for (NumN k = 0; k < K; ++k) {
+                ++count[minor[k] + 1];
+            }
+            for (NumN i = 0; i < n_minor; ++i) {
+                count[i + 1] += count[i];
+            }
+            for (NumN k = 0; k < K; ++k) {
+                by_minor[count[minor[k]]++] = k;
+            }
+            for (NumN k = 0; k < K; ++k) {
+                ++ptr[major[k] + 1];
+            }
+            for (NumN i = 0; i < n_major; ++i) {
+                ptr[i + 1] += ptr[i];
+            }
+            std::vector<NumN> next(ptr.begin(), ptr.end() - 1);
+            for (NumN t = 0; t < K; ++t) {
+                NumN k = by_minor[t];
+                sorted[next[major[k]]++] = k;
+            }
+
+            // merge duplicates
+            indexes.resize(K);
+            values.resize(K);
+            NumN nz = 0;
+            NumN start = 0;
+            for (NumN i = 0; i < n_major; ++i) {
+                NumN end = ptr[i + 1];
+                for (NumN t = start; t < end; ++t) {
+                    NumN k = sorted[t];
+                    if (nz > ptr[i] && indexes[nz - 1] == minor[k]) {
+                        values[nz - 1] += V(k + 1);
+                    } else {
+                        indexes[nz] = minor[k];
+                        values[nz] = V(k + 1);
+                        ++nz;
+                    }
+                }
+                start = end;
+                ptr[i + 1] = nz;
+            }
+            setNnz(nz);
+        }
+
+        void swap(SparseMatrix<T> &B) {
+            std::swap(nr, B.nr);
+            std::swap(nc, B.nc);
+            std::swap(isCsc, B.isCsc);
+            ptr.swap(B.ptr);
+            indexes.swap(B.indexes);
+            values.swap(B.values);
+        }
+
+        NumB log(const char *name = 0) const {
+            return log(std::cout, name);
+        }
+
+        // nonzeros as (i, j) value
+        NumB log(std::ostream &io, const char *name = 0) const {
+            if (name) {
+                io << "SparseMatrix " << name;
+            } else {
+                io << "SparseMatrix";
+            }
+            io << " (" << nr << "*" << nc << ", nnz " << nnz() << ", " << (isCsc ? "CSC" : "CSR") << "):\n";
+            for (NumN i = 0; i < getMajorSize(); ++i) {
+                for (NumN k = ptr[i]; k < ptr[i + 1]; ++k) {
+                    NumN r = isCsc ? indexes[k] + 1 : i + 1;
+                    NumN c = isCsc ? i + 1 : indexes[k] + 1;
+                    io << "(" << r << ", " << c << ") " << values[k] << "\n";
+                }
+            }
+            return 1;
+        }
+    };
+
+    typedef SparseMatrix<NumR> SpMatR;
+
+    // S = A with entries |A(i, j)| <= threshold dropped, CSC if isColumnMajor.
+    void math21_operator_sparse_from_dense(const MatR &A, SpMatR &S, NumR threshold = 0, NumB isColumnMajor = 0);
+
+    void math21_operator_sparse_to_dense(const SpMatR &S, MatR &A);
+
+    // B = A in CSC if isColumnMajor, otherwise in CSR. O(nrows + ncols + nnz).
+    void math21_operator_sparse_convert(const SpMatR &A, SpMatR &B, NumB isColumnMajor);
+
+    // B = A.transpose, same arrays with format swapped, so CSR A gives CSC B.
+    void math21_operator_sparse_transpose(const SpMatR &A, SpMatR &B);
+
+    /*
+     * C = s*op(A)*B + beta*C, op(A) is A or A.transpose, B and C dense.
+     * B can be a vector, then C is a vector, i.e., sparse matrix-vector product.
+     * C is resized if needed, which requires beta = 0. C can't be B.
+     * Rows of C are split among threads by number of nonzeros when A is read by rows,
+     * i.e., CSR A or CSC A.transpose, otherwise threads scatter to own columns or own copies of C.
+     * */
+    void math21_operator_sparse_gemm(NumB isTransA, NumR s, const SpMatR &A, const MatR &B,
+                                     NumR beta, MatR &C);
+
+    // C = s*A*B, B dense matrix or vector.
+    void math21_operator_sparse_multiply(NumR s, const SpMatR &A, const MatR &B, MatR &C);
+
+    // C = s*A*B, A dense, C dense.
+    void math21_operator_sparse_multiply(NumR s, const MatR &A, const SpMatR &B, MatR &C);
+
+    /*
+     * C = s*A*B, all sparse, C has format of A. B is converted if it has another format.
+     * Row by row (Gustavson), rows are split among threads.
+     * */
+    void math21_operator_sparse_multiply(NumR s, const SpMatR &A, const SpMatR &B, SpMatR &C);
+}
@@ -0,0 +1,319 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <cmath>
+#include "inner.h"
+
+namespace math21 {
+
+    /*
+     * Lazy elementwise expressions over continuous tensors.
+     * An expression is built by math21_expr and operators, and nothing is computed until
+     * math21_operator_evaluate, which runs one loop over all elements.
+     * e.x., C = exp(k1*A + k2*B) * D - 1 costs one pass, no intermediate tensor.
+     *     math21_operator_evaluate(math21_expr_exp(k1 * math21_expr(A) + k2 * math21_expr(B)) * math21_expr(D) - 1, C);
+     *
+     * Tensors in an expression must be continuous, have same size, and live until evaluation.
+     * Elements are paired by flat index, so tensors must also have same major order,
+     * unless they have at most one dimension greater than 1.
+     * Tensors are read element i by element i, so output may be one of the inputs.
+     * Numbers are computed in NumR.
+     * */
+
+    // base of expressions, E is the expression itself.
+    template<typename E>
+    struct TensorExpr {
+        const E &self() const {
+            return static_cast<const E &>(*this);
+        }
+    };
+
+    // major order of tensor in expression, 1: row-major, 2: column-major,
+    // 0: any, i.e., at most one dimension greater than 1, so flat index is the same for both.
+    template<typename T>
+    NumN math21_expr_tensor_major(const Tensor<T> &A) {
+        NumN n = 0;
+        for (NumN i = 1; i <= A.dims(); ++i) {
+            if (A.dim(i) > 1) {
+                ++n;
+            }
+        }
+        if (n <= 1) {
+            return 0;
+        }
+        return A.isColumnMajor() ? 2 : 1;
+    }
+
+    template<typename T>
+    struct TensorExprLeaf : public TensorExpr<TensorExprLeaf<T> > {
+        const Tensor<T> &A;
+        const T *data;
+
+        explicit TensorExprLeaf(const Tensor<T> &A) : A(A) {
+            MATH21_ASSERT(A.isContinuous(), "tensor in expression must be continuous, copy view first");
+            MATH21_ASSERT(!A.isEmpty(), "tensor in expression is empty");
+            data = math21_memory_tensor_data_address(A);
+        }
+
+        // i is 0-based.
+        NumR eval(NumN i) const {
+            return (NumR) data[i];
+        }
+
+        NumN size() const {
+            return A.volume();
+        }
+
+        // tensor giving shape of expression, 0 if none.
+        const ArrayN *shape() const {
+            return &A.shape();
+        }
+
+        // major order, 1: row-major, 2: column-major, 0: any.
+        NumN major() const {
+            return math21_expr_tensor_major(A);
+        }
+    };
+
+    struct TensorExprScalar : public TensorExpr<TensorExprScalar> {
+        NumR k;
+
+        explicit TensorExprScalar(NumR k) : k(k) {
+        }
+
+        NumR eval(NumN) const {
+            return k;
+        }
+
+        NumN size() const {
+            return 0;
+        }
+
+        const ArrayN *shape() const {
+            return 0;
+        }
+
+        NumN major() const {
+            return 0;
+        }
+    };
+
+    // Expressions are kept by value, except leaves which refer to tensors.
+    template<typename L, typename R, typename Op>
+    struct TensorExprBinary : public TensorExpr<TensorExprBinary<L, R, Op> > {
+        L x;
+        R y;
+
+        TensorExprBinary(const L &x, const R &y) : x(x), y(y) {
+            MATH21_ASSERT(x.size() == 0 || y.size() == 0 || x.size() == y.size(),
+                          "tensor size doesn't match in expression"
+                                  << "\n\tsize: " << x.size() << ", " << y.size());
+            MATH21_ASSERT(x.major() == 0 || y.major() == 0 || x.major() == y.major(),
+                          "tensor major order doesn't match in expression, copy to same order first");
+        }
+
+        NumR eval(NumN i) const {
+            return Op::apply(x.eval(i), y.eval(i));
+        }
+
+        NumN size() const {
+            return x.size() != 0 ? x.size() : y.size();
+        }
+
+        const ArrayN *shape() const {
+            return x.shape() != 0 ? x.shape() : y.shape();
+        }
+
+        NumN major() const {
+            return x.major() != 0 ? x.major() : y.major();
+        }
+    };
+
+    template<typename E, typename Op>
+    struct TensorExprUnary : public TensorExpr<TensorExprUnary<E, Op> > {
+        E x;
+
+        explicit TensorExprUnary(const E &x) : x(x) {
+        }
+
+        NumR eval(NumN i) const {
+            return Op::apply(x.eval(i));
+        }
+
+        NumN size() const {
+            return x.size();
+        }
+
+        const ArrayN *shape() const {
+            return x.shape();
+        }
+
+        NumN major() const {
+            return x.major();
+        }
+    };
+
+    namespace detail {
+        struct math21_expr_op_add {
+            static NumR apply(NumR a, NumR b) { return a + b; }
+        };
+
+        struct math21_expr_op_subtract {
+            static NumR apply(NumR a, NumR b) { return a - b; }
+        };
+
+        // elementwise, i.e., Schur product.
+        struct math21_expr_op_multiply {
+            static NumR apply(NumR a, NumR b) { return a * b; }
+        };
+
+        struct math21_expr_op_divide {
+            static NumR apply(NumR a, NumR b) { return a / b; }
+        };
+
+        struct math21_expr_op_negate {
+            static NumR apply(NumR a) { return -a; }
+        };
+
+        struct math21_expr_op_exp {
+            static NumR apply(NumR a) { return std::exp(a); }
+        };
+
+        struct math21_expr_op_log {
+            static NumR apply(NumR a) { return std::log(a); }
+        };
+
+        struct math21_expr_op_sqrt {
+            static NumR apply(NumR a) { return std::sqrt(a); }
+        };
+
+        struct math21_expr_op_sin {
+            static NumR apply(NumR a) { return std::sin(a); }
+        };
+
+        struct math21_expr_op_cos {
+            static NumR apply(NumR a) { return std::cos(a); }
+        };
+
+        struct math21_expr_op_square {
+            static NumR apply(NumR a) { return a * a; }
+        };
+
+        // max(a, 0), i.e., relu.
+        struct math21_expr_op_clip_zero {
+            static NumR apply(NumR a) { return a > 0 ? a : 0; }
+        };
+    }
+
+    template<typename T>
+    TensorExprLeaf<T> math21_expr(const Tensor<T> &A) {
+        return TensorExprLeaf<T>(A);
+    }
+
+#define MATH21_EXPR_BINARY_OPERATOR(OPERATOR, OP)                                                   \
+    template<typename L, typename R>                                                                \
+    TensorExprBinary<L, R, detail::OP>                                                              \
+    OPERATOR(const TensorExpr<L> &x, const TensorExpr<R> &y) {                                      \
+        return TensorExprBinary<L, R, detail::OP>(x.self(), y.self());                              \
+    }                                                                                               \
+                                                                                                    \
+    template<typename L>                                                                            \
+    TensorExprBinary<L, TensorExprScalar, detail::OP>                                               \
+    OPERATOR(const TensorExpr<L> &x, NumR k) {                                                      \
+        return TensorExprBinary<L, TensorExprScalar, detail::OP>(x.self(), TensorExprScalar(k));    \
+    }                                                                                               \
+                                                                                                    \
+    template<typename R>                                                                            \
+    TensorExprBinary<TensorExprScalar, R, detail::OP>                                               \
+    OPERATOR(NumR k, const TensorExpr<R> &y) {                                                      \
+        return TensorExprBinary<TensorExprScalar, R, detail::OP>(TensorExprScalar(k), y.self());    \
+    }
+
+    MATH21_EXPR_BINARY_OPERATOR(operator+, math21_expr_op_add)
+
+    MATH21_EXPR_BINARY_OPERATOR(operator-, math21_expr_op_subtract)
+
+    // elementwise
+    MATH21_EXPR_BINARY_OPERATOR(operator*, math21_expr_op_multiply)
+
+    MATH21_EXPR_BINARY_OPERATOR(operator/, math21_expr_op_divide)
+
+#undef MATH21_EXPR_BINARY_OPERATOR
+
+#define MATH21_EXPR_UNARY_FUNCTION(FUNCTION, OP)                         \
+    template<typename E>                                                 \
+    TensorExprUnary<E, detail::OP> FUNCTION(const TensorExpr<E> &x) {    \
+        return TensorExprUnary<E, detail::OP>(x.self());                 \
+    }
+
+    MATH21_EXPR_UNARY_FUNCTION(operator-, math21_expr_op_negate)
+
+    MATH21_EXPR_UNARY_FUNCTION(math21_expr_exp, math21_expr_op_exp)
+
+    MATH21_EXPR_UNARY_FUNCTION(math21_expr_log, math21_expr_op_log)
+
+    MATH21_EXPR_UNARY_FUNCTION(math21_expr_sqrt, math21_expr_op_sqrt)
+
+    MATH21_EXPR_UNARY_FUNCTION(math21_expr_sin, math21_expr_op_sin)
+
+    MATH21_EXPR_UNARY_FUNCTION(math21_expr_cos, math21_expr_op_cos)
+
+    MATH21_EXPR_UNARY_FUNCTION(math21_expr_square, math21_expr_op_square)
+
+    MATH21_EXPR_UNARY_FUNCTION(math21_expr_clip_zero, math21_expr_op_clip_zero)
+
+#undef MATH21_EXPR_UNARY_FUNCTION
+
+    // C = e, C is resized to shape of e and set to major order of e if needed.
+    // One pass over all elements, no intermediate tensor.
+    template<typename E, typename T>
+    void math21_operator_evaluate(const TensorExpr<E> &expr, Tensor<T> &C) {
+        const E &e = expr.self();
+        const ArrayN *shape = e.shape();
+        MATH21_ASSERT(shape != 0, "expression has no tensor")
+        if (C.isEmpty() || C.dims() != shape->size() || !C.isSameSize(*shape)) {
+            // e may read C only if they have same size, so C is free to be resized here.
+            C.setSize(*shape);
+        }
+        NumN major = e.major();
+        if (major != 0 && math21_expr_tensor_major(C) != major) {
+            // C is not read by e, otherwise they have same major order.
+            C.setColumnMajor(major == 2);
+        }
+        MATH21_ASSERT(C.isContinuous())
+        T *c = math21_memory_tensor_data_address(C);
+        NumN n = e.size();
+        for (NumN i = 0; i < n; ++i) {
+            c[i] = (T) e.eval(i);
+        }
+    }
+
+    // C += e
+    template<typename E, typename T>
+    void math21_operator_evaluate_add_to(const TensorExpr<E> &expr, Tensor<T> &C) {
+        const E &e = expr.self();
+        MATH21_ASSERT(C.isContinuous() && C.volume() == e.size(),
+                      "tensor size doesn't match in expression")
+        MATH21_ASSERT(e.major() == 0 || math21_expr_tensor_major(C) == 0 || e.major() == math21_expr_tensor_major(C),
+                      "tensor major order doesn't match in expression")
+        T *c = math21_memory_tensor_data_address(C);
+        NumN n = e.size();
+        for (NumN i = 0; i < n; ++i) {
+            c[i] = (T) (c[i] + e.eval(i));
+        }
+    }
+}
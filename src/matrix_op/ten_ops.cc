@@ -14,9 +14,141 @@ limitations under the License.
 ==============================================================================*/
 
 #include "inner.h"
+#include "ten_ops.h"
+#include "simd.h"
 
 namespace math21 {
 
+    namespace detail {
+        // data of A and B can be visited in the same order.
+        NumB math21_operator_tensor_is_c_compatible(const TenR &A, const TenR &B) {
+            if (A.isContinuous() && B.isContinuous() && A.isColumnMajor() == B.isColumnMajor()) {
+                return 1;
+            }
+            return 0;
+        }
+
+        NumB math21_operator_tensor_is_c_compatible(const TenR &A, const TenR &B, const TenR &C) {
+            return math21_operator_tensor_is_c_compatible(A, B) && math21_operator_tensor_is_c_compatible(A, C);
+        }
+    }
+
+    using namespace detail;
+
+    void math21_operator_add(NumR k, const TenR &x, TenR &y) {
+        MATH21_ASSERT(x.isEmpty() == 0);
+        MATH21_ASSERT(y.isSameSize(x.shape()));
+        if (math21_operator_tensor_is_c_compatible(x, y)) {
+            math21_c_vector_add(x.volume(), k, math21_memory_tensor_data_address(x),
+                                math21_memory_tensor_data_address(y));
+        } else {
+            math21_operator_container_add(k, x, y);
+        }
+    }
+
+    void math21_operator_sqrt(const TenR &X, TenR &Y) {
+        if (X.isEmpty()) {
+            return;
+        }
+        if (Y.isSameSize(X.shape()) == 0) {
+            Y.setSize(X.shape());
+        }
+        if (math21_operator_tensor_is_c_compatible(X, Y)) {
+            math21_c_vector_sqrt(X.volume(), math21_memory_tensor_data_address(X),
+                                 math21_memory_tensor_data_address(Y));
+        } else {
+            math21_operator_container_sqrt(X, Y);
+        }
+    }
+
+    void math21_operator_log(const TenR &X, TenR &Y) {
+        if (X.isEmpty()) {
+            return;
+        }
+        if (Y.isSameSize(X.shape()) == 0) {
+            Y.setSize(X.shape());
+        }
+        if (math21_operator_tensor_is_c_compatible(X, Y)) {
+            MATH21_ASSERT_CHECK_VALUE(math21_operator_container_is_larger_number(X, 0), "" << X.log("X"))
+            math21_c_vector_log(X.volume(), math21_memory_tensor_data_address(X),
+                                math21_memory_tensor_data_address(Y));
+            MATH21_ASSERT_FINITE(math21_operator_container_isfinite(Y))
+        } else {
+            math21_operator_container_log(X, Y);
+        }
+    }
+
+    void math21_operator_exp(const TenR &X, TenR &Y) {
+        if (X.isEmpty()) {
+            return;
+        }
+        if (Y.isSameSize(X.shape()) == 0) {
+            Y.setSize(X.shape());
+        }
+        if (math21_operator_tensor_is_c_compatible(X, Y)) {
+            NumR *y = math21_memory_tensor_data_address(Y);
+            math21_c_vector_exp(X.volume(), math21_memory_tensor_data_address(X), y);
+            math21_c_vector_clip_zero_and_pos_inf(Y.volume(), y);
+        } else {
+            math21_operator_container_exp(X, Y);
+        }
+    }
+
+    NumR math21_operator_InnerProduct(NumR k, const TenR &A, const TenR &B) {
+        MATH21_ASSERT(!A.isEmpty());
+        MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
+        if (math21_operator_tensor_is_c_compatible(A, B)) {
+            NumR y = math21_c_vector_InnerProduct(A.volume(), k, math21_memory_tensor_data_address(A),
+                                                  math21_memory_tensor_data_address(B));
+            MATH21_ASSERT_FINITE(math21_operator_isfinite(y))
+            return y;
+        }
+        return math21_operator_container_InnerProduct(k, A, B);
+    }
+
+    void math21_operator_add(const TenR &A, const TenR &B, TenR &C) {
+        MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
+        MATH21_ASSERT(A.isSameSize(C.shape()), "tensor size doesn't match");
+        if (math21_operator_tensor_is_c_compatible(A, B, C)) {
+            math21_c_vector_add(A.volume(), math21_memory_tensor_data_address(A),
+                                math21_memory_tensor_data_address(B), math21_memory_tensor_data_address(C));
+            MATH21_ASSERT_CHECK_VALUE_TMP(math21_operator_container_isfinite(C))
+        } else {
+            math21_operator_container_addToC(A, B, C);
+        }
+    }
+
+    void math21_operator_SchurProduct(const TenR &A, const TenR &B, TenR &C) {
+        MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
+        MATH21_ASSERT(A.isSameSize(C.shape()), "tensor size doesn't match");
+        if (math21_operator_tensor_is_c_compatible(A, B, C)) {
+            math21_c_vector_SchurProduct(A.volume(), math21_memory_tensor_data_address(A),
+                                         math21_memory_tensor_data_address(B), math21_memory_tensor_data_address(C));
+        } else {
+            math21_operator_container_SchurProduct(A, B, C);
+        }
+    }
+
+    void math21_operator_sin(const TenR &A, TenR &B) {
+        MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
+        if (math21_operator_tensor_is_c_compatible(A, B)) {
+            math21_c_vector_sin(A.volume(), math21_memory_tensor_data_address(A),
+                                math21_memory_tensor_data_address(B));
+        } else {
+            math21_operator_container_sin(A, B);
+        }
+    }
+
+    void math21_operator_cos(const TenR &A, TenR &B) {
+        MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
+        if (math21_operator_tensor_is_c_compatible(A, B)) {
+            math21_c_vector_cos(A.volume(), math21_memory_tensor_data_address(A),
+                                math21_memory_tensor_data_address(B));
+        } else {
+            math21_operator_container_cos(A, B);
+        }
+    }
+
     // C = k1*A
     void math21_operator_linear(NumR k1, const TenR &A, TenR &C) {
         MATH21_ASSERT(!A.isEmpty(), "empty matrix");
@@ -24,7 +156,12 @@ namespace math21 {
         if (C.isSameSize(A.shape()) == 0) {
             C.setSize(A.shape());
         }
-        math21_operator_container_linear(k1, A, C);
+        if (math21_operator_tensor_is_c_compatible(A, C)) {
+            math21_c_vector_linear(A.volume(), k1, math21_memory_tensor_data_address(A),
+                                   math21_memory_tensor_data_address(C));
+        } else {
+            math21_operator_container_linear(k1, A, C);
+        }
     }
 
     // !! Note: A, B can be vectors, C may still be vector.
@@ -41,6 +178,12 @@ namespace math21 {
         if (C.isSameSizeVirtually(A.shape()) == 0) {
             C.setSize(A.shape());
         }
-        math21_operator_container_linear(k1, A, k2, B, C);
+        if (math21_operator_tensor_is_c_compatible(A, B, C)) {
+            math21_c_vector_linear(A.volume(), k1, math21_memory_tensor_data_address(A),
+                                   k2, math21_memory_tensor_data_address(B), math21_memory_tensor_data_address(C));
+            MATH21_ASSERT_CHECK_VALUE_TMP(math21_operator_container_isfinite(C))
+        } else {
+            math21_operator_container_linear(k1, A, k2, B, C);
+        }
     }
 }
\ No newline at end of file
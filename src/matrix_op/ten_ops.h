@@ -106,6 +106,9 @@ namespace math21 {
     }
 
 
+    // NumR tensors with continuous data go to simd kernels, see simd.h.
+    void math21_operator_add(NumR k, const TenR &x, TenR &y);
+
     template<typename T>
     void math21_operator_add(NumR k, const Tensor <T> &x, TenR &y) {
         MATH21_ASSERT(x.isEmpty() == 0);
@@ -135,6 +138,8 @@ namespace math21 {
         math21_operator_container_divide_to(k, x);
     }
 
+    void math21_operator_sqrt(const TenR &X, TenR &Y);
+
     template<typename T>
     void math21_operator_sqrt(const Tensor <T> &X, TenR &Y) {
         if (X.isEmpty()) {
@@ -155,6 +160,8 @@ namespace math21 {
 
 //////////////
 
+    void math21_operator_log(const TenR &X, TenR &Y);
+
 // assign log(X) to Y, Y must have same with X.
     template<typename T>
     void math21_operator_log(const Tensor <T> &X, TenR &Y) {
@@ -168,6 +175,8 @@ namespace math21 {
         math21_operator_container_log(X, Y);
     }
 
+    void math21_operator_exp(const TenR &X, TenR &Y);
+
 // assign exp(X) to Y, Y must have same with X.
     template<typename S>
     void math21_operator_exp(const Tensor <S> &X, TenR &Y) {
@@ -229,6 +238,8 @@ namespace math21 {
         }
     }
 
+    NumR math21_operator_InnerProduct(NumR k, const TenR &A, const TenR &B);
+
 // Y can be X1, X2.
     template<typename T>
     NumR math21_operator_InnerProduct(NumR k, const Tensor <T> &A, const Tensor <T> &B) {
@@ -265,6 +276,83 @@ namespace math21 {
         return max;
     }
 
+    // Strided raw access of continuous tensor or strided view, see TensorView.
+    // return 1 if exists, then element (j1, ..., jn) of A is data[(j1-1)*stride(1) + ... + (jn-1)*stride(n)].
+    template<typename T>
+    NumB math21_memory_tensor_strided_address(const Tensor <T> &A, const T *&data, ArrayN &stride) {
+        if (A.isEmpty()) {
+            return 0;
+        }
+        if (A.isContinuous()) {
+            data = math21_memory_tensor_data_address(A);
+            math21_operator_tensor_continuous_strides(A, stride);
+            return 1;
+        }
+        if (A.getClassName() == "TensorView" || A.getClassName() == "TensorSub") {
+            const TensorView<T> &tv = (const TensorView<T> &) A;
+            if (tv.isStrided()) {
+                data = tv.getStridedData();
+                stride.setSize(tv.getStrides().size());
+                stride.assign(tv.getStrides());
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    template<typename T>
+    NumB math21_memory_tensor_strided_address(Tensor <T> &A, T *&data, ArrayN &stride) {
+        if (!A.isWritable()) {
+            return 0;
+        }
+        // TensorSub derives its strided data again if data is copied.
+        A.prepareWriting();
+        const T *p = 0;
+        if (!math21_memory_tensor_strided_address((const Tensor <T> &) A, p, stride)) {
+            return 0;
+        }
+        data = const_cast<T *>(p);
+        return 1;
+    }
+
+    namespace detail {
+        // assign B to A, both strided with shape d, the last dim is innermost.
+        template<typename T, typename S>
+        void math21_operator_tensor_strided_assign(const ArrayN &d, T *A, const ArrayN &stride_A,
+                                                   const S *B, const ArrayN &stride_B) {
+            NumN n = d.size();
+            NumN len = d(n);
+            NumN sa = stride_A(n);
+            NumN sb = stride_B(n);
+            ArrayN index(n);
+            index = 1;
+            NumN offset_A = 0, offset_B = 0;
+            NumN j, k;
+            while (1) {
+                T *a = A + offset_A;
+                const S *b = B + offset_B;
+                for (j = 0; j < len; ++j) {
+                    a[j * sa] = (T) b[j * sb];
+                }
+                // increase index from right, skip the innermost dim.
+                for (k = n - 1; k >= 1; --k) {
+                    if (index(k) < d(k)) {
+                        ++index(k);
+                        offset_A += stride_A(k);
+                        offset_B += stride_B(k);
+                        break;
+                    }
+                    offset_A -= (d(k) - 1) * stride_A(k);
+                    offset_B -= (d(k) - 1) * stride_B(k);
+                    index(k) = 1;
+                }
+                if (k == 0) {
+                    break;
+                }
+            }
+        }
+    }
+
     // assign B to A
     template<typename T, typename S>
     void math21_operator_tensor_assign_elementwise_no_recursive(Tensor <T> &A, const Tensor <S> &B) {
@@ -272,6 +360,14 @@ namespace math21 {
             return;
         }
         MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match in assign");
+        T *A_data = 0;
+        const S *B_data = 0;
+        ArrayN stride_A, stride_B;
+        if (math21_memory_tensor_strided_address(A, A_data, stride_A) &&
+            math21_memory_tensor_strided_address(B, B_data, stride_B)) {
+            detail::math21_operator_tensor_strided_assign(A.shape(), A_data, stride_A, B_data, stride_B);
+            return;
+        }
         VecN d;
         d.setSize(A.dims());
         d = 1;
@@ -319,6 +415,8 @@ namespace math21 {
 
 /////////////////////////////////
 
+    void math21_operator_add(const TenR &A, const TenR &B, TenR &C);
+
     // C=A+B
     template<typename T>
     void math21_operator_add(const Tensor <T> &A, const Tensor <T> &B, Tensor <T> &C) {
@@ -329,17 +427,16 @@ namespace math21 {
 
     template<typename T>
     void math21_operator_addToA(Tensor <T> &A, const Tensor <T> &B) {
-        MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
-        math21_operator_container_addToA(A, B);
-//        math21_operator_container_addToA(A, B);
+        math21_operator_add(A, B, A);
     }
 
     template<typename T>
     void math21_operator_addToB(const Tensor <T> &A, Tensor <T> &B) {
-        MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
-        math21_operator_container_addToB(A, B);
+        math21_operator_add(A, B, B);
     }
 
+    void math21_operator_SchurProduct(const TenR &A, const TenR &B, TenR &C);
+
     template<typename T>
     void math21_operator_SchurProduct(const Tensor <T> &A, const Tensor <T> &B, Tensor <T> &C) {
         MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
@@ -353,7 +450,7 @@ namespace math21 {
                 << "\n\tA.shape(): (" << A.shape() << ")"
                 << "\n\tB.shape(): (" << B.shape() << ")"
         );
-        math21_operator_container_SchurProduct_to_A(A, B);
+        math21_operator_SchurProduct(A, B, A);
     }
 
     template<typename T>
@@ -362,9 +459,13 @@ namespace math21 {
                 << "\n\tA.shape(): (" << A.shape() << ")"
                 << "\n\tB.shape(): (" << B.shape() << ")"
         );
-        math21_operator_container_SchurProduct_to_B(A, B);
+        math21_operator_SchurProduct(A, B, B);
     }
 
+    void math21_operator_sin(const TenR &A, TenR &B);
+
+    void math21_operator_cos(const TenR &A, TenR &B);
+
     template<typename T>
     void math21_operator_sin(const Tensor <T> &A, Tensor <T> &B) {
         MATH21_ASSERT(A.isSameSize(B.shape()), "tensor size doesn't match");
@@ -29,7 +29,7 @@ namespace math21 {
         io << "space paras:"
            << "\n\taddress: " << (void *) paras.address
            << "\n\tstart: " << (void *) paras.start
-           << "\n\tref_count: " << (paras.ref_count == 0 ? (0) : (*paras.ref_count))
+           << "\n\tref_count: " << (paras.ref_count == 0 ? (NumN) 0 : paras.ref_count->load())
            << "\n\tsize: " << paras.size
            << "\n\tunit: " << paras.unit << " in byte (char)."
            << std::endl;
@@ -89,18 +89,22 @@ namespace math21 {
 
     void AutoBuffer::allocate() {
         if (space_address == 0) {
-            math21_memory_malloc((void **) &space_address, sizeof(char) * nn);
-//            xjmemset(space_address, 0, sizeof(char) * nn);
-
-            MATH21_ASSERT((space_address != 0 && nn > 0) || (space_address == 0 && nn == 0));
-            space_start = space_address;
-            space_size = nn;
-            if (space_address) {
-                math21_memory_malloc((void **) &refcount, sizeof(*refcount));
-                *refcount = 1;
+            if (nn > 0 && nn <= MATH21_AUTOBUFFER_INLINE_SIZE) {
+                space_address = inline_space.c;
+                space_start = space_address;
+                space_size = nn;
+                refcount = 0;
+                return;
+            }
+            if (nn > 0) {
+                space_address = (char *) math21_memory_block_allocate(
+                        allocator ? *allocator : math21_memory_get_current_allocator(), sizeof(char) * nn);
+                refcount = math21_memory_block_refcount(space_address);
             } else {
                 refcount = 0;
             }
+            space_start = space_address;
+            space_size = nn;
         }
     }
 
@@ -111,6 +115,8 @@ namespace math21 {
         space_size = 0;
         nn = 0;
         refcount = 0;
+        is_cow = 0;
+        allocator = 0;
         name = "";
     }
 
@@ -119,6 +125,20 @@ namespace math21 {
         init();
     }
 
+    AutoBuffer::AutoBuffer(AutoBuffer &&B) noexcept {
+        init();
+        swap(B);
+    }
+
+    // allocator of this is kept.
+    AutoBuffer &AutoBuffer::operator=(AutoBuffer &&B) {
+        if (this != &B) {
+            clear();
+            swap(B);
+        }
+        return *this;
+    }
+
     NumN AutoBuffer::size() const {
         return nn;
     }
@@ -129,8 +149,7 @@ namespace math21 {
 
 
     void AutoBuffer::deallocate() {
-        math21_memory_free(space_address);
-        math21_memory_free(refcount);
+        math21_memory_block_free(space_address);
     }
 
 
@@ -143,8 +162,10 @@ namespace math21 {
         if (!isEmpty()) {
             if (refcount) {
 //                m21log(name, *refcount);
-                (*refcount)--;
-                if (*refcount == 0) {
+                // The only owner can't race with others, so it frees without atomic decrement.
+                // This is the usual case of buffers never shared.
+                if (refcount->load(std::memory_order_acquire) == 1 ||
+                    refcount->fetch_sub(1, std::memory_order_acq_rel) == 1) {
 //                    m21log(name, "data deallocate");
                     deallocate();
                 }
@@ -155,11 +176,12 @@ namespace math21 {
             space_start = 0;
             space_size = 0;
         }
+        is_cow = 0;
     }
 
 
-    NumB AutoBuffer::isIndependent() {
-        if (isEmpty() || (refcount && *refcount == 1)) {
+    NumB AutoBuffer::isIndependent() const {
+        if (isEmpty() || isInline() || (refcount && refcount->load(std::memory_order_acquire) == 1)) {
             return 1;
         } else {
             return 0;
@@ -170,23 +192,20 @@ namespace math21 {
     // Todo: remove xjmemset, don't clear to zero.
     void AutoBuffer::setSize(NumN n, const SpaceParas *paras) {
         if (paras == 0) {
+            // data is not kept, so copy-on-write space is just dropped.
+            if (is_cow) {
+                if (!isIndependent()) {
+                    clear();
+                }
+                is_cow = 0;
+            }
             MATH21_ASSERT(isIndependent(), "call ensureIndependence() or clear() first!\n"
                     << "\tname: " << name)
-            if (n == 0 || isEmpty() || !isIndependent()) {
+            // space is kept when size doesn't change.
+            if (n == 0 || isEmpty() || !isIndependent() || n != nn) {
                 clear();
                 nn = n;
                 allocate();
-            } else {
-                if (n != nn) {
-//                    xjrealloc((void**)&space_address, space_address, sizeof(char) * n);
-//                    NumZ newStorage = n - nn;
-//                    if (newStorage > 0)xjmemset(space_address + nn, 0, sizeof(char) * newStorage);
-                    math21_memory_malloc((void **) &space_address, sizeof(char) * n);
-//                    xjmemset(space_address, 0, sizeof(char) * n);
-                    nn = n;
-                    space_start = space_address;
-                    space_size = nn;
-                }
             }
         } else {
             setSpace(*paras);
@@ -197,9 +216,21 @@ namespace math21 {
         }
     }
 
+    void AutoBuffer::moveToHeap() {
+        if (!isInline()) {
+            return;
+        }
+        char *address = (char *) math21_memory_block_allocate(
+                allocator ? *allocator : math21_memory_get_current_allocator(), sizeof(char) * space_size);
+        math21_memory_memcpy(address, space_address, sizeof(char) * space_size);
+        refcount = math21_memory_block_refcount(address);
+        space_address = address;
+        space_start = address;
+    }
+
     void AutoBuffer::addref() {
         if (refcount) {
-            (*refcount)++;
+            refcount->fetch_add(1, std::memory_order_relaxed);
         }
 //        m21logDebug(*refcount);
     }
@@ -210,7 +241,7 @@ namespace math21 {
     }
 
 
-    NumN *AutoBuffer::getRefCount() const {
+    std::atomic<NumN> *AutoBuffer::getRefCount() const {
         return refcount;
     }
 
@@ -220,6 +251,22 @@ namespace math21 {
         return 1;
     }
 
+    int AutoBuffer::setDataCopyOnWrite(AutoBuffer &autoBuffer) {
+        MATH21_ASSERT(!autoBuffer.isInline(), "call moveToHeap() first")
+        if (&autoBuffer != this) {
+            setDataShallow(autoBuffer);
+        }
+        if (!isEmpty()) {
+            is_cow = 1;
+            autoBuffer.is_cow = 1;
+        }
+        return 1;
+    }
+
+    void AutoBuffer::setCopyOnWrite(NumB is_cow) {
+        this->is_cow = is_cow;
+    }
+
     int AutoBuffer::setDataDeep(const AutoBuffer &autoBuffer) {
         if (size() != autoBuffer.size()) {
             setSize(autoBuffer.size());
@@ -230,11 +277,12 @@ namespace math21 {
 
     void AutoBuffer::ensureIndependence() {
         if (!isEmpty() && !isIndependent()) {
-            const void *data = space_start;
-            NumN nn = size();
-            clear();
-            setSize(nn);
-            dataCopy(data);
+            // copy before releasing, because other owners may free the space once it's released.
+            AutoBuffer B;
+            B.setAllocator(allocator);
+            B.setSize(size());
+            B.dataCopy(space_start);
+            swap(B);
         }
     }
 
@@ -248,7 +296,7 @@ namespace math21 {
             MATH21_ASSERT((refcount == 0 || (refcount != 0 && *refcount > 0)),
                           "data is supposed to be not null, but"
                                   << "\n\trefcount is " << refcount
-                                  << "\n\t*refcount is " << *refcount
+                                  << "\n\t*refcount is " << refcount->load()
                                   << "\n\tsize is " << size() << " (size is allowed not to be zero when is empty.)"
                                   << "\n\tgetClassName is " << getClassName());
             return 0;
@@ -272,12 +320,35 @@ namespace math21 {
         m21log(getSpace());
     }
 
+    void AutoBuffer::setAllocator(Allocator *allocator) {
+        this->allocator = allocator;
+    }
+
+    Allocator *AutoBuffer::getAllocator() const {
+        return allocator;
+    }
+
     void AutoBuffer::swap(AutoBuffer &B) {
+        NumB isInline_A = isInline();
+        NumB isInline_B = B.isInline();
         m21_swap(space_address, B.space_address);
         m21_swap(space_start, B.space_start);
         m21_swap(space_size, B.space_size);
         m21_swap(nn, B.nn);
         m21_swap(refcount, B.refcount);
+        m21_swap(is_cow, B.is_cow);
+        // inline data is swapped by value, and pointers are set to own inline space.
+        if (isInline_A || isInline_B) {
+            m21_swap(inline_space, B.inline_space);
+            if (isInline_A) {
+                B.space_address = B.inline_space.c;
+                B.space_start = B.space_address;
+            }
+            if (isInline_B) {
+                space_address = inline_space.c;
+                space_start = space_address;
+            }
+        }
     }
 
 //    void AutoBuffer::zeros() {
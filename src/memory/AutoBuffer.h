@@ -16,13 +16,14 @@ limitations under the License.
 #pragma once
 
 #include "inner.h"
+#include "allocator.h"
 
 namespace math21 {
 
     struct SpaceParas {
         char *address;//new and delete address.
         char *start;//available space start position.
-        NumN *ref_count;
+        std::atomic<NumN> *ref_count;
         NumN size;//size space is available.
         NumN unit;//unit size in byte, char
         SpaceParas() {
@@ -43,9 +44,22 @@ namespace math21 {
 
     void math21_memory_getSpace(const SpaceParas &src, SpaceParas &dst, NumN offset, NumN size, NumN unit);
 
+    // buffers not larger than this size in byte are kept inside AutoBuffer, no heap allocation.
+#define MATH21_AUTOBUFFER_INLINE_SIZE 32
+
     /*
      * 1. setSize: allocate or set space.
-     * 2.
+     * 2. small buffers use inline space, see MATH21_AUTOBUFFER_INLINE_SIZE.
+     *    Inline space lives and dies with the buffer, so getSpace() of an inline buffer
+     *    can't be shared. Call moveToHeap() first if space will be shared.
+     * 3. heap space is a block from math21_memory_block_allocate, and reference count lives in the block header.
+     *    The allocator is the one set by setAllocator(), or the current allocator of the thread when allocating.
+     * 4. reference count is atomic, so buffers sharing space can be used and cleared in different threads.
+     *    A buffer which is the only owner of its space skips the atomic decrement, see clear().
+     *    Data itself isn't protected, writing shared space in parallel is still a race.
+     * 5. copy-on-write: buffers sharing space by setDataCopyOnWrite() copy it before writing,
+     *    so read-only data, e.x., weights, can be shared by threads without deep copy.
+     *    Writers must call prepareWriting() first, Array does this in its non-const accessors.
      * */
     // space_unit is char.
     struct AutoBuffer {
@@ -55,7 +69,18 @@ namespace math21 {
         char *space_start; // start address given to this buffer.
         NumN space_size; // space_size is the size given to this buffer, not all allocated buffer size.
         NumN nn;// size used by this buffer, nn <= space_size, but the two values often equal to each other.
-        NumN *refcount;// when matrix points to user-allocated data, the pointer is NULL
+        std::atomic<NumN> *refcount;// when matrix points to user-allocated data or inline space, the pointer is NULL
+        NumB is_cow; // copy-on-write
+
+        // union for alignment of basic types.
+        union {
+            char c[MATH21_AUTOBUFFER_INLINE_SIZE];
+            NumR r;
+            NumN64 n;
+            void *p;
+        } inline_space;
+
+        Allocator *allocator; // 0 means current allocator when allocating.
 
         /////////////
         std::string name;
@@ -80,6 +105,11 @@ namespace math21 {
 
         virtual ~AutoBuffer();
 
+        // move constructor, B becomes empty. Copy isn't allowed, use setDataDeep or setDataShallow.
+        AutoBuffer(AutoBuffer &&B) noexcept;
+
+        AutoBuffer &operator=(AutoBuffer &&B);
+
         virtual SpaceParas getSpace() const;
 
         // unit is input unit, but char is used as unit inside the buffer.
@@ -97,16 +127,41 @@ namespace math21 {
         //Todo: copy all headers including start position, end position...
         int setDataShallow(const AutoBuffer &autoBuffer);
 
+        // share space as setDataShallow, and set both buffers copy-on-write.
+        // autoBuffer is const, but its mode is changed, so it must not be written by other threads meanwhile.
+        int setDataCopyOnWrite(AutoBuffer &autoBuffer);
+
+        NumB isCopyOnWrite() const {
+            return is_cow;
+        }
+
+        void setCopyOnWrite(NumB is_cow);
+
+        // copy shared space if copy-on-write. Call before writing.
+        void prepareWriting() {
+            if (is_cow) {
+                ensureIndependence();
+                is_cow = 0;
+            }
+        }
+
         void *getObj() const;
 
-        NumN *getRefCount() const;
+        std::atomic<NumN> *getRefCount() const;
 
         NumN size() const;
 
         void clear();
 
         //return false if in share mode, or data is set by unknowns.
-        NumB isIndependent();
+        NumB isIndependent() const;
+
+        NumB isInline() const {
+            return space_address == inline_space.c;
+        }
+
+        // move inline data to heap, so space can be shared.
+        void moveToHeap();
 
         //Construct n*m matrix with element set to zero using xjcalloc. Fast.
         //must set to zero. Other functions rely on this.
@@ -127,6 +182,12 @@ namespace math21 {
 
         std::string getClassName() const;
 
+        // allocator is kept by the buffer, not swapped or shared.
+        // It is used for next allocation, space already allocated isn't moved.
+        void setAllocator(Allocator *allocator);
+
+        Allocator *getAllocator() const;
+
         void swap(AutoBuffer &B);
     };
 }
\ No newline at end of file
@@ -0,0 +1,339 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tool.h"
+#include "allocator.h"
+
+namespace math21 {
+
+    void *DefaultAllocator::allocate(NumN n) {
+        void *p = 0;
+        math21_memory_malloc(&p, n);
+        return p;
+    }
+
+    void DefaultAllocator::deallocate(void *p, NumN n) {
+        math21_memory_free(p);
+    }
+
+    namespace detail {
+        const NumN math21_memory_pool_class_min = 6;
+        const NumN math21_memory_pool_class_max = 26;
+        const NumN math21_memory_pool_class_size = math21_memory_pool_class_max - math21_memory_pool_class_min + 1;
+
+        // return 0-based class, or math21_memory_pool_class_size if too large.
+        inline NumN math21_memory_pool_get_class(NumN n) {
+            NumN k = math21_memory_pool_class_min;
+            while (k <= math21_memory_pool_class_max && ((NumN) 1 << k) < n) {
+                ++k;
+            }
+            return k - math21_memory_pool_class_min;
+        }
+
+        struct math21_memory_pool_cache {
+            void *blocks[math21_memory_pool_class_size][MATH21_MEMORY_POOL_CACHE_SIZE];
+            NumN sizes[math21_memory_pool_class_size];
+
+            math21_memory_pool_cache() {
+                for (NumN i = 0; i < math21_memory_pool_class_size; ++i) {
+                    sizes[i] = 0;
+                }
+            }
+
+            void release() {
+                for (NumN i = 0; i < math21_memory_pool_class_size; ++i) {
+                    for (NumN j = 0; j < sizes[i]; ++j) {
+                        math21_memory_free(blocks[i][j]);
+                    }
+                    sizes[i] = 0;
+                }
+            }
+
+            ~math21_memory_pool_cache() {
+                release();
+            }
+        };
+
+        math21_memory_pool_cache &math21_memory_pool_get_cache() {
+            static thread_local math21_memory_pool_cache cache;
+            return cache;
+        }
+
+        Allocator *&math21_memory_get_current_allocator_address() {
+            static thread_local Allocator *allocator = 0;
+            return allocator;
+        }
+    }
+
+    void *PoolAllocator::allocate(NumN n) {
+        NumN k = detail::math21_memory_pool_get_class(n);
+        if (k == detail::math21_memory_pool_class_size) {
+            return math21_memory_get_default_allocator().allocate(n);
+        }
+        detail::math21_memory_pool_cache &cache = detail::math21_memory_pool_get_cache();
+        if (cache.sizes[k] > 0) {
+            --cache.sizes[k];
+            return cache.blocks[k][cache.sizes[k]];
+        }
+        void *p = 0;
+        math21_memory_malloc(&p, (NumN) 1 << (k + detail::math21_memory_pool_class_min));
+        return p;
+    }
+
+    void PoolAllocator::deallocate(void *p, NumN n) {
+        if (p == 0) {
+            return;
+        }
+        NumN k = detail::math21_memory_pool_get_class(n);
+        if (k == detail::math21_memory_pool_class_size) {
+            math21_memory_get_default_allocator().deallocate(p, n);
+            return;
+        }
+        detail::math21_memory_pool_cache &cache = detail::math21_memory_pool_get_cache();
+        if (cache.sizes[k] < MATH21_MEMORY_POOL_CACHE_SIZE) {
+            cache.blocks[k][cache.sizes[k]] = p;
+            ++cache.sizes[k];
+        } else {
+            math21_memory_free(p);
+        }
+    }
+
+    void PoolAllocator::release() {
+        detail::math21_memory_pool_get_cache().release();
+    }
+
+    ArenaAllocator::ArenaAllocator(NumN chunk_size_min) {
+        MATH21_ASSERT(chunk_size_min > 0)
+        this->chunk_size_min = chunk_size_min;
+        chunk_index = 0;
+        offset = 0;
+        num_live = 0;
+    }
+
+    // blocks still alive are invalid after this.
+    ArenaAllocator::~ArenaAllocator() {
+        for (NumN i = 0; i < chunks.size(); ++i) {
+            math21_memory_free(chunks[i].address);
+        }
+    }
+
+    void ArenaAllocator::addChunk(NumN n) {
+        Chunk chunk;
+        chunk.size = xjmax(n, chunk_size_min);
+        chunk.address = 0;
+        math21_memory_malloc((void **) &chunk.address, chunk.size);
+        MATH21_ASSERT(chunk.address, "arena out of memory")
+        chunks.push_back(chunk);
+    }
+
+    // blocks are kept aligned to MATH21_MEMORY_BLOCK_HEADER_SIZE inside a chunk.
+    void *ArenaAllocator::allocate(NumN n) {
+        n = (n + MATH21_MEMORY_BLOCK_HEADER_SIZE - 1) / MATH21_MEMORY_BLOCK_HEADER_SIZE *
+            MATH21_MEMORY_BLOCK_HEADER_SIZE;
+        if (chunks.empty()) {
+            addChunk(n);
+            chunk_index = 0;
+            offset = 0;
+        }
+        if (offset + n > chunks[chunk_index].size) {
+            // skip chunks too small, they are reused after reset.
+            NumN i;
+            for (i = chunk_index + 1; i < chunks.size(); ++i) {
+                if (chunks[i].size >= n) {
+                    break;
+                }
+            }
+            if (i == chunks.size()) {
+                addChunk(n);
+            }
+            chunk_index = i;
+            offset = 0;
+        }
+        void *p = chunks[chunk_index].address + offset;
+        Block block;
+        block.chunk_index = chunk_index;
+        block.offset = offset;
+        block.isLive = 1;
+        blocks.push_back(block);
+        offset += n;
+        ++num_live;
+        return p;
+    }
+
+    NumN ArenaAllocator::getBlockIndex(const void *p) const {
+        NumN i;
+        for (i = 0; i < chunks.size(); ++i) {
+            if ((const char *) p >= chunks[i].address && (const char *) p < chunks[i].address + chunks[i].size) {
+                break;
+            }
+        }
+        MATH21_ASSERT(i < chunks.size(), "block not from this arena")
+        Block key;
+        key.chunk_index = i;
+        key.offset = (NumN) ((const char *) p - chunks[i].address);
+        // blocks are sorted by position, and most blocks are freed in reverse order, so search from back first.
+        NumN k = (NumN) blocks.size();
+        if (k > 0 && blocks[k - 1].chunk_index == key.chunk_index && blocks[k - 1].offset == key.offset) {
+            return k - 1;
+        }
+        NumN lo = 0, hi = k;
+        while (lo < hi) {
+            NumN mid = lo + (hi - lo) / 2;
+            const Block &b = blocks[mid];
+            if (b.chunk_index < key.chunk_index || (b.chunk_index == key.chunk_index && b.offset < key.offset)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        MATH21_ASSERT(lo < k && blocks[lo].chunk_index == key.chunk_index && blocks[lo].offset == key.offset,
+                      "block not from this arena")
+        return lo;
+    }
+
+    void ArenaAllocator::deallocate(void *p, NumN n) {
+        if (p == 0) {
+            return;
+        }
+        Block &block = blocks[getBlockIndex(p)];
+        MATH21_ASSERT(block.isLive, "block deallocated twice")
+        block.isLive = 0;
+        MATH21_ASSERT(num_live > 0)
+        --num_live;
+    }
+
+    void ArenaAllocator::getMark(NumN &chunk_index, NumN &offset, NumN &num_blocks) const {
+        chunk_index = this->chunk_index;
+        offset = this->offset;
+        num_blocks = (NumN) blocks.size();
+    }
+
+    NumN ArenaAllocator::getNumLiveAfterMark(NumN num_blocks) const {
+        NumN n = 0;
+        for (NumN i = num_blocks; i < blocks.size(); ++i) {
+            if (blocks[i].isLive) {
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    void ArenaAllocator::resetToMark(NumN chunk_index, NumN offset, NumN num_blocks) {
+        MATH21_ASSERT(num_blocks <= blocks.size())
+        NumN num_live_after = getNumLiveAfterMark(num_blocks);
+        MATH21_ASSERT(num_live_after == 0,
+                      "blocks allocated after mark are still alive"
+                              << "\n\tlive blocks after mark: " << num_live_after)
+        MATH21_ASSERT(chunk_index < chunks.size() || (chunk_index == 0 && offset == 0))
+        blocks.resize(num_blocks);
+        this->chunk_index = chunk_index;
+        this->offset = offset;
+    }
+
+    void ArenaAllocator::reset() {
+        resetToMark(0, 0, 0);
+    }
+
+    void ArenaAllocator::clear() {
+        reset();
+        for (NumN i = 0; i < chunks.size(); ++i) {
+            math21_memory_free(chunks[i].address);
+        }
+        chunks.clear();
+    }
+
+    DefaultAllocator &math21_memory_get_default_allocator() {
+        static DefaultAllocator allocator;
+        return allocator;
+    }
+
+    PoolAllocator &math21_memory_get_pool_allocator() {
+        static PoolAllocator allocator;
+        return allocator;
+    }
+
+    Allocator &math21_memory_get_current_allocator() {
+        Allocator *allocator = detail::math21_memory_get_current_allocator_address();
+        if (allocator) {
+            return *allocator;
+        }
+        return math21_memory_get_default_allocator();
+    }
+
+    void math21_memory_set_current_allocator(Allocator *allocator) {
+        detail::math21_memory_get_current_allocator_address() = allocator;
+    }
+
+    AllocatorScope::AllocatorScope(Allocator &allocator) {
+        previous = detail::math21_memory_get_current_allocator_address();
+        math21_memory_set_current_allocator(&allocator);
+    }
+
+    AllocatorScope::~AllocatorScope() {
+        math21_memory_set_current_allocator(previous);
+    }
+
+    ArenaScope::ArenaScope(ArenaAllocator &arena) : arena(arena), scope(arena) {
+        arena.getMark(chunk_index, offset, num_blocks);
+    }
+
+    // If blocks allocated in the scope are still alive, the arena isn't rewound,
+    // and their memory is kept until the arena is reset.
+    // Only blocks after the mark count, blocks before it may be freed in the scope, e.g., by resize.
+    ArenaScope::~ArenaScope() {
+        if (arena.getNumLiveAfterMark(num_blocks) == 0) {
+            arena.resetToMark(chunk_index, offset, num_blocks);
+        }
+    }
+
+    namespace detail {
+        union math21_memory_block_header {
+            struct {
+                Allocator *allocator;
+                NumN size; // data size, header not included.
+                std::atomic<NumN> refcount;
+            } info;
+            char pad[MATH21_MEMORY_BLOCK_HEADER_SIZE];
+        };
+
+        inline math21_memory_block_header *math21_memory_block_get_header(void *data) {
+            return (math21_memory_block_header *) ((char *) data - MATH21_MEMORY_BLOCK_HEADER_SIZE);
+        }
+    }
+
+    void *math21_memory_block_allocate(Allocator &allocator, NumN n) {
+        MATH21_ASSERT(n > 0)
+        char *p = (char *) allocator.allocate(n + MATH21_MEMORY_BLOCK_HEADER_SIZE);
+        MATH21_ASSERT(p, "out of memory when allocating " << n << " bytes by " << allocator.getClassName())
+        detail::math21_memory_block_header *header = (detail::math21_memory_block_header *) p;
+        header->info.allocator = &allocator;
+        header->info.size = n;
+        std::atomic_init(&header->info.refcount, (NumN) 1);
+        return p + MATH21_MEMORY_BLOCK_HEADER_SIZE;
+    }
+
+    void math21_memory_block_free(void *data) {
+        if (data == 0) {
+            return;
+        }
+        detail::math21_memory_block_header *header = detail::math21_memory_block_get_header(data);
+        header->info.allocator->deallocate(header, header->info.size + MATH21_MEMORY_BLOCK_HEADER_SIZE);
+    }
+
+    std::atomic<NumN> *math21_memory_block_refcount(void *data) {
+        MATH21_ASSERT(data)
+        return &detail::math21_memory_block_get_header(data)->info.refcount;
+    }
+}
@@ -0,0 +1,207 @@
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include "inner.h"
+
+namespace math21 {
+
+    /*
+     * Allocators used by AutoBuffer.
+     * AutoBuffer doesn't call an allocator directly, but allocates blocks by math21_memory_block_allocate.
+     * A block has a header before its data, recording its allocator, size and reference count.
+     * So a block, or a space of it shared by SpaceParas, is always freed by the allocator it comes from.
+     *
+     * Selection, from high to low priority:
+     *   1. per buffer: AutoBuffer::setAllocator, Tensor::setAllocator.
+     *   2. per scope: AllocatorScope, which sets the current allocator of this thread.
+     *   3. DefaultAllocator, i.e., math21_memory_malloc.
+     * */
+    class Allocator {
+    public:
+        Allocator() {}
+
+        virtual ~Allocator() {}
+
+        // return n bytes, aligned at least as math21_memory_malloc.
+        virtual void *allocate(NumN n) = 0;
+
+        // n is same as in allocate.
+        virtual void deallocate(void *p, NumN n) = 0;
+
+        virtual std::string getClassName() const = 0;
+    };
+
+    // uses math21_memory_malloc and math21_memory_free.
+    class DefaultAllocator : public Allocator {
+    public:
+        void *allocate(NumN n) override;
+
+        void deallocate(void *p, NumN n) override;
+
+        std::string getClassName() const override {
+            return "DefaultAllocator";
+        }
+    };
+
+    /*
+     * Size-class pool with per-thread caches.
+     * Sizes are rounded up to powers of 2, from 2^6 to 2^26 bytes. Larger blocks go to math21_memory_malloc directly.
+     * A freed block is cached by the thread which frees it, at most MATH21_MEMORY_POOL_CACHE_SIZE blocks per class,
+     * and is reused by next allocation of same class in that thread.
+     * Cached blocks are released when thread exits, or by release().
+     * All pools share the caches, so use math21_memory_get_pool_allocator().
+     * */
+#define MATH21_MEMORY_POOL_CACHE_SIZE 64
+
+    class PoolAllocator : public Allocator {
+    public:
+        void *allocate(NumN n) override;
+
+        void deallocate(void *p, NumN n) override;
+
+        // release cached blocks of this thread.
+        void release();
+
+        std::string getClassName() const override {
+            return "PoolAllocator";
+        }
+    };
+
+    /*
+     * Bump arena. Allocation moves a pointer in a chunk, deallocation only marks the block dead.
+     * Memory is reused only after reset, and chunks are kept, so a loop which resets the arena every iteration
+     * allocates nothing after first iteration.
+     * Blocks are recorded in allocation order, so the arena knows which blocks after a mark are still alive.
+     * Not thread-safe, use one arena per thread.
+     * */
+    class ArenaAllocator : public Allocator {
+    private:
+        struct Chunk {
+            char *address;
+            NumN size;
+        };
+
+        struct Block {
+            NumN chunk_index;
+            NumN offset;
+            NumB isLive;
+        };
+
+        std::vector<Chunk> chunks;
+        std::vector<Block> blocks; // blocks since last reset, in allocation order, i.e., increasing position.
+        NumN chunk_index; // current chunk, 0-based
+        NumN offset; // used size of current chunk
+        NumN chunk_size_min;
+        NumN num_live; // blocks not deallocated
+
+        void addChunk(NumN n);
+
+        // return 0-based index of block at p in blocks.
+        NumN getBlockIndex(const void *p) const;
+
+    public:
+        // chunk_size_min in byte.
+        explicit ArenaAllocator(NumN chunk_size_min = 1 << 20);
+
+        ~ArenaAllocator() override;
+
+        void *allocate(NumN n) override;
+
+        void deallocate(void *p, NumN n) override;
+
+        NumN getNumLive() const {
+            return num_live;
+        }
+
+        // position of arena, and number of blocks allocated before it. See ArenaScope.
+        void getMark(NumN &chunk_index, NumN &offset, NumN &num_blocks) const;
+
+        // number of blocks allocated after mark which are still alive.
+        NumN getNumLiveAfterMark(NumN num_blocks) const;
+
+        // all blocks after mark must have been deallocated.
+        void resetToMark(NumN chunk_index, NumN offset, NumN num_blocks);
+
+        // all blocks must have been deallocated.
+        void reset();
+
+        // free all chunks, all blocks must have been deallocated.
+        void clear();
+
+        std::string getClassName() const override {
+            return "ArenaAllocator";
+        }
+    };
+
+    DefaultAllocator &math21_memory_get_default_allocator();
+
+    PoolAllocator &math21_memory_get_pool_allocator();
+
+    // current allocator of this thread, DefaultAllocator if not set.
+    Allocator &math21_memory_get_current_allocator();
+
+    // set current allocator of this thread, 0 means default.
+    void math21_memory_set_current_allocator(Allocator *allocator);
+
+    // Sets current allocator of this thread, and restores the previous one when out of scope.
+    class AllocatorScope {
+    private:
+        Allocator *previous;
+
+        AllocatorScope(const AllocatorScope &);
+
+        AllocatorScope &operator=(const AllocatorScope &);
+
+    public:
+        explicit AllocatorScope(Allocator &allocator);
+
+        ~AllocatorScope();
+    };
+
+    // Uses arena in the scope, and resets arena to the position at construction when out of scope.
+    // Buffers allocated in the scope should be freed in the scope, otherwise arena isn't reset.
+    // This includes a buffer created before the scope but resized in it, because its new block is after the mark.
+    class ArenaScope {
+    private:
+        ArenaAllocator &arena;
+        AllocatorScope scope;
+        NumN chunk_index;
+        NumN offset;
+        NumN num_blocks;
+
+        ArenaScope(const ArenaScope &);
+
+        ArenaScope &operator=(const ArenaScope &);
+
+    public:
+        explicit ArenaScope(ArenaAllocator &arena);
+
+        ~ArenaScope();
+    };
+
+#define MATH21_MEMORY_BLOCK_HEADER_SIZE 32
+
+    // return data of n bytes with reference count 1.
+    void *math21_memory_block_allocate(Allocator &allocator, NumN n);
+
+    // data must be from math21_memory_block_allocate.
+    void math21_memory_block_free(void *data);
+
+    std::atomic<NumN> *math21_memory_block_refcount(void *data);
+}
@@ -15,4 +15,5 @@ limitations under the License.
 
 #pragma once
 #include "AutoBuffer.h"
-#include "tool.h"
\ No newline at end of file
+#include "tool.h"
+#include "allocator.h"
\ No newline at end of file
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include <cstring>
+#include <atomic>
 #include "tool.h"
 
 namespace math21 {
@@ -59,7 +60,27 @@ namespace math21 {
 
     /////////////////////
 
+    namespace detail {
+        // relaxed, they are statistics only.
+        std::atomic<NumN64> math21_memory_malloc_count(0);
+        std::atomic<NumN64> math21_memory_free_count(0);
+    }
+
+    NumN64 math21_memory_get_malloc_count() {
+        return detail::math21_memory_malloc_count.load(std::memory_order_relaxed);
+    }
+
+    NumN64 math21_memory_get_free_count() {
+        return detail::math21_memory_free_count.load(std::memory_order_relaxed);
+    }
+
+    void math21_memory_reset_count() {
+        detail::math21_memory_malloc_count.store(0, std::memory_order_relaxed);
+        detail::math21_memory_free_count.store(0, std::memory_order_relaxed);
+    }
+
     void math21_memory_malloc(void **p_data, size_t size) {
+        detail::math21_memory_malloc_count.fetch_add(1, std::memory_order_relaxed);
 #ifdef MATH21_FLAG_USE_CUDA
         cudaMallocHost(p_data, size);
 #else
@@ -76,6 +97,9 @@ namespace math21 {
     }
 
     void math21_memory_free(void *ptr) {
+        if (ptr) {
+            detail::math21_memory_free_count.fetch_add(1, std::memory_order_relaxed);
+        }
 #ifdef MATH21_FLAG_USE_CUDA
         cudaFreeHost(ptr);
 #else
@@ -25,6 +25,14 @@ namespace math21 {
 
     void math21_memory_free(void *ptr);
 
+    // number of allocations and frees by math21_memory_malloc and math21_memory_free,
+    // counted since program start or last reset.
+    NumN64 math21_memory_get_malloc_count();
+
+    NumN64 math21_memory_get_free_count();
+
+    void math21_memory_reset_count();
+
 #ifdef MATH21_FLAG_USE_CUDA
 
     void math21_cuda_malloc_device(void **p_data, size_t size);
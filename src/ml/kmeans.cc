@@ -166,7 +166,7 @@ namespace math21 {
                             labels(index_point + 1) = i + 1;
                             const VecR &A = data(index_point + 1);
                             Cluster cluster(i + 1, A);
-                            clusters.push_back(cluster);
+                            clusters.push_back(std::move(cluster));
                             break;
                         }
                     }
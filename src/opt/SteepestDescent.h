@@ -128,9 +128,6 @@ namespace math21 {
         NumR delta;
         NumR epsilon;
         VecR r;
-        VecR delta_x;
-
-        VecR tmp_1;
     public:
 
         sd_update_rule_AdaGrad(Functional &f) : sd_update_rule(f) {
@@ -138,27 +135,20 @@ namespace math21 {
             epsilon = 0.1;
             x.setSize(f.getXDim());
             r.setSize(f.getXDim());
-            tmp_1.setSize(f.getXDim());
-            delta_x.setSize(f.getXDim());
             x = 0;
+            r = 0;
             y = f.valueAt(x);
         }
 
         void update() {
             const VecR &g = f.derivativeValueAt(x);
-            math21_operator_SchurProduct(g, g, tmp_1);
-            math21_operator_addToA(r, tmp_1);
+            math21_operator_evaluate_add_to(math21_expr_square(math21_expr(g)), r);
 //            VecR r_tmp;
 //            r_tmp = m21sqrt(m21add(delta, r));
 //            MATH21_ASSERT(argmin(r_tmp)>0, "r_tmp should be larger than zero!");
 //            delta_x = m21divide((-epsilon), r_tmp).SchurProduct(g);
-            VecR &tmp_2 = tmp_1;
-            math21_operator_add(delta, r, tmp_2);
-            math21_operator_sqrt_to(tmp_2);
-            math21_operator_divide_to(-epsilon, tmp_2);
-            math21_operator_SchurProduct(tmp_2, g, delta_x);
-//            delta_x = m21divide((-epsilon), m21sqrt(m21add(delta, r))).SchurProduct(g);
-            math21_operator_addToA(x, delta_x);
+            // delta_x = m21divide((-epsilon), m21sqrt(m21add(delta, r))).SchurProduct(g);
+            math21_operator_evaluate_add_to((-epsilon) / math21_expr_sqrt(delta + math21_expr(r)) * math21_expr(g), x);
             y_old = y;
             y = f.valueAt(x);
         }
@@ -171,7 +161,6 @@ namespace math21 {
         NumR rho;
         NumR epsilon;
         VecR r;
-        VecR tmp_1;
     public:
 
         sd_update_rule_RMSProp(Functional &f) : sd_update_rule(f) {
@@ -180,25 +169,15 @@ namespace math21 {
             epsilon = 0.01;
             x.setSize(f.getXDim());
             r.setSize(f.getXDim());
-            tmp_1.setSize(f.getXDim());
             x = 0;
+            r = 0;
             y = f.valueAt(x);
         }
 
         void update() {
             const VecR &g = f.derivativeValueAt(x);
-            math21_operator_SchurProduct(g, g, tmp_1);
-            math21_operator_linear_to_A(rho, r, (1 - rho), tmp_1);
-
-            VecR &tmp_2 = tmp_1;
-            math21_operator_add(delta, r, tmp_2);
-            math21_operator_sqrt_to(tmp_2);
-            math21_operator_divide_to(-epsilon, tmp_2);
-
-            VecR &delta_x = tmp_2;
-            math21_operator_SchurProduct_to_A(delta_x, g);
-
-            math21_operator_addToA(x, delta_x);
+            math21_operator_evaluate(rho * math21_expr(r) + (1 - rho) * math21_expr_square(math21_expr(g)), r);
+            math21_operator_evaluate_add_to((-epsilon) / math21_expr_sqrt(delta + math21_expr(r)) * math21_expr(g), x);
             y_old = y;
             y = f.valueAt(x);
         }
@@ -227,6 +206,8 @@ namespace math21 {
             tmp.setSize(f.getXDim());
             r.setSize(f.getXDim());
             x = 0;
+            v = 0;
+            r = 0;
             DefaultRandomEngine engine(21);
             RanUniform ranUniform(engine);
             ranUniform.set(-0.8, 0.8);
@@ -262,9 +243,6 @@ namespace math21 {
         NumR rho1_product, rho2_product;
         NumR epsilon;
         VecR s, r;
-        VecR s_hat, r_hat;
-
-        VecR tmp;
     public:
         sd_update_rule_Adam(Functional &f) : sd_update_rule(f) {
             s.setSize(f.getXDim());
@@ -278,8 +256,9 @@ namespace math21 {
 
             delta = MATH21_10NEG7;
             x.setSize(f.getXDim());
-            tmp.setSize(f.getXDim());
             x = 0;
+            s = 0;
+            r = 0;
             y = f.valueAt(x);
         }
 
@@ -288,21 +267,15 @@ namespace math21 {
             rho1_product *= rho1;
             rho2_product *= rho2;
 
-            math21_operator_linear_to_A(rho1, s, (1 - rho1), g);
-            math21_operator_SchurProduct(g, g, tmp);
-            math21_operator_linear_to_A(rho2, r, (1 - rho2), tmp);
-            math21_operator_linear((1 / (1 - rho1_product)), s, s_hat);
-            math21_operator_linear((1 / (1 - rho2_product)), r, r_hat);
-
-            VecR &tmp_2 = tmp;
-            math21_operator_add(delta, r_hat, tmp_2);
-            math21_operator_sqrt_to(tmp_2);
-            math21_operator_divide_to(-epsilon, tmp_2);
-
-            VecR &delta_x = tmp_2;
-            math21_operator_SchurProduct_to_A(delta_x, s_hat);
+            math21_operator_evaluate(rho1 * math21_expr(s) + (1 - rho1) * math21_expr(g), s);
+            math21_operator_evaluate(rho2 * math21_expr(r) + (1 - rho2) * math21_expr_square(math21_expr(g)), r);
 
-            math21_operator_addToA(x, delta_x);
+            // s_hat = s/(1-rho1_product), r_hat = r/(1-rho2_product)
+            // x += (-epsilon)/sqrt(delta + r_hat) * s_hat, in one pass.
+            NumR k1 = 1 / (1 - rho1_product);
+            NumR k2 = 1 / (1 - rho2_product);
+            math21_operator_evaluate_add_to(
+                    (-epsilon) / math21_expr_sqrt(delta + k2 * math21_expr(r)) * (k1 * math21_expr(s)), x);
 
             y_old = y;
             y = f.valueAt(x);
@@ -195,6 +195,289 @@ namespace math21 {
         u.log("u");
     }
 
+    // allocation counts assume the stride layout, index tables of the legacy layout are allocated too.
+#ifdef MATH21_FLAG_TENSOR_INDEX_TABLE
+#define MATH21_PASS_MALLOC_COUNT(...) {}
+#else
+#define MATH21_PASS_MALLOC_COUNT(...) MATH21_PASS(__VA_ARGS__)
+#endif
+
+    void test_array_memory_inline() {
+        math21_tool_log_title(__FUNCTION__);
+        NumN n = 1000;
+        math21_memory_reset_count();
+        for (NumN i = 1; i <= n; ++i) {
+            VecR x(3);
+            x = 1, 2, i;
+            MATH21_PASS(x(3) == i);
+        }
+        NumN64 count = math21_memory_get_malloc_count();
+        m21log("malloc count of VecR(3)", count);
+        // shape and strides of tensor, and the data, are all inline.
+        MATH21_PASS(count == 0);
+        MATH21_PASS(math21_memory_get_free_count() == 0);
+
+        // swap keeps inline data with its array.
+        ArrayZ u(2), v(5);
+        u = 1, 2;
+        v = 3, 4, 5, 6, 7;
+        u.swap(v);
+        MATH21_PASS(u.size() == 5 && u(1) == 3 && u(5) == 7);
+        MATH21_PASS(v.size() == 2 && v(1) == 1 && v(2) == 2);
+
+        // shared space of small array moves to heap, so it outlives the array.
+        ArrayZ w;
+        {
+            ArrayZ z(2);
+            z = 8, 9;
+            SpaceParas paras = z.getSpace(0, 2, sizeof(NumZ));
+            w.setSize(2, &paras);
+            z(1) = 10;
+        }
+        MATH21_PASS(w(1) == 10 && w(2) == 9);
+    }
+
+    void test_memory_allocator() {
+        math21_tool_log_title(__FUNCTION__);
+        NumN n = 100;
+
+        // pool: after warm-up, temporaries reuse cached blocks.
+        {
+            AllocatorScope scope(math21_memory_get_pool_allocator());
+            for (NumN i = 1; i <= n; ++i) {
+                if (i == 2) {
+                    math21_memory_reset_count();
+                }
+                TenR A(20, 30), B(30, 10);
+                A = i;
+                B = 1;
+                MatR C;
+                math21_operator_multiply(1, A, B, C);
+                MATH21_PASS(C(1, 1) == 30 * i);
+            }
+            m21log("malloc count with pool", math21_memory_get_malloc_count());
+            MATH21_PASS(math21_memory_get_malloc_count() == 0);
+            math21_memory_get_pool_allocator().release();
+        }
+
+        // arena: memory is given back when scope ends.
+        ArenaAllocator arena;
+        for (NumN i = 1; i <= n; ++i) {
+            if (i == 2) {
+                math21_memory_reset_count();
+            }
+            ArenaScope scope(arena);
+            TenR A(50, 50);
+            A = i;
+            MATH21_PASS(A(50, 50) == i);
+        }
+        m21log("malloc count with arena", math21_memory_get_malloc_count());
+        MATH21_PASS(math21_memory_get_malloc_count() == 0);
+        MATH21_PASS(arena.getNumLive() == 0);
+
+        // resize in inner scope frees a block before its mark, and allocates one after it,
+        // so inner scope mustn't rewind over the new block.
+        {
+            ArenaScope scope_1(arena);
+            TenR X(100);
+            {
+                ArenaScope scope_2(arena);
+                X.setSize(200);
+            }
+            X = 1;
+            TenR Y(200);
+            Y = -1;
+            MATH21_PASS(X(1) == 1 && X(200) == 1);
+        }
+        MATH21_PASS(arena.getNumLive() == 0);
+
+        // per tensor, and shared space is freed by its own allocator.
+        TenR x(10, 10);
+        {
+            TenR y;
+            y.setAllocator(&math21_memory_get_pool_allocator());
+            y.setSize(10, 10);
+            y = 3;
+            x.setSpace(y.getSpace());
+        }
+        MATH21_PASS(x(10, 10) == 3);
+        math21_memory_get_pool_allocator().release();
+    }
+
+    void test_memory_copy_on_write() {
+        math21_tool_log_title(__FUNCTION__);
+        TenR W(20, 30);
+        W = 1;
+        const NumR *w_data = math21_memory_tensor_data_address((const TenR &) W);
+
+        // share without copy.
+        NumN n = 8;
+        Seqce<TenR> ws;
+        ws.setSize(n);
+        math21_memory_reset_count();
+        for (NumN i = 1; i <= n; ++i) {
+            ws(i).setDataCopyOnWrite(W);
+        }
+        MATH21_PASS_MALLOC_COUNT(math21_memory_get_malloc_count() == 0);
+        MATH21_PASS(W.getSpace().ref_count->load() == n + 1);
+
+        // threads share W by reference counting, and copy only when writing.
+        NumZ i;
+#pragma omp parallel for
+        for (i = 1; i <= (NumZ) n; ++i) {
+            const TenR &w = ws((NumN) i);
+            MATH21_PASS(math21_memory_tensor_data_address(w) == w_data);
+            MATH21_PASS(w(20, 30) == 1);
+            for (NumN k = 0; k < 1000; ++k) {
+                TenR tmp;
+                math21_operator_shareReshape_to_vector(W, tmp);
+            }
+            ws((NumN) i)(1, 1) = i;
+        }
+        MATH21_PASS(W.getSpace().ref_count->load() == 1);
+        MATH21_PASS(((const TenR &) W)(1, 1) == 1);
+        for (NumN i = 1; i <= n; ++i) {
+            MATH21_PASS(ws(i)(1, 1) == i && ws(i)(20, 30) == 1);
+            MATH21_PASS(math21_memory_tensor_data_address((const TenR &) ws(i)) != w_data);
+        }
+
+        // W is copy-on-write too, and it doesn't copy once it's the only owner.
+        MATH21_PASS(W.isCopyOnWrite());
+        W(1, 1) = 2;
+        MATH21_PASS(math21_memory_tensor_data_address((const TenR &) W) == w_data);
+        MATH21_PASS(!W.isCopyOnWrite());
+
+        // writes through strided sub views copy shared data too.
+        TenR W2;
+        W2.setDataCopyOnWrite(W);
+        VecN y(2);
+        y = 0, 3;
+        {
+            TenSubR ts = W.shrinkSub(y);
+            ts(2) = 42;
+            MATH21_PASS(W(2, 3) == 42 && W2(2, 3) == 1);
+        }
+        // W is shared after sub views are created, and sub of sub writes first.
+        {
+            TenSubR ts = W.shrinkSub(y);
+            VecN y2(1);
+            y2 = 0;
+            TenSubR ts2 = ts.shrinkSub(y2);
+            W2.setDataCopyOnWrite(W);
+            ts2(5) = 43;
+            MATH21_PASS(W(5, 3) == 43 && W2(5, 3) == 1);
+
+            // strided assign copies too.
+            W2.setDataCopyOnWrite(W);
+            VecR z(20);
+            z = 7;
+            math21_operator_tensor_assign_elementwise_no_recursive(ts, z);
+            MATH21_PASS(W(20, 3) == 7 && W2(20, 3) == 1 && W2(5, 3) == 43);
+        }
+    }
+
+    void test_tensor_move() {
+        math21_tool_log_title(__FUNCTION__);
+        math21_memory_reset_count();
+        TenR A(100, 100);
+        A = 3;
+        const NumR *p = math21_memory_tensor_data_address((const TenR &) A);
+
+        // move constructor takes data.
+        TenR B(std::move(A));
+        MATH21_PASS(A.isEmpty() && B.isSameSize(100, 100));
+        MATH21_PASS(math21_memory_tensor_data_address((const TenR &) B) == p);
+
+        // move assignment to empty tensor takes data.
+        TenR C;
+        C = std::move(B);
+        MATH21_PASS(B.isEmpty() && math21_memory_tensor_data_address((const TenR &) C) == p);
+        MATH21_PASS_MALLOC_COUNT(math21_memory_get_malloc_count() == 1);
+
+        // move assignment to shared space writes the space.
+        TenR D(100, 100), E;
+        VecN d(2);
+        d = 100, 100;
+        math21_operator_shareReshape(D, E, d);
+        D = std::move(C);
+        MATH21_PASS(((const TenR &) E)(100, 100) == 3);
+
+        // elements are relocated, not copied, when seqce grows or moves.
+        NumN n = 100;
+        math21_memory_reset_count();
+        Seqce<TenR> xs;
+        for (NumN i = 1; i <= n; ++i) {
+            TenR x(50, 50);
+            x = i;
+            xs.push(std::move(x));
+        }
+        Seqce<TenR> ys(std::move(xs));
+        MATH21_PASS(xs.isEmpty() && ys.size() == n && ys(n)(50, 50) == n);
+        m21log("malloc count", math21_memory_get_malloc_count());
+        MATH21_PASS_MALLOC_COUNT(math21_memory_get_malloc_count() == n);
+
+        ArrayR u(100);
+        u = 1;
+        ArrayR v(std::move(u));
+        MATH21_PASS(u.isEmpty() && v.size() == 100 && v(100) == 1);
+    }
+
+    void test_tensor_expr() {
+        math21_tool_log_title(__FUNCTION__);
+        NumN n = 1000;
+        TenR A(n), B(n), D(n);
+        DefaultRandomEngine engine(21);
+        RanUniform ran(engine);
+        ran.set(0.5, 1);
+        math21_random_draw(A, ran);
+        math21_random_draw(B, ran);
+        math21_random_draw(D, ran);
+        NumR k1 = 0.3, k2 = -0.2;
+
+        // C = exp(k1*A + k2*B) * D - 1, chained.
+        TenR C1, C2;
+        math21_operator_linear(k1, A, k2, B, C1);
+        math21_operator_exp(C1, C1);
+        math21_operator_SchurProduct(C1, D, C1);
+        math21_operator_add(-1, C1, C1);
+
+        // fused, one pass and no intermediate tensor.
+        C2.setSize(n);
+        math21_memory_reset_count();
+        math21_operator_evaluate(math21_expr_exp(k1 * math21_expr(A) + k2 * math21_expr(B)) * math21_expr(D) - 1, C2);
+        MATH21_PASS_MALLOC_COUNT(math21_memory_get_malloc_count() == 0);
+        MATH21_PASS(math21_operator_isEqual(C1, C2, MATH21_EPS));
+
+        // output can be input.
+        math21_operator_evaluate(math21_expr_sqrt(math21_expr(A) / math21_expr(B)) + math21_expr(A), A);
+        math21_operator_evaluate_add_to(-math21_expr_square(math21_expr(D)), D);
+        MATH21_PASS(A(1) > 0 && D(n) <= 0.25);
+
+        // C takes major order of e, and vectors go with any order.
+        TenR X, Y, V, M;
+        X.setColumnMajor(1);
+        X.setSize(2, 3);
+        X = 1, 2, 3, 4, 5, 6;
+        Y.setColumnMajor(1);
+        Y.setSize(2, 3);
+        Y = 6, 5, 4, 3, 2, 1;
+        V.setSize(6);
+        V = 1, 1, 1, 2, 2, 2;
+        M.setSize(2, 3);
+        math21_operator_evaluate(math21_expr(X) + math21_expr(Y) * math21_expr(V), M);
+        MATH21_PASS(M.isColumnMajor());
+        NumB isOk = 1;
+        for (NumN i = 1; i <= 2; ++i) {
+            for (NumN j = 1; j <= 3; ++j) {
+                NumN k = (j - 1) * 2 + i;
+                if (M(i, j) != X(i, j) + Y(i, j) * V(k)) {
+                    isOk = 0;
+                }
+            }
+        }
+        MATH21_PASS(isOk);
+    }
+
     void test_tensor_memory_01() {
         TenR v;
         v.setSize(1, 2, 3);
@@ -462,6 +745,662 @@ namespace math21 {
         I.log("I");
     }
 
+    void test_lu_cholesky() {
+        math21_tool_log_title(__FUNCTION__);
+        MatR A(3, 3);
+        A =
+                1, 2, 3,
+                0, 5, 0,
+                3, 9, 5;
+        LUDecomposition lu;
+        MATH21_PASS(lu.factor(A));
+        MATH21_PASS(xjabs(lu.determinant() + 20) < MATH21_10NEG6);
+
+        // odd size covers edge blocks.
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+        NumN n = 203, m = 7;
+        A.setSize(n, n);
+        math21_random_draw(A, ran);
+        MatR B(n, m), X, R;
+        math21_random_draw(B, ran);
+
+        NumR t = math21_time_getticks();
+        MatR A_gje, X_gje;
+        A_gje.setSize(n, n);
+        A_gje.assign(A);
+        X_gje.setSize(n, m);
+        X_gje.assign(B);
+        GaussJordanElimination gje;
+        gje.solve(A_gje, X_gje);
+        t = math21_time_getticks() - t;
+        m21log("time Gauss-Jordan", t);
+
+        t = math21_time_getticks();
+        MATH21_PASS(lu.factor(A));
+        t = math21_time_getticks() - t;
+        m21log("time LU", t);
+        lu.solve(B, X);
+        MATH21_PASS(math21_operator_isEqual(X, X_gje, MATH21_10NEG6));
+        math21_operator_multiply(1, A, X, R);
+        MATH21_PASS(math21_operator_isEqual(R, B, MATH21_10NEG6));
+
+        // factor is reused for other right-hand sides, and B can be vector.
+        VecR b(n), x;
+        math21_random_draw(b, ran);
+        lu.solve(b, x);
+        MATH21_PASS(x.dims() == 1);
+        VecR r;
+        math21_operator_multiply(1, A, x, r);
+        MATH21_PASS(math21_operator_isEqual(r, b, MATH21_10NEG6));
+
+        MatR A_inv, I;
+        math21_operator_inverse(A, A_inv);
+        MATH21_PASS(math21_operator_isEqual(A_inv, A_gje, MATH21_10NEG6));
+        math21_operator_multiply(1, A, A_inv, I);
+        MatR I_ref(n, n);
+        I_ref = 0;
+        for (NumN i = 1; i <= n; ++i) {
+            I_ref(i, i) = 1;
+        }
+        MATH21_PASS(math21_operator_isEqual(I, I_ref, MATH21_10NEG6));
+
+        // symmetric positive definite S = A*A.transpose + n*I.
+        MatR S;
+        math21_operator_multiply_trans(1, A, A, S);
+        for (NumN i = 1; i <= n; ++i) {
+            S(i, i) += n;
+        }
+        CholeskyDecomposition chol;
+        t = math21_time_getticks();
+        MATH21_PASS(chol.factor(S));
+        t = math21_time_getticks() - t;
+        m21log("time Cholesky", t);
+        MatR L, S2;
+        chol.getL(L);
+        math21_operator_multiply_trans(1, L, L, S2);
+        MATH21_PASS(math21_operator_isEqual(S2, S, MATH21_10NEG6 * n));
+        chol.solve(B, X);
+        math21_operator_multiply(1, S, X, R);
+        MATH21_PASS(math21_operator_isEqual(R, B, MATH21_10NEG6));
+
+        A.setSize(3, 3);
+        A =
+                4, 2, 0,
+                2, 3, 1,
+                0, 1, 2;
+        MATH21_PASS(chol.factor(A));
+        MATH21_PASS(xjabs(chol.determinant() - 12) < MATH21_10NEG6);
+
+        // singular and not positive definite.
+        A =
+                1, 2, 3,
+                2, 4, 6,
+                3, 9, 5;
+        MATH21_PASS(!lu.factor(A));
+        A =
+                1, 2, 0,
+                2, 1, 0,
+                0, 0, 1;
+        MATH21_PASS(!chol.factor(A));
+        MATH21_PASS(lu.factor(A));
+    }
+
+    // U.transpose*U = I
+    void test_svd_is_orthonormal(const MatR &U) {
+        MatR I;
+        math21_operator_trans_multiply(1, U, U, I);
+        for (NumN i = 1; i <= I.nrows(); ++i) {
+            for (NumN j = 1; j <= I.ncols(); ++j) {
+                MATH21_PASS(xjabs(I(i, j) - (i == j ? 1 : 0)) < MATH21_10NEG6);
+            }
+        }
+    }
+
+    // U*diag(S)*V.transpose = A
+    void test_svd_is_decomposition(const MatR &A, const svd &s) {
+        NumN k = s.getS().size();
+        MatR US(A.nrows(), k), V(A.ncols(), k), A2;
+        for (NumN i = 1; i <= A.nrows(); ++i) {
+            for (NumN j = 1; j <= k; ++j) {
+                US(i, j) = s.getU()(i, j) * s.getS()(j);
+            }
+        }
+        for (NumN i = 1; i <= A.ncols(); ++i) {
+            for (NumN j = 1; j <= k; ++j) {
+                V(i, j) = s.getV()(i, j);
+            }
+        }
+        math21_operator_multiply_trans(1, US, V, A2);
+        MATH21_PASS(math21_operator_isEqual(A2, A, MATH21_10NEG6));
+        for (NumN i = 2; i <= k; ++i) {
+            MATH21_PASS(s.getS()(i - 1) >= s.getS()(i));
+        }
+    }
+
+    void test_svd() {
+        math21_tool_log_title(__FUNCTION__);
+        svd s;
+        MatR A(3, 3);
+        A =
+                0, 0, 1,
+                0, 3, 0,
+                -2, 0, 0;
+        s.solve(A);
+        MATH21_PASS(xjabs(s.getS()(1) - 3) < MATH21_10NEG6 && xjabs(s.getS()(2) - 2) < MATH21_10NEG6
+                    && xjabs(s.getS()(3) - 1) < MATH21_10NEG6);
+        test_svd_is_decomposition(A, s);
+
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+
+        // tall, thin and full.
+        A.setSize(120, 50);
+        math21_random_draw(A, ran);
+        s.solve(A);
+        MATH21_PASS(s.getU().isSameSize(120, 50) && s.getV().isSameSize(50, 50));
+        test_svd_is_orthonormal(s.getU());
+        test_svd_is_orthonormal(s.getV());
+        test_svd_is_decomposition(A, s);
+        s.solve(A, 0);
+        MATH21_PASS(s.getU().isSameSize(120, 120));
+        test_svd_is_orthonormal(s.getU());
+        test_svd_is_decomposition(A, s);
+
+        // wide.
+        A.setSize(30, 70);
+        math21_random_draw(A, ran);
+        s.solve(A, 0);
+        MATH21_PASS(s.getU().isSameSize(30, 30) && s.getV().isSameSize(70, 70));
+        test_svd_is_orthonormal(s.getU());
+        test_svd_is_orthonormal(s.getV());
+        test_svd_is_decomposition(A, s);
+
+        // rank 5, columns of zero singular values are still orthonormal.
+        MatR X(60, 5), Y(5, 40);
+        math21_random_draw(X, ran);
+        math21_random_draw(Y, ran);
+        math21_operator_multiply(1, X, Y, A);
+        s.solve(A);
+        MATH21_PASS(s.rank() == 5);
+        test_svd_is_orthonormal(s.getU());
+        test_svd_is_decomposition(A, s);
+        MatR A_5;
+        s.approximate(5, A_5);
+        MATH21_PASS(math21_operator_isEqual(A_5, A, MATH21_10NEG6));
+
+        // randomized, rank 10 plus small noise.
+        NumN m = 400, n = 300, k = 10;
+        X.setSize(m, k);
+        Y.setSize(k, n);
+        math21_random_draw(X, ran);
+        math21_random_draw(Y, ran);
+        MatR E(m, n);
+        ran.set(0, 1e-3);
+        math21_random_draw(E, ran);
+        ran.set(0, 1);
+        math21_operator_multiply(1, X, Y, A);
+        math21_operator_linear(1, A, 1, E, A);
+
+        NumR t = math21_time_getticks();
+        s.solve(A);
+        t = math21_time_getticks() - t;
+        m21log("time svd", t);
+        VecR S_ref;
+        S_ref.setSize(k);
+        for (NumN i = 1; i <= k; ++i) {
+            S_ref(i) = s.getS()(i);
+        }
+        MatR A_k_ref, A_k;
+        s.approximate(k, A_k_ref);
+
+        svd s_r;
+        t = math21_time_getticks();
+        s_r.solve_randomized(A, k);
+        t = math21_time_getticks() - t;
+        m21log("time randomized svd", t);
+        MATH21_PASS(s_r.getU().isSameSize(m, k) && s_r.getV().isSameSize(n, k));
+        test_svd_is_orthonormal(s_r.getU());
+        test_svd_is_orthonormal(s_r.getV());
+        MATH21_PASS(math21_operator_isEqual(s_r.getS(), S_ref, 1e-3 * S_ref(1)));
+        s_r.approximate(k, A_k);
+        MATH21_PASS(math21_operator_isEqual(A_k, A_k_ref, 1e-2));
+
+        // pseudo inverse of invertible matrix is inverse.
+        n = 150;
+        A.setSize(n, n);
+        math21_random_draw(A, ran);
+        MatR A_inv, A_pinv;
+        t = math21_time_getticks();
+        math21_operator_inverse(A, A_inv);
+        t = math21_time_getticks() - t;
+        m21log("time inverse", t);
+        t = math21_time_getticks();
+        s.solve(A);
+        s.pseudoInverse(A_pinv);
+        t = math21_time_getticks() - t;
+        m21log("time svd pseudo inverse", t);
+        MATH21_PASS(math21_operator_isEqual(A_pinv, A_inv, MATH21_10NEG6));
+    }
+
+    void test_qr() {
+        math21_tool_log_title(__FUNCTION__);
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+
+        // sizes cover several panels and edge panel.
+        NumN m = 150, n = 70;
+        MatR A(m, n);
+        math21_random_draw(A, ran);
+        QRDecomposition qr;
+        qr.factor(A);
+        MATH21_PASS(qr.isFullRank());
+        MatR Q, R, A2;
+        qr.getQ(Q);
+        qr.getR(R);
+        MATH21_PASS(Q.isSameSize(m, n));
+        test_svd_is_orthonormal(Q);
+        math21_operator_multiply(1, Q, R, A2);
+        MATH21_PASS(math21_operator_isEqual(A2, A, MATH21_10NEG6));
+        qr.getQ(Q, 0);
+        MATH21_PASS(Q.isSameSize(m, m));
+        test_svd_is_orthonormal(Q);
+
+        // least squares, residual is orthogonal to columns of A.
+        MatR B(m, 3), X, AX, E, AtE;
+        math21_random_draw(B, ran);
+        qr.solve(B, X);
+        MATH21_PASS(X.isSameSize(n, 3));
+        math21_operator_multiply(1, A, X, AX);
+        math21_operator_linear(1, B, -1, AX, E);
+        math21_operator_trans_multiply(1, A, E, AtE);
+        MATH21_PASS(math21_operator_norm(AtE, 2) < MATH21_10NEG6);
+
+        // exact system, and vector right-hand side.
+        VecR x_ref(n), b, x;
+        math21_random_draw(x_ref, ran);
+        math21_operator_multiply(1, A, x_ref, b);
+        qr.solve(b, x);
+        MATH21_PASS(x.dims() == 1);
+        MATH21_PASS(math21_operator_isEqual(x, x_ref, MATH21_10NEG6));
+
+        // Q*Q.transpose*B = B for square A
+        A.setSize(40, 40);
+        math21_random_draw(A, ran);
+        qr.factor(A);
+        MatR C(40, 5);
+        math21_random_draw(C, ran);
+        MatR C2;
+        C2.setSize(C.shape());
+        C2.assign(C);
+        qr.multiplyQTrans(C2);
+        qr.multiplyQ(C2);
+        MATH21_PASS(math21_operator_isEqual(C2, C, MATH21_10NEG6));
+
+        // dependent columns
+        A.setSize(5, 3);
+        A =
+                1, 2, 3,
+                2, 4, 5,
+                3, 6, 7,
+                4, 8, 9,
+                5, 10, 1;
+        qr.factor(A);
+        MATH21_PASS(!qr.isFullRank());
+    }
+
+    // A*V = V*diag(values)
+    void test_eigen_is_decomposition(const MatR &A, const SymmetricEigenDecomposition &eig) {
+        const VecR &values = eig.getValues();
+        const MatR &V = eig.getVectors();
+        MatR AV, VD;
+        math21_operator_multiply(1, A, V, AV);
+        VD.setSize(V.shape());
+        for (NumN i = 1; i <= V.nrows(); ++i) {
+            for (NumN j = 1; j <= V.ncols(); ++j) {
+                VD(i, j) = V(i, j) * values(j);
+            }
+        }
+        MATH21_PASS(math21_operator_isEqual(AV, VD, MATH21_10NEG6));
+        test_svd_is_orthonormal(V);
+        for (NumN i = 2; i <= values.size(); ++i) {
+            MATH21_PASS(values(i - 1) <= values(i));
+        }
+    }
+
+    void test_eigen_symmetric() {
+        math21_tool_log_title(__FUNCTION__);
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+
+        // tridiagonal(-1, 2, -1), values are 2 - 2*cos(k*pi/(n+1)).
+        NumN n = 100;
+        VecR d(n), e(n - 1);
+        d = 2;
+        e = -1;
+        SymmetricEigenDecomposition eig;
+        eig.solve_tridiagonal(d, e);
+        for (NumN k = 1; k <= n; ++k) {
+            MATH21_PASS(xjabs(eig.getValues()(k) - (2 - 2 * xjcos(k * MATH21_PI / (n + 1)))) < MATH21_10NEG6);
+        }
+        test_svd_is_orthonormal(eig.getVectors());
+
+        // random symmetric, lower triangle only is read.
+        n = 180;
+        MatR A(n, n), A_sym(n, n);
+        math21_random_draw(A, ran);
+        for (NumN i = 1; i <= n; ++i) {
+            for (NumN j = 1; j <= i; ++j) {
+                A_sym(i, j) = A(i, j);
+                A_sym(j, i) = A(i, j);
+            }
+        }
+        NumR t = math21_time_getticks();
+        eig.solve(A);
+        t = math21_time_getticks() - t;
+        m21log("time symmetric eigen", t);
+        test_eigen_is_decomposition(A_sym, eig);
+        VecR values;
+        values.setSize(n);
+        values.assign(eig.getValues());
+        eig.solve(A, 0);
+        MATH21_PASS(eig.getVectors().isEmpty());
+        MATH21_PASS(math21_operator_isEqual(eig.getValues(), values, MATH21_10NEG6));
+
+        // repeated values are deflated, A = Q*diag(1, ..., 1, 2, ..., 2, 3)*Q.transpose
+        QRDecomposition qr;
+        qr.factor(A);
+        MatR Q, QD(n, n);
+        qr.getQ(Q);
+        for (NumN i = 1; i <= n; ++i) {
+            for (NumN j = 1; j <= n; ++j) {
+                QD(i, j) = Q(i, j) * (j <= n / 2 ? 1 : (j < n ? 2 : 3));
+            }
+        }
+        math21_operator_multiply_trans(1, QD, Q, A_sym);
+        eig.solve(A_sym);
+        test_eigen_is_decomposition(A_sym, eig);
+        MATH21_PASS(xjabs(eig.getValues()(1) - 1) < MATH21_10NEG6 && xjabs(eig.getValues()(n) - 3) < MATH21_10NEG6);
+    }
+
+    // random n*m matrix with about density*n*m nonzeros.
+    void test_sparse_draw(NumN n, NumN m, NumR density, DefaultRandomEngine &engine, MatR &A) {
+        RanNormal ran(engine);
+        ran.set(0, 1);
+        RanUniform ran_u(engine);
+        ran_u.set(0, 1);
+        MatR mask(n, m);
+        A.setSize(n, m);
+        math21_random_draw(A, ran);
+        math21_random_draw(mask, ran_u);
+        for (NumN i = 1; i <= n; ++i) {
+            for (NumN j = 1; j <= m; ++j) {
+                if (mask(i, j) > density) {
+                    A(i, j) = 0;
+                }
+            }
+        }
+    }
+
+    void test_sparse() {
+        math21_tool_log_title(__FUNCTION__);
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+
+        // conversion, element access, threshold
+        MatR A, A2;
+        test_sparse_draw(50, 40, 0.1, engine, A);
+        SpMatR S, S2;
+        for (NumB isCsc = 0; isCsc <= 1; ++isCsc) {
+            math21_operator_sparse_from_dense(A, S, 0, isCsc);
+            MATH21_PASS(S.isColumnMajor() == isCsc && S.nrows() == 50 && S.ncols() == 40);
+            math21_operator_sparse_to_dense(S, A2);
+            MATH21_PASS(math21_operator_isEqual(A2, A, 0));
+            MATH21_PASS(S(3, 7) == A(3, 7) && S(50, 40) == A(50, 40));
+            math21_operator_sparse_convert(S, S2, !isCsc);
+            math21_operator_sparse_to_dense(S2, A2);
+            MATH21_PASS(S2.nnz() == S.nnz() && math21_operator_isEqual(A2, A, 0));
+        }
+        NumN nnz = 0, nnz_big = 0;
+        for (NumN i = 1; i <= A.nrows(); ++i) {
+            for (NumN j = 1; j <= A.ncols(); ++j) {
+                nnz += A(i, j) != 0;
+                nnz_big += xjabs(A(i, j)) > 0.5;
+            }
+        }
+        MATH21_PASS(S.nnz() == nnz);
+        math21_operator_sparse_from_dense(A, S, 0.5);
+        MATH21_PASS(S.nnz() == nnz_big);
+
+        // triplets, duplicates are summed.
+        VecN I(5), J(5);
+        VecR V(5);
+        I = 2, 1, 2, 3, 2;
+        J = 3, 1, 3, 2, 1;
+        V = 1, 2, 3, 4, 5;
+        MatR D(3, 3);
+        D = 2, 0, 0,
+                5, 0, 4,
+                0, 4, 0;
+        for (NumB isCsc = 0; isCsc <= 1; ++isCsc) {
+            S.setFromTriplets(3, 3, I, J, V, isCsc);
+            MATH21_PASS(S.nnz() == 4);
+            math21_operator_sparse_to_dense(S, A2);
+            MATH21_PASS(math21_operator_isEqual(A2, D, 0));
+        }
+
+        // products with dense, op(A) is A or A.transpose, in both formats.
+        NumN n = 300, r = 200;
+        MatR B, C, C_ref, X(r, 7), X_t(n, 7);
+        VecR x(r), x_t(n), y, y_ref;
+        test_sparse_draw(n, r, 0.05, engine, A);
+        math21_random_draw(X, ran);
+        math21_random_draw(X_t, ran);
+        math21_random_draw(x, ran);
+        math21_random_draw(x_t, ran);
+        for (NumB isCsc = 0; isCsc <= 1; ++isCsc) {
+            math21_operator_sparse_from_dense(A, S, 0, isCsc);
+            math21_operator_sparse_multiply(2, S, x, y);
+            math21_operator_multiply(2, A, x, y_ref);
+            MATH21_PASS(y.dims() == 1 && math21_operator_isEqual(y, y_ref, MATH21_10NEG6));
+            math21_operator_sparse_multiply(2, S, X, C);
+            math21_operator_multiply(2, A, X, C_ref);
+            MATH21_PASS(math21_operator_isEqual(C, C_ref, MATH21_10NEG6));
+
+            // C = 2*A.transpose*X_t + 0.5*C
+            math21_operator_trans_multiply(2, A, X_t, C_ref);
+            C.setSize(C_ref.shape());
+            math21_random_draw(C, ran);
+            math21_operator_linear(1, C_ref, 0.5, C, B);
+            math21_operator_sparse_gemm(1, 2, S, X_t, 0.5, C);
+            MATH21_PASS(math21_operator_isEqual(C, B, MATH21_10NEG6));
+            MatR A_t;
+            math21_operator_matrix_trans(A, A_t);
+            math21_operator_sparse_gemm(1, 1, S, x_t, 0, y);
+            math21_operator_multiply(1, A_t, x_t, y_ref);
+            MATH21_PASS(math21_operator_isEqual(y, y_ref, MATH21_10NEG6));
+
+            // dense times sparse
+            MatR W(9, n);
+            math21_random_draw(W, ran);
+            math21_operator_sparse_multiply(2, W, S, C);
+            math21_operator_multiply(2, W, A, C_ref);
+            MATH21_PASS(math21_operator_isEqual(C, C_ref, MATH21_10NEG6));
+        }
+
+        // sparse times sparse, in all formats.
+        MatR A_2;
+        test_sparse_draw(r, 150, 0.05, engine, A_2);
+        math21_operator_multiply(-1, A, A_2, C_ref);
+        for (NumN k = 0; k < 4; ++k) {
+            SpMatR S_2, S_3;
+            math21_operator_sparse_from_dense(A, S, 0, k % 2);
+            math21_operator_sparse_from_dense(A_2, S_2, 0, k / 2);
+            math21_operator_sparse_multiply(-1, S, S_2, S_3);
+            MATH21_PASS(S_3.isColumnMajor() == S.isColumnMajor());
+            math21_operator_sparse_to_dense(S_3, C);
+            MATH21_PASS(math21_operator_isEqual(C, C_ref, MATH21_10NEG6));
+            math21_operator_sparse_transpose(S_3, S_2);
+            MATH21_PASS(S_2.nrows() == 150 && S_2(5, 9) == S_3(9, 5));
+        }
+
+        // large enough to run in threads.
+        n = 4000;
+        test_sparse_draw(n, n, 0.01, engine, A);
+        x.setSize(n);
+        math21_random_draw(x, ran);
+        math21_operator_multiply(1, A, x, y_ref);
+        for (NumB isCsc = 0; isCsc <= 1; ++isCsc) {
+            math21_operator_sparse_from_dense(A, S, 0, isCsc);
+            NumR t = math21_time_getticks();
+            for (NumN k = 0; k < 10; ++k) {
+                math21_operator_sparse_multiply(1, S, x, y);
+            }
+            t = math21_time_getticks() - t;
+            m21log("time 10 sparse matrix-vector products", t);
+            MATH21_PASS(math21_operator_isEqual(y, y_ref, MATH21_10NEG6));
+        }
+    }
+
+    void test_mat_fixed_is_identity(const MatR &I) {
+        for (NumN i = 1; i <= I.nrows(); ++i) {
+            for (NumN j = 1; j <= I.ncols(); ++j) {
+                MATH21_PASS(xjabs(I(i, j) - (i == j ? 1 : 0)) < MATH21_10NEG6);
+            }
+        }
+    }
+
+    template<NumN N>
+    void test_mat_fixed_inverse(RanNormal &ran) {
+        MatR A(N, N), A_inv, I;
+        math21_random_draw(A, ran);
+        MatFixed<NumR, N, N> A_f, A_f_inv, I_f;
+        A_f.assign(A);
+        MATH21_PASS(math21_operator_fixed_inverse(A_f, A_f_inv));
+        math21_operator_fixed_multiply(A_f, A_f_inv, I_f);
+        I_f.copyTo(I);
+        test_mat_fixed_is_identity(I);
+        LUDecomposition lu;
+        lu.factor(A);
+        MATH21_PASS(xjabs(math21_operator_fixed_det(A_f) - lu.determinant()) < MATH21_10NEG6);
+        A_f.setZero();
+        MATH21_PASS(!math21_operator_fixed_inverse(A_f, A_f_inv));
+    }
+
+    void test_mat_fixed() {
+        math21_tool_log_title(__FUNCTION__);
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+
+        test_mat_fixed_inverse<2>(ran);
+        test_mat_fixed_inverse<3>(ran);
+        test_mat_fixed_inverse<4>(ran);
+
+        // products agree with Tensor ones.
+        MatR A(3, 4), B(4, 2), C, C_ref;
+        math21_random_draw(A, ran);
+        math21_random_draw(B, ran);
+        MatFixed<NumR, 3, 4> A_f;
+        MatFixed<NumR, 4, 2> B_f;
+        MatFixed<NumR, 3, 2> C_f;
+        A_f.assign(A);
+        B_f.assign(B);
+        math21_operator_fixed_multiply(A_f, B_f, C_f);
+        C_f.copyTo(C);
+        math21_operator_multiply(1, A, B, C_ref);
+        MATH21_PASS(math21_operator_isEqual(C, C_ref, MATH21_10NEG6));
+        VecR x(4), y, y_ref;
+        math21_random_draw(x, ran);
+        Vec4R x_f;
+        Vec3R y_f;
+        x_f.assign(x);
+        math21_operator_fixed_multiply(A_f, x_f, y_f);
+        y_f.copyTo(y);
+        math21_operator_multiply(1, A, x, y_ref);
+        MATH21_PASS(y.dims() == 1 && math21_operator_isEqual(y, y_ref, MATH21_10NEG6));
+
+        // batched projection agrees with projection of single points.
+        NumN n = 1000;
+        MatR T(3, 3), xs(n, 3), Xs;
+        T =
+                1.2, 0.1, 3,
+                -0.2, 0.9, 4,
+                0.001, 0.002, 1;
+        math21_random_draw(xs, ran);
+        for (NumN i = 1; i <= n; ++i) {
+            xs(i, 3) = 1;
+        }
+        MATH21_PASS(geometry_project_in_batch(T, xs, Xs));
+        VecR x3(3), X3;
+        for (NumN i = 1; i <= n; i += 97) {
+            x3 = xs(i, 1), xs(i, 2), 1;
+            geometry_project(T, x3, X3);
+            MATH21_PASS(xjabs(X3(1) - Xs(i, 1)) < MATH21_10NEG6 && xjabs(X3(2) - Xs(i, 2)) < MATH21_10NEG6
+                        && Xs(i, 3) == 1);
+        }
+
+        // SoA layout, in place.
+        Mat33R T_f;
+        T_f.assign(T);
+        std::vector<NumR> px(n), py(n);
+        for (NumN i = 1; i <= n; ++i) {
+            px[i - 1] = xs(i, 1);
+            py[i - 1] = xs(i, 2);
+        }
+        MATH21_PASS(math21_la_2d_project_in_batch(T_f, n, px.data(), py.data(), px.data(), py.data()));
+        for (NumN i = 1; i <= n; ++i) {
+            MATH21_PASS(xjabs(px[i - 1] - Xs(i, 1)) < MATH21_10NEG6 && xjabs(py[i - 1] - Xs(i, 2)) < MATH21_10NEG6);
+        }
+        // a point at infinity
+        px[5] = -1000;
+        py[5] = 0;
+        MATH21_PASS(!math21_la_2d_project_in_batch(T_f, n, px.data(), py.data(), px.data(), py.data()));
+        // is kept not divided, as geometry_project does.
+        MATH21_PASS(xjabs(px[5] + 1197) < MATH21_10NEG6 && xjabs(py[5] - 204) < MATH21_10NEG6);
+
+        // 3d affine, last row of T is (0, 0, 0, 1).
+        MatR T4(4, 4), p(4, n), P;
+        math21_random_draw(T4, ran);
+        T4(4, 1) = 0, T4(4, 2) = 0, T4(4, 3) = 0, T4(4, 4) = 1;
+        math21_random_draw(p, ran);
+        for (NumN i = 1; i <= n; ++i) {
+            p(4, i) = 1;
+        }
+        math21_operator_multiply(1, T4, p, P);
+        Mat44R T4_f;
+        T4_f.assign(T4);
+        std::vector<NumR> pz(n), PX(n), PY(n), PZ(n);
+        for (NumN i = 1; i <= n; ++i) {
+            px[i - 1] = p(1, i);
+            py[i - 1] = p(2, i);
+            pz[i - 1] = p(3, i);
+        }
+        math21_la_3d_affine_transform_in_batch(T4_f, n, px.data(), py.data(), pz.data(),
+                                               PX.data(), PY.data(), PZ.data());
+        for (NumN i = 1; i <= n; ++i) {
+            MATH21_PASS(xjabs(PX[i - 1] - P(1, i)) < MATH21_10NEG6 && xjabs(PY[i - 1] - P(2, i)) < MATH21_10NEG6
+                        && xjabs(PZ[i - 1] - P(3, i)) < MATH21_10NEG6);
+        }
+
+        // 2*2 inverse, image projection
+        MatR A2(2, 2), A2_inv, I2;
+        A2 = 1, 2, 3, 4;
+        math21_operator_matrix_2_2_inverse(A2, A2_inv);
+        math21_operator_multiply(1, A2, A2_inv, I2);
+        test_mat_fixed_is_identity(I2);
+        TenR index;
+        geometry_project_image(T, 20, 30, index);
+        x3 = 7, 11, 1;
+        geometry_project(T, x3, X3);
+        MATH21_PASS(xjabs(index(1, 7, 11) - X3(1)) < MATH21_10NEG6 && xjabs(index(2, 7, 11) - X3(2)) < MATH21_10NEG6);
+    }
+
     void test_random_uniform() {
         DefaultRandomEngine engine(21);
         RanUniform ran(engine);
@@ -752,6 +1691,210 @@ namespace math21 {
         C.logInfo("C");
     }
 
+    void test_tensor_gemm() {
+        math21_tool_log_title(__FUNCTION__);
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+
+        // odd sizes cover the zero padded edge tiles.
+        NumN n = 131, r = 259, m = 67;
+        TenR A(n, r), B(r, m), C, C_ref;
+        math21_random_draw(A, ran);
+        math21_random_draw(B, ran);
+
+        NumR t = math21_time_getticks();
+        math21_operator_multiply_no_parallel(2, A, B, C_ref);
+        t = math21_time_getticks() - t;
+        m21log("time reference", t);
+
+        NumR t_gemm = math21_time_getticks();
+        math21_operator_multiply(2, A, B, C);
+        t_gemm = math21_time_getticks() - t_gemm;
+        m21log("time gemm", t_gemm);
+        MATH21_PASS(math21_operator_isEqual(C, C_ref, MATH21_10NEG6));
+
+        Tensor<float> Af(n, r), Bf(r, m), Cf, Cf_ref;
+        math21_operator_container_set(A, Af);
+        math21_operator_container_set(B, Bf);
+        math21_operator_multiply_no_parallel(1, Af, Bf, Cf_ref);
+        math21_operator_multiply(1, Af, Bf, Cf);
+        MATH21_PASS(math21_operator_isEqual(Cf, Cf_ref, 1e-3));
+    }
+
+    NumR test_tensor_simd_relative_error(const TenR &C, const TenR &C_ref) {
+        NumR err = 0;
+        for (NumN i = 1; i <= C.size(); ++i) {
+            err = xjmax(err, xjabs(C(i) - C_ref(i)) / xjmax(xjabs(C_ref(i)), MATH21_EPS));
+        }
+        return err;
+    }
+
+    void test_tensor_simd() {
+        math21_tool_log_title(__FUNCTION__);
+        m21log("simd", math21_c_vector_get_simd_name());
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 10);
+
+        NumN n = 1003;
+        TenR A(n), B(n), C(n), C_ref(n);
+        math21_random_draw(A, ran);
+        math21_random_draw(B, ran);
+
+        // relative, since compiler may contract scalar reference into fma, e.x., with -mfma.
+        math21_operator_linear(2, A, -3, B, C);
+        math21_operator_container_linear(2, A, -3, B, C_ref);
+        MATH21_PASS(test_tensor_simd_relative_error(C, C_ref) <= 1e-12);
+
+        math21_operator_SchurProduct(A, B, C);
+        math21_operator_container_SchurProduct(A, B, C_ref);
+        MATH21_PASS(test_tensor_simd_relative_error(C, C_ref) <= 1e-12);
+
+        NumR y = math21_operator_InnerProduct(1, A, B);
+        NumR y_ref = math21_operator_container_InnerProduct(1, A, B);
+        MATH21_PASS(xjabs(y - y_ref) <= MATH21_10NEG7 * xjabs(y_ref), "" << y << ", " << y_ref);
+
+        // relative error of exp and log, a few ulp.
+        NumR err_exp = 0, err_log = 0;
+        math21_operator_exp(A, C);
+        math21_operator_container_abs(A, B);
+        math21_operator_add(MATH21_EPS, B, B);
+        math21_operator_log(B, C_ref);
+        for (NumN i = 1; i <= n; ++i) {
+            err_exp = xjmax(err_exp, xjabs(C(i) - xjexp(A(i))) / xjexp(A(i)));
+            err_log = xjmax(err_log, xjabs(C_ref(i) - xjlog(B(i))) / xjabs(xjlog(B(i))));
+        }
+        m21log("exp relative error", err_exp);
+        m21log("log relative error", err_log);
+        MATH21_PASS(err_exp < 5e-16 && err_log < 5e-16);
+
+        // absolute error of sin and cos, also near multiples of pi/2 and for large x.
+        NumR err_sin = 0, err_cos = 0;
+        math21_operator_container_set(A, B);
+        for (NumN i = 1; i <= 200; ++i) {
+            B(i) = (i - 100) * MATH21_PI / 2 + (i % 3) * 1e-12;
+            B(200 + i) = B(i) * 3000;
+        }
+        math21_operator_sin(B, C);
+        math21_operator_cos(B, C_ref);
+        for (NumN i = 1; i <= n; ++i) {
+            err_sin = xjmax(err_sin, xjabs(C(i) - xjsin(B(i))));
+            err_cos = xjmax(err_cos, xjabs(C_ref(i) - xjcos(B(i))));
+        }
+        m21log("sin absolute error", err_sin);
+        m21log("cos absolute error", err_cos);
+        MATH21_PASS(err_sin < 3e-16 && err_cos < 3e-16);
+    }
+
+    void test_tensor_gemm_trans() {
+        math21_tool_log_title(__FUNCTION__);
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+
+        // large sizes go through packing, small sizes through the simple path.
+        NumN sizes[2][3] = {{131, 259, 67},
+                            {5,   7,   3}};
+        for (NumN l = 0; l < 2; ++l) {
+            NumN n = sizes[l][0], r = sizes[l][1], m = sizes[l][2];
+            TenR A(r, n), B(m, r), At, Bt, C, C_ref;
+            math21_random_draw(A, ran);
+            math21_random_draw(B, ran);
+            math21_operator_matrix_trans(A, At);
+            math21_operator_matrix_trans(B, Bt);
+
+            math21_operator_trans_multiply(2, A, Bt, C);
+            math21_operator_multiply_no_parallel(2, At, Bt, C_ref);
+            MATH21_PASS(math21_operator_isEqual(C, C_ref, MATH21_10NEG6));
+
+            math21_operator_multiply_trans(2, At, B, C);
+            MATH21_PASS(math21_operator_isEqual(C, C_ref, MATH21_10NEG6));
+
+            math21_operator_trans_multiply_trans(2, A, B, C);
+            MATH21_PASS(math21_operator_isEqual(C, C_ref, MATH21_10NEG6));
+
+            // C = 2*A.t*B.t + 3*C
+            TenR C2(n, m);
+            math21_operator_container_set(C_ref, C2);
+            math21_operator_gemm(1, 1, 2, A, B, 3, C2);
+            math21_operator_linear(4, C_ref, C_ref);
+            MATH21_PASS(math21_operator_isEqual(C2, C_ref, MATH21_10NEG6));
+        }
+    }
+
+    void test_tensor_view_strided() {
+        math21_tool_log_title(__FUNCTION__);
+        TenR A(4, 5, 6);
+        A.letters();
+
+        // contiguous and stepped ranges are strided, others are not.
+        Seqce<VecN> X;
+        X.setSize(A.dims());
+        X(1).setSize(2);
+        X(1) = 2, 3;
+        X(2).setSize(3);
+        X(2) = 1, 3, 5;
+        X(3).setSize(1);
+        X(3) = 0;
+        TenViewR tv_ = A.sliceView(X);
+        const TenViewR &tv = tv_;
+        MATH21_PASS(tv.isStrided());
+        NumN i1, i2, i3;
+        for (i1 = 1; i1 <= tv.dim(1); ++i1) {
+            for (i2 = 1; i2 <= tv.dim(2); ++i2) {
+                for (i3 = 1; i3 <= tv.dim(3); ++i3) {
+                    MATH21_PASS(tv(i1, i2, i3) == A(X(1)(i1), X(2)(i2), i3));
+                }
+            }
+        }
+        X(2) = 1, 3, 4;
+        TenViewR tv2 = A.sliceView(X);
+        MATH21_PASS(!tv2.isStrided());
+        TenR B, C;
+        tv2.toTensor(B);
+        MATH21_PASS(B(2, 3, 4) == A(3, 4, 4));
+
+        // shrink of strided view is strided.
+        VecN y(3);
+        y = 0, 2, 0;
+        TenViewR tv3_ = tv.shrinkView(y);
+        const TenViewR &tv3 = tv3_;
+        MATH21_PASS(tv3.isStrided());
+        TenR B3;
+        tv3.toTensor(B3);
+        y = 0, 3, 0;
+        math21_operator_tensor_shrink(A, C, y);
+        Seqce<VecN> Z;
+        Z.setSize(2);
+        Z(1).copyFrom(X(1));
+        Z(2).setSize(1);
+        Z(2) = 0;
+        TenR E;
+        math21_operator_tensor_slice(C, E, Z);
+        MATH21_PASS(math21_operator_isEqual(B3, E));
+
+        // container order is from left.
+        NumN k = 0;
+        for (i3 = 1; i3 <= tv3.dim(2); ++i3) {
+            for (i1 = 1; i1 <= tv3.dim(1); ++i1) {
+                ++k;
+                MATH21_PASS(tv3(k) == tv3(i1, i3));
+            }
+        }
+
+        // write through strided sub.
+        y = 0, 0, 2;
+        TenSubR ts = A.shrinkSub(y);
+        MATH21_PASS(ts.isStrided());
+        ts(4, 5) = -1;
+        MATH21_PASS(A(4, 5, 2) == -1);
+        TenR D(4, 5);
+        D = 7;
+        ts.assign(D);
+        MATH21_PASS(A(1, 1, 2) == 7 && A(3, 4, 2) == 7 && A(3, 4, 3) != 7);
+    }
+
     void test_tensor() {
 //        test_num_NumN_and_NumZ();
 //        test_array();
@@ -800,6 +1943,21 @@ namespace math21 {
 //        test_shuffle_sort();
 
 //        test_tensor_omp();
+//        test_tensor_gemm();
+//        test_tensor_simd();
+//        test_tensor_gemm_trans();
+//        test_tensor_view_strided();
+//        test_array_memory_inline();
+//        test_memory_allocator();
+//        test_memory_copy_on_write();
+//        test_tensor_move();
+//        test_tensor_expr();
+//        test_lu_cholesky();
+//        test_svd();
+//        test_qr();
+//        test_eigen_symmetric();
+//        test_sparse();
+//        test_mat_fixed();
 //        math21_cuda_test();
 //        math21_cuda_test_02();
     }
@@ -1,18 +1,19 @@
-/* Copyright 2015 The math21 Authors. All Rights Reserved.
-
-Licensed under the Apache License, Version 2.0 (the "License");
-you may not use this file except in compliance with the License.
-You may obtain a copy of the License at
-
-    http://www.apache.org/licenses/LICENSE-2.0
-
-Unless required by applicable law or agreed to in writing, software
-distributed under the License is distributed on an "AS IS" BASIS,
-WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-See the License for the specific language governing permissions and
-limitations under the License.
-==============================================================================*/
-
+/* Copyright 2015 The math21 Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstring>
 #include <fstream>
 #include "files.h"
 #include "inner.h"
@@ -145,7 +146,768 @@ namespace math21 {
 
     }
 
+    // f takes layers of config_fns, which are deleted then.
+    void test_cnn_set_layers(cnn &f, const VecN &d1, Seqce<cnn_config_fn *> &config_fns, NumB isUsingDiff = 1) {
+        f.setSize(d1, config_fns, isUsingDiff);
+        for (NumN i = 1; i <= config_fns.size(); i++) {
+            delete config_fns(i);
+        }
+    }
+
+    // random points with one-hot labels, cnn on them, and cost of cnn, shared by cnn tests.
+    struct test_cnn_fixture {
+        DefaultRandomEngine engine;
+        RanNormal ran;
+        VecN d1;
+        Seqce<TenR> X, Y;
+        cnn f;
+        CostFunctional_nll_CrossEntroy_softmax_class L;
+        cnn_cost_class *J;
+
+        // n points of shape d1, point i has label i % d2(1) + 1.
+        test_cnn_fixture(NumN n, const VecN &_d1, const VecN &d2, NumN seed, NumR sigma = 1)
+                : engine(seed), ran(engine), J(0) {
+            ran.set(0, sigma);
+            _d1.copyTo(d1);
+            X.setSize(n);
+            Y.setSize(n);
+            for (NumN i = 1; i <= n; i++) {
+                X(i).setSize(d1);
+                Y(i).setSize(d2);
+                math21_random_draw(X(i), ran);
+                Y(i) = 0;
+                Y(i)(i % d2(1) + 1, 1, 1) = 1;
+            }
+        }
+
+        virtual ~test_cnn_fixture() {
+            delete J;
+        }
+
+        void setCnn(Seqce<cnn_config_fn *> &config_fns) {
+            test_cnn_set_layers(f, d1, config_fns);
+        }
+
+        // cost on minibatch of size points from start.
+        cnn_cost_class &setCost(NumN start, NumN size) {
+            delete J;
+            J = new cnn_cost_class(f, L, X, Y, start, size);
+            return *J;
+        }
+    };
+
+    // compare derivative of conv by im2col and gemm with central difference, tiled kernels included.
+    void test_cnn_conv_gradient() {
+        math21_tool_log_title(__FUNCTION__);
+        VecN d1(3), d2(3);
+        d1 = 2, 6, 7;
+        d2 = 4, 1, 1;
+        for (NumN mt = 1; mt <= 2; ++mt) {
+            test_cnn_fixture fx(4, d1, d2, 7);
+            Seqce<cnn_config_fn *> config_fns;
+            config_fns.setSize(2);
+            VecN d(3);
+            d = 3, 3, 4;
+            config_fns(1) = new cnn_config_fn_conv(d, cnn_type_hn_tanh, 3, 3, 2, 2, mt, 3);
+            d.assign(d2);
+            config_fns(2) = new cnn_config_fn_fully(d, cnn_type_hn_linear);
+            fx.setCnn(config_fns);
+
+            cnn_cost_class &J = fx.setCost(1, 1);
+            VecR theta(J.getXDim());
+            math21_random_draw(theta, fx.ran);
+            VecR g(theta.size());
+            math21_operator_container_set(J.derivativeValueAt(theta), g);
+            NumR h = 1e-6;
+            for (NumN i = 1; i <= theta.size(); i++) {
+                NumR t = theta(i);
+                theta(i) = t + h;
+                NumR a = J.valueAt(theta);
+                theta(i) = t - h;
+                NumR b = J.valueAt(theta);
+                theta(i) = t;
+                MATH21_PASS(xjabs((a - b) / (2 * h) - g(i)) < 1e-6);
+            }
+        }
+    }
+
+    // batch execution must agree with one point at a time, layers without batch version included.
+    void test_cnn_batch() {
+        math21_tool_log_title(__FUNCTION__);
+        VecN d1(3), d2(3);
+        d1 = 2, 8, 8;
+        d2 = 3, 1, 1;
+        test_cnn_fixture fx(7, d1, d2, 11);
+        Seqce<cnn_config_fn *> config_fns;
+        config_fns.setSize(4);
+        VecN d(3);
+        d = 4, 6, 6;
+        config_fns(1) = new cnn_config_fn_conv(d, cnn_type_hn_ReLU, 3, 3, 1, 1, 2, 1);
+        d = 4, 3, 3;
+        config_fns(2) = new cnn_config_fn_pooling(d, cnn_type_pooling_max);
+        d = 5, 2, 2;
+        config_fns(3) = new cnn_config_fn_locally(d, cnn_type_hn_tanh, 2, 2, 1, 1);
+        d.assign(d2);
+        config_fns(4) = new cnn_config_fn_fully(d, cnn_type_hn_linear);
+        fx.setCnn(config_fns);
+
+        cnn_cost_class &J = fx.setCost(2, 5);
+        VecR theta(J.getXDim());
+        math21_random_draw(theta, fx.ran);
+
+        J.setUsingBatch(0);
+        NumR value = J.valueAt(theta);
+        VecR g(theta.size());
+        math21_operator_container_set(J.derivativeValueAt(theta), g);
+
+        J.setUsingBatch(1);
+        J.setBatchSizeMax(2);
+        MATH21_PASS(xjabs(J.valueAt(theta) - value) < 1e-10);
+        MATH21_PASS(math21_operator_isEqual(J.derivativeValueAt(theta), g, 1e-10));
+    }
+
+    // loss which can't be cloned, as out-of-tree ones written before clone.
+    class test_cnn_loss_no_clone : public CostFunctional_nll_CrossEntroy_softmax_class {
+    public:
+        CostFunctional_class *clone() const override {
+            return 0;
+        }
+    };
+
+    // data parallel cost must agree with serial one, parts of threads have different sizes.
+    void test_cnn_parallel() {
+        math21_tool_log_title(__FUNCTION__);
+        VecN d1(3), d2(3);
+        d1 = 1, 7, 7;
+        d2 = 4, 1, 1;
+        test_cnn_fixture fx(9, d1, d2, 13);
+        Seqce<cnn_config_fn *> config_fns;
+        config_fns.setSize(3);
+        VecN d(3);
+        d = 3, 5, 5;
+        config_fns(1) = new cnn_config_fn_conv(d, cnn_type_hn_tanh, 3, 3, 1, 1, 1, 1);
+        d = 3, 2, 2;
+        config_fns(2) = new cnn_config_fn_pooling(d, cnn_type_pooling_average);
+        d.assign(d2);
+        config_fns(3) = new cnn_config_fn_fully(d, cnn_type_hn_linear);
+        fx.setCnn(config_fns);
+
+        cnn_cost_class &J = fx.setCost(3, 8);
+        J.setBatchSizeMax(2);
+        VecR theta(J.getXDim());
+        math21_random_draw(theta, fx.ran);
+
+        NumR value = J.valueAt(theta);
+        VecR g(theta.size());
+        math21_operator_container_set(J.derivativeValueAt(theta), g);
+
+        J.setThreadNumber(3);
+        MATH21_PASS(xjabs(J.valueAt(theta) - value) < 1e-10);
+        MATH21_PASS(math21_operator_isEqual(J.derivativeValueAt(theta), g, 1e-10));
+        // again, workspaces are reused.
+        MATH21_PASS(math21_operator_isEqual(J.derivativeValueAt(theta), g, 1e-10));
+
+        // falls back to one thread.
+        test_cnn_loss_no_clone L2;
+        cnn_cost_class J2(fx.f, L2, fx.X, fx.Y, 3, 8);
+        J2.setBatchSizeMax(2);
+        J2.setThreadNumber(3);
+        MATH21_PASS(xjabs(J2.valueAt(theta) - value) < 1e-10);
+        MATH21_PASS(math21_operator_isEqual(J2.derivativeValueAt(theta), g, 1e-10));
+    }
+
+    // weight penalty of a network with 1M parameters,
+    // once for every point of minibatch as before vs once for the minibatch, and cached for evaluation.
+    void test_cnn_penalty_benchmark() {
+        math21_tool_log_title(__FUNCTION__);
+        NumN minibatch_size = 32;
+        VecN d1(3), d2(3);
+        d1 = 1, 32, 32;
+        d2 = 1000, 1, 1;
+        test_cnn_fixture fx(minibatch_size, d1, d2, 17, 0.01);
+        cnn &f = fx.f;
+        Seqce<cnn_config_fn *> config_fns;
+        config_fns.setSize(1);
+        config_fns(1) = new cnn_config_fn_fully(d2, cnn_type_hn_linear);
+        fx.setCnn(config_fns);
+
+        cnn_cost_class &J = fx.setCost(1, minibatch_size);
+        VecR theta(J.getXDim());
+        math21_random_draw(theta, fx.ran);
+
+        timer t;
+        NumR penalty = 0;
+        t.start();
+        for (NumN i = 1; i <= minibatch_size; i++) {
+            penalty = penalty + f.calWeightNormSquare(theta, 2);
+        }
+        t.end();
+        NumR time_per_point = t.time();
+        t.start();
+        penalty = f.calWeightNormSquare(theta, 2);
+        t.end();
+        NumR time_once = t.time();
+        t.start();
+        NumR value = J.valueAt(theta);
+        t.end();
+        NumR time_value = t.time();
+
+        f.setTheta(theta);
+        TenR y_hat;
+        y_hat.setSize(d2);
+        math21_operator_container_set(f.valueAt(fx.X(1)), y_hat);
+        t.start();
+        for (NumN i = 1; i <= minibatch_size; i++) {
+            J.valueAt_cnn_y(f, y_hat, fx.Y(i));
+        }
+        t.end();
+        NumR time_evaluate = t.time();
+        MATH21_PASS(xjabs(f.calWeightNormSquare(2) - penalty) < 1e-10);
+
+        m21log("theta size", theta.size());
+        m21log("penalty for every point (ms)", time_per_point);
+        m21log("penalty once (ms)", time_once);
+        m21log("J.valueAt (ms)", time_value, value);
+        m21log("loss of points with cached penalty (ms)", time_evaluate);
+    }
+
+    // frozen cnn must give the same outputs, tiled conv included.
+    void test_cnn_freeze() {
+        math21_tool_log_title(__FUNCTION__);
+        NumN n_samples = 3;
+        VecN d1(3);
+        d1 = 2, 8, 8;
+        DefaultRandomEngine engine(19);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+        TenR X;
+        X.setSize(n_samples, d1(1), d1(2), d1(3));
+        math21_random_draw(X, ran);
+
+        cnn f;
+        Seqce<cnn_config_fn *> config_fns;
+        config_fns.setSize(4);
+        VecN d(3);
+        d = 4, 6, 6;
+        config_fns(1) = new cnn_config_fn_conv(d, cnn_type_hn_ReLU, 3, 3, 1, 1, 2, 3);
+        d = 4, 3, 3;
+        config_fns(2) = new cnn_config_fn_pooling(d, cnn_type_pooling_max);
+        d = 6, 1, 1;
+        config_fns(3) = new cnn_config_fn_fully(d, cnn_type_hn_tanh);
+        d = 3, 1, 1;
+        config_fns(4) = new cnn_config_fn_fully(d, cnn_type_hn_linear);
+        test_cnn_set_layers(f, d1, config_fns);
+        VecR theta(f.getThetaSize());
+        math21_random_draw(theta, ran);
+        f.setTheta(theta);
+
+        Seqce<TenR> Y(n_samples);
+        TenR x;
+        for (NumN i = 1; i <= n_samples; i++) {
+            math21_operator_share_first_dim_slice(X, i, x);
+            Y(i).setSize(f.valueAt(x).shape());
+            math21_operator_container_set(f.valueAt(x), Y(i));
+        }
+
+        f.freeze();
+        for (NumN i = 1; i <= n_samples; i++) {
+            math21_operator_share_first_dim_slice(X, i, x);
+            MATH21_PASS(math21_operator_isEqual(f.valueAt(x), Y(i), 1e-12));
+        }
+        const TenR &Y_batch = f.valueAt_batch(X);
+        TenR y;
+        for (NumN i = 1; i <= n_samples; i++) {
+            math21_operator_share_first_dim_slice(Y_batch, i, y);
+            MATH21_PASS(math21_operator_isEqual(y, Y(i), 1e-12));
+        }
+    }
+
+    // fused hn must agree with the Function classes it replaces in cnn layers.
+    void test_cnn_hn_fused() {
+        math21_tool_log_title(__FUNCTION__);
+        NumN n = 100;
+        DefaultRandomEngine engine(21);
+        RanNormal ran(engine);
+        ran.set(0, 3);
+        VecR x(n), b(n), dy_next(n);
+        math21_random_draw(x, ran);
+        math21_random_draw(b, ran);
+        math21_random_draw(dy_next, ran);
+
+        NumN types[4] = {cnn_type_hn_linear, cnn_type_hn_tanh, cnn_type_hn_ReLU, cnn_type_hn_LogSigmoid};
+        Function *fs[4] = {new Function_linear(), new Function_tanh(), new Function_LeakyReLU(),
+                           new Function_LogSigmoid()};
+        for (NumN k = 0; k < 4; ++k) {
+            VecR y(n), dy(n);
+            math21_operator_container_set(x, y);
+            math21_c_cnn_hn_bias_valueAt(types[k], n, math21_memory_tensor_data_address((const VecR &) b),
+                                         math21_memory_tensor_data_address(y));
+            math21_c_cnn_hn_derivativeValue_using_y(types[k], n,
+                                                    math21_memory_tensor_data_address((const VecR &) dy_next),
+                                                    math21_memory_tensor_data_address((const VecR &) y),
+                                                    math21_memory_tensor_data_address(dy));
+            for (NumN i = 1; i <= n; ++i) {
+                NumR y0 = fs[k]->valueAt(x(i) + b(i));
+                NumR dy0 = dy_next(i) * fs[k]->derivativeValue_using_y(y0);
+                MATH21_PASS(xjabs(y(i) - y0) < MATH21_EPS && xjabs(dy(i) - dy0) < MATH21_EPS,
+                            math21_type2string_cnn(types[k]));
+            }
+            delete fs[k];
+        }
+
+        // tanh near 0, where tanh(x) ~ x, and far from 0, relative to std::tanh and float path.
+        NumN m = 8;
+        NumR xs[8] = {1e-12, -3e-9, 2e-6, -1e-4, 0.01, -0.49, 0.51, -400};
+        NumR ys[8];
+        float ys_f[8];
+        for (NumN i = 0; i < m; ++i) {
+            ys[i] = xs[i];
+            ys_f[i] = (float) xs[i];
+        }
+        math21_c_cnn_hn_bias_valueAt(cnn_type_hn_tanh, m, (const NumR *) 0, ys);
+        math21_c_cnn_hn_bias_valueAt(cnn_type_hn_tanh, m, (const float *) 0, ys_f);
+        for (NumN i = 0; i < m; ++i) {
+            NumR y0 = std::tanh(xs[i]);
+            MATH21_PASS(xjabs(ys[i] - y0) <= 4e-16 * xjabs(y0), xs[i] << ", " << ys[i] << ", " << y0);
+            MATH21_PASS(xjabs(ys[i] - ys_f[i]) <= 1e-6 * xjabs(ys[i]), xs[i] << ", " << ys_f[i]);
+        }
+    }
+
+    // pooling layer must agree with math21_operator_ml_pooling_valueAt, its batch with single samples,
+    // and its derivative with finite difference.
+    void test_cnn_pooling() {
+        math21_tool_log_title(__FUNCTION__);
+        DefaultRandomEngine engine(23);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+        NumN n_samples = 3;
+        // 2x2, 3x3 and general windows
+        NumN shapes[4][4] = {{8, 8, 4, 4},
+                             {7, 7, 3, 3},
+                             {9, 9, 3, 3},
+                             {7, 9, 2, 3}};
+        NumN types[2] = {cnn_type_pooling_max, cnn_type_pooling_average};
+        for (NumN k = 0; k < 4; ++k) {
+            for (NumN l = 0; l < 2; ++l) {
+                VecN d1(3), d2(3);
+                d1 = 2, shapes[k][0], shapes[k][1];
+                d2 = 2, shapes[k][2], shapes[k][3];
+                NumN mk, nk, ms, ns;
+                math21_operator_ml_pooling_get_mk_ms(d1(2), d1(3), d2(2), d2(3), mk, nk, ms, ns);
+                cnn_fn_pooling fn(d1, d2, types[l], 1);
+
+                TenR X, dY;
+                X.setSize(n_samples, d1(1), d1(2), d1(3));
+                dY.setSize(n_samples, d2(1), d2(2), d2(3));
+                math21_random_draw(X, ran);
+                math21_random_draw(dY, ran);
+                fn.valueAt_batch(X);
+                fn.derivativeValueAtTheta_and_xn_J_batch(X, dY, 0);
+                TenR x, dy, y_batch, dx_batch, y0;
+                y0.setSize(d2);
+                for (NumN n = 1; n <= n_samples; ++n) {
+                    math21_operator_share_first_dim_slice(X, n, x);
+                    math21_operator_share_first_dim_slice(dY, n, dy);
+                    math21_operator_share_first_dim_slice(fn.getValue_batch(), n, y_batch);
+                    math21_operator_share_first_dim_slice(fn.get_derivativeValue_J_batch(), n, dx_batch);
+                    math21_operator_ml_pooling_valueAt(x, y0, types[l], mk, nk, ms, ns);
+                    MATH21_PASS(math21_operator_isEqual(fn.valueAt(x), y0));
+                    MATH21_PASS(math21_operator_isEqual(y_batch, y0));
+                    fn.derivativeValueAtTheta_and_xn_J(x, dy, 0);
+                    MATH21_PASS(math21_operator_isEqual(fn.get_derivativeValue_J(), dx_batch));
+                }
+
+                // d(dy . y)/dx
+                NumR h = 1e-6;
+                math21_operator_share_first_dim_slice(X, 1, x);
+                math21_operator_share_first_dim_slice(dY, 1, dy);
+                fn.valueAt(x);
+                fn.derivativeValueAtTheta_and_xn_J(x, dy, 0);
+                TenR dx;
+                dx.setSize(d1);
+                math21_operator_container_set(fn.get_derivativeValue_J(), dx);
+                for (NumN i = 1; i <= dx.size(); ++i) {
+                    NumR x_i = x(i);
+                    x(i) = x_i + h;
+                    NumR a = math21_operator_InnerProduct(1, dy, fn.valueAt(x));
+                    x(i) = x_i - h;
+                    NumR b = math21_operator_InnerProduct(1, dy, fn.valueAt(x));
+                    x(i) = x_i;
+                    MATH21_PASS(xjabs((a - b) / (2 * h) - dx(i)) < 1e-6);
+                }
+            }
+        }
+
+        // ties go to the first max in row-major order, for vector and scalar windows alike.
+        {
+            VecN d1(3), d2(3);
+            d1 = 1, 7, 7;
+            d2 = 1, 3, 3;
+            cnn_fn_pooling fn(d1, d2, cnn_type_pooling_max, 1);
+            TenR x, dy;
+            x.setSize(d1);
+            dy.setSize(d2);
+            x = 1;
+            dy = 1;
+            fn.valueAt(x);
+            fn.derivativeValueAtTheta_and_xn_J(x, dy, 0);
+            const TenR &dx = fn.get_derivativeValue_J();
+            MATH21_PASS(dx(1, 1, 1) == 1 && dx(1, 1, 2) == 0 && dx(1, 3, 3) == 1 && dx(1, 5, 5) == 1);
+            MATH21_PASS(dx(1, 7, 7) == 0 && math21_operator_container_sum(dx, 1) == 9);
+        }
+
+        // timing of the generic function and the layer.
+        VecN d1(3), d2(3);
+        d1 = 32, 64, 64;
+        d2 = 32, 32, 32;
+        NumN mk, nk, ms, ns;
+        math21_operator_ml_pooling_get_mk_ms(d1(2), d1(3), d2(2), d2(3), mk, nk, ms, ns);
+        cnn_fn_pooling fn(d1, d2, cnn_type_pooling_max, 1);
+        TenR x, y0;
+        x.setSize(d1);
+        y0.setSize(d2);
+        math21_random_draw(x, ran);
+        Seqce<TenN> xn_argmax(2);
+        xn_argmax(1).setSize(d2);
+        xn_argmax(2).setSize(d2);
+        NumN n_times = 20;
+        timer t;
+        t.start();
+        for (NumN i = 1; i <= n_times; ++i) {
+            math21_operator_ml_pooling_valueAt(x, y0, cnn_type_pooling_max, mk, nk, ms, ns, &xn_argmax, 1);
+        }
+        t.end();
+        NumR time_generic = t.time();
+        t.start();
+        for (NumN i = 1; i <= n_times; ++i) {
+            fn.valueAt(x);
+        }
+        t.end();
+        NumR time_layer = t.time();
+        MATH21_PASS(math21_operator_isEqual(fn.valueAt(x), y0));
+        m21log("max pooling 2x2, generic (ms)", time_generic);
+        m21log("max pooling 2x2, layer (ms)", time_layer);
+    }
+
+    // checkpoint must give the same cnn with theta in mapped file, and load fast.
+    void test_cnn_checkpoint() {
+        math21_tool_log_title(__FUNCTION__);
+        NumN n_samples = 2;
+        VecN d1(3);
+        d1 = 2, 8, 8;
+        DefaultRandomEngine engine(29);
+        RanNormal ran(engine);
+        ran.set(0, 1);
+        TenR X;
+        X.setSize(n_samples, d1(1), d1(2), d1(3));
+        math21_random_draw(X, ran);
+
+        cnn f;
+        Seqce<cnn_config_fn *> config_fns;
+        config_fns.setSize(3);
+        VecN d(3);
+        d = 4, 6, 6;
+        config_fns(1) = new cnn_config_fn_conv(d, cnn_type_hn_ReLU, 3, 3, 1, 1, 1, 1);
+        d = 4, 3, 3;
+        config_fns(2) = new cnn_config_fn_pooling(d, cnn_type_pooling_max);
+        d = 3, 1, 1;
+        config_fns(3) = new cnn_config_fn_fully(d, cnn_type_hn_tanh);
+        test_cnn_set_layers(f, d1, config_fns);
+        VecR theta(f.getThetaSize());
+        math21_random_draw(theta, ran);
+        f.setTheta(theta);
+        TenR Y;
+        Y.setSize(f.valueAt_batch(X).shape());
+        math21_operator_container_set(f.valueAt_batch(X), Y);
+
+        const char *name = "test_cnn_checkpoint.bin";
+        MATH21_PASS(math21_cnn_checkpoint_save(name, f, theta));
+        {
+            cnn_checkpoint checkpoint;
+            MATH21_PASS(checkpoint.open(name));
+            MATH21_PASS(checkpoint.getNumberOfLayers() == 3);
+            MATH21_PASS(checkpoint.getLayer(2).type == cnn_type_fn_pooling);
+            cnn g;
+            checkpoint.getModel(g);
+            const NumR *theta_data = math21_memory_tensor_data_address(checkpoint.getTheta());
+            MATH21_PASS(math21_memory_tensor_data_address(g.getTheta()) == theta_data);
+            MATH21_PASS((NumN) theta_data % MATH21_CNN_CHECKPOINT_ALIGNMENT == 0);
+            MATH21_PASS(math21_operator_isEqual(g.valueAt_batch(X), Y));
+            g.freeze();
+            MATH21_PASS(math21_operator_isEqual(g.valueAt_batch(X), Y));
+            // theta of g is copied when set again, so the file isn't written.
+            g.setTheta(theta);
+            g.clear();
+        }
+
+        // truncated file is rejected.
+        {
+            std::ifstream in(name, std::ifstream::binary);
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            in.close();
+            std::ofstream out(name, std::ofstream::binary);
+            out.write(data.data(), data.size() - sizeof(NumR));
+            out.close();
+            cnn_checkpoint checkpoint;
+            MATH21_PASS(!checkpoint.open(name));
+
+            // so is number of layers making size of layer table wrap around.
+            NumN64 n_layers = (NumN64) 1 << 61;
+            std::memcpy(&data[sizeof(cnn_checkpoint_header)], &n_layers, sizeof(n_layers));
+            out.open(name, std::ofstream::binary);
+            out.write(data.data(), data.size());
+            out.close();
+            MATH21_PASS(!checkpoint.open(name));
+        }
+
+        // loading time of a network with 1M parameters.
+        cnn h;
+        d1 = 1, 32, 32;
+        config_fns.setSize(1);
+        d = 1000, 1, 1;
+        config_fns(1) = new cnn_config_fn_fully(d, cnn_type_hn_linear);
+        test_cnn_set_layers(h, d1, config_fns, 0);
+        theta.setSize(h.getThetaSize());
+        math21_random_draw(theta, ran);
+        MATH21_PASS(math21_cnn_checkpoint_save(name, h, theta));
+        const char *name_old = "test_cnn_checkpoint_old.bin";
+        std::ofstream out;
+        out.open(name_old, std::ofstream::binary);
+        math21_serialize_model(out, h, theta);
+        out.close();
+
+        timer t;
+        t.start();
+        cnn h1;
+        VecR theta1;
+        std::ifstream in;
+        in.open(name_old, std::ifstream::binary);
+        math21_deserialize_model(in, h1, theta1);
+        in.close();
+        h1.setTheta(theta1);
+        t.end();
+        NumR time_old = t.time();
+        t.start();
+        cnn h2;
+        cnn_checkpoint checkpoint;
+        checkpoint.open(name);
+        checkpoint.getModel(h2);
+        t.end();
+        NumR time_checkpoint = t.time();
+        MATH21_PASS(math21_operator_isEqual(h2.getTheta(), theta1));
+        h2.clear();
+        checkpoint.close();
+        std::remove(name);
+        std::remove(name_old);
+        m21log("theta size", theta.size());
+        m21log("math21_deserialize_model (ms)", time_old);
+        m21log("cnn_checkpoint (ms)", time_checkpoint);
+    }
+
+    // batch in float must agree with NumR within precision of float, in serial and in parallel.
+    void test_cnn_float() {
+        math21_tool_log_title(__FUNCTION__);
+        VecN d1(3), d2(3);
+        d1 = 2, 8, 8;
+        d2 = 3, 1, 1;
+        test_cnn_fixture fx(7, d1, d2, 31);
+        cnn &f = fx.f;
+        RanNormal &ran = fx.ran;
+        Seqce<cnn_config_fn *> config_fns;
+        config_fns.setSize(5);
+        VecN d(3);
+        d = 4, 6, 6;
+        config_fns(1) = new cnn_config_fn_conv(d, cnn_type_hn_ReLU, 3, 3, 1, 1, 2, 1);
+        d = 4, 3, 3;
+        config_fns(2) = new cnn_config_fn_pooling(d, cnn_type_pooling_max);
+        d = 5, 2, 2;
+        config_fns(3) = new cnn_config_fn_locally(d, cnn_type_hn_tanh, 2, 2, 1, 1);
+        d = 6, 1, 1;
+        config_fns(4) = new cnn_config_fn_fully(d, cnn_type_hn_LogSigmoid);
+        d.assign(d2);
+        config_fns(5) = new cnn_config_fn_fully(d, cnn_type_hn_linear);
+        fx.setCnn(config_fns);
+
+        cnn_cost_class &J = fx.setCost(2, 5);
+        J.setBatchSizeMax(3);
+        VecR theta(J.getXDim());
+        math21_random_draw(theta, ran);
+        math21_operator_linear_to(0.3, theta);
+
+        NumR value = J.valueAt(theta);
+        VecR g(theta.size());
+        math21_operator_container_set(J.derivativeValueAt(theta), g);
+
+        f.setUsingFloat(1);
+        MATH21_PASS(f.getUsingFloat());
+        NumR value_f = J.valueAt(theta);
+        VecR g_f(theta.size());
+        math21_operator_container_set(J.derivativeValueAt(theta), g_f);
+        MATH21_PASS(xjabs(value_f - value) < 1e-4 * (1 + xjabs(value)));
+        MATH21_PASS(math21_operator_isEqual(g_f, g, 1e-4));
+
+        // threads split batches differently, so sums in float differ by rounding.
+        J.setThreadNumber(2);
+        MATH21_PASS(xjabs(J.valueAt(theta) - value_f) < 1e-6);
+        MATH21_PASS(math21_operator_isEqual(J.derivativeValueAt(theta), g_f, 1e-5));
+
+        f.setUsingFloat(0);
+        MATH21_PASS(xjabs(J.valueAt(theta) - value) < 1e-10);
+
+        // timing of a fully layer batch, NumR and float.
+        d1 = 1, 32, 32;
+        config_fns.setSize(1);
+        d = 512, 1, 1;
+        config_fns(1) = new cnn_config_fn_fully(d, cnn_type_hn_ReLU);
+        cnn h;
+        test_cnn_set_layers(h, d1, config_fns, 0);
+        theta.setSize(h.getThetaSize());
+        math21_random_draw(theta, ran);
+        h.setTheta(theta);
+        TenR X_batch;
+        X_batch.setSize(64, d1(1), d1(2), d1(3));
+        math21_random_draw(X_batch, ran);
+        NumN n_times = 5;
+        timer t;
+        t.start();
+        for (NumN i = 1; i <= n_times; ++i) {
+            h.valueAt_batch(X_batch);
+        }
+        t.end();
+        NumR time_r = t.time();
+        h.setUsingFloat(1);
+        t.start();
+        for (NumN i = 1; i <= n_times; ++i) {
+            h.valueAt_batch(X_batch);
+        }
+        t.end();
+        NumR time_f = t.time();
+        m21log("fully 1024x512, batch 64, NumR (ms)", time_r);
+        m21log("fully 1024x512, batch 64, float (ms)", time_f);
+    }
+
+    // minibatches from pipeline must follow the order given by seed, whatever the thread number,
+    // and cost on them must be that on the same points in memory.
+    void test_cnn_data_pipeline() {
+        math21_tool_log_title(__FUNCTION__);
+        VecN d1(3), d2(3);
+        d1 = 1, 8, 8;
+        d2 = 3, 1, 1;
+        test_cnn_fixture fx(10, d1, d2, 37);
+        const Seqce<TenR> &X = fx.X;
+        const Seqce<TenR> &Y = fx.Y;
+        cnn_data_source_memory source(X, Y);
+
+        // in order, minibatches run across epochs.
+        {
+            cnn_data_pipeline pipeline(source, 4, 3, 3);
+            pipeline.start();
+            for (NumN k = 1; k <= 6; ++k) {
+                pipeline.next();
+                MATH21_PASS(pipeline.getMinibatchNumber() == k);
+                for (NumN i = 1; i <= 4; ++i) {
+                    NumN index = ((k - 1) * 4 + i - 1) % 10 + 1;
+                    MATH21_PASS(pipeline.getIndexes()(i) == index);
+                    MATH21_PASS(math21_operator_isEqual(pipeline.getPoints_x()(i), X(index)));
+                    MATH21_PASS(math21_operator_isEqual(pipeline.getPoints_y()(i), Y(index)));
+                }
+            }
+        }
+
+        // shuffled, every epoch has every point once, and order doesn't depend on thread number.
+        VecN order_1(20), order_2(20);
+        for (NumN l = 1; l <= 2; ++l) {
+            cnn_data_pipeline pipeline(source, 5, l == 1 ? 1 : 4, 2);
+            pipeline.setShuffle(1, 7);
+            pipeline.start();
+            VecN &order = l == 1 ? order_1 : order_2;
+            for (NumN k = 1; k <= 4; ++k) {
+                pipeline.next();
+                for (NumN i = 1; i <= 5; ++i) {
+                    NumN index = pipeline.getIndexes()(i);
+                    order((k - 1) * 5 + i) = index;
+                    MATH21_PASS(math21_operator_isEqual(pipeline.getPoints_x()(i), X(index)));
+                }
+            }
+            pipeline.stop();
+        }
+        MATH21_PASS(math21_operator_isEqual(order_1, order_2));
+        for (NumN e = 0; e < 2; ++e) {
+            VecN count(10);
+            count = 0;
+            for (NumN i = 1; i <= 10; ++i) {
+                count(order_1(e * 10 + i)) += 1;
+            }
+            for (NumN i = 1; i <= 10; ++i) {
+                MATH21_PASS(count(i) == 1);
+            }
+        }
+
+        // resized to input shape.
+        {
+            VecN d(3);
+            d = 1, 4, 4;
+            cnn_data_pipeline pipeline(source, 2, 2, 2);
+            pipeline.setInputShape(d);
+            pipeline.start();
+            pipeline.next();
+            TenR x;
+            x.setSize(d);
+            math21_img_resize(X(1), x);
+            MATH21_PASS(math21_operator_isEqual(pipeline.getPoints_x()(1), x));
+        }
+
+        // cost on minibatch from pipeline is that on the same points in memory.
+        Seqce<cnn_config_fn *> config_fns;
+        config_fns.setSize(2);
+        VecN d(3);
+        d = 1, 4, 4;
+        config_fns(1) = new cnn_config_fn_pooling(d, cnn_type_pooling_max);
+        d.assign(d2);
+        config_fns(2) = new cnn_config_fn_fully(d, cnn_type_hn_linear);
+        fx.setCnn(config_fns);
+        cnn_data_pipeline pipeline(source, 4, 2, 3);
+        cnn_cost_class J(fx.f, fx.L, pipeline);
+        J.setBatchSizeMax(3);
+        VecR theta(J.getXDim());
+        math21_random_draw(theta, fx.ran);
+        J.updateParas();
+        MATH21_PASS(pipeline.getMinibatchNumber() == 2);
+
+        Seqce<TenR> X_2, Y_2;
+        X_2.setSize(4);
+        Y_2.setSize(4);
+        for (NumN i = 1; i <= 4; ++i) {
+            X_2(i).setSize(d1);
+            Y_2(i).setSize(d2);
+            X_2(i).assign(X(4 + i));
+            Y_2(i).assign(Y(4 + i));
+        }
+        cnn_cost_class J_2(fx.f, fx.L, X_2, Y_2, 1, 4);
+        NumR value = J_2.valueAt(theta);
+        VecR g(theta.size());
+        math21_operator_container_set(J_2.derivativeValueAt(theta), g);
+        MATH21_PASS(xjabs(J.valueAt(theta) - value) < 1e-10);
+        MATH21_PASS(math21_operator_isEqual(J.derivativeValueAt(theta), g, 1e-10));
+        J.setThreadNumber(2);
+        MATH21_PASS(math21_operator_isEqual(J.derivativeValueAt(theta), g, 1e-10));
+        J.setThreadNumber(1);
+        J.setUsingBatch(0);
+        MATH21_PASS(xjabs(J.valueAt(theta) - value) < 1e-10);
+    }
+
     void test_opt() {
+        test_cnn_data_pipeline();
+        test_cnn_float();
+        test_cnn_checkpoint();
+        test_cnn_pooling();
+        test_cnn_hn_fused();
+        test_cnn_freeze();
+        // benchmark
+//        test_cnn_penalty_benchmark();
+        test_cnn_parallel();
+        test_cnn_batch();
+        test_cnn_conv_gradient();
         test_steepest_decent();
         test_ConjugateGradient();
 